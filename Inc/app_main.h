@@ -31,13 +31,18 @@
 
  /* Exported types ------------------------------------------------------------*/
 
-#define TASK_MAIN_DELAY_MS          200
+#define MAIN_EVENT_QUEUE_SIZE       8
+#define MAIN_BUTTON_DEBOUNCE_MS     20
+#define MAIN_BUTTON_LOCKOUT_MS      2000          // a held button triggers again after this time
+#define MAIN_HEARTBEAT_MS           2000
+#define MAIN_PREP_STEP_MS           50            // gap between the preparation outputs and settle time after the last
 
 #define MAIN_SD_PRESENT_FLAG        0x00000001U
 #define MAIN_MOUNT_SDCARD_FLAG      0x00000002U
 #define MAIN_CREATE_FOLDERS_FLAG    0x00000004U
 #define MAIN_OPEN_FILE_FLAG         0x00000008U
 #define MAIN_IO_EXPANDER_FLAG       0x00000010U
+#define MAIN_OPERATION_FLAG         0x00000020U   // set from preparation until the stop button
 
  typedef enum
  {
@@ -47,19 +52,29 @@
    STATE_MAIN_START_IDLE,
  }mainState_t;
 
+ typedef enum
+ {
+   MAIN_EVENT_BUTTON = 0,                   // debounced start button press
+   MAIN_EVENT_BUTTON_UNLOCK,                // button lockout timer expired
+   MAIN_EVENT_HEARTBEAT,
+   MAIN_EVENT_START,                        // start the screw operation
+   MAIN_EVENT_DONE,                         // work of the current state finished
+   MAIN_EVENT_ABORT,                        // work of the current state failed
+ }mainEvent_t;
+
  /* Exported constants --------------------------------------------------------*/
  /* Exported macro ------------------------------------------------------------*/
  /* Exported functions ------------------------------------------------------- */
  void StartMainTask(void *argument);
- void main_task_Init(void);
- void main_task_Preparation(void);
- void main_task_Running(void);
- void main_task_Idle(uint32_t tickCount);
+ void main_task_Init(void* context);
+ void main_task_Preparation(void* context);
+ void main_task_Running(void* context);
 
- void main_ChangeCurrentState(mainState_t state);
+ mainState_t main_GetState(void);
  void main_CreateSubThreads(void);
  void main_Interrupt_Handler(uint16_t GPIO_Pin);
  void main_StartbuttonHandler(void);
+ uint32_t main_PostEvent(mainEvent_t event);
 
 #endif /* __APP_MAIN_H_ */
 
@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * @file    debounce.h
+  * @author  IBronx MDE team
+  * @brief   Port-wide input debounce header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_DEBOUNCE_H_
+#define INC_DEBOUNCE_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define DEBOUNCE_SAMPLE_MS      2             // sample period of every port
+#define DEBOUNCE_COUNTER_BITS   5             // up to 31 samples, 62 ms
+#define DEBOUNCE_DEFAULT_MS     10
+#define DEBOUNCE_PORT_MAX       8
+
+ // raw port word, one bit per input
+ typedef uint32_t (*debounceRead_t)(void);
+ // called from the timer task with the inputs that changed in this sample
+ typedef void (*debounceEdge_t)(uint32_t rose, uint32_t fell, uint32_t timestamp);
+
+ typedef struct
+ {
+   const char* name;
+   debounceRead_t pfnRead;
+   debounceEdge_t pfnEdge;                  // optional
+   uint32_t mask;                           // inputs filtered, the other bits are ignored
+
+   uint32_t threshold[DEBOUNCE_COUNTER_BITS];  // bit planes of the per input sample count
+   uint32_t count[DEBOUNCE_COUNTER_BITS];      // bit planes of the samples seen against the state
+   uint32_t state;                          // debounced inputs
+   uint32_t timestamp;                      // tick of the last edge
+ }debouncePort_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t debounce_Init(void);
+ uint32_t debounce_Register(debouncePort_t* port);
+ void debounce_SetTime(debouncePort_t* port, uint32_t inputs, uint32_t timeMs);
+ uint32_t debounce_GetState(const debouncePort_t* port);
+ uint32_t debounce_Filter(debouncePort_t* port, uint32_t sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DEBOUNCE_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
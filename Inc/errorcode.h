@@ -63,6 +63,13 @@
 #define PER_ERROR_RTC_INIT                    (PER_ERROR_BASE_NUM + 26) ///< Failed to initialize RTC peripheral module
 #define PER_ERROR_RTC_SET_DATE                (PER_ERROR_BASE_NUM + 27) ///< Failed to set RTC Date
 #define PER_ERROR_RTC_SET_TIME                (PER_ERROR_BASE_NUM + 28) ///< Failed to set RTC Time
+#define PER_ERROR_FLASH_ERASE                 (PER_ERROR_BASE_NUM + 29) ///< Failed to erase FLASH sector
+#define PER_ERROR_FLASH_PROGRAM               (PER_ERROR_BASE_NUM + 30) ///< Failed to program FLASH memory
+#define PER_ERROR_FLASH_EMPTY                 (PER_ERROR_BASE_NUM + 31) ///< No valid data found in FLASH
+#define PER_ERROR_SEQUENCE_TIMEOUT            (PER_ERROR_BASE_NUM + 32) ///< Actuator sequence condition not met in time
+#define PER_ERROR_SEQUENCE_BUSY               (PER_ERROR_BASE_NUM + 33) ///< Actuator sequencer is running another timeline
+#define PER_ERROR_QUEUE_FULL                  (PER_ERROR_BASE_NUM + 34) ///< Queue full, the item was dropped
+#define PER_ERROR_FLASH_FOREIGN               (PER_ERROR_BASE_NUM + 35) ///< FLASH area holds data of another owner
 
 #define PER_ERROR_DW1000_INIT                 (PER_ERROR_APP_NUM + 0)   ///< DWS1000 Module failed to initializations
 #define PER_ERROR_DW1000_SEND_MESSAGE         (PER_ERROR_APP_NUM + 1)   ///< DWS1000 Module failed to transmit message
@@ -81,6 +88,8 @@
 #define PER_ERROR_FATFS_DUPLICATE_FILE_OPEN   (PER_ERROR_APP_NUM + 14)   ///< FATFS failed to open duplicate file
  #define PER_ERROR_PCA9505_REGISTER_VALUE     (PER_ERROR_APP_NUM + 15)   ///< PCA9505 Wrong Register value
 #define PER_ERROR_PCA9505_DATA_SIZE           (PER_ERROR_APP_NUM + 16)   ///< PCA9505 Wrong Data size value
+#define PER_ERROR_USB_TRANSMIT                (PER_ERROR_APP_NUM + 17)   ///< USB CDC failed to transmit data
+#define PER_ERROR_LOG_QUERY_BUSY              (PER_ERROR_APP_NUM + 18)   ///< Log query already running
 
 //#define PER_ERROR_INTERNAL                    (PER_ERROR_BASE_NUM + 3)  ///< Internal Error
 //#define PER_ERROR_NO_MEM                      (PER_ERROR_BASE_NUM + 4)  ///< No Memory for operation
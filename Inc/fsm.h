@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    fsm.h
+  * @author  IBronx MDE team
+  * @brief   Table driven state machine header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_FSM_H_
+#define INC_FSM_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define FSM_QUEUE_SIZE          8             // power of two
+#define FSM_STATE_ANY           0xFF          // transition source matching every state
+#define FSM_STATE_NONE          0xFF          // transition target, run the action without leaving the state
+
+ typedef struct
+ {
+   uint8_t id;
+   uint32_t postTime;                       // clock value when the event was posted
+ }fsmEvent_t;
+
+ typedef uint32_t (*fsmClock_t)(void);
+ typedef void (*fsmHook_t)(void* context);
+ typedef bool (*fsmGuard_t)(void* context, const fsmEvent_t* event);
+ typedef void (*fsmAction_t)(void* context, const fsmEvent_t* event);
+
+ typedef struct
+ {
+   const char* name;
+   fsmHook_t pfnEntry;                      // optional
+   fsmHook_t pfnExit;                       // optional
+ }fsmState_t;
+
+ typedef struct
+ {
+   uint8_t from;                            // state or FSM_STATE_ANY
+   uint8_t event;
+   uint8_t to;                              // state or FSM_STATE_NONE
+   fsmGuard_t pfnGuard;                     // optional, the transition is skipped when false
+   fsmAction_t pfnAction;                   // optional, runs between exit and entry
+ }fsmTransition_t;
+
+ typedef struct
+ {
+   uint32_t entries;
+   uint32_t dwellTotal;                     // clock units spent in the state, excluding the current visit
+   uint32_t dwellMax;
+ }fsmStateStats_t;
+
+ typedef struct
+ {
+   uint32_t count;
+   uint32_t latencyTotal;                   // clock units from the post until the entry hook returned
+   uint32_t latencyMax;
+ }fsmTransitionStats_t;
+
+ typedef struct
+ {
+   const fsmState_t* states;
+   uint8_t stateCount;
+   const fsmTransition_t* transitions;      // searched in order, the first match is taken
+   uint8_t transitionCount;
+   fsmStateStats_t* stateStats;             // optional, stateCount entries
+   fsmTransitionStats_t* transitionStats;   // optional, transitionCount entries
+   fsmClock_t pfnClock;
+   void* context;                           // passed to every hook
+
+   uint8_t current;
+   uint32_t enteredAt;
+   fsmEvent_t queue[FSM_QUEUE_SIZE];
+   uint32_t head;
+   uint32_t tail;
+   uint32_t dropped;                        // events lost because the queue was full
+   uint32_t unhandled;                      // events without a matching transition
+   bool bDispatching;
+ }fsm_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ void fsm_Init(fsm_t* fsm, uint8_t initial);
+ uint32_t fsm_Post(fsm_t* fsm, uint8_t id);
+ uint32_t fsm_PostEvent(fsm_t* fsm, const fsmEvent_t* event);
+ uint32_t fsm_Dispatch(fsm_t* fsm);
+ uint8_t fsm_GetState(const fsm_t* fsm);
+ uint32_t fsm_GetDwell(const fsm_t* fsm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_FSM_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
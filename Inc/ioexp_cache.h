@@ -0,0 +1,102 @@
+/**
+  ******************************************************************************
+  * @file    ioexp_cache.h
+  * @author  IBronx MDE team
+  * @brief   PCA9505 IO expander register cache and input capture header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_IOEXP_CACHE_H_
+#define INC_IOEXP_CACHE_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "cmsis_os.h"
+
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define IOEXP_I2C_HANDLE        hi2c1         // shared with pca9505_control, TX DMA and I2C interrupts enabled
+#define IOEXP_I2C_ADDRESS       0x40          // 8 bit address, A2..A0 low
+#define IOEXP_PORT_COUNT        5
+#define IOEXP_FLUSH_DELAY       1             // ticks, pin changes within it go out in one burst
+#define IOEXP_RETRY_DELAY_MAX   64            // ticks, longest wait before a failed burst is resent
+#define IOEXP_IDLE_FLAG         0x00000001U
+
+#define IOEXP_INT_PIN           IOEXP_INT_Pin // PCA9505 INT, EXTI on the falling edge
+#define IOEXP_INT_PORT          IOEXP_INT_GPIO_Port
+#define IOEXP_INT_IRQn          EXTI9_5_IRQn  // EXTI line of IOEXP_INT_PIN
+#define IOEXP_SNAPSHOT_COUNT    16            // power of two
+#define IOEXP_SUBSCRIBER_MAX    4
+
+ typedef struct
+ {
+   uint32_t timestamp;                      // SYSVIEW timestamp of the INT edge, CPU cycles
+   uint8_t input[IOEXP_PORT_COUNT];
+   uint8_t changed[IOEXP_PORT_COUNT];       // pins that differ from the previous snapshot
+ }ioexpSnapshot_t;
+
+ typedef struct
+ {
+   uint8_t mask[IOEXP_PORT_COUNT];          // pins of interest, their interrupts are enabled on subscribe
+   osThreadId_t thread;                     // notified with flag when a snapshot changes a masked pin
+   uint32_t flag;
+   uint32_t tail;                           // next snapshot to read
+   uint32_t lost;                           // snapshots overwritten before they were read
+ }ioexpSubscriber_t;
+
+ typedef struct
+ {
+   uint32_t pinWrites;                      // pin changes requested
+   uint32_t skipped;                        // pin changes equal to the cached state, no bus access
+   uint32_t transactions;                   // I2C bursts started
+   uint32_t busyRetries;                    // bursts deferred because the bus was taken
+   uint32_t errors;                         // bursts failed, the flush timer resends their ports
+   uint32_t captures;                       // input snapshots taken
+ }ioexpStats_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t ioexp_Init(void);
+ uint32_t ioexp_SetOutputPin(uint8_t port, uint8_t pin, uint8_t state);
+ uint32_t ioexp_SetDirection(uint8_t port, uint8_t inputMask);
+ uint32_t ioexp_SetInterruptMask(uint8_t port, uint8_t disableMask);
+ bool ioexp_GetOutputPin(uint8_t port, uint8_t pin);
+ uint8_t ioexp_GetOutputPort(uint8_t port);
+ uint8_t ioexp_GetDirection(uint8_t port);
+ void ioexp_Flush(void);
+ uint32_t ioexp_Sync(uint32_t timeout);
+ void ioexp_GetStats(ioexpStats_t* stats);
+
+ uint32_t ioexp_Subscribe(ioexpSubscriber_t* sub);
+ bool ioexp_GetSnapshot(ioexpSubscriber_t* sub, ioexpSnapshot_t* snapshot);
+ uint8_t ioexp_GetInputPort(uint8_t port);
+ void ioexp_Capture(void);
+ void ioexp_InterruptHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_IOEXP_CACHE_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
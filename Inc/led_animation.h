@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file    led_animation.h
+  * @author  IBronx MDE team
+  * @brief   WS28xx status LED animation header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_ANIMATION_H_
+#define __LED_ANIMATION_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "led_control.h"
+#include "app_main.h"
+
+ /* Exported types ------------------------------------------------------------*/
+
+// 1: start the WS2812 driver (TIM8, DMA) and the animations at boot,
+//    the LED strip output is not enabled on this hardware yet
+#ifndef LEDANIM_ENABLE
+#define LEDANIM_ENABLE          0
+#endif
+
+#ifndef LEDANIM_FRAME_MS
+#define LEDANIM_FRAME_MS              20        // frame period, 50 frames per second
+#endif
+#define LEDANIM_BRIGHTNESS_ONE        0x0100    // 8.8 fixed point 1.0
+#define LEDANIM_BRIGHTNESS_MAX        0x01FF    // above 1.0 saturates at full scale
+
+ typedef enum
+ {
+   LEDANIM_OFF = 0,
+   LEDANIM_SOLID,
+   LEDANIM_BLINK,                           // on for the first half of the period
+   LEDANIM_BREATHE,                         // triangle fade, gamma corrected
+   LEDANIM_CHASE,                           // one LED runs along the strip per period
+ }ledAnimPattern_t;
+
+ typedef struct
+ {
+   ledAnimPattern_t pattern;
+   uint8_t red;
+   uint8_t green;
+   uint8_t blue;
+   uint16_t periodMs;
+ }ledAnimation_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t ledanim_Init(void);
+ void ledanim_Play(const ledAnimation_t* anim);
+ void ledanim_SetBrightness(uint16_t brightness);
+ void ledanim_ShowState(mainState_t state);
+ void ledanim_ShowError(uint32_t errorCode);
+ void ledanim_ClearError(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LED_ANIMATION_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -33,19 +33,69 @@
 
  /* Exported types ------------------------------------------------------------*/
 
+#ifndef MAX_WS28XX_LED
 #define MAX_WS28XX_LED                5
+#endif
 #define WS2812_FREQ                   800000  // it is fixed: WS2812 require 800kHz
 #define RGB_LED_PIXEL_SIZE            24
-#define TOTAL_RGB_LED_PIXEL_SIZE      RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED + 1
+#define TOTAL_RGB_LED_PIXEL_SIZE      (RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED + 1)
+#define RGB_LED_FRAME_SIZE            (3 * MAX_WS28XX_LED)  // compact G-R-B frame
+#define RGBLED_LATCH_US               50      // line low time that latches the frame
+#define RGBLED_FRAME_QUEUE_DEPTH      2       // frame being sent and the next one
+#define RGBLED_FRAME_DONE_FLAG        0x01
+
+// 1: stream the strip through a small circular DMA buffer refilled from the
+//    compact frame on half and full transfer, RAM no longer grows per LED
+#ifndef RGBLED_STREAMING_ENABLE
+#define RGBLED_STREAMING_ENABLE       0
+#endif
+#define RGBLED_STREAM_HALF_LEDS       4       // LEDs encoded per buffer half, 120us to refill
+#define RGBLED_STREAM_BUFFER_SIZE     (2 * RGBLED_STREAM_HALF_LEDS * RGB_LED_PIXEL_SIZE)
 #define RGB_LED_PIN                   RGBLED_Pin
 #define RGB_LED_PORT                  RGBLED_GPIO_Port
+#define RGBLED_LATCH_SLOTS            ((RGBLED_LATCH_US * (WS2812_FREQ / 1000U) + 999U) / 1000U)
+
+// output backend, the rgbled_* API is the same for all of them
+#define RGBLED_BACKEND_GPIO_DMA       0       // TIM8 UP/CC1/CC3 DMA to BSRR, 32 bits per data bit
+#define RGBLED_BACKEND_SPI            1       // MOSI at 2.4 MHz, 3 bits per data bit, one DMA stream
+#define RGBLED_BACKEND_PWM            2       // TIM8 CH1 PWM, 16 bit CCR per data bit, one DMA stream
+#ifndef RGBLED_BACKEND
+#define RGBLED_BACKEND                RGBLED_BACKEND_GPIO_DMA
+#endif
+
+#define RGBLED_SPI_HANDLE             hspi2   // SCK prescaled to 2.25 - 2.5 MHz, 8 bit, MSB first
+#define RGBLED_SPI_DMA_HANDLE         hdma_spi2_tx
+#define RGBLED_SPI_BYTES_PER_LED      9
+// MOSI low for the latch at 2.4 bits per us, 2 more bytes are in the SPI when the DMA completes
+#define RGBLED_SPI_LATCH_BYTES        ((RGBLED_LATCH_US * 24U + 79U) / 80U + 2U)
+#define RGBLED_SPI_BUFFER_SIZE        (RGBLED_SPI_BYTES_PER_LED * MAX_WS28XX_LED + RGBLED_SPI_LATCH_BYTES)
+
+#define RGBLED_PWM_T0H_PERCENT        30      // 375 ns, spec 400 +-150 ns
+#define RGBLED_PWM_T1H_PERCENT        60      // 750 ns, spec 800 +-150 ns
+#define RGBLED_PWM_BUFFER_SIZE        (RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED + RGBLED_LATCH_SLOTS)
+
+// strips driven in parallel, on consecutive pins of RGB_LED_PORT from RGB_LED_PIN up, 1 to 8
+#ifndef RGBLED_STRIP_COUNT
+#define RGBLED_STRIP_COUNT            1
+#endif
+#define RGBLED_STRIP_PINS             ((uint32_t)RGB_LED_PIN * ((1U << RGBLED_STRIP_COUNT) - 1U))
+
+#if (RGBLED_STRIP_COUNT < 1) || (RGBLED_STRIP_COUNT > 8)
+#error "RGBLED_STRIP_COUNT must be 1 to 8"
+#endif
+#if (RGBLED_STRIP_COUNT > 1) && RGBLED_STREAMING_ENABLE
+#error "streaming supports a single strip"
+#endif
+#if (RGBLED_BACKEND != RGBLED_BACKEND_GPIO_DMA) && (RGBLED_STREAMING_ENABLE || (RGBLED_STRIP_COUNT > 1))
+#error "streaming and parallel strips need the GPIO DMA backend"
+#endif
 
  typedef struct
  {
    uint8_t red;
    uint8_t green;
    uint8_t blue;
-   bool bSet;
+   bool bSet;                               // changed since the last rgbled_Commit
  }ws2812Color_t;
 
  /* Exported constants --------------------------------------------------------*/
@@ -55,9 +105,18 @@
  void rgbled_Init(void);
  void rgbled_TurnOnLED(uint8_t red, uint8_t green, uint8_t blue);
  void rgbled_TurnOffLED(void);
+ void rgbled_DMAXferCpltCallback(DMA_HandleTypeDef *DmaHandle);
+#if (RGBLED_BACKEND == RGBLED_BACKEND_GPIO_DMA)
  void rgbled_SetColorPixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t blue);
  void rgbled_TriggerTransmit(uint16_t buffer_size);
- void rgbled_DMAXferCpltCallback(DMA_HandleTypeDef *DmaHandle);
+ void rgbled_DMAStreamHalfCallback(DMA_HandleTypeDef *DmaHandle);
+ void rgbled_DMAStreamCpltCallback(DMA_HandleTypeDef *DmaHandle);
+#endif
+ void rgbled_SetStripPixel(uint32_t strip, uint32_t led, uint8_t red, uint8_t green, uint8_t blue);
+ void rgbled_SetRange(uint32_t strip, uint32_t first, uint32_t count, uint8_t red, uint8_t green, uint8_t blue);
+ uint32_t rgbled_Commit(void);
+ uint32_t rgbled_SubmitFrame(const uint8_t* p_frames);
+ bool rgbled_WaitFrame(uint32_t seq, uint32_t timeout);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * @file    led_encoder.h
+  * @author  IBronx MDE team
+  * @brief   WS28xx bit encoder header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_ENCODER_H_
+#define __LED_ENCODER_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "led_control.h"
+
+ /* Exported types ------------------------------------------------------------*/
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ void ledenc_EncodePixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t blue);
+ void ledenc_FillPixels(uint32_t* p_buf, uint32_t count);
+ void ledenc_EncodeFrame(uint32_t* p_buf, const uint8_t* p_frame, uint32_t first, uint32_t count, uint32_t ledCount);
+ void ledenc_EncodeStrips(uint32_t* p_buf, const uint8_t* p_frames, uint32_t stripCount, uint32_t first, uint32_t count);
+ void ledenc_EncodeSpi(uint8_t* p_buf, const uint8_t* p_frame, uint32_t first, uint32_t count);
+ void ledenc_EncodePwm(uint16_t* p_buf, const uint8_t* p_frame, uint32_t first, uint32_t count, uint16_t ccr0, uint16_t ccr1);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LED_ENCODER_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    log_crashram.h
+  * @author  IBronx MDE team
+  * @brief   Crash surviving RAM log header file
+  *          The ring is placed in the .noinit section, which the linker script
+  *          must provide as a NOLOAD output section so the startup code does
+  *          not clear it.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_CRASHRAM_H_
+#define INC_LOG_CRASHRAM_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "logger.h"
+
+#include <stdatomic.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGCRASH_RECORD_COUNT   24
+#define LOGCRASH_PAYLOAD_LEN    18        // text is cut, all message arguments fit
+#define LOGCRASH_MAGIC          0x4C4F4752U
+#define LOGCRASH_CRC_INIT       0xFFFFU
+
+ typedef struct
+ {
+   uint32_t seq;                            // append position, selects the slot
+   uint32_t timestamp;
+   uint16_t msgId;
+   uint8_t level;
+   uint8_t len;
+   uint8_t payload[LOGCRASH_PAYLOAD_LEN];
+   uint16_t crc;                            // CRC-16/CCITT of the fields above
+ }logCrashSlot_t;
+
+ typedef struct
+ {
+   uint32_t magic;
+   atomic_uint head;
+   logCrashSlot_t slots[LOGCRASH_RECORD_COUNT];
+ }logCrashRing_t;
+
+ typedef void (*logCrashRestore_t)(const loggerRecord_t* record);
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ void logcrash_Reset(logCrashRing_t* ring);
+ void logcrash_Append(logCrashRing_t* ring, const loggerRecord_t* record);
+ uint32_t logcrash_Recover(logCrashRing_t* ring, logCrashRestore_t pfnRestore);
+ uint16_t logcrash_Crc16(uint16_t crc, const uint8_t* pData, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_CRASHRAM_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,107 @@
+/**
+  ******************************************************************************
+  * @file    log_flash.h
+  * @author  IBronx MDE team
+  * @brief   Log-structured FLASH log store header file
+  *          The log area must be kept free by the linker script, the internal
+  *          FLASH device uses sectors 8 and 9 (0x08080000 - 0x080BFFFF) and
+  *          refuses to start when the program image reaches into them.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_FLASH_H_
+#define INC_LOG_FLASH_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGFLASH_PAGE_SIZE            256       // program unit, one SPI NOR page
+#define LOGFLASH_SYNC_PERIOD_MS       10000     // a partial page is programmed after this time
+#define LOGFLASH_ERASED_SEQ           0xFFFFFFFFU
+#define LOGFLASH_MAGIC                0x474F4C50U   // "PLOG", first word of every page
+
+// 1: erase ahead between cycles, every task and interrupt stalls for about
+//    1 s per 128 KB sector. 0: erase only in logflash_Init at boot, the store
+//    stops taking records once the erased sectors are full
+#ifndef LOGFLASH_RUNTIME_ERASE
+#define LOGFLASH_RUNTIME_ERASE        0
+#endif
+
+#define LOGFLASH_INT_FIRST_SECTOR     FLASH_SECTOR_8
+#define LOGFLASH_INT_ADDR             0x08080000U
+#define LOGFLASH_INT_SECTOR_SIZE      (128U * 1024U)
+#define LOGFLASH_INT_SECTOR_COUNT     2         // sectors 10 and 11 hold the log journal
+
+ typedef struct
+ {
+   uint32_t magic;                          // LOGFLASH_MAGIC, erased if the page is free
+   uint32_t seq;                            // page sequence number
+   uint16_t len;                            // payload bytes
+   uint16_t crc;                            // CRC-16/CCITT of magic, seq, len and payload
+ }logFlashPageHdr_t;
+
+#define LOGFLASH_PAGE_PAYLOAD         (LOGFLASH_PAGE_SIZE - sizeof(logFlashPageHdr_t))
+
+ // FLASH device, offsets are relative to the start of the log area
+ typedef struct
+ {
+   uint32_t (*pfnRead)(uint32_t offset, void* pData, uint32_t size);
+   uint32_t (*pfnProgram)(uint32_t offset, const void* pData, uint32_t size);
+   uint32_t (*pfnErase)(uint32_t sectorIdx);
+   uint32_t sectorSize;                     // multiple of LOGFLASH_PAGE_SIZE
+   uint32_t sectorCount;                    // at least 2, one is erased ahead
+ }logFlashDev_t;
+
+ typedef struct
+ {
+   uint32_t bytesLogged;                    // payload bytes handed to the store
+   uint32_t pagesWritten;
+   uint32_t erases;
+   uint32_t errors;                         // failed program or erase
+   uint32_t headSeq;                        // sequence number of the next page
+ }logFlashStats_t;
+
+ // called for each valid page, oldest first, with whole packed records
+ typedef void (*logFlashPage_t)(uint32_t seq, const uint8_t* pPayload, uint32_t len, void* ctx);
+
+ /* Exported constants --------------------------------------------------------*/
+ extern const logFlashDev_t logflash_internalDev;
+
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t logflash_Init(const logFlashDev_t* dev);
+ bool logflash_IsReady(uint32_t size);
+ uint32_t logflash_Write(const uint8_t* pData, uint32_t size);
+ void logflash_Flush(void);
+ void logflash_Poll(bool bEraseAllowed);
+ uint32_t logflash_ForEachPage(logFlashPage_t pfnPage, void* ctx);
+ void logflash_GetStats(logFlashStats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_FLASH_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
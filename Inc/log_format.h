@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file    log_format.h
+  * @author  IBronx MDE team
+  * @brief   Bounded log text formatter header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_FORMAT_H_
+#define INC_LOG_FORMAT_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+ typedef struct
+ {
+   char* buf;
+   uint32_t size;                           // buffer size including the terminator
+   uint32_t len;
+   bool bTruncated;
+ }logFmt_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ void logfmt_Init(logFmt_t* fmt, char* buf, uint32_t size);
+ void logfmt_Char(logFmt_t* fmt, char c);
+ void logfmt_Str(logFmt_t* fmt, const char* str);
+ void logfmt_StrPad(logFmt_t* fmt, const char* str, uint32_t width);
+ void logfmt_UDec(logFmt_t* fmt, uint32_t value);
+ void logfmt_Dec(logFmt_t* fmt, int32_t value);
+ void logfmt_Hex(logFmt_t* fmt, uint32_t value, uint32_t digits);
+ void logfmt_ErrorCode(logFmt_t* fmt, uint32_t code);
+ void logfmt_Args(logFmt_t* fmt, const char* format, const uint32_t* args, uint32_t nArgs);
+ uint32_t logfmt_End(logFmt_t* fmt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_FORMAT_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
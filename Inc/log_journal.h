@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    log_journal.h
+  * @author  IBronx MDE team
+  * @brief   Append-only FLASH journal header file for the log file counter
+  *          The two journal sectors must be kept out of the program area in
+  *          the linker script.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_JOURNAL_H_
+#define INC_LOG_JOURNAL_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGJOURNAL_FLASH_SECTOR       FLASH_SECTOR_10     // first of the two sectors
+#define LOGJOURNAL_FLASH_ADDR         0x080C0000U
+#define LOGJOURNAL_SECTOR_SIZE        (128U * 1024U)
+#define LOGJOURNAL_SECTOR_COUNT       2
+#define LOGJOURNAL_ENTRY_COUNT        1024      // entries per sector
+
+ typedef struct
+ {
+   uint32_t value;
+   uint32_t check;                          // ~value, detects torn writes
+ }logJournalEntry_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t logjournal_Read(uint32_t* pValue);
+ uint32_t logjournal_Append(uint32_t value);
+ uint32_t logjournal_PrepareSpare(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_JOURNAL_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,70 @@
+/**
+  ******************************************************************************
+  * @file    log_queue.h
+  * @author  IBronx MDE team
+  * @brief   Lock-free multi-producer log record queue header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_QUEUE_H_
+#define INC_LOG_QUEUE_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "logger.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGQ_SIZE               32    // must be a power of two
+#define LOGQ_MASK               (LOGQ_SIZE - 1)
+
+ typedef struct
+ {
+   atomic_uint seq;                   // slot sequence, owned by producer or consumer
+   loggerRecord_t record;
+ }logqSlot_t;
+
+ typedef struct
+ {
+   logqSlot_t slots[LOGQ_SIZE];
+   atomic_uint head;                  // next position to reserve by the producers
+   atomic_uint tail;                  // next position to read by the consumer
+   atomic_uint dropped;               // records lost because the queue was full
+   uint32_t highWater;                // maximum depth seen by the consumer
+ }logQueue_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ void logq_Init(logQueue_t* q);
+ logqSlot_t* logq_Reserve(logQueue_t* q);
+ void logq_Commit(logqSlot_t* slot);
+ bool logq_Pop(logQueue_t* q, loggerRecord_t* record);
+ uint32_t logq_GetDepth(logQueue_t* q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_QUEUE_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file    log_sdwriter.h
+  * @author  IBronx MDE team
+  * @brief   Batched SD card log writer header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_SDWRITER_H_
+#define INC_LOG_SDWRITER_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGSD_SECTOR_SIZE       512
+#define LOGSD_BUFFER_COUNT      2
+#define LOGSD_REQUEST_COUNT     (LOGSD_BUFFER_COUNT + 1)  // one more request for a query
+#define LOGSD_SYNC_PERIOD_MS    1000      // sync the file at least this often
+#define LOGSD_SYNC_BYTES        4096      // or after this many unsynced bytes
+#define LOGSD_FIRST_FILE_NUMBER 10000     // log files are named 10000.LOG, 10001.LOG, ...
+#define LOGSD_ROTATE_SIZE       (1024U * 1024U)
+#define LOGSD_ROTATE_AGE_MS     (8U * 3600U * 1000U)
+#define LOGSD_MAX_FILES         100       // older files are deleted on rotation
+#define LOGSD_INDEX_BUCKET_MS   30000     // one index entry per bucket, <number>.IDX next to the log
+
+ typedef struct
+ {
+   uint32_t bytesLogged;                    // payload bytes handed to the writer
+   uint32_t bytesWritten;                   // bytes passed to f_write, incl. rewritten tails
+   uint32_t sectorWrites;                   // full sector writes
+   uint32_t syncs;                          // partial writes followed by f_sync
+   uint32_t dropped;                        // bytes lost because no buffer was free
+   uint32_t errors;                         // failed FatFs calls
+   uint32_t rotations;                      // files closed for size or age
+   uint32_t indexEntries;                   // buckets written to the index files
+   uint32_t queries;                        // retrieval queries served
+ }logsdStats_t;
+
+ typedef struct
+ {
+   uint32_t tickMs;                         // kernel tick of the first record in the bucket
+   uint32_t offset;                         // log file offset of the first record in the bucket
+   uint8_t levelMask;                       // bit (1 << level) for each level in the bucket
+   uint8_t reserved[3];
+ }logsdIndexEntry_t;
+
+ // request to the storage task, sized into the static queue of rtos_objects.h
+ typedef struct
+ {
+   uint8_t type;                            // LOGSD_REQ_WRITE, LOGSD_REQ_ROTATE or LOGSD_REQ_QUERY
+   uint8_t bufIdx;
+   uint16_t size;                           // LOGSD_SECTOR_SIZE, or less for a sync or the end of a file
+ }logsdRequest_t;
+
+ // blocking output of a query, the data is only valid during the call
+ typedef uint32_t (*logsdSend_t)(const uint8_t* pData, uint32_t size);
+ typedef void (*logsdQueryDone_t)(uint32_t count, uint32_t rc);
+
+ typedef struct
+ {
+   uint32_t fromMs;                         // kernel ticks since boot
+   uint32_t toMs;
+   uint8_t levelMask;                       // bit (1 << level) for each wanted level
+   logsdSend_t pfnSend;
+   logsdQueryDone_t pfnDone;                // called by the storage task at the end
+ }logsdQuery_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t logsd_Init(uint32_t fileNumber);
+ bool logsd_IsReady(uint32_t size);
+ void logsd_MarkRecord(uint8_t level, uint32_t tick);
+ uint32_t logsd_Write(const uint8_t* pData, uint32_t size);
+ uint32_t logsd_Query(const logsdQuery_t* query);
+ void logsd_Flush(void);
+ void logsd_Poll(void);
+ void logsd_GetStats(logsdStats_t* stats);
+ uint32_t logsd_GetFileNumber(void);
+ void StartLogStorageTask(void *argument);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_SDWRITER_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file    log_sink.h
+  * @author  IBronx MDE team
+  * @brief   Log output sink registry header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOG_SINK_H_
+#define INC_LOG_SINK_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "logger.h"
+
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGSINK_MAX             6
+
+ typedef enum
+ {
+   LOGSINK_WRITTEN,                         // record taken by the output
+   LOGSINK_BUSY,                            // output busy, the record is offered again on the next pump
+   LOGSINK_DISCARDED,                       // output not available, the record is lost
+ }logSinkResult_t;
+
+ // non-blocking output, called by the logger task only
+ typedef logSinkResult_t (*logSinkWrite_t)(const loggerRecord_t* record);
+
+ typedef struct
+ {
+   uint32_t queued;                         // records accepted into the sink queue
+   uint32_t written;                        // records taken by the output
+   uint32_t overflow;                       // records lost because the sink queue was full
+   uint32_t discarded;                      // records lost because the output was not available
+   uint32_t busy;                           // write attempts refused by the output
+   uint32_t highWater;                      // maximum sink queue depth
+ }logSinkStats_t;
+
+ typedef struct
+ {
+   const char* name;
+   loggerLevel_t minLevel;
+   logSinkWrite_t pfnWrite;
+   loggerRecord_t* queue;                   // storage of queueSize records
+   uint32_t queueSize;                      // power of two
+   uint32_t head;
+   uint32_t tail;
+   logSinkStats_t stats;
+ }logSink_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t logsink_Register(logSink_t* sink);
+ void logsink_Dispatch(const loggerRecord_t* record);
+ bool logsink_PumpAll(void);
+ uint32_t logsink_GetOverflow(void);
+ void logsink_SetLevel(const char* name, loggerLevel_t level);
+ bool logsink_GetStats(const char* name, logSinkStats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOG_SINK_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
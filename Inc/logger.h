@@ -28,6 +28,8 @@
  /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_hal.h"
 
+#include <stdbool.h>
+
  /* Exported types ------------------------------------------------------------*/
 
 #define LOGGER_STR_LEN          300
@@ -38,14 +40,172 @@
 #define LOGGER_TYPE_WARN        "Warn"
 #define LOGGER_NULL_STRING      '\0'
 
+#define LOGGER_RECORD_TEXT_LEN  56
+#define LOGGER_TASK_DELAY_MS    50
+#define LOGGER_WAKEUP_FLAG      0x00000001U
+
+// 1: store packed binary records decoded on the host by Tools/logdecode.py
+// 0: store formatted text lines
+#ifndef LOGGER_BINARY_MODE
+#define LOGGER_BINARY_MODE      1
+#endif
+
+// 1: write the log file on the SD card through log_sdwriter
+#ifndef LOGGER_SDCARD_ENABLE
+#define LOGGER_SDCARD_ENABLE    0
+#endif
+
+// 1: copy the log as text lines to the USB CDC port while a host is connected
+#ifndef LOGGER_USB_ENABLE
+#define LOGGER_USB_ENABLE       1
+#endif
+
+// 1: keep the log in the FLASH store when no SD card is mounted, the log area
+//    of log_flash.h must be reserved in the linker script first
+#ifndef LOGGER_FLASH_ENABLE
+#define LOGGER_FLASH_ENABLE     0
+#endif
+
+// output sink names for logsink_SetLevel and logsink_GetStats
+#define LOGGER_SINK_SYSVIEW     "SYSVIEW"
+#define LOGGER_SINK_SDCARD      "SD"
+#define LOGGER_SINK_USB         "USB"
+#define LOGGER_SINK_RAM         "RAM"
+#define LOGGER_SINK_FLASH       "FLASH"
+#define LOGGER_RAM_RECORD_COUNT 16        // newest records kept by the RAM sink
+
+// USB log retrieval, a command line is answered with the stored records of
+// this boot followed by an end record (msgId LOGGER_QUERY_END_ID, timestamp
+// holding the record count) in binary mode or an "END - <count>." line:
+//   GET <fromMs> <toMs> <minLevel>    kernel ticks since boot
+//   LAST <ms> <minLevel>
+// The live USB lines are suspended from the query start until the end record,
+// so the answer is the plain record stream. Records on the SD card hold the
+// kernel tick, binary records are selected by their own tick, text lines by
+// the 30 s index buckets
+#define LOGGER_USB_CMD_LEN      40
+#define LOGGER_USB_SEND_TIMEOUT_MS  500
+#define LOGGER_QUERY_END_ID     0xFFFFU
+#define LOGGER_NO_TICK          0xFFFFFFFFU   // stored record without a time
+
+#define LOGGER_BINARY_HDR_SIZE  8         // msgId(2) level(1) len(1) timestamp(4)
+#define LOGGER_BINARY_MAX_SIZE  (LOGGER_BINARY_HDR_SIZE + LOGGER_RECORD_TEXT_LEN)
+
+#define LOGGER_LEVEL_INFO       0
+#define LOGGER_LEVEL_WARN       1
+#define LOGGER_LEVEL_ERROR      2
+#define LOGGER_LEVEL_NONE       3         // suppress every log event
+
+// log sites below this level are removed at compile time
+#ifndef LOGGER_BUILD_LEVEL
+#define LOGGER_BUILD_LEVEL      LOGGER_LEVEL_INFO
+#endif
+
+ typedef uint8_t loggerLevel_t;
+
+#include "logger_msg.h"
+
+ typedef struct
+ {
+   uint32_t timestamp;                      // SYSVIEW timestamp when the event was logged
+   uint8_t level : 4;                       // loggerLevel_t
+   uint8_t bReplayed : 1;                   // recovered from the crash ring, logged before the reset
+   uint8_t len;                             // text length without terminator, or argument bytes
+   uint16_t msgId;                          // loggerMsgId_t, LOGMSG_TEXT for free text
+   union
+   {
+     char text[LOGGER_RECORD_TEXT_LEN];
+     uint32_t args[LOGGER_MSG_MAX_ARGS];
+   };
+ }loggerRecord_t;
+
+ typedef struct
+ {
+   uint32_t written;                        // records handed to the output sinks
+   uint32_t dropped;                        // records lost because the queue was full
+   uint32_t truncated;                      // records cut to LOGGER_RECORD_TEXT_LEN
+   uint32_t highWater;                      // maximum queue depth
+ }loggerStats_t;
+
  /* Exported constants --------------------------------------------------------*/
+ extern volatile loggerLevel_t logger_runtimeLevel;
+
  /* Exported macro ------------------------------------------------------------*/
+
+ // log a message table event, the level test folds to a constant for the
+ // build level and to a single compare for the runtime level
+#define LOGGER_LOG_MSG(id, ...) \
+  do { \
+    if ((id##_LEVEL >= LOGGER_BUILD_LEVEL) && (id##_LEVEL >= logger_runtimeLevel)) \
+      logger_LogMsg(id, __VA_ARGS__); \
+  } while (0)
+
  /* Exported functions ------------------------------------------------------- */
  void logger_Init(void);
  uint32_t logger_SaveLogEvents(const char* sState, const char* sMsg);
- void logger_LogInfo(const char* sMsg, const char* sArg);
- void logger_LogWarn(const char* sMsg, const char* sArg);
- void logger_LogError(const char* sMsg, const char* sArg);
+ void logger_LogText(loggerLevel_t level, const char* sMsg, const char* sArg);
+ void logger_LogMsg(loggerMsgId_t msgId, uint32_t nArgs, ...);
+ void logger_SetLevel(loggerLevel_t level);
+ uint32_t logger_SaveLogRecord(const loggerRecord_t* record);
+ uint32_t logger_SaveLogData(const uint8_t* pData, uint32_t size);
+ uint32_t logger_PackRecord(const loggerRecord_t* record, uint8_t* pBuf);
+ uint32_t logger_FormatLine(const loggerRecord_t* record, char* pBuf, uint32_t size);
+ bool logger_ParseRecord(const uint8_t* pData, uint32_t size, uint32_t* pRecordSize, uint8_t* pLevel, uint32_t* pTick);
+ void logger_UsbRxHandler(const uint8_t* pBuf, uint32_t len);
+ uint32_t logger_ReadRamLog(loggerRecord_t* records, uint32_t maxCount);
+ void logger_GetStats(loggerStats_t* stats);
+ void StartLoggerTask(void *argument);
+
+/**
+* @brief  Log the Info Event into log file
+* @param  sMsg       Event log message
+* @param  sArg       Input argument
+  @retval None
+*/
+static inline void logger_LogInfo(const char* sMsg, const char* sArg)
+{
+#if LOGGER_BUILD_LEVEL <= LOGGER_LEVEL_INFO
+  if (LOGGER_LEVEL_INFO >= logger_runtimeLevel)
+    logger_LogText(LOGGER_LEVEL_INFO, sMsg, sArg);
+#else
+  (void)sMsg;
+  (void)sArg;
+#endif
+}
+
+/**
+* @brief  Log the Warn Event into log file
+* @param  sMsg       Event log message
+* @param  sArg       Input argument
+  @retval None
+*/
+static inline void logger_LogWarn(const char* sMsg, const char* sArg)
+{
+#if LOGGER_BUILD_LEVEL <= LOGGER_LEVEL_WARN
+  if (LOGGER_LEVEL_WARN >= logger_runtimeLevel)
+    logger_LogText(LOGGER_LEVEL_WARN, sMsg, sArg);
+#else
+  (void)sMsg;
+  (void)sArg;
+#endif
+}
+
+/**
+* @brief  Log the Error Event into log file
+* @param  sMsg       Event log message
+* @param  sArg       Input argument
+  @retval None
+*/
+static inline void logger_LogError(const char* sMsg, const char* sArg)
+{
+#if LOGGER_BUILD_LEVEL <= LOGGER_LEVEL_ERROR
+  if (LOGGER_LEVEL_ERROR >= logger_runtimeLevel)
+    logger_LogText(LOGGER_LEVEL_ERROR, sMsg, sArg);
+#else
+  (void)sMsg;
+  (void)sArg;
+#endif
+}
 
 
 
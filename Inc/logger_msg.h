@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file    logger_msg.h
+  * @author  IBronx MDE team
+  * @brief   Binary log message table
+  *          Each entry gives the message ID, its level and the printf style
+  *          format of its raw arguments (%u, %d or %x, at most
+  *          LOGGER_MSG_MAX_ARGS). Tools/logdecode.py reads this file to turn
+  *          binary log records back into text, so only append new entries at
+  *          the end of the table to keep old log files decodable.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_LOGGER_MSG_H_
+#define INC_LOGGER_MSG_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+ /* Exported types ------------------------------------------------------------*/
+
+#define LOGGER_MSG_MAX_ARGS     4
+
+#define LOGGER_MSG_TABLE(X) \
+  X(LOGMSG_MAIN_PROGRAM_START,      LOGGER_LEVEL_INFO,  "[MAIN] - Program Start from here....") \
+  X(LOGMSG_MAIN_IOEXP_INIT_OK,      LOGGER_LEVEL_INFO,  "[MAIN] - IO Port Expander has been initialized") \
+  X(LOGMSG_MAIN_IOEXP_INIT_FAIL,    LOGGER_LEVEL_ERROR, "[MAIN] - IO Port Expander failed to initialize") \
+  X(LOGMSG_MAIN_PREPARATION,        LOGGER_LEVEL_INFO,  "[MAIN] - Preparation before the Screw operation") \
+  X(LOGMSG_MAIN_START_OPERATION,    LOGGER_LEVEL_INFO,  "[MAIN] - Start the Screw Operation") \
+  X(LOGMSG_EXTI_STOP_BUTTON,        LOGGER_LEVEL_INFO,  "[EXTI] - Receive Stop button signal") \
+  X(LOGMSG_EXTI_START_BUTTON,       LOGGER_LEVEL_INFO,  "[EXTI] - Receive Start button signal") \
+  X(LOGMSG_LOG_DROPPED,             LOGGER_LEVEL_WARN,  "[LOG] - Dropped %u records") \
+  X(LOGMSG_LOG_CRASH_RECOVERED,     LOGGER_LEVEL_WARN,  "[LOG] - Recovered %u records logged before reset") \
+  X(LOGMSG_LOG_SINK_OVERFLOW,       LOGGER_LEVEL_WARN,  "[LOG] - Lost %u records on a full sink queue") \
+  X(LOGMSG_MAIN_PREPARATION_FAIL,   LOGGER_LEVEL_ERROR, "[MAIN] - Preparation failed at step %u, error %E") \
+  X(LOGMSG_MAIN_READY,              LOGGER_LEVEL_INFO,  "[MAIN] - Ready at %u ms, init took %u us, %u bytes of static RTOS objects")
+
+ typedef enum
+ {
+   LOGMSG_TEXT = 0,                   // free text record from logger_LogInfo/Warn/Error
+#define LOGGER_MSG_ENUM(id, level, fmt)   id,
+   LOGGER_MSG_TABLE(LOGGER_MSG_ENUM)
+#undef LOGGER_MSG_ENUM
+   LOGMSG_COUNT,
+ }loggerMsgId_t;
+
+ // <id>_LEVEL constants used by LOGGER_LOG_MSG to drop sites at compile time
+ enum
+ {
+#define LOGGER_MSG_LEVEL_ENUM(id, level, fmt)   id##_LEVEL = level,
+   LOGGER_MSG_TABLE(LOGGER_MSG_LEVEL_ENUM)
+#undef LOGGER_MSG_LEVEL_ENUM
+ };
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_LOGGER_MSG_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * @file    msgbus.h
+  * @author  IBronx MDE team
+  * @brief   Inter-task message bus header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_MSGBUS_H_
+#define INC_MSGBUS_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "cmsis_os.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define MSGBUS_POOL_SIZE        32            // at most 32, one bit each in the free map
+#define MSGBUS_QUEUE_SIZE       16            // per subscriber, must be a power of two
+#define MSGBUS_QUEUE_MASK       (MSGBUS_QUEUE_SIZE - 1)
+#define MSGBUS_SUBSCRIBER_MAX   6
+#define MSGBUS_PAYLOAD_WORDS    3
+
+// topic id, payload words
+#define MSGBUS_TOPIC_TABLE(X) \
+  X(MSGBUS_OPERATION_PREPARE,   "OPERATION_PREPARE")    /* none */ \
+  X(MSGBUS_OPERATION_START,     "OPERATION_START")      /* none */ \
+  X(MSGBUS_OPERATION_STOP,      "OPERATION_STOP")       /* none */ \
+  X(MSGBUS_SCREW_COUNT_RESET,   "SCREW_COUNT_RESET")    /* none */ \
+  X(MSGBUS_MAIN_STATE,          "MAIN_STATE")           /* [0] mainState_t */ \
+  X(MSGBUS_FAULT,               "FAULT")                /* [0] error code from errorcode.h */
+
+ typedef enum
+ {
+#define MSGBUS_TOPIC_ENUM(id, name)   id,
+   MSGBUS_TOPIC_TABLE(MSGBUS_TOPIC_ENUM)
+#undef MSGBUS_TOPIC_ENUM
+   MSGBUS_TOPIC_COUNT,
+ }msgbusTopic_t;
+
+#define MSGBUS_TOPIC(id)        (1U << (id))
+
+ typedef struct
+ {
+   atomic_uint refs;                        // subscribers still holding the message
+   uint8_t topic;
+   uint32_t timestamp;                      // SYSVIEW timestamp of the publish, CPU cycles
+   uint32_t payload[MSGBUS_PAYLOAD_WORDS];
+ }msgbusMsg_t;
+
+ typedef struct
+ {
+   atomic_uint seq;                         // cell sequence, owned by a publisher or the subscriber
+   msgbusMsg_t* msg;
+ }msgbusCell_t;
+
+ typedef struct
+ {
+   const char* name;
+   uint32_t topics;                         // MSGBUS_TOPIC() bits
+   osThreadId_t thread;                     // woken with flag, NULL is the subscribing thread
+   uint32_t flag;                           // 0, the subscriber polls msgbus_Receive
+
+   msgbusCell_t cells[MSGBUS_QUEUE_SIZE];
+   atomic_uint head;                        // next position to reserve by the publishers
+   atomic_uint tail;                        // next position to read by the subscriber
+   atomic_uint dropped;                     // messages lost because the queue was full
+   uint32_t highWater;                      // maximum queue depth seen by the subscriber
+   uint32_t received;
+   uint32_t latencyMax;                     // cycles from publish to receive
+   uint64_t latencyTotal;
+ }msgbusSubscriber_t;
+
+ typedef struct
+ {
+   uint32_t published;
+   uint32_t poolEmpty;                      // publishes refused because no message was free
+   uint32_t poolLow;                        // fewest free messages seen
+ }msgbusStats_t;
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ void msgbus_Init(void);
+ uint32_t msgbus_Subscribe(msgbusSubscriber_t* sub);
+ msgbusMsg_t* msgbus_Alloc(msgbusTopic_t topic);
+ uint32_t msgbus_Publish(msgbusMsg_t* msg);
+ uint32_t msgbus_Post(msgbusTopic_t topic, uint32_t arg);
+ const msgbusMsg_t* msgbus_Receive(msgbusSubscriber_t* sub);
+ void msgbus_Release(const msgbusMsg_t* msg);
+ bool msgbus_Wait(msgbusSubscriber_t* sub, uint32_t timeout);
+ void msgbus_GetStats(msgbusStats_t* stats);
+ const char* msgbus_GetTopicName(msgbusTopic_t topic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_MSGBUS_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,137 @@
+/**
+  ******************************************************************************
+  * @file    rtos_objects.h
+  * @author  IBronx MDE team
+  * @brief   Static RTOS object registry header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_RTOS_OBJECTS_H_
+#define INC_RTOS_OBJECTS_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include "cmsis_os.h"
+#include "logger.h"
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define RTOS_STATIC_BUDGET      (12U * 1024U)   // bytes of control blocks, stacks and queue buffers
+
+#if LOGGER_SDCARD_ENABLE
+#define RTOS_THREAD_SDCARD(X) \
+  X(RTOS_THREAD_LOG_STORAGE,    "logStorageTask",   512, osPriorityLow)
+#define RTOS_SEMAPHORE_SDCARD(X) \
+  X(RTOS_SEMAPHORE_LOGSD_FREE,  "logsdFree")
+#define RTOS_QUEUE_SDCARD(X) \
+  X(RTOS_QUEUE_LOGSD_REQUEST,   "logsdRequest",     LOGSD_REQUEST_COUNT, sizeof(logsdRequest_t))
+#else
+#define RTOS_THREAD_SDCARD(X)
+#define RTOS_SEMAPHORE_SDCARD(X)
+#define RTOS_QUEUE_SDCARD(X)
+#endif
+
+// thread id, name, stack words, priority
+#define RTOS_THREAD_TABLE(X) \
+  X(RTOS_THREAD_FEEDER,         "feederTask",       640, osPriorityNormal3) \
+  X(RTOS_THREAD_SCREW_CTRL,     "screwController",  640, osPriorityNormal2) \
+  X(RTOS_THREAD_SEQUENCER,      "sequencerTask",    256, osPriorityHigh) \
+  X(RTOS_THREAD_LOGGER,         "loggerTask",       384, osPriorityLow) \
+  RTOS_THREAD_SDCARD(X)
+
+// semaphore id, name
+#define RTOS_SEMAPHORE_TABLE(X) \
+  X(RTOS_SEMAPHORE_START_BTN,   "startBtn") \
+  X(RTOS_SEMAPHORE_SCREW_COUNT, "screwCount") \
+  RTOS_SEMAPHORE_SDCARD(X)
+
+// event flags id, name
+#define RTOS_FLAGS_TABLE(X) \
+  X(RTOS_FLAGS_SCREW_CTRL,      "screwCtrlFlags") \
+  X(RTOS_FLAGS_SCREW_FEEDER,    "screwFeederFlags") \
+  X(RTOS_FLAGS_MAIN,            "mainFlags") \
+  X(RTOS_FLAGS_SEQUENCER,       "seqFlags") \
+  X(RTOS_FLAGS_IOEXP,           "ioexpFlags") \
+  X(RTOS_FLAGS_RGBLED,          "rgbledFlags")
+
+// queue id, name, message count, message size
+#define RTOS_QUEUE_TABLE(X) \
+  X(RTOS_QUEUE_MAIN_EVENT,      "mainEvent",        MAIN_EVENT_QUEUE_SIZE, sizeof(fsmEvent_t)) \
+  RTOS_QUEUE_SDCARD(X)
+
+// timer id, name
+#define RTOS_TIMER_TABLE(X) \
+  X(RTOS_TIMER_MAIN_BUTTON,     "mainButton") \
+  X(RTOS_TIMER_MAIN_HEARTBEAT,  "mainHeartbeat") \
+  X(RTOS_TIMER_DEBOUNCE,        "debounce") \
+  X(RTOS_TIMER_IOEXP_FLUSH,     "ioexpFlush") \
+  X(RTOS_TIMER_LEDANIM,         "ledanim")
+
+#define RTOS_OBJECT_ENUM(id, ...)   id,
+
+ typedef enum
+ {
+   RTOS_THREAD_TABLE(RTOS_OBJECT_ENUM)
+   RTOS_THREAD_COUNT,
+ }rtosThread_t;
+
+ typedef enum
+ {
+   RTOS_SEMAPHORE_TABLE(RTOS_OBJECT_ENUM)
+   RTOS_SEMAPHORE_COUNT,
+ }rtosSemaphore_t;
+
+ typedef enum
+ {
+   RTOS_FLAGS_TABLE(RTOS_OBJECT_ENUM)
+   RTOS_FLAGS_COUNT,
+ }rtosFlags_t;
+
+ typedef enum
+ {
+   RTOS_QUEUE_TABLE(RTOS_OBJECT_ENUM)
+   RTOS_QUEUE_COUNT,
+ }rtosQueue_t;
+
+ typedef enum
+ {
+   RTOS_TIMER_TABLE(RTOS_OBJECT_ENUM)
+   RTOS_TIMER_COUNT,
+ }rtosTimer_t;
+
+#undef RTOS_OBJECT_ENUM
+
+ /* Exported constants --------------------------------------------------------*/
+ extern const osThreadAttr_t rtos_threadAttr[RTOS_THREAD_COUNT];
+ extern const osSemaphoreAttr_t rtos_semaphoreAttr[RTOS_SEMAPHORE_COUNT];
+ extern const osEventFlagsAttr_t rtos_flagsAttr[RTOS_FLAGS_COUNT];
+ extern const osMessageQueueAttr_t rtos_queueAttr[RTOS_QUEUE_COUNT];
+ extern const osTimerAttr_t rtos_timerAttr[RTOS_TIMER_COUNT];
+ extern const uint32_t rtos_staticBytes;   // reserved for the objects, checked against RTOS_STATIC_BUDGET
+
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_RTOS_OBJECTS_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,97 @@
+/**
+  ******************************************************************************
+  * @file    sequencer.h
+  * @author  IBronx MDE team
+  * @brief   Actuator timeline sequencer header file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_SEQUENCER_H_
+#define INC_SEQUENCER_H_
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+ /* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+ /* Exported types ------------------------------------------------------------*/
+
+#define SEQ_POLL_MS             1             // condition poll period of a wait step
+#define SEQ_SYNC_TIMEOUT_MS     20            // IO expander writes of the timeline to complete
+#define SEQ_START_FLAG          0x00000001U
+#define SEQ_DONE_FLAG           0x00000002U
+#define SEQ_STEP_SYNC           0xFF          // failedStep of a failure in the final IO expander sync
+
+ typedef enum
+ {
+   SEQ_STEP_OUTPUT = 0,                     // drive an IO expander pin at the offset
+   SEQ_STEP_WAIT,                           // from the offset, wait for the condition, later offsets count from here
+ }seqStepType_t;
+
+ // polled from the sequencer task, must not block
+ typedef bool (*seqCondition_t)(void);
+
+ typedef struct
+ {
+   seqStepType_t type;
+   uint16_t offsetMs;                       // from the timeline start or the last wait, non decreasing
+   uint8_t port;
+   uint8_t pin;
+   uint8_t value;
+   seqCondition_t pfnCondition;             // wait step only, NULL waits for the offset alone
+   uint16_t timeoutMs;                      // wait step only, from its offset
+ }seqStep_t;
+
+ typedef struct
+ {
+   const char* name;
+   const seqStep_t* steps;
+   uint8_t stepCount;
+ }seqTimeline_t;
+
+ typedef struct
+ {
+   uint32_t runs;
+   uint32_t failures;
+   uint32_t lastDurationMs;
+   uint32_t maxLateMs;                      // worst delay of a step behind its offset
+   uint8_t failedStep;                      // index of the step of the last failure, or SEQ_STEP_SYNC
+ }seqStats_t;
+
+#define SEQ_OUTPUT(offset, port, pin, value)   { SEQ_STEP_OUTPUT, (offset), (port), (pin), (value), NULL, 0 }
+#define SEQ_WAIT(offset, condition, timeout)   { SEQ_STEP_WAIT, (offset), 0, 0, 0, (condition), (timeout) }
+#define SEQ_SETTLE(offset)                     { SEQ_STEP_WAIT, (offset), 0, 0, 0, NULL, 0 }
+
+ /* Exported constants --------------------------------------------------------*/
+ /* Exported macro ------------------------------------------------------------*/
+ /* Exported functions ------------------------------------------------------- */
+ uint32_t seq_Init(void);
+ uint32_t seq_Start(const seqTimeline_t* timeline);
+ uint32_t seq_Wait(uint32_t timeout);
+ uint32_t seq_Run(const seqTimeline_t* timeline);
+ void seq_GetStats(seqStats_t* stats);
+ void StartSequencerTask(void *argument);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_SEQUENCER_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
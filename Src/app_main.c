@@ -24,43 +24,113 @@
 #include "app_main.h"
 #include "cmsis_os.h"
 #include "errorcode.h"
+#include "fsm.h"
 #include "pca9505_control.h"
+#include "ioexp_cache.h"
 #include "screw_feeder.h"
 #include "screw_controller.h"
+#include "sequencer.h"
+#include "debounce.h"
+#include "msgbus.h"
+#include "rtos_objects.h"
 //#include "led_control.h"
+#include "led_animation.h"
 #include "logger.h"
+#include "log_sdwriter.h"
 #include "usb_device.h"
 
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 
-mainState_t mainState;
 osSemaphoreId_t osSmp_StartBtn;
 osSemaphoreId_t osSmp_ScrewCount;
 osEventFlagsId_t osFlag_ScrewCtrl;
 osEventFlagsId_t osFlag_ScrewFeeder;
 osEventFlagsId_t osFlag_Main;
 
-static uint16_t tickCount_StartButton;
+static osMessageQueueId_t main_eventQueue;
+static osTimerId_t main_buttonTimer;
+static osTimerId_t main_heartbeatTimer;
+static bool main_bButtonLocked;
 
-/* Definitions for feederTask */
+/* Sub threads, stack sizes and priorities are in RTOS_THREAD_TABLE ----------*/
 osThreadId_t feederTaskHandle;
-const osThreadAttr_t feederTask_attributes = {
-  .name = "feederTask",
-  .stack_size = 640 * 4,
-  .priority = (osPriority_t) osPriorityNormal3,
+osThreadId_t screwControllerHandle;
+osThreadId_t sequencerTaskHandle;
+osThreadId_t loggerTaskHandle;
+#if LOGGER_SDCARD_ENABLE
+osThreadId_t logStorageTaskHandle;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static bool main_ButtonReady(void* context, const fsmEvent_t* event);
+static void main_ButtonPressed(void* context, const fsmEvent_t* event);
+static void main_ButtonUnlock(void* context, const fsmEvent_t* event);
+static void main_Heartbeat(void* context, const fsmEvent_t* event);
+static void main_TimerCallback(void* argument);
+static uint32_t main_ReadButtons(void);
+static void main_ButtonEdge(uint32_t rose, uint32_t fell, uint32_t timestamp);
+/* function prototypes -------------------------------------------------------*/
+
+/* Main state machine, new states and events are added to these tables -------*/
+static const fsmState_t main_states[] = {
+  [STATE_MAIN_INIT]       = { "INIT",    main_task_Init,        NULL },
+  [STATE_MAIN_START]      = { "START",   main_task_Preparation, NULL },
+  [STATE_MAIN_RUNNING]    = { "RUNNING", main_task_Running,     NULL },
+  [STATE_MAIN_START_IDLE] = { "IDLE",    NULL,                  NULL },
 };
 
-/* Definitions for screwController */
-osThreadId_t screwControllerHandle;
-const osThreadAttr_t screwController_attributes = {
-  .name = "screwController",
-  .stack_size = 640 * 4,
-  .priority = (osPriority_t) osPriorityNormal2,
+static const fsmTransition_t main_transitions[] = {
+  { STATE_MAIN_INIT,       MAIN_EVENT_DONE,          STATE_MAIN_START_IDLE, NULL,             NULL },
+  { STATE_MAIN_START_IDLE, MAIN_EVENT_START,         STATE_MAIN_START,      NULL,             NULL },
+  { STATE_MAIN_START,      MAIN_EVENT_DONE,          STATE_MAIN_RUNNING,    NULL,             NULL },
+  { STATE_MAIN_START,      MAIN_EVENT_ABORT,         STATE_MAIN_START_IDLE, NULL,             NULL },
+  { STATE_MAIN_RUNNING,    MAIN_EVENT_DONE,          STATE_MAIN_START_IDLE, NULL,             NULL },
+  { FSM_STATE_ANY,         MAIN_EVENT_BUTTON,        FSM_STATE_NONE,        main_ButtonReady, main_ButtonPressed },
+  { FSM_STATE_ANY,         MAIN_EVENT_BUTTON_UNLOCK, FSM_STATE_NONE,        NULL,             main_ButtonUnlock },
+  { FSM_STATE_ANY,         MAIN_EVENT_HEARTBEAT,     FSM_STATE_NONE,        NULL,             main_Heartbeat },
 };
 
-/* function prototypes -------------------------------------------------------*/
+#define MAIN_STATE_COUNT        (sizeof(main_states) / sizeof(main_states[0]))
+#define MAIN_TRANSITION_COUNT   (sizeof(main_transitions) / sizeof(main_transitions[0]))
+
+static fsmStateStats_t main_stateStats[MAIN_STATE_COUNT];
+static fsmTransitionStats_t main_transitionStats[MAIN_TRANSITION_COUNT];
+
+/* Preparation, one solenoid after the other to its default state -----------*/
+// no actuators are known to switch together safely, steps only share an offset with hardware sign-off
+static const seqStep_t main_prepSteps[] = {
+  SEQ_OUTPUT(0 * MAIN_PREP_STEP_MS, SOLENOID_ROTARY_PORT, SOLENOID_ROTARY_PIN, SOLENOID_ROTARY_BACKWARD),
+  SEQ_OUTPUT(1 * MAIN_PREP_STEP_MS, SOLENOID_VACUUM_PORT, SOLENOID_VACUUM_PIN, SOLENOID_VACUUM_OFF),
+  SEQ_OUTPUT(2 * MAIN_PREP_STEP_MS, SOLENOID_DISPATCH_PORT, SOLENOID_DISPATCH_PIN, SOLENOID_DISPATCH_OFF),
+  SEQ_OUTPUT(3 * MAIN_PREP_STEP_MS, SOLENOID_FEEDER_PORT, SOLENOID_FEEDER_PIN, SOLENOID_FEEDER_UP),
+  SEQ_SETTLE(4 * MAIN_PREP_STEP_MS),
+};
+
+static const seqTimeline_t main_prepTimeline = {
+  "PREPARATION", main_prepSteps, sizeof(main_prepSteps) / sizeof(main_prepSteps[0])
+};
+
+/* Debounced inputs of the start button port --------------------------------*/
+static debouncePort_t main_buttons = {
+  .name = "BUTTONS",
+  .pfnRead = main_ReadButtons,
+  .pfnEdge = main_ButtonEdge,
+  .mask = START_BTN_Pin,
+};
+
+// clock in ms, the tick counter is readable from interrupts as well
+static fsm_t main_fsm = {
+  .states = main_states,
+  .stateCount = MAIN_STATE_COUNT,
+  .transitions = main_transitions,
+  .transitionCount = MAIN_TRANSITION_COUNT,
+  .stateStats = main_stateStats,
+  .transitionStats = main_transitionStats,
+  .pfnClock = osKernelGetTickCount,
+  .context = NULL,
+};
 
 /**
   * @brief  Function implementing the mainTask thread.
@@ -69,30 +139,25 @@ const osThreadAttr_t screwController_attributes = {
   */
 void StartMainTask(void *argument)
 {
-  uint32_t tick = osKernelGetTickCount();
-  mainState = STATE_MAIN_INIT;
+  fsmEvent_t event;
+  mainState_t shown;
+
+  fsm_Init(&main_fsm, STATE_MAIN_INIT);
+  shown = main_GetState();
 
-  uint32_t tickCount = 0;
   for(;;)
   {
-    tick += TASK_MAIN_DELAY_MS;
-    tickCount++;
-    switch(mainState)
+    // the state hooks post their own events, run them before blocking
+    fsm_Dispatch(&main_fsm);
+
+    if (main_GetState() != shown)
     {
-      case STATE_MAIN_INIT:
-        main_task_Init();
-        break;
-      case STATE_MAIN_START:
-        main_task_Preparation();
-        break;
-      case STATE_MAIN_RUNNING:
-        main_task_Running();
-        break;
-      case STATE_MAIN_START_IDLE:
-        main_task_Idle(tickCount);
-        break;
+      shown = main_GetState();
+      msgbus_Post(MSGBUS_MAIN_STATE, shown);
     }
-    osDelayUntil(tick);
+
+    if (osMessageQueueGet(main_eventQueue, &event, NULL, osWaitForever) == osOK)
+      fsm_PostEvent(&main_fsm, &event);
   }
 
   // delete the main thread, in case accidentally break the loop
@@ -100,144 +165,295 @@ void StartMainTask(void *argument)
 }
 
 /**
-  * @brief  Execute task initialization when under STATE_MAIN_INIT
-  * @param  None
+  * @brief  Execute task initialization, entry of STATE_MAIN_INIT
+  * @param  context:  Not used
   * @retval None
   */
-void main_task_Init(void)
+void main_task_Init(void* context)
 {
+  // boot to ready time, in cycles from the entry of STATE_MAIN_INIT
+  uint32_t initStart = SEGGER_SYSVIEW_GET_TIMESTAMP();
+
   SEGGER_SYSVIEW_Print("[MAINTASK] - STATE_MAIN_INIT");
 
-  osSmp_StartBtn = osSemaphoreNew(1, 0, NULL);
-  osSmp_ScrewCount = osSemaphoreNew(1, 0, NULL);
-  osFlag_ScrewCtrl = osEventFlagsNew(NULL);
-  osFlag_ScrewFeeder = osEventFlagsNew(NULL);
-  osFlag_Main = osEventFlagsNew(NULL);
-  main_CreateSubThreads();
+  // the button and IO expander handlers post to the queue once they are enabled below
+  main_eventQueue = osMessageQueueNew(MAIN_EVENT_QUEUE_SIZE, sizeof(fsmEvent_t), &rtos_queueAttr[RTOS_QUEUE_MAIN_EVENT]);
+  main_buttonTimer = osTimerNew(main_TimerCallback, osTimerOnce, (void*)MAIN_EVENT_BUTTON_UNLOCK, &rtos_timerAttr[RTOS_TIMER_MAIN_BUTTON]);
+  main_heartbeatTimer = osTimerNew(main_TimerCallback, osTimerPeriodic, (void*)MAIN_EVENT_HEARTBEAT, &rtos_timerAttr[RTOS_TIMER_MAIN_HEARTBEAT]);
+  osTimerStart(main_heartbeatTimer, MAIN_HEARTBEAT_MS);
+
+  osSmp_StartBtn = osSemaphoreNew(1, 0, &rtos_semaphoreAttr[RTOS_SEMAPHORE_START_BTN]);
+  osSmp_ScrewCount = osSemaphoreNew(1, 0, &rtos_semaphoreAttr[RTOS_SEMAPHORE_SCREW_COUNT]);
+  osFlag_ScrewCtrl = osEventFlagsNew(&rtos_flagsAttr[RTOS_FLAGS_SCREW_CTRL]);
+  osFlag_ScrewFeeder = osEventFlagsNew(&rtos_flagsAttr[RTOS_FLAGS_SCREW_FEEDER]);
+  osFlag_Main = osEventFlagsNew(&rtos_flagsAttr[RTOS_FLAGS_MAIN]);
+  msgbus_Init();
+  seq_Init();
 
-  // Init Logger
-  //logger_Init();
+  // Init Logger before any task can log
+  logger_Init();
 
   IO_Expander_Init();
+  if (osEventFlagsGet(osFlag_Main) & MAIN_IO_EXPANDER_FLAG)
+    ioexp_Init();
 
   MX_USB_DEVICE_Init();
-  //rgbled_TurnOffLED();
-
-  // configure default Solenoid state
-  PCA9505_SetOutputPin(SOLENOID_ROTARY_PORT, SOLENOID_ROTARY_PIN, SOLENOID_ROTARY_BACKWARD);
-  PCA9505_SetOutputPin(SOLENOID_VACUUM_PORT, SOLENOID_VACUUM_PIN, SOLENOID_VACUUM_OFF);
-  PCA9505_SetOutputPin(SOLENOID_DISPATCH_PORT, SOLENOID_DISPATCH_PIN, SOLENOID_DISPATCH_OFF);
-  PCA9505_SetOutputPin(SOLENOID_FEEDER_PORT, SOLENOID_FEEDER_PIN, SOLENOID_FEEDER_UP);
-
+#if LEDANIM_ENABLE
+  ledanim_Init();
+#endif
+
+  // configure default Solenoid state, one burst for all four
+  ioexp_SetOutputPin(SOLENOID_ROTARY_PORT, SOLENOID_ROTARY_PIN, SOLENOID_ROTARY_BACKWARD);
+  ioexp_SetOutputPin(SOLENOID_VACUUM_PORT, SOLENOID_VACUUM_PIN, SOLENOID_VACUUM_OFF);
+  ioexp_SetOutputPin(SOLENOID_DISPATCH_PORT, SOLENOID_DISPATCH_PIN, SOLENOID_DISPATCH_OFF);
+  ioexp_SetOutputPin(SOLENOID_FEEDER_PORT, SOLENOID_FEEDER_PIN, SOLENOID_FEEDER_UP);
+  ioexp_Flush();
+
+  debounce_SetTime(&main_buttons, START_BTN_Pin, MAIN_BUTTON_DEBOUNCE_MS);
+  debounce_Register(&main_buttons);
+  debounce_Init();
+
+  // the start button is polled, the EXTI 10-15 lines stay enabled for the other inputs on them
   HAL_NVIC_SetPriority(EXTI15_10_IRQn, 5, 0);
   HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+  HAL_NVIC_SetPriority(IOEXP_INT_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(IOEXP_INT_IRQn);
 
   // save the log when program Init
-  logger_LogInfo("[MAIN] - Program Start from here....", LOGGER_NULL_STRING);
+  LOGGER_LOG_MSG(LOGMSG_MAIN_PROGRAM_START, 0);
 
   // save the log for IO Port Expander
   if (osEventFlagsGet(osFlag_Main) & MAIN_IO_EXPANDER_FLAG)
-    logger_LogInfo("[MAIN] - IO Port Expander has been initialized", LOGGER_NULL_STRING);
+    LOGGER_LOG_MSG(LOGMSG_MAIN_IOEXP_INIT_OK, 0);
   else
-    logger_LogError("[MAIN] - IO Port Expander failed to initialize", LOGGER_NULL_STRING);
+  {
+    LOGGER_LOG_MSG(LOGMSG_MAIN_IOEXP_INIT_FAIL, 0);
+    msgbus_Post(MSGBUS_FAULT, PER_ERROR_I2C_INIT);
+  }
 
-  mainState = STATE_MAIN_START_IDLE;
+  // every driver the sub threads use is initialized, the log queue holds the records until now
+  main_CreateSubThreads();
+
+  uint32_t initUs = (SEGGER_SYSVIEW_GET_TIMESTAMP() - initStart) / (SystemCoreClock / 1000000U);
+  LOGGER_LOG_MSG(LOGMSG_MAIN_READY, 3, osKernelGetTickCount(), initUs, rtos_staticBytes);
+
+  fsm_Post(&main_fsm, MAIN_EVENT_DONE);
 }
 
 /**
-  * @brief  Preparation before the screw operation
-  * @param  None
+  * @brief  Preparation before the screw operation, entry of STATE_MAIN_START
+  * @param  context:  Not used
   * @retval None
   */
-void main_task_Preparation(void)
+void main_task_Preparation(void* context)
 {
-  logger_LogInfo("[MAIN] - Preparation before the Screw operation", LOGGER_NULL_STRING);
+  osEventFlagsSet(osFlag_Main, MAIN_OPERATION_FLAG);
+  LOGGER_LOG_MSG(LOGMSG_MAIN_PREPARATION, 0);
+  msgbus_Post(MSGBUS_OPERATION_PREPARE, 0);
 
   // configure default Solenoid state
-  PCA9505_SetOutputPin(SOLENOID_ROTARY_PORT, SOLENOID_ROTARY_PIN, SOLENOID_ROTARY_BACKWARD);
-  osDelay(50);
-  PCA9505_SetOutputPin(SOLENOID_VACUUM_PORT, SOLENOID_VACUUM_PIN, SOLENOID_VACUUM_OFF);
-  osDelay(50);
-  PCA9505_SetOutputPin(SOLENOID_DISPATCH_PORT, SOLENOID_DISPATCH_PIN, SOLENOID_DISPATCH_OFF);
-  osDelay(50);
-  PCA9505_SetOutputPin(SOLENOID_FEEDER_PORT, SOLENOID_FEEDER_PIN, SOLENOID_FEEDER_UP);
-  osDelay(50);
-
-  mainState = STATE_MAIN_RUNNING;
+  uint32_t rc = seq_Run(&main_prepTimeline);
+  if (rc != PER_NO_ERROR)
+  {
+    seqStats_t stats;
+    seq_GetStats(&stats);
+    LOGGER_LOG_MSG(LOGMSG_MAIN_PREPARATION_FAIL, 2, stats.failedStep, rc);
+
+    osEventFlagsClear(osFlag_Main, MAIN_OPERATION_FLAG);
+    msgbus_Post(MSGBUS_FAULT, rc);
+    fsm_Post(&main_fsm, MAIN_EVENT_ABORT);
+    return;
+  }
+
+  fsm_Post(&main_fsm, MAIN_EVENT_DONE);
 }
 
 /**
-  * @brief  Execute the screw operation
-  * @param  None
+  * @brief  Execute the screw operation, entry of STATE_MAIN_RUNNING
+  * @param  context:  Not used
   * @retval None
   */
-void main_task_Running(void)
+void main_task_Running(void* context)
 {
-  logger_LogInfo("[MAIN] - Start the Screw Operation", LOGGER_NULL_STRING);
+  LOGGER_LOG_MSG(LOGMSG_MAIN_START_OPERATION, 0);
 
-  // trigger ScrewController & ScrewFeeder Task to running screw operation
+  // trigger ScrewController & ScrewFeeder Task to running screw operation,
+  // the flags stay until both tasks take the command from the bus
+  msgbus_Post(MSGBUS_OPERATION_START, 0);
   osEventFlagsSet(osFlag_ScrewCtrl, HAYASHI_OPERATION_START_FLAG);
   osEventFlagsSet(osFlag_ScrewFeeder, FEEDER_OPERATION_START_FLAG);
 
   osSemaphoreRelease(osSmp_StartBtn);
 
-  mainState = STATE_MAIN_START_IDLE;
+  fsm_Post(&main_fsm, MAIN_EVENT_DONE);
 }
 
 /**
-  * @brief  Monitoring Start/Stop button
+  * @brief  Create the sub thread from main thread, each sub thread will execute its own task
+  *         Called once every object and driver is initialized. The scheduler
+  *         stays locked until all handles are set, the threads look up each
+  *         other's handles when they start.
   * @param  None
   * @retval None
   */
-void main_task_Idle(uint32_t tickCount)
+void main_CreateSubThreads(void)
 {
-  GPIO_PinState pin_state = HAL_GPIO_ReadPin(START_BTN_GPIO_Port, START_BTN_Pin);
-  if (pin_state == GPIO_PIN_RESET)
-  {
-    tickCount_StartButton++;
-    if (tickCount_StartButton == 1)
-      main_StartbuttonHandler();
+  int32_t lock = osKernelLock();
 
-    // allow Button to trigger again after 2 seconds
-    if (tickCount_StartButton >= 10)
-      tickCount_StartButton = 0;
-  }
-  else
-  {
-    tickCount_StartButton = 0;
-  }
+  // creation of feederTask
+  feederTaskHandle = osThreadNew(StartFeederTask, NULL, &rtos_threadAttr[RTOS_THREAD_FEEDER]);
+
+  // creation of screwCtrlTask
+  screwControllerHandle = osThreadNew(StartScrewCtrlTask, NULL, &rtos_threadAttr[RTOS_THREAD_SCREW_CTRL]);
+
+  // creation of sequencerTask
+  sequencerTaskHandle = osThreadNew(StartSequencerTask, NULL, &rtos_threadAttr[RTOS_THREAD_SEQUENCER]);
+
+  // creation of loggerTask
+  loggerTaskHandle = osThreadNew(StartLoggerTask, NULL, &rtos_threadAttr[RTOS_THREAD_LOGGER]);
 
-  // print the message
-  if ((tickCount % 10) == 0)
-    SEGGER_SYSVIEW_Print("[MAIN] - ");
+#if LOGGER_SDCARD_ENABLE
+  // creation of logStorageTask
+  logStorageTaskHandle = osThreadNew(StartLogStorageTask, NULL, &rtos_threadAttr[RTOS_THREAD_LOG_STORAGE]);
+#endif
+
+  osKernelRestoreLock(lock);
 }
 
 /**
-  * @brief  Create the sub thread from main thread, each sub thread will execute its own task
+  * @brief  Current main task state
   * @param  None
+  * @retval State
+  */
+mainState_t main_GetState(void)
+{
+  return (mainState_t)fsm_GetState(&main_fsm);
+}
+
+/**
+  * @brief  GPIO EXTI handler, called from interrupt context
+  * @param  GPIO_Pin:  Pin of the interrupt line
   * @retval None
   */
-void main_CreateSubThreads(void)
+void main_Interrupt_Handler(uint16_t GPIO_Pin)
 {
-  taskENTER_CRITICAL();
+  if (GPIO_Pin == IOEXP_INT_PIN)
+    ioexp_InterruptHandler();
+}
 
-  // creation of feederTask
-  feederTaskHandle = osThreadNew(StartFeederTask, NULL, &feederTask_attributes);
+/**
+  * @brief  Post an event to the main task, from a task, timer or interrupt
+  * @param  event:  Main task event
+  * @retval rc:  PER_NO_ERROR, PER_ERROR_INIT before the queue exists or PER_ERROR_QUEUE_FULL
+  */
+uint32_t main_PostEvent(mainEvent_t event)
+{
+  fsmEvent_t fsmEvent;
 
-  // creation of screwCtrlTask
-  screwControllerHandle = osThreadNew(StartScrewCtrlTask, NULL, &screwController_attributes);
+  if (main_eventQueue == NULL)
+    return PER_ERROR_INIT;
+
+  fsmEvent.id = (uint8_t)event;
+  fsmEvent.postTime = osKernelGetTickCount();
 
-  taskEXIT_CRITICAL();
+  if (osMessageQueuePut(main_eventQueue, &fsmEvent, 0U, 0U) != osOK)
+    return PER_ERROR_QUEUE_FULL;
+
+  return PER_NO_ERROR;
 }
 
 /**
-  * @brief  Change the current main task state, so that it can proceed to next state
-  * @param  state:  Main task state
+  * @brief  Guard of the button event, a press within the lockout of the previous one is ignored
+  * @param  context:  Not used
+  * @param  event:  Button event
+  * @retval True when the press is to be handled
+  */
+static bool main_ButtonReady(void* context, const fsmEvent_t* event)
+{
+  // active low
+  return !main_bButtonLocked && !(debounce_GetState(&main_buttons) & START_BTN_Pin);
+}
+
+/**
+  * @brief  Act on a start button press and lock the button out
+  * @param  context:  Not used
+  * @param  event:  Button event
   * @retval None
   */
-void main_ChangeCurrentState(mainState_t state)
+static void main_ButtonPressed(void* context, const fsmEvent_t* event)
 {
-  mainState = state;
+  main_bButtonLocked = true;
+  osTimerStart(main_buttonTimer, MAIN_BUTTON_LOCKOUT_MS);
+
+  main_StartbuttonHandler();
+}
+
+/**
+  * @brief  Button lockout expired, a button held through it acts again as the polling loop did
+  * @param  context:  Not used
+  * @param  event:  Unlock event
+  * @retval None
+  */
+static void main_ButtonUnlock(void* context, const fsmEvent_t* event)
+{
+  main_bButtonLocked = false;
+
+  if (main_ButtonReady(context, event))
+    main_ButtonPressed(context, event);
+}
+
+/**
+  * @brief  Periodic report of the time spent in each state
+  * @param  context:  Not used
+  * @param  event:  Heartbeat event
+  * @retval None
+  */
+static void main_Heartbeat(void* context, const fsmEvent_t* event)
+{
+  for (uint32_t idx = 0; idx < MAIN_STATE_COUNT; idx++)
+  {
+    const fsmStateStats_t* stats = &main_stateStats[idx];
+    // the visit in progress is not in the total yet
+    uint32_t visits = stats->entries - ((idx == fsm_GetState(&main_fsm)) ? 1 : 0);
+    uint32_t average = (visits > 0) ? (stats->dwellTotal / visits) : 0;
+
+    // the state name lives in target memory, format it here
+    SEGGER_SYSVIEW_PrintfTarget("[MAIN] - %s entries %u dwell avg %u max %u ms",
+                                main_states[idx].name, stats->entries, average, stats->dwellMax);
+  }
+}
+
+/**
+  * @brief  Main task timers, the argument is the event to post
+  * @param  argument:  Event
+  * @retval None
+  */
+static void main_TimerCallback(void* argument)
+{
+  main_PostEvent((mainEvent_t)(uintptr_t)argument);
+}
+
+/**
+  * @brief  Raw inputs of the start button port, read by the debounce timer
+  * @param  None
+  * @retval Port input word
+  */
+static uint32_t main_ReadButtons(void)
+{
+  return START_BTN_GPIO_Port->IDR;
+}
+
+/**
+  * @brief  Debounced edges of the start button port, from the debounce timer
+  * @param  rose:  Inputs released
+  * @param  fell:  Inputs pressed
+  * @param  timestamp:  Tick of the edge
+  * @retval None
+  */
+static void main_ButtonEdge(uint32_t rose, uint32_t fell, uint32_t timestamp)
+{
+  if (fell & START_BTN_Pin)
+    main_PostEvent(MAIN_EVENT_BUTTON);
 }
 
 /**
@@ -250,30 +466,43 @@ void main_StartbuttonHandler(void)
   if (osSemaphoreGetCount(osSmp_StartBtn) >= 1)
   {
     //rgbled_TurnOffLED();
+    msgbus_Post(MSGBUS_OPERATION_STOP, 0);
     osEventFlagsSet(osFlag_ScrewCtrl, HAYASHI_OPERATION_STOP_FLAG);
     osEventFlagsSet(osFlag_ScrewFeeder, FEEDER_OPERATION_STOP_FLAG);
     osSemaphoreAcquire(osSmp_StartBtn, 0U);
+    osEventFlagsClear(osFlag_Main, MAIN_OPERATION_FLAG);
 
-    logger_LogInfo("[EXTI] - Receive Stop button signal", LOGGER_NULL_STRING);
+    LOGGER_LOG_MSG(LOGMSG_EXTI_STOP_BUTTON, 0);
   }
   else
   {
-    // clear the IO interrupt flags
+    // clear the IO interrupt flags, a full re-init only to recover a failed expander
     if (!(osEventFlagsGet(osFlag_Main) & MAIN_IO_EXPANDER_FLAG))
+    {
       SEGGER_SYSVIEW_Print("[EXTI] - IO PORT is not ready to use");
-//    else
-//      IO_Expander_ClearInterrupt();
+
+      IO_Expander_Init();
+      if (osEventFlagsGet(osFlag_Main) & MAIN_IO_EXPANDER_FLAG)
+      {
+        // the re-init rewrote the registers, reload the cache
+        ioexp_Init();
+#if LEDANIM_ENABLE
+        ledanim_ClearError();
+#endif
+      }
+    }
+    else
+      ioexp_Capture();
 
     if (osSemaphoreGetCount(osSmp_ScrewCount) >= 1)
     {
       SEGGER_SYSVIEW_Print("[MAIN] - Reset screw count");
       osSemaphoreAcquire(osSmp_ScrewCount, 100U);
+      msgbus_Post(MSGBUS_SCREW_COUNT_RESET, 0);
     }
 
-    IO_Expander_Init();
-
-    logger_LogInfo("[EXTI] - Receive Start button signal", LOGGER_NULL_STRING);
-    main_ChangeCurrentState(STATE_MAIN_START);
+    LOGGER_LOG_MSG(LOGMSG_EXTI_START_BUTTON, 0);
+    fsm_Post(&main_fsm, MAIN_EVENT_START);
   }
 }
 
@@ -0,0 +1,178 @@
+/**
+  ******************************************************************************
+  * @file    debounce.c
+  * @author  IBronx MDE team
+  * @brief   Port-wide input debounce
+  *          Every DEBOUNCE_SAMPLE_MS the whole word of each registered port is
+  *          sampled and all its inputs are filtered at once. Each input has a
+  *          counter of the consecutive samples differing from its debounced
+  *          state, kept as bit planes so one plane holds the same counter bit
+  *          of all 32 inputs. The counters, their reset and the compare with
+  *          the per input threshold are plain word operations, the cost per
+  *          port does not depend on how many inputs it carries.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "debounce.h"
+#include "cmsis_os.h"
+#include "errorcode.h"
+#include "rtos_objects.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define DEBOUNCE_COUNT_MAX      ((1U << DEBOUNCE_COUNTER_BITS) - 1U)
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static debouncePort_t* debounce_ports[DEBOUNCE_PORT_MAX];
+static volatile uint32_t debounce_portCount;
+static osTimerId_t debounce_timer;
+/* Private function prototypes -----------------------------------------------*/
+static void debounce_TimerCallback(void* argument);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Start sampling the registered ports
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t debounce_Init(void)
+{
+  debounce_timer = osTimerNew(debounce_TimerCallback, osTimerPeriodic, NULL, &rtos_timerAttr[RTOS_TIMER_DEBOUNCE]);
+  if (debounce_timer == NULL)
+    return PER_ERROR_TIMER_NOT_AVAILABLE;
+
+  if (osTimerStart(debounce_timer, DEBOUNCE_SAMPLE_MS) != osOK)
+    return PER_ERROR_TIMER_NOT_AVAILABLE;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Add a port, its current inputs are taken as the debounced state
+* @param  port:  Port with read function and mask set, thresholds set before or DEBOUNCE_DEFAULT_MS
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t debounce_Register(debouncePort_t* port)
+{
+  if ((debounce_portCount >= DEBOUNCE_PORT_MAX) || (port->pfnRead == NULL))
+    return PER_ERROR_INIT;
+
+  uint32_t configured = 0;
+  for (uint32_t k = 0; k < DEBOUNCE_COUNTER_BITS; k++)
+    configured |= port->threshold[k];
+  debounce_SetTime(port, port->mask & ~configured, DEBOUNCE_DEFAULT_MS);
+
+  memset(port->count, 0, sizeof(port->count));
+  port->state = port->pfnRead() & port->mask;
+  port->timestamp = osKernelGetTickCount();
+
+  // the timer task sees the port once the count covers it
+  debounce_ports[debounce_portCount] = port;
+  debounce_portCount++;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Set the debounce time of some inputs of a port
+* @param  port:  Port
+* @param  inputs:  Inputs to set
+* @param  timeMs:  Time an input has to be stable, rounded to samples and clamped to 1 - 31 samples
+* @retval None
+*/
+void debounce_SetTime(debouncePort_t* port, uint32_t inputs, uint32_t timeMs)
+{
+  uint32_t samples = (timeMs + DEBOUNCE_SAMPLE_MS - 1U) / DEBOUNCE_SAMPLE_MS;
+
+  if (samples == 0)
+    samples = 1;
+  if (samples > DEBOUNCE_COUNT_MAX)
+    samples = DEBOUNCE_COUNT_MAX;
+
+  for (uint32_t k = 0; k < DEBOUNCE_COUNTER_BITS; k++)
+  {
+    if (samples & (1U << k))
+      port->threshold[k] |= inputs;
+    else
+      port->threshold[k] &= ~inputs;
+  }
+}
+
+/**
+* @brief  Debounced inputs of a port
+* @param  port:  Port
+* @retval Input word, masked
+*/
+uint32_t debounce_GetState(const debouncePort_t* port)
+{
+  return port->state;
+}
+
+/**
+* @brief  Filter one sample of a port
+* @param  port:  Port
+* @param  sample:  Raw port word
+* @retval Inputs whose debounced state toggled with this sample
+*/
+uint32_t debounce_Filter(debouncePort_t* port, uint32_t sample)
+{
+  // inputs back at their state restart counting from zero
+  uint32_t delta = (sample ^ port->state) & port->mask;
+  uint32_t carry = delta;
+  uint32_t diff = 0;
+
+  // ripple increment of the counters of the differing inputs, compared plane by plane
+  for (uint32_t k = 0; k < DEBOUNCE_COUNTER_BITS; k++)
+  {
+    uint32_t plane = port->count[k] & delta;
+    port->count[k] = plane ^ carry;
+    carry &= plane;
+    diff |= port->count[k] ^ port->threshold[k];
+  }
+
+  uint32_t toggle = delta & ~diff;
+  port->state ^= toggle;
+  for (uint32_t k = 0; k < DEBOUNCE_COUNTER_BITS; k++)
+    port->count[k] &= ~toggle;
+
+  return toggle;
+}
+
+/**
+* @brief  Sample timer, filter every port and report its edges
+* @param  argument:  Not used
+* @retval None
+*/
+static void debounce_TimerCallback(void* argument)
+{
+  uint32_t count = debounce_portCount;
+
+  for (uint32_t idx = 0; idx < count; idx++)
+  {
+    debouncePort_t* port = debounce_ports[idx];
+    uint32_t toggle = debounce_Filter(port, port->pfnRead());
+
+    if (toggle == 0)
+      continue;
+
+    port->timestamp = osKernelGetTickCount();
+    if (port->pfnEdge != NULL)
+      port->pfnEdge(toggle & port->state, toggle & ~port->state, port->timestamp);
+  }
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,256 @@
+/**
+  ******************************************************************************
+  * @file    fsm.c
+  * @author  IBronx MDE team
+  * @brief   Table driven state machine
+  *          The states and transitions are constant tables owned by the user.
+  *          Events are queued and handled one at a time to completion, an
+  *          event posted from a hook is handled after the current transition
+  *          has finished its exit, action and entry. The engine keeps the
+  *          dwell time of every state and the latency of every transition,
+  *          measured with the user clock. It has no RTOS dependency, the
+  *          owner thread is the only caller, other contexts forward their
+  *          events through the owner's own queue.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+#include "errorcode.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static int32_t fsm_FindTransition(fsm_t* fsm, const fsmEvent_t* event);
+static void fsm_Enter(fsm_t* fsm, uint8_t state);
+static void fsm_Leave(fsm_t* fsm);
+static void fsm_CountTransition(fsm_t* fsm, int32_t idx, const fsmEvent_t* event);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Clear the queue and statistics and enter the initial state
+* @param  fsm:  State machine with its tables, clock and context set
+* @param  initial:  Initial state
+* @retval None
+*/
+void fsm_Init(fsm_t* fsm, uint8_t initial)
+{
+  fsm->head = 0;
+  fsm->tail = 0;
+  fsm->dropped = 0;
+  fsm->unhandled = 0;
+  fsm->bDispatching = false;
+
+  if (fsm->stateStats != NULL)
+    memset(fsm->stateStats, 0, fsm->stateCount * sizeof(fsmStateStats_t));
+  if (fsm->transitionStats != NULL)
+    memset(fsm->transitionStats, 0, fsm->transitionCount * sizeof(fsmTransitionStats_t));
+
+  fsm_Enter(fsm, initial);
+}
+
+/**
+* @brief  Queue an event stamped with the current clock
+* @param  fsm:  State machine
+* @param  id:  Event id
+* @retval rc:  PER_NO_ERROR or PER_ERROR_QUEUE_FULL
+*/
+uint32_t fsm_Post(fsm_t* fsm, uint8_t id)
+{
+  fsmEvent_t event;
+
+  event.id = id;
+  event.postTime = fsm->pfnClock();
+
+  return fsm_PostEvent(fsm, &event);
+}
+
+/**
+* @brief  Queue an event keeping its post time, for events forwarded from another context
+* @param  fsm:  State machine
+* @param  event:  Event
+* @retval rc:  PER_NO_ERROR or PER_ERROR_QUEUE_FULL
+*/
+uint32_t fsm_PostEvent(fsm_t* fsm, const fsmEvent_t* event)
+{
+  if ((fsm->head - fsm->tail) >= FSM_QUEUE_SIZE)
+  {
+    fsm->dropped++;
+    return PER_ERROR_QUEUE_FULL;
+  }
+
+  fsm->queue[fsm->head & (FSM_QUEUE_SIZE - 1)] = *event;
+  fsm->head++;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Handle the queued events until the queue is empty
+* @param  fsm:  State machine
+* @retval Number of events taken from the queue, 0 when called from a hook
+*/
+uint32_t fsm_Dispatch(fsm_t* fsm)
+{
+  uint32_t handled = 0;
+
+  // a hook must post, never dispatch, so transitions cannot nest
+  if (fsm->bDispatching)
+    return 0;
+  fsm->bDispatching = true;
+
+  while (fsm->tail != fsm->head)
+  {
+    fsmEvent_t event = fsm->queue[fsm->tail & (FSM_QUEUE_SIZE - 1)];
+    fsm->tail++;
+    handled++;
+
+    int32_t idx = fsm_FindTransition(fsm, &event);
+    if (idx < 0)
+    {
+      fsm->unhandled++;
+      continue;
+    }
+
+    const fsmTransition_t* transition = &fsm->transitions[idx];
+    if (transition->to == FSM_STATE_NONE)
+    {
+      if (transition->pfnAction != NULL)
+        transition->pfnAction(fsm->context, &event);
+    }
+    else
+    {
+      fsm_Leave(fsm);
+      if (transition->pfnAction != NULL)
+        transition->pfnAction(fsm->context, &event);
+      fsm_Enter(fsm, transition->to);
+    }
+
+    fsm_CountTransition(fsm, idx, &event);
+  }
+
+  fsm->bDispatching = false;
+  return handled;
+}
+
+/**
+* @brief  Current state
+* @param  fsm:  State machine
+* @retval State
+*/
+uint8_t fsm_GetState(const fsm_t* fsm)
+{
+  return fsm->current;
+}
+
+/**
+* @brief  Time spent in the current state so far
+* @param  fsm:  State machine
+* @retval Clock units
+*/
+uint32_t fsm_GetDwell(const fsm_t* fsm)
+{
+  return fsm->pfnClock() - fsm->enteredAt;
+}
+
+/**
+* @brief  First transition matching the current state, the event and its guard
+* @param  fsm:  State machine
+* @param  event:  Event
+* @retval Transition index, -1 when none matches
+*/
+static int32_t fsm_FindTransition(fsm_t* fsm, const fsmEvent_t* event)
+{
+  for (uint32_t idx = 0; idx < fsm->transitionCount; idx++)
+  {
+    const fsmTransition_t* transition = &fsm->transitions[idx];
+
+    if (transition->event != event->id)
+      continue;
+    if ((transition->from != FSM_STATE_ANY) && (transition->from != fsm->current))
+      continue;
+    if ((transition->pfnGuard != NULL) && !transition->pfnGuard(fsm->context, event))
+      continue;
+
+    return (int32_t)idx;
+  }
+
+  return -1;
+}
+
+/**
+* @brief  Make a state current and run its entry hook
+* @param  fsm:  State machine
+* @param  state:  New state
+* @retval None
+*/
+static void fsm_Enter(fsm_t* fsm, uint8_t state)
+{
+  fsm->current = state;
+  fsm->enteredAt = fsm->pfnClock();
+
+  if (fsm->stateStats != NULL)
+    fsm->stateStats[state].entries++;
+
+  if (fsm->states[state].pfnEntry != NULL)
+    fsm->states[state].pfnEntry(fsm->context);
+}
+
+/**
+* @brief  Account the dwell time of the current state and run its exit hook
+* @param  fsm:  State machine
+* @retval None
+*/
+static void fsm_Leave(fsm_t* fsm)
+{
+  if (fsm->stateStats != NULL)
+  {
+    fsmStateStats_t* stats = &fsm->stateStats[fsm->current];
+    uint32_t dwell = fsm->pfnClock() - fsm->enteredAt;
+
+    stats->dwellTotal += dwell;
+    if (dwell > stats->dwellMax)
+      stats->dwellMax = dwell;
+  }
+
+  if (fsm->states[fsm->current].pfnExit != NULL)
+    fsm->states[fsm->current].pfnExit(fsm->context);
+}
+
+/**
+* @brief  Account a finished transition, from the event post until now
+* @param  fsm:  State machine
+* @param  idx:  Transition index
+* @param  event:  Event that fired it
+* @retval None
+*/
+static void fsm_CountTransition(fsm_t* fsm, int32_t idx, const fsmEvent_t* event)
+{
+  if (fsm->transitionStats == NULL)
+    return;
+
+  fsmTransitionStats_t* stats = &fsm->transitionStats[idx];
+  uint32_t latency = fsm->pfnClock() - event->postTime;
+
+  stats->count++;
+  stats->latencyTotal += latency;
+  if (latency > stats->latencyMax)
+    stats->latencyMax = latency;
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,600 @@
+/**
+  ******************************************************************************
+  * @file    ioexp_cache.c
+  * @author  IBronx MDE team
+  * @brief   PCA9505 IO expander register cache and input capture
+  *          RAM copies of the output, IO configuration and interrupt mask
+  *          registers. A pin
+  *          change only updates the copy and marks its port, reads never go
+  *          to the bus. The marked ports are written in one auto increment
+  *          burst with I2C DMA, one tick after the first change or at once
+  *          on ioexp_Flush, so the solenoids switched together cost one
+  *          transaction instead of one blocking transfer each. Changes made
+  *          while a burst is in flight go out from its completion. The flush
+  *          timer stays armed until the marked ports are written, it resends
+  *          a failed burst with a doubling delay up to IOEXP_RETRY_DELAY_MAX.
+  *          The INT line EXTI starts one DMA read of all input ports, ahead
+  *          of any pending write. Its completion stores a snapshot stamped
+  *          with the edge time in a ring read by every subscriber at its own
+  *          pace, and notifies the subscribers whose pins changed.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "ioexp_cache.h"
+#include "cmsis_os.h"
+#include "errorcode.h"
+#include "rtos_objects.h"
+#include "SEGGER_SYSVIEW.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define PCA9505_REG_IP0         0x00          // input port 0, ports follow at consecutive addresses
+#define PCA9505_REG_OP0         0x08          // output port 0
+#define PCA9505_REG_IOC0        0x18          // IO configuration port 0, 1 is input
+#define PCA9505_REG_MSK0        0x20          // interrupt mask port 0, 1 is disabled
+#define PCA9505_AUTO_INCREMENT  0x80
+
+#define IOEXP_BANK_OUTPUT       0
+#define IOEXP_BANK_CONFIG       1
+#define IOEXP_BANK_MASK         2
+#define IOEXP_BANK_COUNT        3
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+extern I2C_HandleTypeDef IOEXP_I2C_HANDLE;
+
+static const uint8_t ioexp_bankReg[IOEXP_BANK_COUNT] = { PCA9505_REG_OP0, PCA9505_REG_IOC0, PCA9505_REG_MSK0 };
+static uint8_t ioexp_shadow[IOEXP_BANK_COUNT][IOEXP_PORT_COUNT];
+static volatile uint8_t ioexp_dirty[IOEXP_BANK_COUNT];
+static uint8_t ioexp_txBuffer[IOEXP_PORT_COUNT];
+static uint8_t ioexp_txBank;
+static uint8_t ioexp_txMask;
+static volatile bool ioexp_bBusy;
+static volatile bool ioexp_bFailed;
+static volatile uint32_t ioexp_retryTick;
+static volatile uint32_t ioexp_retryDelay;
+
+static uint8_t ioexp_rxBuffer[IOEXP_PORT_COUNT];
+static uint8_t ioexp_input[IOEXP_PORT_COUNT];
+static volatile bool ioexp_bReadPending;
+static volatile bool ioexp_bReading;
+static volatile uint32_t ioexp_readTime;
+static uint32_t ioexp_rxTime;
+static ioexpSnapshot_t ioexp_snapshots[IOEXP_SNAPSHOT_COUNT];
+static volatile uint32_t ioexp_snapHead;
+static ioexpSubscriber_t* ioexp_subscribers[IOEXP_SUBSCRIBER_MAX];
+static volatile uint32_t ioexp_subscriberCount;
+static osTimerId_t ioexp_flushTimer;
+static osEventFlagsId_t ioexp_flags;
+static ioexpStats_t ioexp_stats;
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t ioexp_Modify(uint8_t bank, uint8_t port, uint8_t mask, uint8_t value);
+static void ioexp_StartTransfer(void);
+static void ioexp_FlushTimerCallback(void* argument);
+static void ioexp_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+static void ioexp_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+static void ioexp_ErrorCallback(I2C_HandleTypeDef* hi2c);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Load the register copies from the expander, called after IO_Expander_Init with no burst in flight
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ioexp_Init(void)
+{
+  if (ioexp_flags == NULL)
+  {
+    ioexp_flags = osEventFlagsNew(&rtos_flagsAttr[RTOS_FLAGS_IOEXP]);
+    ioexp_flushTimer = osTimerNew(ioexp_FlushTimerCallback, osTimerOnce, NULL, &rtos_timerAttr[RTOS_TIMER_IOEXP_FLUSH]);
+    if ((ioexp_flags == NULL) || (ioexp_flushTimer == NULL))
+      return PER_ERROR_INIT;
+
+    HAL_I2C_RegisterCallback(&IOEXP_I2C_HANDLE, HAL_I2C_MEM_TX_COMPLETE_CB_ID, ioexp_MemTxCpltCallback);
+    HAL_I2C_RegisterCallback(&IOEXP_I2C_HANDLE, HAL_I2C_MEM_RX_COMPLETE_CB_ID, ioexp_MemRxCpltCallback);
+    HAL_I2C_RegisterCallback(&IOEXP_I2C_HANDLE, HAL_I2C_ERROR_CB_ID, ioexp_ErrorCallback);
+  }
+
+  osTimerStop(ioexp_flushTimer);
+  memset((void*)ioexp_dirty, 0, sizeof(ioexp_dirty));
+  ioexp_bFailed = false;
+  ioexp_retryDelay = 0;
+  ioexp_bReadPending = false;
+
+  for (uint32_t bank = 0; bank < IOEXP_BANK_COUNT; bank++)
+  {
+    if (HAL_I2C_Mem_Read(&IOEXP_I2C_HANDLE, IOEXP_I2C_ADDRESS, ioexp_bankReg[bank] | PCA9505_AUTO_INCREMENT,
+                         I2C_MEMADD_SIZE_8BIT, ioexp_shadow[bank], IOEXP_PORT_COUNT, 10) != HAL_OK)
+      return PER_ERROR_I2C_RECEIVE_DATA;
+  }
+
+  // reading the inputs also releases INT, the next change pulls it again
+  if (HAL_I2C_Mem_Read(&IOEXP_I2C_HANDLE, IOEXP_I2C_ADDRESS, PCA9505_REG_IP0 | PCA9505_AUTO_INCREMENT,
+                       I2C_MEMADD_SIZE_8BIT, ioexp_input, IOEXP_PORT_COUNT, 10) != HAL_OK)
+    return PER_ERROR_I2C_RECEIVE_DATA;
+
+  osEventFlagsSet(ioexp_flags, IOEXP_IDLE_FLAG);
+
+  // the re-init may have masked the subscribed pins again
+  for (uint32_t idx = 0; idx < ioexp_subscriberCount; idx++)
+  {
+    for (uint8_t port = 0; port < IOEXP_PORT_COUNT; port++)
+    {
+      if (ioexp_subscribers[idx]->mask[port] != 0)
+        ioexp_Modify(IOEXP_BANK_MASK, port, ioexp_subscribers[idx]->mask[port], 0);
+    }
+  }
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Change output pins in the cache, the expander follows within IOEXP_FLUSH_DELAY
+* @param  port:  Port 0 - 4
+* @param  pin:  Pin mask
+* @param  state:  0 drives the pins low, otherwise high
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ioexp_SetOutputPin(uint8_t port, uint8_t pin, uint8_t state)
+{
+  return ioexp_Modify(IOEXP_BANK_OUTPUT, port, pin, state ? pin : 0);
+}
+
+/**
+* @brief  Change the pin directions of a port in the cache
+* @param  port:  Port 0 - 4
+* @param  inputMask:  1 makes the pin an input
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ioexp_SetDirection(uint8_t port, uint8_t inputMask)
+{
+  return ioexp_Modify(IOEXP_BANK_CONFIG, port, 0xFF, inputMask);
+}
+
+/**
+* @brief  Enable or disable the change interrupt of input pins
+* @param  port:  Port 0 - 4
+* @param  disableMask:  1 disables the pin interrupt
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ioexp_SetInterruptMask(uint8_t port, uint8_t disableMask)
+{
+  return ioexp_Modify(IOEXP_BANK_MASK, port, 0xFF, disableMask);
+}
+
+/**
+* @brief  Output state from the cache, no bus access
+* @param  port:  Port 0 - 4
+* @param  pin:  Pin mask
+* @retval True when any of the pins is driven high
+*/
+bool ioexp_GetOutputPin(uint8_t port, uint8_t pin)
+{
+  return (ioexp_GetOutputPort(port) & pin) != 0;
+}
+
+/**
+* @brief  Output register from the cache, no bus access
+* @param  port:  Port 0 - 4
+* @retval Output register value
+*/
+uint8_t ioexp_GetOutputPort(uint8_t port)
+{
+  return (port < IOEXP_PORT_COUNT) ? ioexp_shadow[IOEXP_BANK_OUTPUT][port] : 0;
+}
+
+/**
+* @brief  IO configuration register from the cache, no bus access
+* @param  port:  Port 0 - 4
+* @retval Direction mask, 1 is input
+*/
+uint8_t ioexp_GetDirection(uint8_t port)
+{
+  return (port < IOEXP_PORT_COUNT) ? ioexp_shadow[IOEXP_BANK_CONFIG][port] : 0;
+}
+
+/**
+* @brief  Send the pending changes now instead of at the next tick
+* @param  None
+* @retval None
+*/
+void ioexp_Flush(void)
+{
+  // the armed timer stays, it resends the burst if it fails
+  ioexp_StartTransfer();
+}
+
+/**
+* @brief  Wait until the expander matches the cache or a burst has failed
+* @param  timeout:  Timeout in ms or osWaitForever
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ioexp_Sync(uint32_t timeout)
+{
+  uint32_t flags = osEventFlagsWait(ioexp_flags, IOEXP_IDLE_FLAG, osFlagsWaitAny | osFlagsNoClear, timeout);
+
+  if ((flags & osFlagsError) || !(flags & IOEXP_IDLE_FLAG))
+    return PER_ERROR_I2C_TRANSMIT_COMMAND;
+
+  // report a failed burst once, its ports go out again with the next flush
+  if (ioexp_bFailed)
+  {
+    ioexp_bFailed = false;
+    return PER_ERROR_I2C_TRANSMIT_COMMAND;
+  }
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Read the cache counters
+* @param  stats:  Destination of the counters
+* @retval None
+*/
+void ioexp_GetStats(ioexpStats_t* stats)
+{
+  *stats = ioexp_stats;
+}
+
+/**
+* @brief  Receive the input snapshots changing masked pins and enable their interrupts
+* @param  sub:  Subscriber with mask, flag and thread set, NULL thread is the caller
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ioexp_Subscribe(ioexpSubscriber_t* sub)
+{
+  if ((ioexp_subscriberCount >= IOEXP_SUBSCRIBER_MAX) || (ioexp_flags == NULL))
+    return PER_ERROR_INIT;
+
+  if (sub->thread == NULL)
+    sub->thread = osThreadGetId();
+  sub->tail = ioexp_snapHead;
+  sub->lost = 0;
+
+  ioexp_subscribers[ioexp_subscriberCount] = sub;
+  ioexp_subscriberCount++;
+
+  for (uint8_t port = 0; port < IOEXP_PORT_COUNT; port++)
+  {
+    if (sub->mask[port] != 0)
+      ioexp_Modify(IOEXP_BANK_MASK, port, sub->mask[port], 0);
+  }
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Next snapshot changing a pin of the subscriber, older ones it does not care about are skipped
+* @param  sub:  Subscriber
+* @param  snapshot:  Destination
+* @retval True when a snapshot was copied
+*/
+bool ioexp_GetSnapshot(ioexpSubscriber_t* sub, ioexpSnapshot_t* snapshot)
+{
+  for (;;)
+  {
+    uint32_t head = ioexp_snapHead;
+    if (sub->tail == head)
+      return false;
+
+    if ((head - sub->tail) > IOEXP_SNAPSHOT_COUNT)
+    {
+      sub->lost += head - sub->tail - IOEXP_SNAPSHOT_COUNT;
+      sub->tail = head - IOEXP_SNAPSHOT_COUNT;
+    }
+
+    *snapshot = ioexp_snapshots[sub->tail & (IOEXP_SNAPSHOT_COUNT - 1)];
+    __DMB();
+
+    // the completion overwrote the slot while it was copied, take the next one
+    if ((ioexp_snapHead - sub->tail) > IOEXP_SNAPSHOT_COUNT)
+      continue;
+    sub->tail++;
+
+    for (uint8_t port = 0; port < IOEXP_PORT_COUNT; port++)
+    {
+      if (snapshot->changed[port] & sub->mask[port])
+        return true;
+    }
+  }
+}
+
+/**
+* @brief  Input register from the last snapshot, no bus access
+* @param  port:  Port 0 - 4
+* @retval Input register value
+*/
+uint8_t ioexp_GetInputPort(uint8_t port)
+{
+  return (port < IOEXP_PORT_COUNT) ? ioexp_input[port] : 0;
+}
+
+/**
+* @brief  Take an input snapshot now, it also releases a stuck INT line
+* @param  None
+* @retval None
+*/
+void ioexp_Capture(void)
+{
+  ioexp_InterruptHandler();
+}
+
+/**
+* @brief  INT line EXTI handler, called from interrupt context
+* @param  None
+* @retval None
+*/
+void ioexp_InterruptHandler(void)
+{
+  if (ioexp_flags == NULL)
+    return;
+
+  // edges before the read starts share its snapshot and the first edge time
+  if (!ioexp_bReadPending)
+  {
+    ioexp_readTime = SEGGER_SYSVIEW_GET_TIMESTAMP();
+    ioexp_bReadPending = true;
+  }
+
+  ioexp_StartTransfer();
+}
+
+/**
+* @brief  Update a register copy and schedule the burst when it changed
+* @param  bank:  Output or configuration registers
+* @param  port:  Port 0 - 4
+* @param  mask:  Bits to change
+* @param  value:  New value of the masked bits
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t ioexp_Modify(uint8_t bank, uint8_t port, uint8_t mask, uint8_t value)
+{
+  if ((port >= IOEXP_PORT_COUNT) || (ioexp_flags == NULL))
+    return PER_ERROR_INIT;
+
+  ioexp_stats.pinWrites++;
+
+  // the shadow registers are only written by tasks, compare before taking the interrupts
+  if ((uint8_t)((ioexp_shadow[bank][port] & ~mask) | (value & mask)) == ioexp_shadow[bank][port])
+  {
+    ioexp_stats.skipped++;
+    return PER_NO_ERROR;
+  }
+
+  // not idle from before the port is marked, the completion of its burst sets the flag again
+  osEventFlagsClear(ioexp_flags, IOEXP_IDLE_FLAG);
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  ioexp_shadow[bank][port] = (uint8_t)((ioexp_shadow[bank][port] & ~mask) | (value & mask));
+  ioexp_dirty[bank] |= (uint8_t)(1U << port);
+  __set_PRIMASK(primask);
+
+  // a burst in flight picks the change up from its completion, the timer is armed anyway
+  // so that a failure from the interrupt context still has a flush pending
+  if (!osTimerIsRunning(ioexp_flushTimer))
+    osTimerStart(ioexp_flushTimer, IOEXP_FLUSH_DELAY);
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Start the input read when one is pending, otherwise write the marked ports of one bank
+*         in an auto increment burst, outputs before directions before interrupt masks
+* @param  None
+* @retval None
+*/
+static void ioexp_StartTransfer(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (ioexp_bBusy)
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  if (ioexp_bReadPending)
+  {
+    ioexp_bReadPending = false;
+    ioexp_bReading = true;
+    ioexp_bBusy = true;
+    ioexp_rxTime = ioexp_readTime;
+    __set_PRIMASK(primask);
+
+    if (HAL_I2C_Mem_Read_DMA(&IOEXP_I2C_HANDLE, IOEXP_I2C_ADDRESS, PCA9505_REG_IP0 | PCA9505_AUTO_INCREMENT,
+                             I2C_MEMADD_SIZE_8BIT, ioexp_rxBuffer, IOEXP_PORT_COUNT) != HAL_OK)
+    {
+      // bus held by a blocking transfer, the read goes first with the next transfer
+      primask = __get_PRIMASK();
+      __disable_irq();
+      ioexp_bReadPending = true;
+      ioexp_bReading = false;
+      ioexp_bBusy = false;
+      __set_PRIMASK(primask);
+
+      ioexp_stats.busyRetries++;
+      if (__get_IPSR() == 0)
+        osTimerStart(ioexp_flushTimer, IOEXP_FLUSH_DELAY);
+      return;
+    }
+
+    ioexp_stats.transactions++;
+    return;
+  }
+
+  uint8_t bank = 0;
+  while ((bank < IOEXP_BANK_COUNT - 1) && (ioexp_dirty[bank] == 0))
+    bank++;
+  uint8_t mask = ioexp_dirty[bank];
+  if (mask == 0)
+  {
+    __set_PRIMASK(primask);
+    osEventFlagsSet(ioexp_flags, IOEXP_IDLE_FLAG);
+    return;
+  }
+
+  // the clean ports between the marked ones are written with their cached value
+  uint8_t first = (uint8_t)__builtin_ctz(mask);
+  uint8_t count = (uint8_t)(32 - __builtin_clz(mask) - first);
+  memcpy(ioexp_txBuffer, &ioexp_shadow[bank][first], count);
+  ioexp_dirty[bank] = 0;
+  ioexp_txBank = bank;
+  ioexp_txMask = mask;
+  ioexp_bBusy = true;
+  __set_PRIMASK(primask);
+
+  if (HAL_I2C_Mem_Write_DMA(&IOEXP_I2C_HANDLE, IOEXP_I2C_ADDRESS, (ioexp_bankReg[bank] + first) | PCA9505_AUTO_INCREMENT,
+                            I2C_MEMADD_SIZE_8BIT, ioexp_txBuffer, count) != HAL_OK)
+  {
+    // bus held by a blocking transfer, try again on the next tick
+    primask = __get_PRIMASK();
+    __disable_irq();
+    ioexp_dirty[bank] |= mask;
+    ioexp_bBusy = false;
+    __set_PRIMASK(primask);
+
+    ioexp_stats.busyRetries++;
+    if (__get_IPSR() == 0)
+      osTimerStart(ioexp_flushTimer, IOEXP_FLUSH_DELAY);
+    else
+    {
+      // no timer from an interrupt, ioexp_Sync reports it and the armed flush timer resends
+      ioexp_bFailed = true;
+      osEventFlagsSet(ioexp_flags, IOEXP_IDLE_FLAG);
+    }
+    return;
+  }
+
+  ioexp_stats.transactions++;
+}
+
+/**
+* @brief  Flush timer, the first change of a tick armed it, it re-arms itself until the marked ports are written
+* @param  argument:  Not used
+* @retval None
+*/
+static void ioexp_FlushTimerCallback(void* argument)
+{
+  // a failed burst waits for its backoff, a flush or a completion may send it earlier
+  int32_t wait = (int32_t)(ioexp_retryTick - osKernelGetTickCount());
+  if ((ioexp_retryDelay != 0) && (wait > 0) && !ioexp_bBusy)
+  {
+    osTimerStart(ioexp_flushTimer, (uint32_t)wait);
+    return;
+  }
+
+  ioexp_StartTransfer();
+
+  // a write in flight can still fail, look again at the next tick
+  if ((ioexp_bBusy && !ioexp_bReading) || (ioexp_dirty[IOEXP_BANK_OUTPUT] | ioexp_dirty[IOEXP_BANK_CONFIG] | ioexp_dirty[IOEXP_BANK_MASK]))
+    osTimerStart(ioexp_flushTimer, IOEXP_FLUSH_DELAY);
+}
+
+/**
+* @brief  Burst written, send what changed meanwhile
+* @param  hi2c:  I2C handle
+* @retval None
+*/
+static void ioexp_MemTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+  if (!ioexp_bBusy)
+    return;
+
+  ioexp_retryDelay = 0;
+  ioexp_bBusy = false;
+  ioexp_StartTransfer();
+}
+
+/**
+* @brief  Inputs read, store the snapshot and notify the subscribers of the changed pins
+* @param  hi2c:  I2C handle
+* @retval None
+*/
+static void ioexp_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+  if (!ioexp_bReading)
+    return;
+
+  ioexpSnapshot_t* snapshot = &ioexp_snapshots[ioexp_snapHead & (IOEXP_SNAPSHOT_COUNT - 1)];
+  snapshot->timestamp = ioexp_rxTime;
+  for (uint8_t port = 0; port < IOEXP_PORT_COUNT; port++)
+  {
+    snapshot->input[port] = ioexp_rxBuffer[port];
+    snapshot->changed[port] = ioexp_rxBuffer[port] ^ ioexp_input[port];
+    ioexp_input[port] = ioexp_rxBuffer[port];
+  }
+  __DMB();
+  ioexp_snapHead++;
+  ioexp_stats.captures++;
+
+  for (uint32_t idx = 0; idx < ioexp_subscriberCount; idx++)
+  {
+    ioexpSubscriber_t* sub = ioexp_subscribers[idx];
+    for (uint8_t port = 0; port < IOEXP_PORT_COUNT; port++)
+    {
+      if (snapshot->changed[port] & sub->mask[port])
+      {
+        osThreadFlagsSet(sub->thread, sub->flag);
+        break;
+      }
+    }
+  }
+
+  // INT still low, a pin changed again after the read was sampled, no new edge will come
+  if ((HAL_GPIO_ReadPin(IOEXP_INT_PORT, IOEXP_INT_PIN) == GPIO_PIN_RESET) && !ioexp_bReadPending)
+  {
+    ioexp_readTime = SEGGER_SYSVIEW_GET_TIMESTAMP();
+    ioexp_bReadPending = true;
+  }
+
+  ioexp_bReading = false;
+  ioexp_bBusy = false;
+  ioexp_StartTransfer();
+}
+
+/**
+* @brief  Burst failed, mark its ports again, the flush timer resends them after the backoff so a dead bus cannot storm
+* @param  hi2c:  I2C handle
+* @retval None
+*/
+static void ioexp_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+  if (!ioexp_bBusy)
+    return;
+
+  ioexp_stats.errors++;
+
+  // a failed read is not repeated here, ioexp_Capture takes it again, the writes go on
+  if (ioexp_bReading)
+  {
+    ioexp_bReading = false;
+    ioexp_bBusy = false;
+    ioexp_StartTransfer();
+    return;
+  }
+
+  ioexp_dirty[ioexp_txBank] |= ioexp_txMask;
+  ioexp_retryDelay = (ioexp_retryDelay == 0) ? IOEXP_FLUSH_DELAY :
+                     (ioexp_retryDelay >= IOEXP_RETRY_DELAY_MAX / 2) ? IOEXP_RETRY_DELAY_MAX : ioexp_retryDelay * 2;
+  ioexp_retryTick = osKernelGetTickCount() + ioexp_retryDelay;
+  ioexp_bFailed = true;
+  ioexp_bBusy = false;
+  osEventFlagsSet(ioexp_flags, IOEXP_IDLE_FLAG);
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,400 @@
+/**
+  ******************************************************************************
+  * @file    led_animation.c
+  * @author  IBronx MDE team
+  * @brief   WS28xx status LED animation
+  *          A periodic RTOS timer renders the running pattern into the LED
+  *          framebuffer. Colors are packed 0x00BBGGRR and scaled with two
+  *          lanes per multiply, brightness is 8.8 fixed point and the gamma
+  *          table is applied last. The framebuffer commit only sends a frame
+  *          when a pixel changed, a solid color costs no transfer at all.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "led_animation.h"
+#include "cmsis_os.h"
+#include "errorcode.h"
+#include "rtos_objects.h"
+#include "msgbus.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define LEDANIM_CHASE_TAIL            96        // level of the LED behind the head
+#define LEDANIM_CHASE_BASE            12        // level of the rest of the strip
+/* Private macro -------------------------------------------------------------*/
+#define LEDANIM_PACK(r, g, b)         (((uint32_t)(b) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(r))
+/* Private variables ---------------------------------------------------------*/
+typedef struct
+{
+  uint32_t errorCode;
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+}ledAnimErrorColor_t;
+
+// fault color by error code, one line per code, red for the codes not listed
+static const ledAnimErrorColor_t ledanim_errorColors[] = {
+  { PER_ERROR_SDCARD_FAILED_WRITE,       255,   0, 255 },
+  { PER_ERROR_SDCARD_FAILED_READ,        255,   0, 255 },
+  { PER_ERROR_SDCARD_FAILED_MOUNT,       255,   0, 255 },
+  { PER_ERROR_SDCARD_CREATE_DIRECTORY,   255,   0, 255 },
+  { PER_ERROR_FATFS_UPLOAD_DATA,         255,   0, 255 },
+  { PER_ERROR_FATFS_DELETE_FILES,        255,   0, 255 },
+  { PER_ERROR_FATFS_DUPLICATE_FILE_OPEN, 255,   0, 255 },
+  { PER_ERROR_PCA9505_REGISTER_VALUE,    255,  96,   0 },
+  { PER_ERROR_PCA9505_DATA_SIZE,         255,  96,   0 },
+  { PER_ERROR_I2C_INIT,                  255,  96,   0 },
+  { PER_ERROR_I2C_TRANSMIT_COMMAND,      255,  96,   0 },
+  { PER_ERROR_I2C_RECEIVE_DATA,          255,  96,   0 },
+  { PER_ERROR_USB_TRANSMIT,                0, 255, 255 },
+  { PER_ERROR_LOG_QUERY_BUSY,              0, 255, 255 },
+  { PER_ERROR_QUEUE_FULL,                  0, 255, 255 },
+  { PER_ERROR_FLASH_ERASE,               255, 255,   0 },
+  { PER_ERROR_FLASH_PROGRAM,             255, 255,   0 },
+  { PER_ERROR_FLASH_EMPTY,               255, 255,   0 },
+  { PER_ERROR_FLASH_FOREIGN,             255, 255,   0 },
+};
+
+// gamma 2.2, linear level to PWM duty
+static const uint8_t ledanim_gamma[256] = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+static ledAnimation_t ledanim_state;            // pattern for the main task state
+static ledAnimation_t ledanim_played;           // pattern of ledanim_Play, shown over the state
+static ledAnimation_t ledanim_error;            // fault pattern, shown over both
+static bool ledanim_bPlayed;
+static bool ledanim_bError;
+static uint32_t ledanim_stateTick;              // start of the state pattern
+static uint32_t ledanim_playedTick;             // start of the played pattern
+static uint32_t ledanim_errorTick;              // start of the fault pattern
+static uint16_t ledanim_brightness = LEDANIM_BRIGHTNESS_ONE;
+static osTimerId_t ledanim_timer;
+
+// main state and faults come from the bus, drained once per frame
+static msgbusSubscriber_t ledanim_subscriber = {
+  .name = "LEDANIM",
+  .topics = MSGBUS_TOPIC(MSGBUS_MAIN_STATE) | MSGBUS_TOPIC(MSGBUS_FAULT),
+  .flag = 0,
+};
+static mainState_t ledanim_mainState = STATE_MAIN_INIT;
+
+extern osEventFlagsId_t osFlag_Main;
+
+/* Private function prototypes -----------------------------------------------*/
+static void ledanim_TimerCallback(void* argument);
+static void ledanim_ReadBus(void);
+static void ledanim_Start(ledAnimation_t* dst, uint32_t* p_startTick, const ledAnimation_t* anim);
+static uint32_t ledanim_Level(const ledAnimation_t* anim, uint32_t elapsed, uint32_t led);
+static inline uint32_t ledanim_Scale(uint32_t rgb, uint32_t level);
+static inline uint32_t ledanim_AddSat(uint32_t a, uint32_t b);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Initialize the LED driver and start the animation timer
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t ledanim_Init(void)
+{
+  rgbled_Init();
+
+  if (msgbus_Subscribe(&ledanim_subscriber) != PER_NO_ERROR)
+    return PER_ERROR_INIT;
+
+  ledanim_timer = osTimerNew(ledanim_TimerCallback, osTimerPeriodic, NULL, &rtos_timerAttr[RTOS_TIMER_LEDANIM]);
+  if (ledanim_timer == NULL)
+    return PER_ERROR_TIMER_NOT_AVAILABLE;
+
+  if (osTimerStart(ledanim_timer, LEDANIM_FRAME_MS) != osOK)
+    return PER_ERROR_TIMER_NOT_AVAILABLE;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Play a pattern over the main task state until it is cleared, it
+*         restarts only if it differs
+* @param  anim:  Pattern, NULL clears it and the state pattern shows again
+* @retval None
+*/
+void ledanim_Play(const ledAnimation_t* anim)
+{
+  if (anim == NULL)
+  {
+    ledanim_bPlayed = false;
+    return;
+  }
+
+  // a pattern played again after a clear starts from its first frame
+  if (!ledanim_bPlayed)
+    memset(&ledanim_played, 0, sizeof(ledAnimation_t));
+  ledanim_Start(&ledanim_played, &ledanim_playedTick, anim);
+  ledanim_bPlayed = true;
+}
+
+/**
+* @brief  Set the output brightness
+* @param  brightness:  8.8 fixed point, LEDANIM_BRIGHTNESS_ONE is full scale
+* @retval None
+*/
+void ledanim_SetBrightness(uint16_t brightness)
+{
+  ledanim_brightness = (brightness > LEDANIM_BRIGHTNESS_MAX) ? LEDANIM_BRIGHTNESS_MAX : brightness;
+}
+
+/**
+* @brief  Show the main task state, called on every frame with the state from the bus
+* @param  state:  Main task state
+* @retval None
+*/
+void ledanim_ShowState(mainState_t state)
+{
+  ledAnimation_t anim = { LEDANIM_SOLID, 0, 64, 0, 1000 };
+
+  switch (state)
+  {
+    case STATE_MAIN_INIT:
+      anim = (ledAnimation_t){ LEDANIM_BREATHE, 0, 0, 255, 2000 };
+      break;
+    case STATE_MAIN_START:
+      anim = (ledAnimation_t){ LEDANIM_BLINK, 255, 160, 0, 400 };
+      break;
+    case STATE_MAIN_RUNNING:
+    case STATE_MAIN_START_IDLE:
+      if (osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG)
+        anim = (ledAnimation_t){ LEDANIM_CHASE, 0, 255, 0, 1000 };
+      break;
+  }
+
+  ledanim_Start(&ledanim_state, &ledanim_stateTick, &anim);
+}
+
+/**
+* @brief  Show a fault over the state pattern until ledanim_ClearError
+* @param  errorCode:  Error code from errorcode.h
+* @retval None
+*/
+void ledanim_ShowError(uint32_t errorCode)
+{
+  ledAnimation_t anim = { LEDANIM_BLINK, 255, 0, 0, 500 };
+
+  for (uint32_t idx = 0; idx < (sizeof(ledanim_errorColors) / sizeof(ledanim_errorColors[0])); idx++)
+  {
+    const ledAnimErrorColor_t* p_map = &ledanim_errorColors[idx];
+    if (errorCode == p_map->errorCode)
+    {
+      anim.red = p_map->red;
+      anim.green = p_map->green;
+      anim.blue = p_map->blue;
+      break;
+    }
+  }
+
+  ledanim_Start(&ledanim_error, &ledanim_errorTick, &anim);
+  ledanim_bError = true;
+}
+
+/**
+* @brief  Remove the fault, the state pattern shows again
+* @param  None
+* @retval None
+*/
+void ledanim_ClearError(void)
+{
+  ledanim_bError = false;
+}
+
+/**
+* @brief  Take a new pattern, the phase restarts only when it changes
+* @param  dst:          Pattern slot
+* @param  p_startTick:  Start tick of the slot, a fault keeps the state phase
+* @param  anim:         Pattern
+* @retval None
+*/
+static void ledanim_Start(ledAnimation_t* dst, uint32_t* p_startTick, const ledAnimation_t* anim)
+{
+  if ((dst->pattern == anim->pattern) && (dst->periodMs == anim->periodMs) &&
+      (dst->red == anim->red) && (dst->green == anim->green) && (dst->blue == anim->blue))
+    return;
+
+  // the timer callback reads the pattern from the timer task
+  osKernelLock();
+  memcpy(dst, anim, sizeof(ledAnimation_t));
+  *p_startTick = osKernelGetTickCount();
+  osKernelUnlock();
+}
+
+/**
+* @brief  Render one frame, from the RTOS timer task
+* @param  argument:  Not used
+* @retval None
+*/
+static void ledanim_TimerCallback(void* argument)
+{
+  ledAnimation_t anim;
+  const ledAnimation_t* p_anim = &ledanim_state;
+  uint32_t startTick;
+
+  ledanim_ReadBus();
+
+  // a fault shows over a played pattern, which shows over the state
+  osKernelLock();
+  startTick = ledanim_stateTick;
+  if (ledanim_bError)
+  {
+    p_anim = &ledanim_error;
+    startTick = ledanim_errorTick;
+  }
+  else if (ledanim_bPlayed)
+  {
+    p_anim = &ledanim_played;
+    startTick = ledanim_playedTick;
+  }
+  memcpy(&anim, p_anim, sizeof(ledAnimation_t));
+  uint32_t elapsed = osKernelGetTickCount() - startTick;
+  osKernelUnlock();
+
+  uint32_t rgb = LEDANIM_PACK(anim.red, anim.green, anim.blue);
+
+  for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+  {
+    uint32_t out = ledanim_Scale(rgb, ledanim_Level(&anim, elapsed, led));
+
+    // brightness above 1.0 adds the scaled excess, clipped at full scale
+    if (ledanim_brightness > LEDANIM_BRIGHTNESS_ONE)
+      out = ledanim_AddSat(out, ledanim_Scale(out, ledanim_brightness - LEDANIM_BRIGHTNESS_ONE));
+    else
+      out = ledanim_Scale(out, ledanim_brightness);
+
+    uint8_t red = ledanim_gamma[out & 0xFF];
+    uint8_t green = ledanim_gamma[(out >> 8) & 0xFF];
+    uint8_t blue = ledanim_gamma[(out >> 16) & 0xFF];
+    for (uint32_t strip = 0; strip < RGBLED_STRIP_COUNT; strip++)
+      rgbled_SetStripPixel(strip, led, red, green, blue);
+  }
+
+  rgbled_Commit();
+}
+
+/**
+* @brief  Take the main state and faults published since the last frame
+* @param  None
+* @retval None
+*/
+static void ledanim_ReadBus(void)
+{
+  const msgbusMsg_t* msg;
+
+  while ((msg = msgbus_Receive(&ledanim_subscriber)) != NULL)
+  {
+    if (msg->topic == MSGBUS_MAIN_STATE)
+      ledanim_mainState = (mainState_t)msg->payload[0];
+    else
+      ledanim_ShowError(msg->payload[0]);
+    msgbus_Release(msg);
+  }
+
+  // the running pattern also follows MAIN_OPERATION_FLAG, checked every frame
+  ledanim_ShowState(ledanim_mainState);
+}
+
+/**
+* @brief  Level of one LED at a point of the pattern
+* @param  anim:     Pattern
+* @param  elapsed:  Time since the pattern started in ms
+* @param  led:      LED index
+* @retval Level, 0 to 256
+*/
+static uint32_t ledanim_Level(const ledAnimation_t* anim, uint32_t elapsed, uint32_t led)
+{
+  uint32_t period = (anim->periodMs == 0) ? 1 : anim->periodMs;
+  uint32_t phase = elapsed % period;
+
+  switch (anim->pattern)
+  {
+    case LEDANIM_SOLID:
+      return 256;
+    case LEDANIM_BLINK:
+      return (phase < (period / 2)) ? 256 : 0;
+    case LEDANIM_BREATHE:
+    {
+      // triangle 0 - 256 - 0 over the period
+      uint32_t ramp = (phase * 512) / period;
+      return (ramp < 256) ? ramp : (512 - ramp);
+    }
+    case LEDANIM_CHASE:
+    {
+      uint32_t head = (phase * MAX_WS28XX_LED) / period;
+      uint32_t dist = (head + MAX_WS28XX_LED - led) % MAX_WS28XX_LED;
+      if (dist == 0)
+        return 256;
+      return (dist == 1) ? LEDANIM_CHASE_TAIL : LEDANIM_CHASE_BASE;
+    }
+    default:
+      return 0;
+  }
+}
+
+/**
+* @brief  Scale a packed color, red and blue share one multiply
+* @param  rgb:    Packed 0x00BBGGRR color
+* @param  level:  Scale, 256 is 1.0
+* @retval Packed color
+*/
+static inline uint32_t ledanim_Scale(uint32_t rgb, uint32_t level)
+{
+  uint32_t rb = ((rgb & 0x00FF00FFU) * level) >> 8;
+  uint32_t g = ((rgb & 0x0000FF00U) * level) >> 8;
+
+  return (rb & 0x00FF00FFU) | (g & 0x0000FF00U);
+}
+
+/**
+* @brief  Add packed colors per byte, saturating at 255
+* @param  a:  Packed color
+* @param  b:  Packed color
+* @retval Packed color
+*/
+static inline uint32_t ledanim_AddSat(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+  return __UQADD8(a, b);
+#else
+  uint32_t sum = ((a & 0x7F7F7F7FU) + (b & 0x7F7F7F7FU)) ^ ((a ^ b) & 0x80808080U);
+  uint32_t carry = ((a & b) | ((a | b) & ~sum)) & 0x80808080U;
+
+  return sum | ((carry >> 7) * 0xFFU);
+#endif
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
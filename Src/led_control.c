@@ -5,6 +5,23 @@
   * @brief   Peripheral driver for ws28xx RGB LED control
   *          This file provides firmware utility functions to support WS28xx RGB
   *          LED functions
+  *          With RGBLED_STREAMING_ENABLE the CC1 DMA runs circular over a
+  *          buffer of 2 x RGBLED_STREAM_HALF_LEDS pixels. The half and full
+  *          transfer interrupts encode the next LEDs of the 3 byte per LED
+  *          frame into the half just sent, so long strips need only the
+  *          frame in RAM.
+  *          With RGBLED_STRIP_COUNT > 1 each BSRR word drives the same bit of
+  *          every strip, so all strips refresh in the time of one.
+  *          Frames are queued and sent from the DMA completion: after the
+  *          data the UP and CC3 streams write no-op words for the reset
+  *          latch, then the next queued frame starts, so callers never wait
+  *          for the strip.
+  *          Pixels are set in a framebuffer that marks what changed, only
+  *          the changed LEDs are encoded again and a commit without change
+  *          sends nothing.
+  *          RGBLED_BACKEND selects the output: the GPIO DMA scheme above, SPI
+  *          MOSI or a TIM8 CH1 PWM. SPI and PWM use one DMA stream and put
+  *          the latch at the end of their buffer.
   *
   ******************************************************************************
   * @attention
@@ -22,21 +39,80 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "led_control.h"
+#include "led_encoder.h"
 #include "main.h"
+#include "cmsis_os.h"
+#include "rtos_objects.h"
+
+#include <string.h>
 /* Private define ------------------------------------------------------------*/
+#define RGBLED_NO_SLOT                0xFF
+#define RGBLED_DIRTY_WORDS            ((MAX_WS28XX_LED + 31) / 32)
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+#if (RGBLED_BACKEND == RGBLED_BACKEND_SPI)
+static uint8_t rgbled_spiBuffer[RGBLED_SPI_BUFFER_SIZE];
+#elif (RGBLED_BACKEND == RGBLED_BACKEND_PWM)
+static uint16_t rgbled_pwmBuffer[RGBLED_PWM_BUFFER_SIZE];
+static uint16_t rgbled_pwmCcr0;
+static uint16_t rgbled_pwmCcr1;
+#elif RGBLED_STREAMING_ENABLE
+uint32_t WS2812_DMA_BUFFER[RGBLED_STREAM_BUFFER_SIZE];
+static const uint8_t* rgbled_pStream;           // frame being streamed
+static volatile uint32_t rgbled_streamNext;     // next LED to encode
+#else
 uint32_t WS2812_DMA_BUFFER[TOTAL_RGB_LED_PIXEL_SIZE];
+#endif
+#if (RGBLED_BACKEND == RGBLED_BACKEND_GPIO_DMA)
 uint32_t WS2812_IO_High[1];
 uint32_t WS2812_IO_Low[1];
-ws2812Color_t color[MAX_WS28XX_LED];
+#endif
+// framebuffer, bSet marks a pixel changed since the last commit
+ws2812Color_t color[RGBLED_STRIP_COUNT][MAX_WS28XX_LED];
+
+typedef enum
+{
+  RGBLED_STATE_IDLE = 0,
+  RGBLED_STATE_FRAME,                           // data slots running
+  RGBLED_STATE_LATCH,                           // line held low for the reset latch
+}rgbledState_t;
 
+// one slot is sent while the other holds the next frame
+static uint8_t rgbled_slots[RGBLED_FRAME_QUEUE_DEPTH][RGBLED_STRIP_COUNT][RGB_LED_FRAME_SIZE];
+static uint32_t rgbled_slotSeq[RGBLED_FRAME_QUEUE_DEPTH];
+// LEDs that differ from the DMA buffer once the slot is sent
+static uint32_t rgbled_slotDirty[RGBLED_FRAME_QUEUE_DEPTH][RGBLED_DIRTY_WORDS];
+static bool rgbled_bForeignFrame;               // a frame not from the framebuffer was sent
+static volatile uint8_t rgbled_active = RGBLED_NO_SLOT;
+static volatile bool rgbled_bPending;
+static volatile bool rgbled_bFilling;
+static volatile rgbledState_t rgbled_state;
+static uint32_t rgbled_submitSeq;
+static volatile uint32_t rgbled_doneSeq;
+static osEventFlagsId_t rgbled_flags;
+
+#if (RGBLED_BACKEND == RGBLED_BACKEND_SPI)
+extern SPI_HandleTypeDef RGBLED_SPI_HANDLE;
+extern DMA_HandleTypeDef RGBLED_SPI_DMA_HANDLE;
+#else
 extern DMA_HandleTypeDef hdma_tim8_up;
 extern DMA_HandleTypeDef hdma_tim8_ch1;
 extern DMA_HandleTypeDef hdma_tim8_ch3;
 extern TIM_HandleTypeDef htim8;
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
+static uint8_t rgbled_AcquireSlot(void);
+static uint32_t rgbled_PublishSlot(uint8_t slot);
+static void rgbled_StartFrame(uint8_t slot);
+#if (RGBLED_BACKEND == RGBLED_BACKEND_GPIO_DMA)
+static void rgbled_StartLatch(void);
+#endif
+#if RGBLED_STREAMING_ENABLE
+static void rgbled_StreamRefill(uint32_t* p_half);
+#else
+static void rgbled_EncodeRun(const uint8_t* p_frames, uint32_t first, uint32_t count);
+#endif
 /* function prototypes -------------------------------------------------------*/
 
 /**
@@ -46,11 +122,59 @@ extern TIM_HandleTypeDef htim8;
 */
 void rgbled_Init(void)
 {
+  rgbled_flags = osEventFlagsNew(&rtos_flagsAttr[RTOS_FLAGS_RGBLED]);
+
+  // the first commit sends the whole framebuffer
+  for (uint32_t strip = 0; strip < RGBLED_STRIP_COUNT; strip++)
+  {
+    for (uint32_t idx = 0; idx < MAX_WS28XX_LED; idx++)
+      color[strip][idx].bSet = true;
+  }
+
+#if (RGBLED_BACKEND == RGBLED_BACKEND_SPI)
+  HAL_DMA_RegisterCallback(&RGBLED_SPI_DMA_HANDLE, HAL_DMA_XFER_CPLT_CB_ID, rgbled_DMAXferCpltCallback);
+  __HAL_SPI_ENABLE(&RGBLED_SPI_HANDLE);
+#elif (RGBLED_BACKEND == RGBLED_BACKEND_PWM)
+  // the CC1 stream writes 16 bit compare values instead of BSRR words
+  hdma_tim8_ch1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma_tim8_ch1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  HAL_DMA_Init(&hdma_tim8_ch1);
+  HAL_DMA_RegisterCallback(&hdma_tim8_ch1, HAL_DMA_XFER_CPLT_CB_ID, rgbled_DMAXferCpltCallback);
+
+  uint32_t period = __HAL_TIM_GET_AUTORELOAD(&htim8) + 1;
+  rgbled_pwmCcr0 = (uint16_t)((period * RGBLED_PWM_T0H_PERCENT + 50) / 100);
+  rgbled_pwmCcr1 = (uint16_t)((period * RGBLED_PWM_T1H_PERCENT + 50) / 100);
+
+  __HAL_TIM_SET_COMPARE(&htim8, TIM_CHANNEL_1, 0);
+  HAL_TIM_PWM_Start(&htim8, TIM_CHANNEL_1);
+#else
   HAL_DMA_RegisterCallback(&hdma_tim8_ch3, HAL_DMA_XFER_CPLT_CB_ID, rgbled_DMAXferCpltCallback);
 
+#if (RGBLED_STRIP_COUNT > 1)
+  // RGB_LED_PIN is set up by CubeMX, the other strip pins follow it
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+  GPIO_InitStruct.Pin = RGBLED_STRIP_PINS;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+  HAL_GPIO_Init(RGB_LED_PORT, &GPIO_InitStruct);
+#endif
+
+#if RGBLED_STREAMING_ENABLE
+  // the data stream wraps over the ping-pong buffer, UP and CC3 still count the frame
+  hdma_tim8_ch1.Init.Mode = DMA_CIRCULAR;
+  HAL_DMA_Init(&hdma_tim8_ch1);
+  HAL_DMA_RegisterCallback(&hdma_tim8_ch1, HAL_DMA_XFER_HALFCPLT_CB_ID, rgbled_DMAStreamHalfCallback);
+  HAL_DMA_RegisterCallback(&hdma_tim8_ch1, HAL_DMA_XFER_CPLT_CB_ID, rgbled_DMAStreamCpltCallback);
+#endif
+
   // disable DMA
   HAL_DMA_Start(&hdma_tim8_up, (uint32_t)WS2812_IO_High, (uint32_t)&RGB_LED_PORT->BSRR, TOTAL_RGB_LED_PIXEL_SIZE);
+#if RGBLED_STREAMING_ENABLE
+  HAL_DMA_Start_IT(&hdma_tim8_ch1,  (uint32_t)WS2812_DMA_BUFFER, (uint32_t)&RGB_LED_PORT->BSRR, RGBLED_STREAM_BUFFER_SIZE);
+#else
   HAL_DMA_Start(&hdma_tim8_ch1,  (uint32_t)WS2812_DMA_BUFFER, (uint32_t)&RGB_LED_PORT->BSRR, TOTAL_RGB_LED_PIXEL_SIZE);
+#endif
   HAL_DMA_Start_IT(&hdma_tim8_ch3,  (uint32_t)WS2812_IO_Low, (uint32_t)&RGB_LED_PORT->BSRR, TOTAL_RGB_LED_PIXEL_SIZE);
   __HAL_DMA_DISABLE(&hdma_tim8_up);
   __HAL_DMA_DISABLE(&hdma_tim8_ch1);
@@ -58,10 +182,11 @@ void rgbled_Init(void)
 
   // Starts the TIM Base generation
   HAL_TIM_Base_Start(&htim8);
+#endif
 }
 
 /**
-* @brief  Turn on WS28xx RGB LED
+* @brief  Turn on WS28xx RGB LED, the frame is queued and sent in background
 * @param  red:    Red color pixel
 * @param  green:  Green color pixel
 * @param  blue:   Blue color pixel
@@ -69,16 +194,10 @@ void rgbled_Init(void)
 */
 void rgbled_TurnOnLED(uint8_t red, uint8_t green, uint8_t blue)
 {
-  int total_pixel_cnt = MAX_WS28XX_LED * RGB_LED_PIXEL_SIZE;
-
-  for (int idx = 0; idx < total_pixel_cnt;)
-  {
-    rgbled_SetColorPixel(&WS2812_DMA_BUFFER[idx], red, green, blue);
-    idx += RGB_LED_PIXEL_SIZE;
-  }
+  for (uint32_t strip = 0; strip < RGBLED_STRIP_COUNT; strip++)
+    rgbled_SetRange(strip, 0, MAX_WS28XX_LED, red, green, blue);
 
-  rgbled_TriggerTransmit(TOTAL_RGB_LED_PIXEL_SIZE);
-  HAL_Delay(2);
+  rgbled_Commit();
 }
 
 /**
@@ -92,46 +211,152 @@ void rgbled_TurnOffLED(void)
 }
 
 /**
-  * @brief  Convert the RGB color pixels to the DMA buffer data
-  * @param  p_buf:  Data buffer pointer
+  * @brief  Set one pixel of a strip, shown by the next rgbled_Commit
+  * @param  strip:  Strip index, 0 is on RGB_LED_PIN
+  * @param  led:    LED index
   * @param  red:    Red color pixel
   * @param  green:  Green color pixel
   * @param  blue:   Blue color pixel
   * @retval None
   */
-void rgbled_SetColorPixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t blue)
+void rgbled_SetStripPixel(uint32_t strip, uint32_t led, uint8_t red, uint8_t green, uint8_t blue)
 {
-  // WS2812B requires serial data in the order G-R-B
-  // Each bytes data is shifted out start from MSB, bit 7
-  for (int bit_idx = 7; bit_idx >= 0; bit_idx--)
-  {
-    if ((green >> bit_idx) & 0x01)
-      *(p_buf)  = RGB_LED_PIN;
-    else
-      *(p_buf) = RGB_LED_PIN << 16;
+  if ((strip >= RGBLED_STRIP_COUNT) || (led >= MAX_WS28XX_LED))
+    return;
+
+  ws2812Color_t* p_color = &color[strip][led];
+  if ((p_color->red == red) && (p_color->green == green) && (p_color->blue == blue))
+    return;
 
-    p_buf++;
+  p_color->red = red;
+  p_color->green = green;
+  p_color->blue = blue;
+  p_color->bSet = true;
+}
+
+/**
+  * @brief  Set consecutive pixels of a strip to one color
+  * @param  strip:  Strip index, 0 is on RGB_LED_PIN
+  * @param  first:  First LED index
+  * @param  count:  Number of LEDs
+  * @param  red:    Red color pixel
+  * @param  green:  Green color pixel
+  * @param  blue:   Blue color pixel
+  * @retval None
+  */
+void rgbled_SetRange(uint32_t strip, uint32_t first, uint32_t count, uint8_t red, uint8_t green, uint8_t blue)
+{
+  for (uint32_t led = first; (led < (first + count)) && (led < MAX_WS28XX_LED); led++)
+    rgbled_SetStripPixel(strip, led, red, green, blue);
+}
+
+/**
+  * @brief  Queue the framebuffer if a pixel changed, all strips go in one
+  *         transfer. The framebuffer is owned by a single task.
+  * @param  None
+  * @retval Frame sequence number for rgbled_WaitFrame, the last one if
+  *         nothing changed
+  */
+uint32_t rgbled_Commit(void)
+{
+  uint32_t dirty[RGBLED_DIRTY_WORDS] = { 0 };
+  bool bDirty = false;
+
+  if (rgbled_bForeignFrame)
+  {
+    memset(dirty, 0xFF, sizeof(dirty));
+    bDirty = true;
+    rgbled_bForeignFrame = false;
   }
 
-  for (int bit_idx = 7; bit_idx >= 0; bit_idx--)
+  for (uint32_t strip = 0; strip < RGBLED_STRIP_COUNT; strip++)
   {
-    if ((red >> bit_idx) & 0x01)
-      *(p_buf) = RGB_LED_PIN;
-    else
-      *(p_buf) = RGB_LED_PIN << 16;
+    for (uint32_t idx = 0; idx < MAX_WS28XX_LED; idx++)
+    {
+      if (color[strip][idx].bSet)
+      {
+        dirty[idx / 32] |= 1U << (idx % 32);
+        bDirty = true;
+      }
+    }
+  }
 
-    p_buf++;
+  if (!bDirty)
+    return rgbled_submitSeq;
+
+  uint8_t slot = rgbled_AcquireSlot();
+
+  for (uint32_t strip = 0; strip < RGBLED_STRIP_COUNT; strip++)
+  {
+    uint8_t* p_grb = &rgbled_slots[slot][strip][0];
+    for (uint32_t idx = 0; idx < MAX_WS28XX_LED; idx++)
+    {
+      ws2812Color_t* p_color = &color[strip][idx];
+      *p_grb++ = p_color->green;
+      *p_grb++ = p_color->red;
+      *p_grb++ = p_color->blue;
+      p_color->bSet = false;
+    }
   }
+  for (uint32_t word = 0; word < RGBLED_DIRTY_WORDS; word++)
+    rgbled_slotDirty[slot][word] |= dirty[word];
+
+  return rgbled_PublishSlot(slot);
+}
+
+/**
+  * @brief  Queue a frame and return at once
+  *         A frame still waiting to be sent is replaced, a status light only
+  *         needs to show the latest state.
+  * @param  p_frames:  RGBLED_STRIP_COUNT frames of RGB_LED_FRAME_SIZE bytes G-R-B
+  * @retval Frame sequence number for rgbled_WaitFrame
+  */
+uint32_t rgbled_SubmitFrame(const uint8_t* p_frames)
+{
+  uint8_t slot = rgbled_AcquireSlot();
+
+  memcpy(&rgbled_slots[slot][0][0], p_frames, sizeof(rgbled_slots[0]));
+  memset(rgbled_slotDirty[slot], 0xFF, sizeof(rgbled_slotDirty[0]));
+  rgbled_bForeignFrame = true;
 
-  for (int bit_idx = 7; bit_idx >= 0; bit_idx--)
+  return rgbled_PublishSlot(slot);
+}
+
+/**
+  * @brief  Wait until a frame, or a newer one replacing it, has been sent
+  * @param  seq:      Frame sequence number
+  * @param  timeout:  Timeout in ticks, osWaitForever to block
+  * @retval true if the frame is done
+  */
+bool rgbled_WaitFrame(uint32_t seq, uint32_t timeout)
+{
+  uint32_t start = osKernelGetTickCount();
+
+  while ((int32_t)(rgbled_doneSeq - seq) < 0)
   {
-    if ((blue >> bit_idx) & 0x01)
-      *(p_buf) = RGB_LED_PIN;
-    else
-      *(p_buf) = RGB_LED_PIN << 16;
+    uint32_t elapsed = osKernelGetTickCount() - start;
+    if ((timeout != osWaitForever) && (elapsed >= timeout))
+      return false;
 
-    p_buf++;
+    // one tick at most, a flag set before this wait is taken by the check above
+    osEventFlagsWait(rgbled_flags, RGBLED_FRAME_DONE_FLAG, osFlagsWaitAny, 1U);
   }
+
+  return true;
+}
+
+#if (RGBLED_BACKEND == RGBLED_BACKEND_GPIO_DMA)
+/**
+  * @brief  Convert the RGB color pixels to the DMA buffer data
+  * @param  p_buf:  Data buffer pointer
+  * @param  red:    Red color pixel
+  * @param  green:  Green color pixel
+  * @param  blue:   Blue color pixel
+  * @retval None
+  */
+void rgbled_SetColorPixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t blue)
+{
+  ledenc_EncodePixel(p_buf, red, green, blue);
 }
 
 /**
@@ -141,12 +366,24 @@ void rgbled_SetColorPixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t b
   */
 void rgbled_TriggerTransmit(uint16_t buffer_size)
 {
+  rgbled_state = RGBLED_STATE_FRAME;
+
   // Update WS2812 IO Signal
-  WS2812_IO_High[0] = RGB_LED_PIN;
-  WS2812_IO_Low[0] = RGB_LED_PIN << 16;
+  WS2812_IO_High[0] = RGBLED_STRIP_PINS;
+  WS2812_IO_Low[0] = RGBLED_STRIP_PINS << 16;
+
+#if RGBLED_STREAMING_ENABLE
+  uint16_t data_size = RGBLED_STREAM_BUFFER_SIZE;
+#else
+  uint16_t data_size = buffer_size;
+#endif
 
   HAL_DMA_Start(&hdma_tim8_up, (uint32_t)WS2812_IO_High, (uint32_t)&RGB_LED_PORT->BSRR, buffer_size);
-  HAL_DMA_Start(&hdma_tim8_ch1,  (uint32_t)WS2812_DMA_BUFFER, (uint32_t)&RGB_LED_PORT->BSRR, buffer_size);
+#if RGBLED_STREAMING_ENABLE
+  HAL_DMA_Start_IT(&hdma_tim8_ch1,  (uint32_t)WS2812_DMA_BUFFER, (uint32_t)&RGB_LED_PORT->BSRR, data_size);
+#else
+  HAL_DMA_Start(&hdma_tim8_ch1,  (uint32_t)WS2812_DMA_BUFFER, (uint32_t)&RGB_LED_PORT->BSRR, data_size);
+#endif
   HAL_DMA_Start_IT(&hdma_tim8_ch3,  (uint32_t)WS2812_IO_Low, (uint32_t)&RGB_LED_PORT->BSRR, buffer_size);
 
   // clear all DMA Interrupt flags
@@ -164,7 +401,7 @@ void rgbled_TriggerTransmit(uint16_t buffer_size)
 
   // set the DMA buffer size and timer period cnt
   hdma_tim8_up.Instance->NDTR = buffer_size;
-  hdma_tim8_ch1.Instance->NDTR = buffer_size;
+  hdma_tim8_ch1.Instance->NDTR = data_size;
   hdma_tim8_ch3.Instance->NDTR = buffer_size;
   htim8.Instance->CNT = 0;
 
@@ -183,20 +420,237 @@ void rgbled_TriggerTransmit(uint16_t buffer_size)
   // start the timer
   __HAL_TIM_ENABLE(&htim8);
 }
+#endif
 
 /**
   * @brief  DMA transfer complete callback
+  *         The end of the data starts the reset latch, the end of the latch
+  *         releases the frame and starts the next queued one.
   * @param  DmaHandle  DMA handle
   * @retval None
   */
 void rgbled_DMAXferCpltCallback(DMA_HandleTypeDef *DmaHandle)
 {
+#if (RGBLED_BACKEND == RGBLED_BACKEND_SPI)
+  // the latch bytes at the end of the buffer are being sent
+  CLEAR_BIT(RGBLED_SPI_HANDLE.Instance->CR2, SPI_CR2_TXDMAEN);
+#elif (RGBLED_BACKEND == RGBLED_BACKEND_PWM)
+  // the zero compare values at the end of the buffer were the latch
+  __HAL_TIM_DISABLE_DMA(&htim8, TIM_DMA_CC1);
+#else
   __HAL_TIM_DISABLE_DMA(&htim8, TIM_DMA_UPDATE);
   __HAL_TIM_DISABLE_DMA(&htim8, TIM_DMA_CC1);
   __HAL_TIM_DISABLE_DMA(&htim8, TIM_DMA_CC3);
+#if RGBLED_STREAMING_ENABLE
+  // the circular data stream never completes on its own
+  __HAL_DMA_DISABLE(&hdma_tim8_ch1);
+#endif
+
+  RGB_LED_PORT->BSRR = RGBLED_STRIP_PINS << 16U;
+
+  if (rgbled_state == RGBLED_STATE_FRAME)
+  {
+    rgbled_state = RGBLED_STATE_LATCH;
+    rgbled_StartLatch();
+    return;
+  }
+#endif
+
+  // the next frame is always in the other slot
+  uint8_t next = (rgbled_active == 0) ? 1 : 0;
 
-  RGB_LED_PORT->BSRR = (uint32_t)RGB_LED_PIN << 16U;
+  if (rgbled_active != RGBLED_NO_SLOT)
+    rgbled_doneSeq = rgbled_slotSeq[rgbled_active];
+  rgbled_active = RGBLED_NO_SLOT;
+  rgbled_state = RGBLED_STATE_IDLE;
+
+  if (rgbled_bPending && !rgbled_bFilling)
+  {
+    rgbled_state = RGBLED_STATE_FRAME;
+    rgbled_StartFrame(next);
+  }
+
+  osEventFlagsSet(rgbled_flags, RGBLED_FRAME_DONE_FLAG);
+}
+
+/**
+  * @brief  Take the slot that is not being sent
+  *         The DMA interrupt neither starts nor releases it until it is
+  *         published. A frame not sent yet is replaced, its changes are kept.
+  * @param  None
+  * @retval Slot index
+  */
+static uint8_t rgbled_AcquireSlot(void)
+{
+  uint8_t slot;
+
+  taskENTER_CRITICAL();
+  slot = (rgbled_active == 0) ? 1 : 0;
+  rgbled_bFilling = true;
+  if (!rgbled_bPending)
+    memset(rgbled_slotDirty[slot], 0, sizeof(rgbled_slotDirty[0]));
+  taskEXIT_CRITICAL();
+
+  return slot;
+}
+
+/**
+  * @brief  Mark a filled slot as the next frame, start it if the strip is idle
+  * @param  slot:  Slot index from rgbled_AcquireSlot
+  * @retval Frame sequence number
+  */
+static uint32_t rgbled_PublishSlot(uint8_t slot)
+{
+  bool bStart;
+
+  taskENTER_CRITICAL();
+  uint32_t seq = ++rgbled_submitSeq;
+  rgbled_slotSeq[slot] = seq;
+  rgbled_bFilling = false;
+  rgbled_bPending = true;
+  bStart = (rgbled_state == RGBLED_STATE_IDLE);
+  if (bStart)
+    rgbled_state = RGBLED_STATE_FRAME;
+  taskEXIT_CRITICAL();
+
+  if (bStart)
+    rgbled_StartFrame(slot);
+
+  return seq;
+}
+
+/**
+  * @brief  Encode a queued frame and start sending it
+  * @param  slot:  Queue slot of the frame
+  * @retval None
+  */
+static void rgbled_StartFrame(uint8_t slot)
+{
+  const uint8_t* p_frames = &rgbled_slots[slot][0][0];
+
+  rgbled_active = slot;
+  rgbled_bPending = false;
+
+#if RGBLED_STREAMING_ENABLE
+  // prime both halves, the interrupts encode the rest while it is sent
+  rgbled_pStream = p_frames;
+  rgbled_streamNext = 0;
+  rgbled_StreamRefill(&WS2812_DMA_BUFFER[0]);
+  rgbled_StreamRefill(&WS2812_DMA_BUFFER[RGBLED_STREAM_BUFFER_SIZE / 2]);
+#else
+  // the DMA buffer still holds the last frame, encode the runs of changed LEDs
+  const uint32_t* p_dirty = rgbled_slotDirty[slot];
+  uint32_t led = 0;
+  while (led < MAX_WS28XX_LED)
+  {
+    if (!(p_dirty[led / 32] & (1U << (led % 32))))
+    {
+      led++;
+      continue;
+    }
+
+    uint32_t first = led;
+    while ((led < MAX_WS28XX_LED) && (p_dirty[led / 32] & (1U << (led % 32))))
+      led++;
+
+    rgbled_EncodeRun(p_frames, first, led - first);
+  }
+#endif
+
+#if (RGBLED_BACKEND == RGBLED_BACKEND_SPI)
+  HAL_DMA_Start_IT(&RGBLED_SPI_DMA_HANDLE, (uint32_t)rgbled_spiBuffer, (uint32_t)&RGBLED_SPI_HANDLE.Instance->DR, RGBLED_SPI_BUFFER_SIZE);
+  SET_BIT(RGBLED_SPI_HANDLE.Instance->CR2, SPI_CR2_TXDMAEN);
+#elif (RGBLED_BACKEND == RGBLED_BACKEND_PWM)
+  HAL_DMA_Start_IT(&hdma_tim8_ch1, (uint32_t)rgbled_pwmBuffer, (uint32_t)&htim8.Instance->CCR1, RGBLED_PWM_BUFFER_SIZE);
+  __HAL_TIM_ENABLE_DMA(&htim8, TIM_DMA_CC1);
+#else
+  rgbled_TriggerTransmit(TOTAL_RGB_LED_PIXEL_SIZE);
+#endif
+}
+
+#if !RGBLED_STREAMING_ENABLE
+/**
+  * @brief  Encode consecutive LEDs into the buffer of the output backend
+  * @param  p_frames:  Frames of all strips
+  * @param  first:     First LED to encode
+  * @param  count:     Number of LEDs to encode
+  * @retval None
+  */
+static void rgbled_EncodeRun(const uint8_t* p_frames, uint32_t first, uint32_t count)
+{
+#if (RGBLED_BACKEND == RGBLED_BACKEND_SPI)
+  ledenc_EncodeSpi(&rgbled_spiBuffer[first * RGBLED_SPI_BYTES_PER_LED], p_frames, first, count);
+#elif (RGBLED_BACKEND == RGBLED_BACKEND_PWM)
+  ledenc_EncodePwm(&rgbled_pwmBuffer[first * RGB_LED_PIXEL_SIZE], p_frames, first, count, rgbled_pwmCcr0, rgbled_pwmCcr1);
+#elif (RGBLED_STRIP_COUNT > 1)
+  ledenc_EncodeStrips(&WS2812_DMA_BUFFER[first * RGB_LED_PIXEL_SIZE], p_frames, RGBLED_STRIP_COUNT, first, count);
+#else
+  ledenc_EncodeFrame(&WS2812_DMA_BUFFER[first * RGB_LED_PIXEL_SIZE], p_frames, first, count, MAX_WS28XX_LED);
+#endif
+}
+#endif
+
+#if (RGBLED_BACKEND == RGBLED_BACKEND_GPIO_DMA)
+/**
+  * @brief  Hold the line low for the reset latch
+  *         The UP and CC3 streams keep running on the timer with no-op BSRR
+  *         words, the CC3 completion marks the end of the latch.
+  * @param  None
+  * @retval None
+  */
+static void rgbled_StartLatch(void)
+{
+  WS2812_IO_High[0] = 0;
+  WS2812_IO_Low[0] = 0;
+
+  HAL_DMA_Start_IT(&hdma_tim8_ch3,  (uint32_t)WS2812_IO_Low, (uint32_t)&RGB_LED_PORT->BSRR, RGBLED_LATCH_SLOTS);
+
+  __HAL_DMA_CLEAR_FLAG (&hdma_tim8_up, __HAL_DMA_GET_TC_FLAG_INDEX(&hdma_tim8_up));
+  __HAL_DMA_CLEAR_FLAG (&hdma_tim8_up, __HAL_DMA_GET_HT_FLAG_INDEX(&hdma_tim8_up));
+  __HAL_DMA_CLEAR_FLAG (&hdma_tim8_up, __HAL_DMA_GET_TE_FLAG_INDEX(&hdma_tim8_up));
+  hdma_tim8_up.Instance->NDTR = RGBLED_LATCH_SLOTS;
+
+  __HAL_DMA_ENABLE(&hdma_tim8_up);
+  __HAL_TIM_ENABLE_DMA(&htim8, TIM_DMA_UPDATE);
+  __HAL_TIM_ENABLE_DMA(&htim8, TIM_DMA_CC3);
+}
+#endif
+
+#if RGBLED_STREAMING_ENABLE
+/**
+  * @brief  DMA half transfer callback of the data stream, the first half
+  *         has been sent
+  * @param  DmaHandle  DMA handle
+  * @retval None
+  */
+void rgbled_DMAStreamHalfCallback(DMA_HandleTypeDef *DmaHandle)
+{
+  rgbled_StreamRefill(&WS2812_DMA_BUFFER[0]);
+}
+
+/**
+  * @brief  DMA transfer complete callback of the data stream, the second
+  *         half has been sent and the stream wraps to the first
+  * @param  DmaHandle  DMA handle
+  * @retval None
+  */
+void rgbled_DMAStreamCpltCallback(DMA_HandleTypeDef *DmaHandle)
+{
+  rgbled_StreamRefill(&WS2812_DMA_BUFFER[RGBLED_STREAM_BUFFER_SIZE / 2]);
+}
+
+/**
+  * @brief  Encode the next LEDs of the frame into a half of the stream
+  *         buffer, past the last LED the half is filled with zero words
+  * @param  p_half:  Half of the stream buffer
+  * @retval None
+  */
+static void rgbled_StreamRefill(uint32_t* p_half)
+{
+  ledenc_EncodeFrame(p_half, rgbled_pStream, rgbled_streamNext, RGBLED_STREAM_HALF_LEDS, MAX_WS28XX_LED);
+  rgbled_streamNext += RGBLED_STREAM_HALF_LEDS;
 }
+#endif
 
 
 /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,242 @@
+/**
+  ******************************************************************************
+  * @file    led_encoder.c
+  * @author  IBronx MDE team
+  * @brief   WS28xx bit encoder
+  *          Each WS28xx data bit is one BSRR word, written by the TIM8 CC1 DMA
+  *          between the high and low edges: set keeps the line high for a 1,
+  *          reset pulls it low early for a 0. A nibble table holds the four
+  *          BSRR words of every nibble, so a color byte is encoded with two
+  *          table copies and no data dependent branch.
+  *          Parallel strips share one BSRR word per bit slot. The same byte
+  *          of up to 8 strips is transposed as an 8x8 bit matrix, so each
+  *          output byte holds one bit of every strip and becomes one word.
+  *          The SPI backend sends 3 MOSI bits per data bit at 2.4 MHz, 110
+  *          for a 1 and 100 for a 0, the PWM backend one CCR value per bit.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "led_encoder.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define LEDENC_ONE              ((uint32_t)RGB_LED_PIN)
+#define LEDENC_ZERO             ((uint32_t)RGB_LED_PIN << 16)
+/* Private macro -------------------------------------------------------------*/
+#define LEDENC_BIT(n, b)        ((((n) >> (b)) & 0x01) ? LEDENC_ONE : LEDENC_ZERO)
+#define LEDENC_NIBBLE(n)        { LEDENC_BIT(n, 3), LEDENC_BIT(n, 2), LEDENC_BIT(n, 1), LEDENC_BIT(n, 0) }
+#define LEDENC_SPI_BIT(n, b)    ((((n) >> (b)) & 0x01) ? 0x6U : 0x4U)
+#define LEDENC_SPI_NIBBLE(n)    ((LEDENC_SPI_BIT(n, 3) << 9) | (LEDENC_SPI_BIT(n, 2) << 6) | \
+                                 (LEDENC_SPI_BIT(n, 1) << 3) | LEDENC_SPI_BIT(n, 0))
+/* Private variables ---------------------------------------------------------*/
+// BSRR words of a nibble, MSB first
+static const uint32_t ledenc_nibble[16][4] = {
+  LEDENC_NIBBLE(0),  LEDENC_NIBBLE(1),  LEDENC_NIBBLE(2),  LEDENC_NIBBLE(3),
+  LEDENC_NIBBLE(4),  LEDENC_NIBBLE(5),  LEDENC_NIBBLE(6),  LEDENC_NIBBLE(7),
+  LEDENC_NIBBLE(8),  LEDENC_NIBBLE(9),  LEDENC_NIBBLE(10), LEDENC_NIBBLE(11),
+  LEDENC_NIBBLE(12), LEDENC_NIBBLE(13), LEDENC_NIBBLE(14), LEDENC_NIBBLE(15),
+};
+// 12 MOSI bits of a nibble, MSB first
+static const uint16_t ledenc_spiNibble[16] = {
+  LEDENC_SPI_NIBBLE(0),  LEDENC_SPI_NIBBLE(1),  LEDENC_SPI_NIBBLE(2),  LEDENC_SPI_NIBBLE(3),
+  LEDENC_SPI_NIBBLE(4),  LEDENC_SPI_NIBBLE(5),  LEDENC_SPI_NIBBLE(6),  LEDENC_SPI_NIBBLE(7),
+  LEDENC_SPI_NIBBLE(8),  LEDENC_SPI_NIBBLE(9),  LEDENC_SPI_NIBBLE(10), LEDENC_SPI_NIBBLE(11),
+  LEDENC_SPI_NIBBLE(12), LEDENC_SPI_NIBBLE(13), LEDENC_SPI_NIBBLE(14), LEDENC_SPI_NIBBLE(15),
+};
+/* Private function prototypes -----------------------------------------------*/
+static inline void ledenc_EncodeByte(uint32_t* p_buf, uint8_t value);
+static inline void ledenc_Transpose8(const uint8_t* p_in, uint8_t* p_out);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+  * @brief  Encode one pixel into 24 BSRR words
+  * @param  p_buf:  Data buffer pointer
+  * @param  red:    Red color pixel
+  * @param  green:  Green color pixel
+  * @param  blue:   Blue color pixel
+  * @retval None
+  */
+void ledenc_EncodePixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t blue)
+{
+  // WS2812B requires serial data in the order G-R-B
+  ledenc_EncodeByte(&p_buf[0], green);
+  ledenc_EncodeByte(&p_buf[8], red);
+  ledenc_EncodeByte(&p_buf[16], blue);
+}
+
+/**
+  * @brief  Repeat the pixel encoded at the start of the buffer, for a strip
+  *         showing one color
+  * @param  p_buf:  Data buffer pointer, the first pixel is already encoded
+  * @param  count:  Number of pixels in the buffer
+  * @retval None
+  */
+void ledenc_FillPixels(uint32_t* p_buf, uint32_t count)
+{
+  for (uint32_t idx = 1; idx < count; idx++)
+    memcpy(&p_buf[idx * RGB_LED_PIXEL_SIZE], p_buf, RGB_LED_PIXEL_SIZE * sizeof(uint32_t));
+}
+
+/**
+  * @brief  Encode part of a compact frame, LEDs past the end of the strip
+  *         become zero words that leave the line unchanged
+  * @param  p_buf:     Data buffer pointer, count pixels
+  * @param  p_frame:   Frame, 3 bytes G-R-B per LED
+  * @param  first:     First LED to encode
+  * @param  count:     Number of LEDs to encode
+  * @param  ledCount:  Number of LEDs in the frame
+  * @retval None
+  */
+void ledenc_EncodeFrame(uint32_t* p_buf, const uint8_t* p_frame, uint32_t first, uint32_t count, uint32_t ledCount)
+{
+  for (uint32_t led = first; led < (first + count); led++)
+  {
+    if (led < ledCount)
+    {
+      const uint8_t* p_grb = &p_frame[led * 3];
+      ledenc_EncodeByte(&p_buf[0], p_grb[0]);
+      ledenc_EncodeByte(&p_buf[8], p_grb[1]);
+      ledenc_EncodeByte(&p_buf[16], p_grb[2]);
+    }
+    else
+    {
+      memset(p_buf, 0, RGB_LED_PIXEL_SIZE * sizeof(uint32_t));
+    }
+    p_buf += RGB_LED_PIXEL_SIZE;
+  }
+}
+
+/**
+  * @brief  Encode the frames of parallel strips, bit n of a word drives the
+  *         strip on pin RGB_LED_PIN << n
+  * @param  p_buf:       Data buffer pointer, count pixels
+  * @param  p_frames:    Frames, RGB_LED_FRAME_SIZE bytes G-R-B per strip
+  * @param  stripCount:  Number of strips, 1 to 8
+  * @param  first:       First LED to encode
+  * @param  count:       Number of LEDs to encode
+  * @retval None
+  */
+void ledenc_EncodeStrips(uint32_t* p_buf, const uint8_t* p_frames, uint32_t stripCount, uint32_t first, uint32_t count)
+{
+  uint32_t pins = (uint32_t)RGB_LED_PIN * ((1U << stripCount) - 1U);
+  uint8_t in[8] = { 0 };
+  uint8_t out[8];
+
+  for (uint32_t idx = first * 3; idx < ((first + count) * 3); idx++)
+  {
+    // row 0 is the last strip, so strip n lands on bit n of each column
+    for (uint32_t strip = 0; strip < stripCount; strip++)
+      in[7 - strip] = p_frames[strip * RGB_LED_FRAME_SIZE + idx];
+
+    ledenc_Transpose8(in, out);
+
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+      uint32_t ones = (uint32_t)RGB_LED_PIN * out[bit];
+      *p_buf++ = ones | ((pins & ~ones) << 16);
+    }
+  }
+}
+
+/**
+  * @brief  Encode part of a compact frame into SPI bytes, 9 bytes per LED
+  * @param  p_buf:    Data buffer pointer, count LEDs
+  * @param  p_frame:  Frame, 3 bytes G-R-B per LED
+  * @param  first:    First LED to encode
+  * @param  count:    Number of LEDs to encode
+  * @retval None
+  */
+void ledenc_EncodeSpi(uint8_t* p_buf, const uint8_t* p_frame, uint32_t first, uint32_t count)
+{
+  for (uint32_t idx = first * 3; idx < ((first + count) * 3); idx++)
+  {
+    uint8_t value = p_frame[idx];
+    uint32_t bits = ((uint32_t)ledenc_spiNibble[value >> 4] << 12) | ledenc_spiNibble[value & 0x0F];
+
+    *p_buf++ = (uint8_t)(bits >> 16);
+    *p_buf++ = (uint8_t)(bits >> 8);
+    *p_buf++ = (uint8_t)bits;
+  }
+}
+
+/**
+  * @brief  Encode part of a compact frame into PWM compare values, 24 per LED
+  * @param  p_buf:    Data buffer pointer, count LEDs
+  * @param  p_frame:  Frame, 3 bytes G-R-B per LED
+  * @param  first:    First LED to encode
+  * @param  count:    Number of LEDs to encode
+  * @param  ccr0:     Compare value of a 0 bit
+  * @param  ccr1:     Compare value of a 1 bit
+  * @retval None
+  */
+void ledenc_EncodePwm(uint16_t* p_buf, const uint8_t* p_frame, uint32_t first, uint32_t count, uint16_t ccr0, uint16_t ccr1)
+{
+  for (uint32_t idx = first * 3; idx < ((first + count) * 3); idx++)
+  {
+    uint8_t value = p_frame[idx];
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+      *p_buf++ = (value & 0x80) ? ccr1 : ccr0;
+      value <<= 1;
+    }
+  }
+}
+
+/**
+  * @brief  Encode one color byte into 8 BSRR words, MSB first
+  * @param  p_buf:  Data buffer pointer
+  * @param  value:  Color byte
+  * @retval None
+  */
+static inline void ledenc_EncodeByte(uint32_t* p_buf, uint8_t value)
+{
+  memcpy(&p_buf[0], ledenc_nibble[value >> 4], sizeof(ledenc_nibble[0]));
+  memcpy(&p_buf[4], ledenc_nibble[value & 0x0F], sizeof(ledenc_nibble[0]));
+}
+
+/**
+  * @brief  Transpose an 8x8 bit matrix, Hacker's Delight 7-3
+  *         Output byte n holds bit 7-n of every input byte, input byte 0
+  *         in the MSB. Three swap stages on two words, no per-bit loop.
+  * @param  p_in:   8 input bytes
+  * @param  p_out:  8 output bytes
+  * @retval None
+  */
+static inline void ledenc_Transpose8(const uint8_t* p_in, uint8_t* p_out)
+{
+  uint32_t x = ((uint32_t)p_in[0] << 24) | ((uint32_t)p_in[1] << 16) | ((uint32_t)p_in[2] << 8) | p_in[3];
+  uint32_t y = ((uint32_t)p_in[4] << 24) | ((uint32_t)p_in[5] << 16) | ((uint32_t)p_in[6] << 8) | p_in[7];
+  uint32_t t;
+
+  // swap 1x1 blocks
+  t = (x ^ (x >> 7)) & 0x00AA00AAU;   x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AAU;   y = y ^ t ^ (t << 7);
+  // swap 2x2 blocks
+  t = (x ^ (x >> 14)) & 0x0000CCCCU;  x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCCU;  y = y ^ t ^ (t << 14);
+  // swap 4x4 blocks
+  t = (x & 0xF0F0F0F0U) | ((y >> 4) & 0x0F0F0F0FU);
+  y = ((x << 4) & 0xF0F0F0F0U) | (y & 0x0F0F0F0FU);
+  x = t;
+
+  p_out[0] = (uint8_t)(x >> 24);  p_out[1] = (uint8_t)(x >> 16);
+  p_out[2] = (uint8_t)(x >> 8);   p_out[3] = (uint8_t)x;
+  p_out[4] = (uint8_t)(y >> 24);  p_out[5] = (uint8_t)(y >> 16);
+  p_out[6] = (uint8_t)(y >> 8);   p_out[7] = (uint8_t)y;
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
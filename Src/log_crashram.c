@@ -0,0 +1,161 @@
+/**
+  ******************************************************************************
+  * @file    log_crashram.c
+  * @author  IBronx MDE team
+  * @brief   Crash surviving RAM log
+  *          Every logged record is also kept in a small ring that is not
+  *          cleared at reset. Each slot carries its append position and a CRC,
+  *          so after a hard fault or watchdog reset the last complete records
+  *          are found again in order and slots torn by the reset are skipped.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_crashram.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static const uint16_t logcrash_crcTable[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+/* Private function prototypes -----------------------------------------------*/
+static bool logcrash_IsValid(const logCrashSlot_t* slot);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Start an empty ring
+* @param  ring:  Ring in the .noinit section
+* @retval None
+*/
+void logcrash_Reset(logCrashRing_t* ring)
+{
+  memset(ring->slots, 0, sizeof(ring->slots));
+  atomic_store(&ring->head, 0);
+  ring->magic = LOGCRASH_MAGIC;
+}
+
+/**
+* @brief  Keep a copy of a record, called by any logging task
+* @param  ring:    Ring in the .noinit section
+* @param  record:  Log record
+* @retval None
+*/
+void logcrash_Append(logCrashRing_t* ring, const loggerRecord_t* record)
+{
+  uint32_t seq = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+  logCrashSlot_t* slot = &ring->slots[seq % LOGCRASH_RECORD_COUNT];
+
+  uint32_t len = record->len;
+  if (len > LOGCRASH_PAYLOAD_LEN)
+    len = LOGCRASH_PAYLOAD_LEN;
+
+  slot->seq = seq;
+  slot->timestamp = record->timestamp;
+  slot->msgId = record->msgId;
+  slot->level = record->level;
+  slot->len = (uint8_t)len;
+  memcpy(slot->payload, record->text, len);
+  slot->crc = logcrash_Crc16(LOGCRASH_CRC_INIT, (const uint8_t*)slot, offsetof(logCrashSlot_t, crc));
+}
+
+/**
+* @brief  Hand the records kept before the last reset back in append order,
+*         the ring must be reset afterwards
+* @param  ring:        Ring in the .noinit section
+* @param  pfnRestore:  Called for each surviving record
+* @retval Number of records restored, 0 after a power-on reset
+*/
+uint32_t logcrash_Recover(logCrashRing_t* ring, logCrashRestore_t pfnRestore)
+{
+  if (ring->magic != LOGCRASH_MAGIC)
+    return 0;
+
+  // the newest complete record gives the end of the sequence
+  bool bFound = false;
+  uint32_t last = 0;
+  for (uint32_t idx = 0; idx < LOGCRASH_RECORD_COUNT; idx++)
+  {
+    const logCrashSlot_t* slot = &ring->slots[idx];
+    if (logcrash_IsValid(slot) && (!bFound || ((int32_t)(slot->seq - last) > 0)))
+    {
+      last = slot->seq;
+      bFound = true;
+    }
+  }
+
+  if (!bFound)
+    return 0;
+
+  uint32_t count = 0;
+  uint32_t first = (last >= LOGCRASH_RECORD_COUNT) ? (last - LOGCRASH_RECORD_COUNT + 1) : 0;
+  loggerRecord_t record;
+
+  for (uint32_t seq = first; seq != (last + 1); seq++)
+  {
+    const logCrashSlot_t* slot = &ring->slots[seq % LOGCRASH_RECORD_COUNT];
+    if (!logcrash_IsValid(slot) || (slot->seq != seq))
+      continue;
+
+    memset(&record, 0, sizeof(record));
+    record.timestamp = slot->timestamp;
+    record.msgId = slot->msgId;
+    record.level = slot->level;
+    record.len = slot->len;
+    memcpy(record.text, slot->payload, slot->len);
+
+    pfnRestore(&record);
+    count++;
+  }
+
+  return count;
+}
+
+/**
+* @brief  CRC-16/CCITT, nibble table, also used for the FLASH log pages
+* @param  crc:    LOGCRASH_CRC_INIT, or the CRC of the preceding data
+* @param  pData:  Data
+* @param  size:   Data size in bytes
+* @retval CRC value
+*/
+uint16_t logcrash_Crc16(uint16_t crc, const uint8_t* pData, uint32_t size)
+{
+  while (size--)
+  {
+    uint8_t byte = *pData++;
+    crc = (crc << 4) ^ logcrash_crcTable[(crc >> 12) ^ (byte >> 4)];
+    crc = (crc << 4) ^ logcrash_crcTable[(crc >> 12) ^ (byte & 0x0F)];
+  }
+
+  return crc;
+}
+
+/**
+* @brief  Check that a slot was completely written
+* @param  slot:  Ring slot
+* @retval true if the CRC matches
+*/
+static bool logcrash_IsValid(const logCrashSlot_t* slot)
+{
+  return (slot->len <= LOGCRASH_PAYLOAD_LEN) &&
+      (slot->crc == logcrash_Crc16(LOGCRASH_CRC_INIT, (const uint8_t*)slot, offsetof(logCrashSlot_t, crc)));
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
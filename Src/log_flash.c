@@ -0,0 +1,537 @@
+/**
+  ******************************************************************************
+  * @file    log_flash.c
+  * @author  IBronx MDE team
+  * @brief   Log-structured FLASH log store
+  *          Packed records are collected in a page buffer and appended to the
+  *          log area one page at a time. Each page starts with a header
+  *          holding its sequence number, length and CRC; the header is
+  *          programmed first so a page torn by a reset fails its CRC but is
+  *          still seen as used. Pages fill the sectors in order and the
+  *          sector after the write head is erased ahead, at boot or, with
+  *          LOGFLASH_RUNTIME_ERASE, while the machine is idle. At boot the
+  *          head is found from the first page header of each sector and a
+  *          binary search over the page headers of the newest sector.
+  *          Only sectors that are blank or start with LOGFLASH_MAGIC are
+  *          ever erased, any other content keeps the store closed.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_flash.h"
+#include "log_crashram.h"
+#include "log_journal.h"
+#include "errorcode.h"
+#include "cmsis_os.h"
+
+#include <stddef.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define LOGFLASH_BLANK_CHUNK    64
+#define LOGFLASH_ERASED_WORD    0xFFFFFFFFU
+
+_Static_assert((LOGFLASH_INT_ADDR + (LOGFLASH_INT_SECTOR_COUNT * LOGFLASH_INT_SECTOR_SIZE)) <= LOGJOURNAL_FLASH_ADDR,
+               "internal FLASH log area overlaps the log journal");
+_Static_assert((LOGFLASH_INT_FIRST_SECTOR + LOGFLASH_INT_SECTOR_COUNT) <= LOGJOURNAL_FLASH_SECTOR,
+               "internal FLASH log sectors overlap the log journal");
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static const logFlashDev_t* logflash_dev;
+static uint32_t logflash_pagesPerSector;
+static uint32_t logflash_sector;                // sector of the write head
+static uint32_t logflash_page;                  // next page in the head sector
+static uint32_t logflash_seq;                   // sequence number of the next page
+static uint32_t logflash_fill;                  // payload bytes in the page buffer
+static uint32_t logflash_fillTick;              // tick of the oldest unprogrammed record
+static bool logflash_bErasePending;
+static uint32_t logflash_eraseSector;
+static uint8_t logflash_buf[LOGFLASH_PAGE_SIZE] __attribute__((aligned(4)));
+static logFlashStats_t logflash_stats;
+
+// end of the program image in FLASH, from the linker script
+extern uint32_t _sidata;
+extern uint32_t _sdata;
+extern uint32_t _edata;
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t logflash_IntRead(uint32_t offset, void* pData, uint32_t size);
+static uint32_t logflash_IntProgram(uint32_t offset, const void* pData, uint32_t size);
+static uint32_t logflash_IntErase(uint32_t sectorIdx);
+static bool logflash_IntIsReserved(void);
+static void logflash_ReadHdr(uint32_t sector, uint32_t page, logFlashPageHdr_t* hdr);
+static bool logflash_ReadPage(uint32_t sector, uint32_t page, uint8_t* pPage);
+static uint32_t logflash_FindFree(uint32_t sector);
+static bool logflash_IsBlank(uint32_t sector);
+static void logflash_ScheduleErase(uint32_t sector);
+static void logflash_EraseAhead(void);
+static bool logflash_HasFreePage(void);
+static uint32_t logflash_ProgramPage(void);
+/* function prototypes -------------------------------------------------------*/
+
+// internal FLASH sectors 8 and 9
+const logFlashDev_t logflash_internalDev = {
+  .pfnRead = logflash_IntRead,
+  .pfnProgram = logflash_IntProgram,
+  .pfnErase = logflash_IntErase,
+  .sectorSize = LOGFLASH_INT_SECTOR_SIZE,
+  .sectorCount = LOGFLASH_INT_SECTOR_COUNT,
+};
+
+/**
+* @brief  Find the write head of the log area and erase the sector ahead,
+*         called at boot before the threads run
+* @param  dev:  FLASH device holding the log area
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logflash_Init(const logFlashDev_t* dev)
+{
+  if ((dev->sectorCount < 2) || (dev->sectorSize % LOGFLASH_PAGE_SIZE) != 0)
+    return PER_ERROR_INIT;
+
+  // the linker script must keep the program out of the internal log area
+  if ((dev == &logflash_internalDev) && !logflash_IntIsReserved())
+    return PER_ERROR_INIT;
+
+  logflash_dev = dev;
+  logflash_pagesPerSector = dev->sectorSize / LOGFLASH_PAGE_SIZE;
+  logflash_fill = 0;
+  logflash_bErasePending = false;
+  memset(logflash_buf, 0xFF, sizeof(logflash_buf));
+  memset(&logflash_stats, 0, sizeof(logflash_stats));
+
+  // the newest sector is the one whose first page has the highest sequence,
+  // the header is programmed before the payload so a torn page still has it
+  bool bFound = false;
+  uint32_t headSeq = 0;
+  for (uint32_t sector = 0; sector < dev->sectorCount; sector++)
+  {
+    logFlashPageHdr_t hdr;
+    logflash_ReadHdr(sector, 0, &hdr);
+
+    if (hdr.magic != LOGFLASH_MAGIC)
+    {
+      // not written by the store, never erase it
+      if (!logflash_IsBlank(sector))
+      {
+        logflash_dev = NULL;
+        return PER_ERROR_FLASH_FOREIGN;
+      }
+      continue;
+    }
+
+    // first header torn before its sequence, the sector is skipped and
+    // erased again once the head reaches it
+    if (hdr.seq == LOGFLASH_ERASED_SEQ)
+      continue;
+
+    if (!bFound || ((int32_t)(hdr.seq - headSeq) > 0))
+    {
+      logflash_sector = sector;
+      headSeq = hdr.seq;
+      bFound = true;
+    }
+  }
+
+  if (bFound)
+  {
+    logflash_page = logflash_FindFree(logflash_sector);
+    logflash_seq = headSeq + logflash_page;
+    logflash_ScheduleErase((logflash_sector + 1) % dev->sectorCount);
+  }
+  else
+  {
+    // empty area, start in the first sector as if the last one was full
+    logflash_sector = dev->sectorCount - 1;
+    logflash_page = logflash_pagesPerSector;
+    logflash_seq = 0;
+    logflash_ScheduleErase(0);
+  }
+
+  logflash_stats.headSeq = logflash_seq;
+
+  // the threads do not run yet, the erase stall is harmless here
+  if (logflash_bErasePending)
+    logflash_EraseAhead();
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Check that a record can be stored without waiting for an erase
+* @param  size:  Packed record size in bytes
+* @retval true if the record fits the page buffer or a free page is ready
+*/
+bool logflash_IsReady(uint32_t size)
+{
+  if ((logflash_dev == NULL) || (size > LOGFLASH_PAGE_PAYLOAD))
+    return false;
+
+  return ((logflash_fill + size) <= LOGFLASH_PAGE_PAYLOAD) || logflash_HasFreePage();
+}
+
+/**
+* @brief  Append a packed record, records never straddle two pages
+* @param  pData:  Packed record
+* @param  size:   Record size in bytes
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logflash_Write(const uint8_t* pData, uint32_t size)
+{
+  if (!logflash_IsReady(size))
+    return PER_ERROR_FLASH_PROGRAM;
+
+  if ((logflash_fill + size) > LOGFLASH_PAGE_PAYLOAD)
+    logflash_ProgramPage();
+
+  if (logflash_fill == 0)
+    logflash_fillTick = osKernelGetTickCount();
+
+  memcpy(&logflash_buf[sizeof(logFlashPageHdr_t) + logflash_fill], pData, size);
+  logflash_fill += size;
+  logflash_stats.bytesLogged += size;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Program the partial page, used for error events and by the time
+*         threshold. The rest of the page stays unused
+* @param  None
+* @retval None
+*/
+void logflash_Flush(void)
+{
+  if ((logflash_fill > 0) && logflash_HasFreePage())
+    logflash_ProgramPage();
+}
+
+/**
+* @brief  Apply the time threshold and erase ahead, called periodically by the
+*         logger task. A sector erase stalls code fetches from the internal
+*         FLASH, every task and interrupt included, for about a second, so
+*         at runtime it only runs between cycles with LOGFLASH_RUNTIME_ERASE
+* @param  bEraseAllowed:  true while no operation is running
+* @retval None
+*/
+void logflash_Poll(bool bEraseAllowed)
+{
+  if (logflash_dev == NULL)
+    return;
+
+  if ((logflash_fill > 0) && ((osKernelGetTickCount() - logflash_fillTick) >= LOGFLASH_SYNC_PERIOD_MS))
+    logflash_Flush();
+
+#if LOGFLASH_RUNTIME_ERASE
+  if (logflash_bErasePending && bEraseAllowed)
+    logflash_EraseAhead();
+#else
+  // only logflash_Init erases, before the threads run
+  (void)bEraseAllowed;
+#endif
+}
+
+/**
+* @brief  Read back the stored pages, oldest first, pages failing their CRC
+*         are skipped. Uses a page sized buffer on the caller stack
+* @param  pfnPage:  Called for each valid page
+* @param  ctx:      Passed to pfnPage
+* @retval Number of valid pages
+*/
+uint32_t logflash_ForEachPage(logFlashPage_t pfnPage, void* ctx)
+{
+  uint8_t page[LOGFLASH_PAGE_SIZE] __attribute__((aligned(4)));
+  uint32_t count = 0;
+
+  if (logflash_dev == NULL)
+    return 0;
+
+  for (uint32_t idx = 1; idx <= logflash_dev->sectorCount; idx++)
+  {
+    uint32_t sector = (logflash_sector + idx) % logflash_dev->sectorCount;
+
+    // a sector waiting for its erase still holds the oldest pages
+    for (uint32_t pageIdx = 0; pageIdx < logflash_pagesPerSector; pageIdx++)
+    {
+      logFlashPageHdr_t hdr;
+      logflash_ReadHdr(sector, pageIdx, &hdr);
+      if (hdr.magic == LOGFLASH_ERASED_WORD)
+        break;
+
+      if (!logflash_ReadPage(sector, pageIdx, page))
+        continue;
+
+      pfnPage(((const logFlashPageHdr_t*)page)->seq, &page[sizeof(logFlashPageHdr_t)],
+              ((const logFlashPageHdr_t*)page)->len, ctx);
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/**
+* @brief  Read the store counters
+* @param  stats:  Destination of the counters
+* @retval None
+*/
+void logflash_GetStats(logFlashStats_t* stats)
+{
+  memcpy(stats, &logflash_stats, sizeof(logFlashStats_t));
+}
+
+/**
+* @brief  Check that the program image ends before the internal log area
+* @param  None
+* @retval true if the log area is free
+*/
+static bool logflash_IntIsReserved(void)
+{
+  uint32_t imageEnd = (uint32_t)&_sidata + ((uint32_t)&_edata - (uint32_t)&_sdata);
+
+  return imageEnd <= LOGFLASH_INT_ADDR;
+}
+
+/**
+* @brief  Internal FLASH read, the log area is memory mapped
+* @param  offset:  Offset in the log area
+* @param  pData:   Destination
+* @param  size:    Size in bytes
+* @retval rc:  PER_NO_ERROR
+*/
+static uint32_t logflash_IntRead(uint32_t offset, void* pData, uint32_t size)
+{
+  memcpy(pData, (const void*)(LOGFLASH_INT_ADDR + offset), size);
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Internal FLASH word programming
+* @param  offset:  Offset in the log area, word aligned
+* @param  pData:   Data, word aligned
+* @param  size:    Size in bytes, multiple of 4
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logflash_IntProgram(uint32_t offset, const void* pData, uint32_t size)
+{
+  uint32_t rc = PER_NO_ERROR;
+  const uint32_t* pWord = (const uint32_t*)pData;
+
+  HAL_FLASH_Unlock();
+  for (uint32_t pos = 0; pos < size; pos += sizeof(uint32_t))
+  {
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, LOGFLASH_INT_ADDR + offset + pos, *pWord++) != HAL_OK)
+    {
+      rc = PER_ERROR_FLASH_PROGRAM;
+      break;
+    }
+  }
+  HAL_FLASH_Lock();
+
+  return rc;
+}
+
+/**
+* @brief  Internal FLASH sector erase
+* @param  sectorIdx:  Sector of the log area
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logflash_IntErase(uint32_t sectorIdx)
+{
+  uint32_t rc = PER_NO_ERROR;
+  FLASH_EraseInitTypeDef erase = {
+    .TypeErase = FLASH_TYPEERASE_SECTORS,
+    .Sector = LOGFLASH_INT_FIRST_SECTOR + sectorIdx,
+    .NbSectors = 1,
+    .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+  };
+  uint32_t sectorError;
+
+  HAL_FLASH_Unlock();
+  if (HAL_FLASHEx_Erase(&erase, &sectorError) != HAL_OK)
+    rc = PER_ERROR_FLASH_ERASE;
+  HAL_FLASH_Lock();
+
+  return rc;
+}
+
+/**
+* @brief  Read a page header, a failed read gives an erased header
+* @param  sector:  Sector of the log area
+* @param  page:    Page in the sector
+* @param  hdr:     Destination of the header
+* @retval None
+*/
+static void logflash_ReadHdr(uint32_t sector, uint32_t page, logFlashPageHdr_t* hdr)
+{
+  if (logflash_dev->pfnRead((sector * logflash_dev->sectorSize) + (page * LOGFLASH_PAGE_SIZE),
+                            hdr, sizeof(logFlashPageHdr_t)) != PER_NO_ERROR)
+    memset(hdr, 0xFF, sizeof(logFlashPageHdr_t));
+}
+
+/**
+* @brief  Read a page and check its header
+* @param  sector:  Sector of the log area
+* @param  page:    Page in the sector
+* @param  pPage:   Destination, LOGFLASH_PAGE_SIZE bytes
+* @retval true if the page was completely written
+*/
+static bool logflash_ReadPage(uint32_t sector, uint32_t page, uint8_t* pPage)
+{
+  const logFlashPageHdr_t* hdr = (const logFlashPageHdr_t*)pPage;
+
+  if (logflash_dev->pfnRead((sector * logflash_dev->sectorSize) + (page * LOGFLASH_PAGE_SIZE),
+                            pPage, LOGFLASH_PAGE_SIZE) != PER_NO_ERROR)
+    return false;
+
+  if ((hdr->magic != LOGFLASH_MAGIC) || (hdr->seq == LOGFLASH_ERASED_SEQ) || (hdr->len > LOGFLASH_PAGE_PAYLOAD))
+    return false;
+
+  uint16_t crc = logcrash_Crc16(LOGCRASH_CRC_INIT, pPage, offsetof(logFlashPageHdr_t, crc));
+  crc = logcrash_Crc16(crc, &pPage[sizeof(logFlashPageHdr_t)], hdr->len);
+
+  return crc == hdr->crc;
+}
+
+/**
+* @brief  Binary search for the first free page, pages are used in order
+* @param  sector:  Sector of the log area
+* @retval Page index, pages per sector if the sector is full
+*/
+static uint32_t logflash_FindFree(uint32_t sector)
+{
+  uint32_t lo = 0;
+  uint32_t hi = logflash_pagesPerSector;
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    logFlashPageHdr_t hdr;
+    logflash_ReadHdr(sector, mid, &hdr);
+    if (hdr.magic == LOGFLASH_ERASED_WORD)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return lo;
+}
+
+/**
+* @brief  Check that a whole sector is erased
+* @param  sector:  Sector of the log area
+* @retval true if every byte reads 0xFF
+*/
+static bool logflash_IsBlank(uint32_t sector)
+{
+  uint32_t chunk[LOGFLASH_BLANK_CHUNK / sizeof(uint32_t)];
+  uint32_t offset = sector * logflash_dev->sectorSize;
+
+  for (uint32_t pos = 0; pos < logflash_dev->sectorSize; pos += sizeof(chunk))
+  {
+    logflash_dev->pfnRead(offset + pos, chunk, sizeof(chunk));
+    for (uint32_t idx = 0; idx < (sizeof(chunk) / sizeof(uint32_t)); idx++)
+    {
+      if (chunk[idx] != 0xFFFFFFFFU)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+* @brief  Mark the sector after the write head for erase, unless it is blank
+* @param  sector:  Sector of the log area
+* @retval None
+*/
+static void logflash_ScheduleErase(uint32_t sector)
+{
+  logflash_eraseSector = sector;
+  logflash_bErasePending = !logflash_IsBlank(sector);
+}
+
+/**
+* @brief  Erase the sector marked by logflash_ScheduleErase
+* @param  None
+* @retval None
+*/
+static void logflash_EraseAhead(void)
+{
+  if (logflash_dev->pfnErase(logflash_eraseSector) == PER_NO_ERROR)
+  {
+    logflash_bErasePending = false;
+    logflash_stats.erases++;
+  }
+  else
+  {
+    logflash_stats.errors++;
+  }
+}
+
+/**
+* @brief  Check that the page buffer can be programmed now
+* @param  None
+* @retval true unless the head sector is full and the next one not erased yet
+*/
+static bool logflash_HasFreePage(void)
+{
+  return (logflash_page < logflash_pagesPerSector) || !logflash_bErasePending;
+}
+
+/**
+* @brief  Program the page buffer at the write head and move the head
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logflash_ProgramPage(void)
+{
+  logFlashPageHdr_t* hdr = (logFlashPageHdr_t*)logflash_buf;
+
+  if (logflash_page >= logflash_pagesPerSector)
+  {
+    logflash_sector = (logflash_sector + 1) % logflash_dev->sectorCount;
+    logflash_page = 0;
+    logflash_ScheduleErase((logflash_sector + 1) % logflash_dev->sectorCount);
+  }
+
+  hdr->magic = LOGFLASH_MAGIC;
+  hdr->seq = logflash_seq;
+  hdr->len = (uint16_t)logflash_fill;
+  hdr->crc = logcrash_Crc16(LOGCRASH_CRC_INIT, logflash_buf, offsetof(logFlashPageHdr_t, crc));
+  hdr->crc = logcrash_Crc16(hdr->crc, &logflash_buf[sizeof(logFlashPageHdr_t)], logflash_fill);
+
+  // header first, a payload torn by a reset then fails the CRC
+  uint32_t offset = (logflash_sector * logflash_dev->sectorSize) + (logflash_page * LOGFLASH_PAGE_SIZE);
+  uint32_t size = (logflash_fill + 3U) & ~3U;
+  uint32_t rc = logflash_dev->pfnProgram(offset, logflash_buf, sizeof(logFlashPageHdr_t));
+  if (rc == PER_NO_ERROR)
+    rc = logflash_dev->pfnProgram(offset + sizeof(logFlashPageHdr_t), &logflash_buf[sizeof(logFlashPageHdr_t)], size);
+
+  // the page is used even if programming failed
+  if (rc == PER_NO_ERROR)
+    logflash_stats.pagesWritten++;
+  else
+    logflash_stats.errors++;
+
+  memset(logflash_buf, 0xFF, sizeof(logflash_buf));
+  logflash_page++;
+  logflash_seq++;
+  logflash_fill = 0;
+  logflash_stats.headSeq = logflash_seq;
+
+  return rc;
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
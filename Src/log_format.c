@@ -0,0 +1,419 @@
+/**
+  ******************************************************************************
+  * @file    log_format.c
+  * @author  IBronx MDE team
+  * @brief   Bounded log text formatter
+  *          Small replacement for sprintf covering the log line shapes:
+  *          strings, decimal and hex integers and error codes. Output is
+  *          written straight into the caller's buffer and always terminated,
+  *          text that does not fit is cut and flagged.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_format.h"
+#include "errorcode.h"
+
+#include <stddef.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define LOGFMT_NUM_LEN          11        // "-2147483648"
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+ typedef struct
+ {
+   uint32_t code;
+   const char* name;
+ }logfmtErrorName_t;
+
+static const char logfmt_hexDigits[] = "0123456789ABCDEF";
+static const char logfmt_hexDigitsLower[] = "0123456789abcdef";
+
+// every code of errorcode.h by its define name, printed without the PER_ERROR_ / PER_ prefix
+#define LOGFMT_ERROR_NAME(id)   { id, #id }
+
+static const logfmtErrorName_t logfmt_errorNames[] = {
+  LOGFMT_ERROR_NAME(PER_NO_ERROR),
+  LOGFMT_ERROR_NAME(PER_ERROR_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_BASE_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_BASE_PWM_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_CONFIG_CLK),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_OC_CONFIG_CHANNEL),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_CONFIG_BREAK_DEAD_TIME),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_ENCODER_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIM_CONFIG_SYNC),
+  LOGFMT_ERROR_NAME(PER_ERROR_PWM_CONFIG_CHANNEL),
+  LOGFMT_ERROR_NAME(PER_ERROR_ADC_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_ADC_CONFIG_CHANNEL),
+  LOGFMT_ERROR_NAME(PER_ERROR_ADC_CHANNEL_NOT_SUPPORTED),
+  LOGFMT_ERROR_NAME(PER_ERROR_DMA_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_USART_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_CAN_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_CAN_CONFIG_FILTER),
+  LOGFMT_ERROR_NAME(PER_ERROR_CAN_START_PERIPHERAL),
+  LOGFMT_ERROR_NAME(PER_ERROR_CAN_ENABLE_INTERRUPT),
+  LOGFMT_ERROR_NAME(PER_ERROR_CAN_SEND_MESSAGE),
+  LOGFMT_ERROR_NAME(PER_ERROR_CAN_RECEIVE_MESSAGE),
+  LOGFMT_ERROR_NAME(PER_ERROR_I2C_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_I2C_TRANSMIT_COMMAND),
+  LOGFMT_ERROR_NAME(PER_ERROR_I2C_RECEIVE_DATA),
+  LOGFMT_ERROR_NAME(PER_ERROR_SPI_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_TIMER_NOT_AVAILABLE),
+  LOGFMT_ERROR_NAME(PER_ERROR_RTC_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_RTC_SET_DATE),
+  LOGFMT_ERROR_NAME(PER_ERROR_RTC_SET_TIME),
+  LOGFMT_ERROR_NAME(PER_ERROR_FLASH_ERASE),
+  LOGFMT_ERROR_NAME(PER_ERROR_FLASH_PROGRAM),
+  LOGFMT_ERROR_NAME(PER_ERROR_FLASH_EMPTY),
+  LOGFMT_ERROR_NAME(PER_ERROR_SEQUENCE_TIMEOUT),
+  LOGFMT_ERROR_NAME(PER_ERROR_SEQUENCE_BUSY),
+  LOGFMT_ERROR_NAME(PER_ERROR_QUEUE_FULL),
+  LOGFMT_ERROR_NAME(PER_ERROR_FLASH_FOREIGN),
+  LOGFMT_ERROR_NAME(PER_ERROR_DW1000_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_DW1000_SEND_MESSAGE),
+  LOGFMT_ERROR_NAME(PER_ERROR_SDCARD_FAILED_WRITE),
+  LOGFMT_ERROR_NAME(PER_ERROR_SDCARD_FAILED_READ),
+  LOGFMT_ERROR_NAME(PER_ERROR_SDCARD_FAILED_MOUNT),
+  LOGFMT_ERROR_NAME(PER_ERROR_SDCARD_CREATE_DIRECTORY),
+  LOGFMT_ERROR_NAME(PER_ERROR_ESP32_UART_INIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_ESP32_ATC_ERROR),
+  LOGFMT_ERROR_NAME(PER_ERROR_ESP32_ATC_SEND_FAIL),
+  LOGFMT_ERROR_NAME(PER_ERROR_ESP32_WIFI_FAIL_CONNECT),
+  LOGFMT_ERROR_NAME(PER_ERROR_ESP32_ATC_TIMEOUT),
+  LOGFMT_ERROR_NAME(PER_ERROR_ESP32_ATC_BUSY),
+  LOGFMT_ERROR_NAME(PER_ERROR_FATFS_UPLOAD_DATA),
+  LOGFMT_ERROR_NAME(PER_ERROR_FATFS_DELETE_FILES),
+  LOGFMT_ERROR_NAME(PER_ERROR_FATFS_DUPLICATE_FILE_OPEN),
+  LOGFMT_ERROR_NAME(PER_ERROR_PCA9505_REGISTER_VALUE),
+  LOGFMT_ERROR_NAME(PER_ERROR_PCA9505_DATA_SIZE),
+  LOGFMT_ERROR_NAME(PER_ERROR_USB_TRANSMIT),
+  LOGFMT_ERROR_NAME(PER_ERROR_LOG_QUERY_BUSY),
+};
+/* Private function prototypes -----------------------------------------------*/
+static void logfmt_Number(logFmt_t* fmt, const char* digits, uint32_t len, uint32_t width, char pad);
+static uint32_t logfmt_ToDec(char* tmp, uint32_t value);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Start formatting into a buffer
+* @param  fmt:   Formatter state
+* @param  buf:   Destination buffer
+* @param  size:  Buffer size including the terminator, must not be 0
+* @retval None
+*/
+void logfmt_Init(logFmt_t* fmt, char* buf, uint32_t size)
+{
+  fmt->buf = buf;
+  fmt->size = size;
+  fmt->len = 0;
+  fmt->bTruncated = false;
+}
+
+/**
+* @brief  Append one character
+* @param  fmt:  Formatter state
+* @param  c:    Character
+* @retval None
+*/
+void logfmt_Char(logFmt_t* fmt, char c)
+{
+  if (fmt->len < (fmt->size - 1))
+    fmt->buf[fmt->len++] = c;
+  else
+    fmt->bTruncated = true;
+}
+
+/**
+* @brief  Append a string, NULL is treated as empty
+* @param  fmt:  Formatter state
+* @param  str:  String
+* @retval None
+*/
+void logfmt_Str(logFmt_t* fmt, const char* str)
+{
+  if (str == NULL)
+    return;
+
+  // local pointers, a char store through fmt->buf could alias fmt itself
+  char* dst = &fmt->buf[fmt->len];
+  char* end = &fmt->buf[fmt->size - 1];
+  while ((*str != '\0') && (dst < end))
+    *dst++ = *str++;
+
+  fmt->len = (uint32_t)(dst - fmt->buf);
+  if (*str != '\0')
+    fmt->bTruncated = true;
+}
+
+/**
+* @brief  Append a string right aligned in a field, like "%6s"
+* @param  fmt:    Formatter state
+* @param  str:    String
+* @param  width:  Field width
+* @retval None
+*/
+void logfmt_StrPad(logFmt_t* fmt, const char* str, uint32_t width)
+{
+  uint32_t len = 0;
+  while ((str != NULL) && (str[len] != '\0'))
+    len++;
+
+  while (width > len)
+  {
+    logfmt_Char(fmt, ' ');
+    width--;
+  }
+  logfmt_Str(fmt, str);
+}
+
+/**
+* @brief  Append an unsigned decimal number
+* @param  fmt:    Formatter state
+* @param  value:  Number
+* @retval None
+*/
+void logfmt_UDec(logFmt_t* fmt, uint32_t value)
+{
+  char tmp[LOGFMT_NUM_LEN];
+  uint32_t len = logfmt_ToDec(tmp, value);
+  logfmt_Number(fmt, &tmp[LOGFMT_NUM_LEN - len], len, 0, ' ');
+}
+
+/**
+* @brief  Append a signed decimal number
+* @param  fmt:    Formatter state
+* @param  value:  Number
+* @retval None
+*/
+void logfmt_Dec(logFmt_t* fmt, int32_t value)
+{
+  if (value < 0)
+  {
+    logfmt_Char(fmt, '-');
+    logfmt_UDec(fmt, 0U - (uint32_t)value);
+  }
+  else
+  {
+    logfmt_UDec(fmt, (uint32_t)value);
+  }
+}
+
+/**
+* @brief  Append an upper case hex number with "0x" prefix
+* @param  fmt:     Formatter state
+* @param  value:   Number
+* @param  digits:  Minimum number of digits, zero padded
+* @retval None
+*/
+void logfmt_Hex(logFmt_t* fmt, uint32_t value, uint32_t digits)
+{
+  char tmp[8];
+  uint32_t len = 0;
+
+  do
+  {
+    tmp[7 - len++] = logfmt_hexDigits[value & 0x0F];
+    value >>= 4;
+  } while (value != 0);
+
+  logfmt_Str(fmt, "0x");
+  logfmt_Number(fmt, &tmp[8 - len], len, digits, '0');
+}
+
+/**
+* @brief  Append an error code from errorcode.h by name, e.g.
+*         "SDCARD_FAILED_WRITE(0x1002)", unknown codes as hex only
+* @param  fmt:   Formatter state
+* @param  code:  Error code
+* @retval None
+*/
+void logfmt_ErrorCode(logFmt_t* fmt, uint32_t code)
+{
+  for (uint32_t idx = 0; idx < (sizeof(logfmt_errorNames) / sizeof(logfmt_errorNames[0])); idx++)
+  {
+    if (logfmt_errorNames[idx].code == code)
+    {
+      const char* name = logfmt_errorNames[idx].name;
+      name += (strncmp(name, "PER_ERROR_", 10) == 0) ? 10 : 4;
+      logfmt_Str(fmt, name);
+      logfmt_Char(fmt, '(');
+      logfmt_Hex(fmt, code, 4);
+      logfmt_Char(fmt, ')');
+      return;
+    }
+  }
+
+  logfmt_Hex(fmt, code, 4);
+}
+
+/**
+* @brief  Expand a message table format with raw arguments. Supports %u, %d,
+*         %x/%X with optional zero flag and width, %E for an error code from
+*         errorcode.h and %%, the "l" length modifier is ignored
+* @param  fmt:     Formatter state
+* @param  format:  Format string
+* @param  args:    Arguments
+* @param  nArgs:   Number of arguments, missing ones print as 0
+* @retval None
+*/
+void logfmt_Args(logFmt_t* fmt, const char* format, const uint32_t* args, uint32_t nArgs)
+{
+  uint32_t argIdx = 0;
+
+  while (*format != '\0')
+  {
+    if (*format != '%')
+    {
+      // copy the text up to the next conversion in one go
+      char* dst = &fmt->buf[fmt->len];
+      char* end = &fmt->buf[fmt->size - 1];
+      while ((*format != '\0') && (*format != '%') && (dst < end))
+        *dst++ = *format++;
+      fmt->len = (uint32_t)(dst - fmt->buf);
+      if ((*format != '\0') && (*format != '%'))
+      {
+        fmt->bTruncated = true;
+        return;
+      }
+      continue;
+    }
+
+    format++;
+    if (*format == '%')
+    {
+      logfmt_Char(fmt, *format++);
+      continue;
+    }
+
+    char pad = ' ';
+    uint32_t width = 0;
+    if (*format == '0')
+    {
+      pad = '0';
+      format++;
+    }
+    while ((*format >= '0') && (*format <= '9'))
+      width = (width * 10) + (uint32_t)(*format++ - '0');
+    while (*format == 'l')
+      format++;
+
+    uint32_t value = (argIdx < nArgs) ? args[argIdx] : 0;
+    argIdx++;
+
+    char tmp[LOGFMT_NUM_LEN];
+    uint32_t len;
+    switch (*format)
+    {
+      case 'd':
+      {
+        bool bNegative = ((int32_t)value < 0);
+        len = logfmt_ToDec(tmp, bNegative ? (0U - value) : value);
+        if (bNegative && (pad == '0'))
+        {
+          // the sign goes before the zeros
+          logfmt_Char(fmt, '-');
+          width = (width > 0) ? (width - 1) : 0;
+        }
+        else if (bNegative)
+        {
+          // and after the spaces
+          tmp[LOGFMT_NUM_LEN - 1 - len++] = '-';
+        }
+        logfmt_Number(fmt, &tmp[LOGFMT_NUM_LEN - len], len, width, pad);
+        break;
+      }
+      case 'u':
+        len = logfmt_ToDec(tmp, value);
+        logfmt_Number(fmt, &tmp[LOGFMT_NUM_LEN - len], len, width, pad);
+        break;
+      case 'x':
+      case 'X':
+      {
+        const char* hex = (*format == 'x') ? logfmt_hexDigitsLower : logfmt_hexDigits;
+        len = 0;
+        do
+        {
+          tmp[LOGFMT_NUM_LEN - 1 - len++] = hex[value & 0x0F];
+          value >>= 4;
+        } while (value != 0);
+        logfmt_Number(fmt, &tmp[LOGFMT_NUM_LEN - len], len, width, pad);
+        break;
+      }
+      case 'E':
+        logfmt_ErrorCode(fmt, value);
+        break;
+      case '\0':
+        return;
+      default:
+        logfmt_Char(fmt, *format);
+        break;
+    }
+    format++;
+  }
+}
+
+/**
+* @brief  Terminate the text
+* @param  fmt:  Formatter state
+* @retval Text length without terminator
+*/
+uint32_t logfmt_End(logFmt_t* fmt)
+{
+  fmt->buf[fmt->len] = '\0';
+  return fmt->len;
+}
+
+/**
+* @brief  Append digits with left padding
+* @param  fmt:     Formatter state
+* @param  digits:  Digits, not terminated
+* @param  len:     Number of digits
+* @param  width:   Field width
+* @param  pad:     Padding character
+* @retval None
+*/
+static void logfmt_Number(logFmt_t* fmt, const char* digits, uint32_t len, uint32_t width, char pad)
+{
+  while (width > len)
+  {
+    logfmt_Char(fmt, pad);
+    width--;
+  }
+
+  for (uint32_t idx = 0; idx < len; idx++)
+    logfmt_Char(fmt, digits[idx]);
+}
+
+/**
+* @brief  Convert to decimal digits, right aligned at the end of tmp
+* @param  tmp:    Buffer of LOGFMT_NUM_LEN characters
+* @param  value:  Number
+* @retval Number of digits
+*/
+static uint32_t logfmt_ToDec(char* tmp, uint32_t value)
+{
+  uint32_t len = 0;
+
+  do
+  {
+    tmp[LOGFMT_NUM_LEN - 1 - len++] = (char)('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+
+  return len;
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
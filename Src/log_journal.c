@@ -0,0 +1,259 @@
+/**
+  ******************************************************************************
+  * @file    log_journal.c
+  * @author  IBronx MDE team
+  * @brief   Append-only FLASH journal for the log file counter
+  *          Every update programs the next free entry of the active sector.
+  *          Once its LOGJOURNAL_ENTRY_COUNT entries are used the journal goes
+  *          on in the other sector, so the erase never touches the sector
+  *          holding the last value and a reset keeps the counter. Entries
+  *          are written in order, so the write position is found with a
+  *          binary search for the first erased entry.
+  *          A sector erase stalls the CPU for 1-2 s, logjournal_PrepareSpare
+  *          does it at boot before the active sector is full.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_journal.h"
+#include "errorcode.h"
+
+#include <stdbool.h>
+/* Private define ------------------------------------------------------------*/
+#define LOGJOURNAL_ERASED       0xFFFFFFFFU
+#define LOGJOURNAL_NO_SECTOR    LOGJOURNAL_SECTOR_COUNT
+/* Private macro -------------------------------------------------------------*/
+#define LOGJOURNAL_ENTRIES(sector) \
+  ((const volatile logJournalEntry_t*)(LOGJOURNAL_FLASH_ADDR + (sector) * LOGJOURNAL_SECTOR_SIZE))
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t logjournal_FindActive(uint32_t* pValue, uint32_t* pFree);
+static bool logjournal_LastValue(uint32_t sector, uint32_t freeIdx, uint32_t* pValue);
+static uint32_t logjournal_FindFree(uint32_t sector);
+static bool logjournal_IsBlank(uint32_t sector);
+static uint32_t logjournal_Erase(uint32_t sector);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Read the last valid journal value
+* @param  pValue:  Destination of the value
+* @retval rc:  PER_NO_ERROR, or PER_ERROR_FLASH_EMPTY if nothing was written yet
+*/
+uint32_t logjournal_Read(uint32_t* pValue)
+{
+  uint32_t freeIdx;
+
+  if (logjournal_FindActive(pValue, &freeIdx) == LOGJOURNAL_NO_SECTOR)
+    return PER_ERROR_FLASH_EMPTY;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Append a new value to the journal, a full sector continues in the
+*         other sector, which is erased first if needed
+* @param  value:  Value to store, not lower than the last one
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logjournal_Append(uint32_t value)
+{
+  uint32_t rc = PER_NO_ERROR;
+  uint32_t last;
+  uint32_t idx;
+  uint32_t sector = logjournal_FindActive(&last, &idx);
+
+  if (sector == LOGJOURNAL_NO_SECTOR)
+  {
+    sector = 0;
+    idx = logjournal_FindFree(0);
+  }
+
+  HAL_FLASH_Unlock();
+
+  // the full sector keeps the last value until the other one has an entry
+  if (idx >= LOGJOURNAL_ENTRY_COUNT)
+  {
+    sector = (sector + 1) % LOGJOURNAL_SECTOR_COUNT;
+    idx = 0;
+    if (!logjournal_IsBlank(sector))
+      rc = logjournal_Erase(sector);
+  }
+
+  if (rc == PER_NO_ERROR)
+  {
+    uint32_t addr = (uint32_t)&LOGJOURNAL_ENTRIES(sector)[idx];
+
+    // value first, the check word makes the entry valid
+    if ((HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, value) != HAL_OK) ||
+        (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + sizeof(uint32_t), ~value) != HAL_OK))
+      rc = PER_ERROR_FLASH_PROGRAM;
+  }
+
+  HAL_FLASH_Lock();
+
+  return rc;
+}
+
+/**
+* @brief  Erase the spare sector ahead once the active one is half full,
+*         called at boot where the 1-2 s stall of the 128 KB sector erase
+*         does not disturb the machine. Without it the erase happens in
+*         logjournal_Append when the active sector is full
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logjournal_PrepareSpare(void)
+{
+  uint32_t rc = PER_NO_ERROR;
+  uint32_t value;
+  uint32_t freeIdx;
+  uint32_t sector = logjournal_FindActive(&value, &freeIdx);
+
+  if ((sector == LOGJOURNAL_NO_SECTOR) || (freeIdx < (LOGJOURNAL_ENTRY_COUNT / 2)))
+    return PER_NO_ERROR;
+
+  uint32_t spare = (sector + 1) % LOGJOURNAL_SECTOR_COUNT;
+  if (!logjournal_IsBlank(spare))
+  {
+    HAL_FLASH_Unlock();
+    rc = logjournal_Erase(spare);
+    HAL_FLASH_Lock();
+  }
+
+  return rc;
+}
+
+/**
+* @brief  Find the sector holding the last value, the values only grow so it
+*         is the sector with the higher last valid entry, on a tie the one
+*         that is not full
+* @param  pValue:  Destination of the last value
+* @param  pFree:   Destination of the first erased entry of that sector
+* @retval Sector index, LOGJOURNAL_NO_SECTOR if no sector has a valid entry
+*/
+static uint32_t logjournal_FindActive(uint32_t* pValue, uint32_t* pFree)
+{
+  uint32_t active = LOGJOURNAL_NO_SECTOR;
+
+  for (uint32_t sector = 0; sector < LOGJOURNAL_SECTOR_COUNT; sector++)
+  {
+    uint32_t freeIdx = logjournal_FindFree(sector);
+    uint32_t value;
+
+    if (logjournal_LastValue(sector, freeIdx, &value) &&
+        ((active == LOGJOURNAL_NO_SECTOR) || (value > *pValue) ||
+         ((value == *pValue) && (freeIdx < *pFree))))
+    {
+      active = sector;
+      *pValue = value;
+      *pFree = freeIdx;
+    }
+  }
+
+  return active;
+}
+
+/**
+* @brief  Read the last valid entry of a sector
+* @param  sector:   Journal sector index
+* @param  freeIdx:  First erased entry of the sector
+* @param  pValue:   Destination of the value
+* @retval true if the sector has a valid entry
+*/
+static bool logjournal_LastValue(uint32_t sector, uint32_t freeIdx, uint32_t* pValue)
+{
+  const volatile logJournalEntry_t* entries = LOGJOURNAL_ENTRIES(sector);
+
+  // skip entries torn by a reset during programming
+  while (freeIdx > 0)
+  {
+    freeIdx--;
+    uint32_t value = entries[freeIdx].value;
+    if (entries[freeIdx].check == ~value)
+    {
+      *pValue = value;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+* @brief  Binary search for the first erased entry of a sector
+* @param  sector:  Journal sector index
+* @retval Entry index, LOGJOURNAL_ENTRY_COUNT if the sector is full
+*/
+static uint32_t logjournal_FindFree(uint32_t sector)
+{
+  const volatile logJournalEntry_t* entries = LOGJOURNAL_ENTRIES(sector);
+  uint32_t lo = 0;
+  uint32_t hi = LOGJOURNAL_ENTRY_COUNT;
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if ((entries[mid].value == LOGJOURNAL_ERASED) && (entries[mid].check == LOGJOURNAL_ERASED))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return lo;
+}
+
+/**
+* @brief  Check that every entry of a sector is erased, a reset during an
+*         erase can leave programmed words anywhere
+* @param  sector:  Journal sector index
+* @retval true if blank
+*/
+static bool logjournal_IsBlank(uint32_t sector)
+{
+  const volatile logJournalEntry_t* entries = LOGJOURNAL_ENTRIES(sector);
+
+  for (uint32_t idx = 0; idx < LOGJOURNAL_ENTRY_COUNT; idx++)
+  {
+    if ((entries[idx].value != LOGJOURNAL_ERASED) || (entries[idx].check != LOGJOURNAL_ERASED))
+      return false;
+  }
+
+  return true;
+}
+
+/**
+* @brief  Erase a journal sector, the FLASH must be unlocked. The CPU stalls
+*         on the FLASH bus until the erase is done
+* @param  sector:  Journal sector index
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logjournal_Erase(uint32_t sector)
+{
+  FLASH_EraseInitTypeDef erase = {
+    .TypeErase = FLASH_TYPEERASE_SECTORS,
+    .Sector = LOGJOURNAL_FLASH_SECTOR + sector,
+    .NbSectors = 1,
+    .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+  };
+  uint32_t sectorError;
+
+  if (HAL_FLASHEx_Erase(&erase, &sectorError) != HAL_OK)
+    return PER_ERROR_FLASH_ERASE;
+
+  return PER_NO_ERROR;
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
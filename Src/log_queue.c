@@ -0,0 +1,138 @@
+/**
+  ******************************************************************************
+  * @file    log_queue.c
+  * @author  IBronx MDE team
+  * @brief   Lock-free multi-producer log record queue
+  *          Any task or interrupt reserves a slot with a single CAS on the
+  *          head index, fills the record in place and publishes it through
+  *          the slot sequence number. The logger task is the only consumer.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_queue.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Initialize the queue, every slot is free for its first position
+* @param  q:  Queue handle
+* @retval None
+*/
+void logq_Init(logQueue_t* q)
+{
+  for (uint32_t idx = 0; idx < LOGQ_SIZE; idx++)
+    atomic_init(&q->slots[idx].seq, idx);
+
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->dropped, 0);
+  q->highWater = 0;
+}
+
+/**
+* @brief  Reserve one slot for a producer
+* @param  q:  Queue handle
+* @retval Slot to fill in, or NULL if the queue is full (record is dropped)
+*/
+logqSlot_t* logq_Reserve(logQueue_t* q)
+{
+  uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+  for (;;)
+  {
+    logqSlot_t* slot = &q->slots[pos & LOGQ_MASK];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    int32_t diff = (int32_t)(seq - pos);
+
+    if (diff == 0)
+    {
+      // slot is free for this position, try to claim it
+      if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+        return slot;
+    }
+    else if (diff < 0)
+    {
+      // consumer has not released this slot yet, the queue is full
+      atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+      return NULL;
+    }
+    else
+    {
+      // another producer took this position
+      pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    }
+  }
+}
+
+/**
+* @brief  Publish a slot filled by the producer to the consumer
+* @param  slot:  Slot returned by logq_Reserve
+* @retval None
+*/
+void logq_Commit(logqSlot_t* slot)
+{
+  uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+  atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+}
+
+/**
+* @brief  Take the oldest published record, only called by the logger task
+* @param  q:       Queue handle
+* @param  record:  Destination of the record
+* @retval true if a record was copied, false if the queue is empty
+*/
+bool logq_Pop(logQueue_t* q, loggerRecord_t* record)
+{
+  uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  logqSlot_t* slot = &q->slots[pos & LOGQ_MASK];
+  uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+  // empty, or the producer of this position has not committed yet
+  if ((int32_t)(seq - (pos + 1)) < 0)
+    return false;
+
+  uint32_t depth = atomic_load_explicit(&q->head, memory_order_relaxed) - pos;
+  if (depth > q->highWater)
+    q->highWater = depth;
+
+  memcpy(record, &slot->record, sizeof(loggerRecord_t));
+
+  // release the slot for the producers one lap later
+  atomic_store_explicit(&slot->seq, pos + LOGQ_SIZE, memory_order_release);
+  atomic_store_explicit(&q->tail, pos + 1, memory_order_relaxed);
+
+  return true;
+}
+
+/**
+* @brief  Number of reserved records not consumed yet
+* @param  q:  Queue handle
+* @retval Queue depth
+*/
+uint32_t logq_GetDepth(logQueue_t* q)
+{
+  return atomic_load_explicit(&q->head, memory_order_relaxed) -
+      atomic_load_explicit(&q->tail, memory_order_relaxed);
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,819 @@
+/**
+  ******************************************************************************
+  * @file    log_sdwriter.c
+  * @author  IBronx MDE team
+  * @brief   Batched SD card log writer
+  *          The log file stays open. The logger task collects records in one
+  *          of two sector buffers and hands full sectors to the storage task,
+  *          which writes them at sector aligned file positions so FatFs
+  *          passes them straight to the SD DMA. On a sync the partial sector
+  *          is written, synced and the file position moved back, so the next
+  *          write rewrites the whole sector and keeps the alignment.
+  *          Files are numbered and rotated by size and age. The logger task
+  *          decides the rotation before a record, so the partial sector is
+  *          handed over as the last write of the file and every file starts
+  *          with a record. The current number is kept in the FLASH journal.
+  *          Each log file has an index file with one entry per time bucket,
+  *          giving the offset and levels of its records. Queries received
+  *          over USB are run by the storage task from the index, so only the
+  *          matching buckets of the card are read.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_sdwriter.h"
+#include "log_journal.h"
+#include "log_format.h"
+#include "logger.h"
+#include "app_main.h"
+#include "errorcode.h"
+#include "rtos_objects.h"
+#include "cmsis_os.h"
+
+#if LOGGER_SDCARD_ENABLE
+#include "fatfs.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define LOGSD_NO_RECORD         0xFFFFU
+#define LOGSD_ALL_LEVELS        0xFFU
+#define LOGSD_REQ_WRITE         0
+#define LOGSD_REQ_QUERY         1
+#define LOGSD_REQ_ROTATE        2     // write the partial sector, then switch files
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+ typedef struct
+ {
+   uint32_t firstTick;                      // tick of the first record starting in the buffer
+   uint16_t firstRecord;                    // its offset, LOGSD_NO_RECORD if none starts here
+   uint8_t levelMask;                       // levels of the records starting in the buffer
+ }logsdBufferInfo_t;
+
+static uint8_t logsd_buf[LOGSD_BUFFER_COUNT][LOGSD_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t logsd_active;
+static uint32_t logsd_fill;
+static uint32_t logsd_unsynced;
+static uint32_t logsd_lastSyncTick;
+static uint32_t logsd_fileBytes;              // bytes of the current file, logger task side
+static uint32_t logsd_fileStartTick;
+static bool logsd_bMarkPending;
+static uint8_t logsd_markLevel;
+static uint32_t logsd_markTick;
+static bool logsd_bOpen;
+static uint32_t logsd_fileNumber;
+static char logsd_filepath[LOGGER_PATH_LEN];
+static logsdStats_t logsd_stats;
+static logsdBufferInfo_t logsd_info[LOGSD_BUFFER_COUNT];
+static uint32_t logsd_bootFileNumber;
+
+// index and queries, storage task only
+static FIL logsd_idxFile;
+static bool logsd_bIdxOpen;
+static logsdIndexEntry_t logsd_bucket;
+static bool logsd_bBucketOpen;
+static FIL logsd_readLogFile;
+static FIL logsd_readIdxFile;
+static uint8_t logsd_readBuf[LOGSD_SECTOR_SIZE] __attribute__((aligned(4)));
+static logsdQuery_t logsd_query;
+static volatile bool logsd_bQueryPending;
+
+static osMessageQueueId_t logsd_requestQueue;
+static osSemaphoreId_t logsd_freeBuffers;
+
+extern osEventFlagsId_t osFlag_Main;
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t logsd_Handover(uint32_t size);
+static void logsd_ResetInfo(logsdBufferInfo_t* info);
+static uint32_t logsd_OpenFile(void);
+static void logsd_CloseFile(void);
+static void logsd_RotateIfDue(void);
+static void logsd_Rotate(void);
+static void logsd_DeleteFile(uint32_t fileNumber);
+static void logsd_FilePath(char* path, uint32_t size, uint32_t fileNumber, const char* sExt);
+static void logsd_IndexSector(uint32_t offset, const logsdBufferInfo_t* info);
+static void logsd_WriteIndex(void);
+static void logsd_RunQuery(void);
+static uint32_t logsd_QueryFile(FIL* pLog, FIL* pIdx, bool bCurrent, uint32_t* pCount);
+static uint32_t logsd_SendRange(FIL* pLog, uint32_t from, uint32_t to, uint32_t* pCount);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Create the writer objects and open the log file, called from
+*         logger_Init once the SD card is mounted and the folder exists
+* @param  fileNumber:  Number of the log file for this boot
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logsd_Init(uint32_t fileNumber)
+{
+  logsd_requestQueue = osMessageQueueNew(LOGSD_REQUEST_COUNT, sizeof(logsdRequest_t), &rtos_queueAttr[RTOS_QUEUE_LOGSD_REQUEST]);
+  logsd_freeBuffers = osSemaphoreNew(LOGSD_BUFFER_COUNT - 1, LOGSD_BUFFER_COUNT - 1, &rtos_semaphoreAttr[RTOS_SEMAPHORE_LOGSD_FREE]);
+  logsd_active = 0;
+  logsd_fill = 0;
+  logsd_unsynced = 0;
+  logsd_lastSyncTick = osKernelGetTickCount();
+  memset(&logsd_stats, 0, sizeof(logsd_stats));
+  for (uint32_t idx = 0; idx < LOGSD_BUFFER_COUNT; idx++)
+    logsd_ResetInfo(&logsd_info[idx]);
+  logsd_bBucketOpen = false;
+  logsd_bQueryPending = false;
+  logsd_bMarkPending = false;
+
+  logsd_bootFileNumber = fileNumber;
+  logsd_fileNumber = fileNumber;
+  if (logsd_fileNumber >= (LOGSD_FIRST_FILE_NUMBER + LOGSD_MAX_FILES))
+    logsd_DeleteFile(logsd_fileNumber - LOGSD_MAX_FILES);
+
+  uint32_t rc = logsd_OpenFile();
+  logsd_fileBytes = logsd_bOpen ? (uint32_t)f_size(&SDFile) : 0;
+  logsd_fileStartTick = osKernelGetTickCount();
+
+  return rc;
+}
+
+/**
+* @brief  Check that data can be appended without waiting for the storage task
+* @param  size:  Data size in bytes, at most one sector
+* @retval true if the data fits the active buffer or a free buffer is ready
+*/
+bool logsd_IsReady(uint32_t size)
+{
+  return ((logsd_fill + size) < LOGSD_SECTOR_SIZE) || (osSemaphoreGetCount(logsd_freeBuffers) > 0);
+}
+
+/**
+* @brief  Note the start of a record for the index, called by the logger task
+*         before the record is written, applied by the next logsd_Write
+* @param  level:  Record level
+* @param  tick:   Kernel tick of the record
+* @retval None
+*/
+void logsd_MarkRecord(uint8_t level, uint32_t tick)
+{
+  logsd_bMarkPending = true;
+  logsd_markLevel = level;
+  logsd_markTick = tick;
+}
+
+/**
+* @brief  Append one record to the sector buffer, only called by the logger
+*         task. A due rotation is started first, so the record opens the file
+* @param  pData:  Record data
+* @param  size:   Record size in bytes
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logsd_Write(const uint8_t* pData, uint32_t size)
+{
+  uint32_t rc = PER_NO_ERROR;
+
+  logsd_RotateIfDue();
+
+  if (logsd_bMarkPending)
+  {
+    logsdBufferInfo_t* info = &logsd_info[logsd_active];
+    if (info->firstRecord == LOGSD_NO_RECORD)
+    {
+      info->firstRecord = (uint16_t)logsd_fill;
+      info->firstTick = logsd_markTick;
+    }
+    info->levelMask |= (uint8_t)(1U << logsd_markLevel);
+    logsd_bMarkPending = false;
+  }
+
+  logsd_stats.bytesLogged += size;
+  logsd_fileBytes += size;
+  while (size > 0)
+  {
+    uint32_t chunk = LOGSD_SECTOR_SIZE - logsd_fill;
+    if (chunk > size)
+      chunk = size;
+
+    memcpy(&logsd_buf[logsd_active][logsd_fill], pData, chunk);
+    logsd_fill += chunk;
+    logsd_unsynced += chunk;
+    pData += chunk;
+    size -= chunk;
+
+    if (logsd_fill == LOGSD_SECTOR_SIZE)
+      rc = logsd_Handover(LOGSD_SECTOR_SIZE);
+  }
+
+  if (logsd_unsynced >= LOGSD_SYNC_BYTES)
+    logsd_Flush();
+
+  return rc;
+}
+
+/**
+* @brief  Queue a retrieval query for the storage task, also callable from the
+*         USB receive interrupt
+* @param  query:  Time and level range, output and completion callbacks
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logsd_Query(const logsdQuery_t* query)
+{
+  if ((logsd_requestQueue == NULL) || logsd_bQueryPending)
+    return PER_ERROR_LOG_QUERY_BUSY;
+
+  logsd_query = *query;
+  logsd_bQueryPending = true;
+
+  logsdRequest_t req = { .type = LOGSD_REQ_QUERY };
+  if (osMessageQueuePut(logsd_requestQueue, &req, 0U, 0U) != osOK)
+  {
+    logsd_bQueryPending = false;
+    return PER_ERROR_LOG_QUERY_BUSY;
+  }
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Write the pending partial sector and sync the file, used for error
+*         events and by the time and size thresholds
+* @param  None
+* @retval None
+*/
+void logsd_Flush(void)
+{
+  if (logsd_unsynced == 0)
+    return;
+
+  logsd_Handover(logsd_fill);
+}
+
+/**
+* @brief  Apply the time threshold, called periodically by the logger task
+* @param  None
+* @retval None
+*/
+void logsd_Poll(void)
+{
+  if ((osKernelGetTickCount() - logsd_lastSyncTick) >= LOGSD_SYNC_PERIOD_MS)
+    logsd_Flush();
+}
+
+/**
+* @brief  Read the writer counters
+* @param  stats:  Destination of the counters
+* @retval None
+*/
+void logsd_GetStats(logsdStats_t* stats)
+{
+  memcpy(stats, &logsd_stats, sizeof(logsdStats_t));
+}
+
+/**
+* @brief  Number of the log file being written
+* @param  None
+* @retval File number
+*/
+uint32_t logsd_GetFileNumber(void)
+{
+  return logsd_fileNumber;
+}
+
+/**
+  * @brief  Function implementing the logStorageTask thread.
+  *         Write the sector buffers handed over by the logger task
+  * @param  argument: Not used
+  * @retval None
+  */
+void StartLogStorageTask(void *argument)
+{
+  logsdRequest_t req;
+  UINT bw;
+
+  for(;;)
+  {
+    if (osMessageQueueGet(logsd_requestQueue, &req, NULL, osWaitForever) != osOK)
+      continue;
+
+    if (req.type == LOGSD_REQ_QUERY)
+    {
+      logsd_RunQuery();
+      continue;
+    }
+
+    if (!logsd_bOpen)
+      logsd_OpenFile();
+
+    if (logsd_bOpen)
+    {
+      uint32_t offset = f_tell(&SDFile);
+      FRESULT res = FR_OK;
+      bw = 0;
+      if (req.size > 0)
+        res = f_write(&SDFile, logsd_buf[req.bufIdx], req.size, &bw);
+      logsd_stats.bytesWritten += bw;
+
+      if (req.size == LOGSD_SECTOR_SIZE)
+      {
+        logsd_stats.sectorWrites++;
+        if ((res == FR_OK) && (bw == req.size))
+          logsd_IndexSector(offset, &logsd_info[req.bufIdx]);
+      }
+      else if ((res == FR_OK) && (req.type == LOGSD_REQ_ROTATE))
+      {
+        // the last sector of the file, it ends on a record and is not rewritten
+        if (bw == req.size)
+          logsd_IndexSector(offset, &logsd_info[req.bufIdx]);
+      }
+      else if (res == FR_OK)
+      {
+        // the tail is rewritten with the next full sector
+        res = f_sync(&SDFile);
+        if (res == FR_OK)
+          res = f_lseek(&SDFile, f_tell(&SDFile) - bw);
+        logsd_stats.syncs++;
+      }
+
+      if ((res != FR_OK) || (bw != req.size))
+      {
+        logsd_stats.errors++;
+        logsd_CloseFile();
+      }
+      else if (req.type == LOGSD_REQ_ROTATE)
+      {
+        logsd_Rotate();
+      }
+    }
+    else
+    {
+      logsd_stats.dropped += req.size;
+    }
+
+    osSemaphoreRelease(logsd_freeBuffers);
+  }
+
+  // delete the storage thread, in case accidentally break the loop
+  osThreadTerminate(NULL);
+}
+
+/**
+* @brief  Hand the active buffer to the storage task and switch to the other
+* @param  size:  Bytes to write, less than a sector for a sync
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logsd_Handover(uint32_t size)
+{
+  // never wait, the logger task also serves the other sinks
+  if (osSemaphoreAcquire(logsd_freeBuffers, 0U) != osOK)
+  {
+    // a sync is retried by the next flush or poll
+    if (size < LOGSD_SECTOR_SIZE)
+      return PER_ERROR_SDCARD_FAILED_WRITE;
+
+    // storage is stalled, drop the sector rather than the logger
+    logsd_stats.dropped += logsd_fill;
+    logsd_fill = 0;
+    logsd_unsynced = 0;
+    return PER_ERROR_SDCARD_FAILED_WRITE;
+  }
+
+  logsdRequest_t req = { .type = LOGSD_REQ_WRITE, .bufIdx = logsd_active, .size = (uint16_t)size };
+  uint8_t next = (logsd_active + 1) % LOGSD_BUFFER_COUNT;
+
+  // a partial sector stays at the start of the next buffer
+  if (size < LOGSD_SECTOR_SIZE)
+  {
+    memcpy(logsd_buf[next], logsd_buf[logsd_active], size);
+    logsd_info[next] = logsd_info[logsd_active];
+    logsd_lastSyncTick = osKernelGetTickCount();
+    logsd_unsynced = 0;
+  }
+  else
+  {
+    logsd_fill = 0;
+    logsd_ResetInfo(&logsd_info[next]);
+  }
+
+  logsd_active = next;
+  osMessageQueuePut(logsd_requestQueue, &req, 0U, 0U);
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Clear the record information of a sector buffer
+* @param  info:  Buffer information
+* @retval None
+*/
+static void logsd_ResetInfo(logsdBufferInfo_t* info)
+{
+  info->firstTick = 0;
+  info->firstRecord = LOGSD_NO_RECORD;
+  info->levelMask = 0;
+}
+
+/**
+* @brief  Open the log file, load an unaligned tail into the active buffer so
+*         the writer continues on a sector boundary
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logsd_OpenFile(void)
+{
+  UINT br;
+
+  if (!((osEventFlagsGet(osFlag_Main) & MAIN_SD_PRESENT_FLAG) &&
+        (osEventFlagsGet(osFlag_Main) & MAIN_MOUNT_SDCARD_FLAG) &&
+        (osEventFlagsGet(osFlag_Main) & MAIN_CREATE_FOLDERS_FLAG)))
+    return PER_ERROR_SDCARD_FAILED_WRITE;
+
+  logsd_FilePath(logsd_filepath, sizeof(logsd_filepath), logsd_fileNumber, ".LOG");
+
+  if (f_open(&SDFile, logsd_filepath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) != FR_OK)
+  {
+    logsd_stats.errors++;
+    return PER_ERROR_SDCARD_FAILED_WRITE;
+  }
+
+  FSIZE_t size = f_size(&SDFile);
+  uint32_t tail = size % LOGSD_SECTOR_SIZE;
+
+  // only safe before the logger has filled anything, later opens append unaligned
+  if ((tail > 0) && (logsd_fill == 0) && (logsd_stats.bytesLogged == 0))
+  {
+    if ((f_lseek(&SDFile, size - tail) != FR_OK) ||
+        (f_read(&SDFile, logsd_buf[logsd_active], tail, &br) != FR_OK) || (br != tail) ||
+        (f_lseek(&SDFile, size - tail) != FR_OK))
+    {
+      logsd_stats.errors++;
+      f_close(&SDFile);
+      return PER_ERROR_SDCARD_FAILED_READ;
+    }
+    logsd_fill = tail;
+  }
+  else
+  {
+    f_lseek(&SDFile, size);
+  }
+
+  // the log is still written without its index
+  char path[LOGGER_PATH_LEN];
+  logsd_FilePath(path, sizeof(path), logsd_fileNumber, ".IDX");
+  logsd_bIdxOpen = (f_open(&logsd_idxFile, path, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) == FR_OK);
+  if (logsd_bIdxOpen)
+    f_lseek(&logsd_idxFile, f_size(&logsd_idxFile));
+  else
+    logsd_stats.errors++;
+  logsd_bBucketOpen = false;
+
+  logsd_bOpen = true;
+  osEventFlagsSet(osFlag_Main, MAIN_OPEN_FILE_FLAG);
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Close the log file and its index, the open bucket is written first
+* @param  None
+* @retval None
+*/
+static void logsd_CloseFile(void)
+{
+  if (logsd_bIdxOpen)
+  {
+    if (logsd_bBucketOpen)
+      logsd_WriteIndex();
+    f_close(&logsd_idxFile);
+    logsd_bIdxOpen = false;
+  }
+  logsd_bBucketOpen = false;
+
+  f_close(&SDFile);
+  logsd_bOpen = false;
+  osEventFlagsClear(osFlag_Main, MAIN_OPEN_FILE_FLAG);
+}
+
+/**
+* @brief  Hand the partial sector over as the end of the file when the file is
+*         too large or too old, called by the logger task before a record.
+*         Without a free buffer the rotation waits for the next record
+* @param  None
+* @retval None
+*/
+static void logsd_RotateIfDue(void)
+{
+  if ((logsd_fileBytes < LOGSD_ROTATE_SIZE) &&
+      ((osKernelGetTickCount() - logsd_fileStartTick) < LOGSD_ROTATE_AGE_MS))
+    return;
+
+  if (osSemaphoreAcquire(logsd_freeBuffers, 0U) != osOK)
+    return;
+
+  logsdRequest_t req = { .type = LOGSD_REQ_ROTATE, .bufIdx = logsd_active, .size = (uint16_t)logsd_fill };
+  uint8_t next = (logsd_active + 1) % LOGSD_BUFFER_COUNT;
+
+  logsd_fill = 0;
+  logsd_unsynced = 0;
+  logsd_lastSyncTick = osKernelGetTickCount();
+  logsd_ResetInfo(&logsd_info[next]);
+  logsd_active = next;
+  logsd_fileBytes = 0;
+  logsd_fileStartTick = osKernelGetTickCount();
+
+  osMessageQueuePut(logsd_requestQueue, &req, 0U, 0U);
+}
+
+/**
+* @brief  Switch to the next numbered file and delete the oldest file above
+*         LOGSD_MAX_FILES, called by the storage task
+* @param  None
+* @retval None
+*/
+static void logsd_Rotate(void)
+{
+  logsd_CloseFile();
+
+  logsd_fileNumber++;
+  logsd_stats.rotations++;
+  if (logjournal_Append(logsd_fileNumber) != PER_NO_ERROR)
+    logsd_stats.errors++;
+
+  if (logsd_fileNumber >= (LOGSD_FIRST_FILE_NUMBER + LOGSD_MAX_FILES))
+    logsd_DeleteFile(logsd_fileNumber - LOGSD_MAX_FILES);
+
+  logsd_OpenFile();
+}
+
+/**
+* @brief  Delete an old log file
+* @param  fileNumber:  Number of the file to delete
+* @retval None
+*/
+static void logsd_DeleteFile(uint32_t fileNumber)
+{
+  char path[LOGGER_PATH_LEN];
+
+  logsd_FilePath(path, sizeof(path), fileNumber, ".LOG");
+  FRESULT res = f_unlink(path);
+  if ((res != FR_OK) && (res != FR_NO_FILE))
+    logsd_stats.errors++;
+
+  logsd_FilePath(path, sizeof(path), fileNumber, ".IDX");
+  f_unlink(path);
+}
+
+/**
+* @brief  Build the path of a numbered log or index file, "0:/LOG/<number><ext>"
+* @param  path:        Destination
+* @param  size:        Destination size
+* @param  fileNumber:  File number
+* @param  sExt:        ".LOG" or ".IDX"
+* @retval None
+*/
+static void logsd_FilePath(char* path, uint32_t size, uint32_t fileNumber, const char* sExt)
+{
+  logFmt_t fmt;
+
+  logfmt_Init(&fmt, path, size);
+  logfmt_Str(&fmt, LOGGER_LOG_DIR);
+  logfmt_Char(&fmt, '/');
+  logfmt_UDec(&fmt, fileNumber);
+  logfmt_Str(&fmt, sExt);
+  logfmt_End(&fmt);
+}
+
+/**
+* @brief  Account a written sector in the open bucket, a new bucket starts
+*         with the first record of a sector once the bucket time is over
+* @param  offset:  File offset of the sector
+* @param  info:    Records starting in the sector
+* @retval None
+*/
+static void logsd_IndexSector(uint32_t offset, const logsdBufferInfo_t* info)
+{
+  if (info->firstRecord == LOGSD_NO_RECORD)
+    return;
+
+  if (logsd_bBucketOpen && ((info->firstTick - logsd_bucket.tickMs) < LOGSD_INDEX_BUCKET_MS))
+  {
+    logsd_bucket.levelMask |= info->levelMask;
+    return;
+  }
+
+  if (logsd_bBucketOpen)
+    logsd_WriteIndex();
+
+  logsd_bucket.tickMs = info->firstTick;
+  logsd_bucket.offset = offset + info->firstRecord;
+  logsd_bucket.levelMask = info->levelMask;
+  logsd_bBucketOpen = true;
+}
+
+/**
+* @brief  Append the closed bucket to the index file
+* @param  None
+* @retval None
+*/
+static void logsd_WriteIndex(void)
+{
+  UINT bw;
+
+  if (!logsd_bIdxOpen)
+    return;
+
+  if ((f_write(&logsd_idxFile, &logsd_bucket, sizeof(logsdIndexEntry_t), &bw) != FR_OK) ||
+      (bw != sizeof(logsdIndexEntry_t)) || (f_sync(&logsd_idxFile) != FR_OK))
+    logsd_stats.errors++;
+  else
+    logsd_stats.indexEntries++;
+}
+
+/**
+* @brief  Serve the pending query over the log files of this boot
+* @param  None
+* @retval None
+*/
+static void logsd_RunQuery(void)
+{
+  uint32_t rc = PER_NO_ERROR;
+  uint32_t count = 0;
+  char path[LOGGER_PATH_LEN];
+
+  for (uint32_t file = logsd_bootFileNumber; (file <= logsd_fileNumber) && (rc == PER_NO_ERROR); file++)
+  {
+    if ((file == logsd_fileNumber) && logsd_bOpen)
+    {
+      // the open files are shared with the writer, their positions are restored
+      FSIZE_t logPos = f_tell(&SDFile);
+      FSIZE_t idxPos = logsd_bIdxOpen ? f_tell(&logsd_idxFile) : 0;
+
+      rc = logsd_QueryFile(&SDFile, logsd_bIdxOpen ? &logsd_idxFile : NULL, true, &count);
+
+      if ((f_lseek(&SDFile, logPos) != FR_OK) ||
+          (logsd_bIdxOpen && (f_lseek(&logsd_idxFile, idxPos) != FR_OK)))
+      {
+        logsd_stats.errors++;
+        logsd_CloseFile();
+      }
+      continue;
+    }
+
+    logsd_FilePath(path, sizeof(path), file, ".LOG");
+    if (f_open(&logsd_readLogFile, path, FA_READ) != FR_OK)
+      continue;
+
+    logsd_FilePath(path, sizeof(path), file, ".IDX");
+    bool bIdx = (f_open(&logsd_readIdxFile, path, FA_READ) == FR_OK);
+
+    rc = logsd_QueryFile(&logsd_readLogFile, bIdx ? &logsd_readIdxFile : NULL, false, &count);
+
+    if (bIdx)
+      f_close(&logsd_readIdxFile);
+    f_close(&logsd_readLogFile);
+  }
+
+  logsd_stats.queries++;
+  logsd_bQueryPending = false;
+  logsd_query.pfnDone(count, rc);
+}
+
+/**
+* @brief  Send the matching buckets of one log file, the open bucket of the
+*         current file and a file without index entries count as one bucket
+*         with every level
+* @param  pLog:      Log file
+* @param  pIdx:      Index file, NULL if missing
+* @param  bCurrent:  File being written
+* @param  pCount:    Incremented for each record sent
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logsd_QueryFile(FIL* pLog, FIL* pIdx, bool bCurrent, uint32_t* pCount)
+{
+  uint32_t rc = PER_NO_ERROR;
+  UINT br;
+  uint32_t nEntries = (pIdx != NULL) ? (f_size(pIdx) / sizeof(logsdIndexEntry_t)) : 0;
+  uint32_t total = nEntries;
+  logsdIndexEntry_t tail = { .tickMs = 0, .offset = 0, .levelMask = LOGSD_ALL_LEVELS };
+
+  if (bCurrent && logsd_bBucketOpen)
+  {
+    tail = logsd_bucket;
+    tail.levelMask = LOGSD_ALL_LEVELS;      // the unwritten tail may add levels
+    total++;
+  }
+  else if (nEntries == 0)
+  {
+    total++;
+  }
+
+  logsdIndexEntry_t cur;
+  logsdIndexEntry_t next;
+  for (uint32_t idx = 0; (idx < total) && (rc == PER_NO_ERROR); idx++)
+  {
+    if (idx == 0)
+    {
+      if (nEntries == 0)
+        cur = tail;
+      else if ((f_lseek(pIdx, 0) != FR_OK) || (f_read(pIdx, &cur, sizeof(cur), &br) != FR_OK) || (br != sizeof(cur)))
+        return PER_ERROR_SDCARD_FAILED_READ;
+    }
+    else
+    {
+      cur = next;
+    }
+
+    uint32_t end = f_size(pLog);
+    uint32_t endTick = 0xFFFFFFFFU;
+    if ((idx + 1) < total)
+    {
+      if ((idx + 1) < nEntries)
+      {
+        if ((f_read(pIdx, &next, sizeof(next), &br) != FR_OK) || (br != sizeof(next)))
+          return PER_ERROR_SDCARD_FAILED_READ;
+      }
+      else
+      {
+        next = tail;
+      }
+      end = next.offset;
+      endTick = next.tickMs;
+    }
+
+    // the index file position moves while reading the log, keep it
+    FSIZE_t idxPos = (pIdx != NULL) ? f_tell(pIdx) : 0;
+
+    if ((cur.tickMs <= logsd_query.toMs) && (endTick > logsd_query.fromMs) &&
+        (cur.levelMask & logsd_query.levelMask))
+      rc = logsd_SendRange(pLog, cur.offset, end, pCount);
+
+    if ((pIdx != NULL) && (f_lseek(pIdx, idxPos) != FR_OK))
+      return PER_ERROR_SDCARD_FAILED_READ;
+  }
+
+  return rc;
+}
+
+/**
+* @brief  Read a file range one sector at a time, keep the records of the
+*         wanted levels and time range in place and send them straight from
+*         the read buffer
+* @param  pLog:    Log file
+* @param  from:    Offset of the first record
+* @param  to:      End offset
+* @param  pCount:  Incremented for each record sent
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logsd_SendRange(FIL* pLog, uint32_t from, uint32_t to, uint32_t* pCount)
+{
+  UINT br;
+  uint32_t pos = from;
+
+  while (pos < to)
+  {
+    uint32_t size = to - pos;
+    if (size > LOGSD_SECTOR_SIZE)
+      size = LOGSD_SECTOR_SIZE;
+
+    if ((f_lseek(pLog, pos) != FR_OK) || (f_read(pLog, logsd_readBuf, size, &br) != FR_OK))
+      return PER_ERROR_SDCARD_FAILED_READ;
+
+    uint32_t in = 0;
+    uint32_t out = 0;
+    uint32_t recordSize;
+    uint8_t level;
+    uint32_t tick;
+    while ((in < br) && logger_ParseRecord(&logsd_readBuf[in], br - in, &recordSize, &level, &tick))
+    {
+      // the buckets only narrow the search, each record is checked
+      if ((logsd_query.levelMask & (1U << level)) &&
+          ((tick == LOGGER_NO_TICK) || ((tick >= logsd_query.fromMs) && (tick <= logsd_query.toMs))))
+      {
+        memmove(&logsd_readBuf[out], &logsd_readBuf[in], recordSize);
+        out += recordSize;
+        (*pCount)++;
+      }
+      in += recordSize;
+    }
+
+    // a record cut by the end of the data that was written
+    if (in == 0)
+      break;
+
+    if ((out > 0) && (logsd_query.pfnSend(logsd_readBuf, out) != PER_NO_ERROR))
+      return PER_ERROR_USB_TRANSMIT;
+
+    pos += in;
+  }
+
+  return PER_NO_ERROR;
+}
+
+#endif /* LOGGER_SDCARD_ENABLE */
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
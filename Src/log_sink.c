@@ -0,0 +1,188 @@
+/**
+  ******************************************************************************
+  * @file    log_sink.c
+  * @author  IBronx MDE team
+  * @brief   Log output sink registry
+  *          The logger task copies every record into the queue of each sink
+  *          whose level accepts it, then offers the queued records to the
+  *          sink outputs. Outputs never block, so a slow SD card or an absent
+  *          USB host only fills its own queue and never stalls the producers
+  *          or the other sinks.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_sink.h"
+#include "errorcode.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static logSink_t* logsink_sinks[LOGSINK_MAX];
+static uint32_t logsink_count;
+static uint32_t logsink_overflow;              // sum of the sink overflow counters
+/* Private function prototypes -----------------------------------------------*/
+static logSink_t* logsink_Find(const char* name);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Add a sink, called before the logger task starts. A sink already
+*         registered by an earlier logger_Init is only emptied
+* @param  sink:  Sink with its queue storage
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logsink_Register(logSink_t* sink)
+{
+  // queue index is masked, the size must be a power of two
+  if ((sink->queueSize == 0) || ((sink->queueSize & (sink->queueSize - 1)) != 0))
+    return PER_ERROR_INIT;
+
+  bool bRegistered = false;
+  for (uint32_t idx = 0; idx < logsink_count; idx++)
+    bRegistered |= (logsink_sinks[idx] == sink);
+
+  if (!bRegistered && (logsink_count >= LOGSINK_MAX))
+    return PER_ERROR_INIT;
+
+  sink->head = 0;
+  sink->tail = 0;
+  memset(&sink->stats, 0, sizeof(logSinkStats_t));
+  if (!bRegistered)
+    logsink_sinks[logsink_count++] = sink;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Copy a record into the queue of every sink accepting its level
+* @param  record:  Log record
+* @retval None
+*/
+void logsink_Dispatch(const loggerRecord_t* record)
+{
+  for (uint32_t idx = 0; idx < logsink_count; idx++)
+  {
+    logSink_t* sink = logsink_sinks[idx];
+    if (record->level < sink->minLevel)
+      continue;
+
+    uint32_t depth = sink->head - sink->tail;
+    if (depth >= sink->queueSize)
+    {
+      sink->stats.overflow++;
+      logsink_overflow++;
+      continue;
+    }
+
+    memcpy(&sink->queue[sink->head & (sink->queueSize - 1)], record, sizeof(loggerRecord_t));
+    sink->head++;
+    sink->stats.queued++;
+    if (++depth > sink->stats.highWater)
+      sink->stats.highWater = depth;
+  }
+}
+
+/**
+* @brief  Offer the queued records to each sink output until it is busy
+* @param  None
+* @retval true if every sink queue is empty
+*/
+bool logsink_PumpAll(void)
+{
+  bool bIdle = true;
+
+  for (uint32_t idx = 0; idx < logsink_count; idx++)
+  {
+    logSink_t* sink = logsink_sinks[idx];
+
+    while (sink->tail != sink->head)
+    {
+      logSinkResult_t res = sink->pfnWrite(&sink->queue[sink->tail & (sink->queueSize - 1)]);
+      if (res == LOGSINK_BUSY)
+      {
+        sink->stats.busy++;
+        bIdle = false;
+        break;
+      }
+
+      if (res == LOGSINK_WRITTEN)
+        sink->stats.written++;
+      else
+        sink->stats.discarded++;
+      sink->tail++;
+    }
+  }
+
+  return bIdle;
+}
+
+/**
+* @brief  Read the records lost on a full sink queue, all sinks together
+* @param  None
+* @retval Overflow count since boot
+*/
+uint32_t logsink_GetOverflow(void)
+{
+  return logsink_overflow;
+}
+
+/**
+* @brief  Change the minimum level of a sink
+* @param  name:   Sink name
+* @param  level:  Minimum level, LOGGER_LEVEL_NONE to mute the sink
+* @retval None
+*/
+void logsink_SetLevel(const char* name, loggerLevel_t level)
+{
+  logSink_t* sink = logsink_Find(name);
+  if (sink != NULL)
+    sink->minLevel = level;
+}
+
+/**
+* @brief  Read the counters of a sink
+* @param  name:   Sink name
+* @param  stats:  Destination of the counters
+* @retval true if the sink exists
+*/
+bool logsink_GetStats(const char* name, logSinkStats_t* stats)
+{
+  logSink_t* sink = logsink_Find(name);
+  if (sink == NULL)
+    return false;
+
+  memcpy(stats, &sink->stats, sizeof(logSinkStats_t));
+  return true;
+}
+
+/**
+* @brief  Look up a registered sink
+* @param  name:  Sink name
+* @retval Sink, NULL if unknown
+*/
+static logSink_t* logsink_Find(const char* name)
+{
+  for (uint32_t idx = 0; idx < logsink_count; idx++)
+  {
+    if (strcmp(logsink_sinks[idx]->name, name) == 0)
+      return logsink_sinks[idx];
+  }
+
+  return NULL;
+}
+
+
+/************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -20,26 +20,135 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "logger.h"
-//#include "fatfs.h"
+#include "log_queue.h"
+#include "log_crashram.h"
+#include "log_format.h"
+#include "log_sdwriter.h"
+#include "log_journal.h"
+#include "log_sink.h"
+#include "log_flash.h"
+#if LOGGER_SDCARD_ENABLE
+#include "fatfs.h"
+#endif
+#if LOGGER_USB_ENABLE
+#include "usbd_cdc_if.h"
+#endif
 #include "app_main.h"
 #include "errorcode.h"
 #include "SEGGER_SYSVIEW.h"
 #include "cmsis_os.h"
-//#include "flash_control.h"
 
-#include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 /* Private define ------------------------------------------------------------*/
+#define LOGGER_USB_LINE_LEN     96
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 char logger_filepath[LOGGER_PATH_LEN];
 char logger_line_buf[LOGGER_STR_LEN];
-char logger_string_buf[LOGGER_STR_LEN];
-//uint8_t logger_filename[FLASH_FILENAME_SIZE];
 uint32_t loggerFileName;
 
+static logQueue_t logger_queue;
+static atomic_uint logger_truncated;
+static uint32_t logger_written;
+
+volatile loggerLevel_t logger_runtimeLevel = LOGGER_BUILD_LEVEL;
+static uint32_t logger_reportedDrops;
+static uint32_t logger_reportedOverflow;
+#if LOGGER_BINARY_MODE
+static uint8_t logger_pack_buf[LOGGER_BINARY_MAX_SIZE];
+#endif
+static logCrashRing_t logger_crashRing __attribute__((section(".noinit")));
+
+// sink queues, the SD card and USB ones absorb a slow or busy device
+static loggerRecord_t logger_sysviewQueue[4];
+static logSink_t logger_sysviewSink;
+static loggerRecord_t logger_ramQueue[4];
+static logSink_t logger_ramSink;
+static loggerRecord_t logger_ramLog[LOGGER_RAM_RECORD_COUNT];
+static uint32_t logger_ramCount;
+#if LOGGER_SDCARD_ENABLE
+static loggerRecord_t logger_sdQueue[16];
+static logSink_t logger_sdSink;
+#endif
+#if LOGGER_FLASH_ENABLE
+static loggerRecord_t logger_flashQueue[16];
+static logSink_t logger_flashSink;
+static bool logger_bFlashStore;
+#endif
+#if LOGGER_USB_ENABLE
+static loggerRecord_t logger_usbQueue[16];
+static logSink_t logger_usbSink;
+static uint8_t logger_usbBuf[2][LOGGER_USB_LINE_LEN];
+static uint8_t logger_usbActive;
+static char logger_usbCmd[LOGGER_USB_CMD_LEN];
+static uint32_t logger_usbCmdLen;
+static volatile bool logger_bUsbQuery;        // live lines wait while a query is sent
+#if LOGGER_SDCARD_ENABLE
+static logsdQuery_t logger_usbQuery;
+static volatile bool logger_bUsbQueryPending; // parsed by the USB interrupt, started by the logger task
+#endif
+#if LOGGER_SDCARD_ENABLE
+static uint8_t logger_usbEnd[LOGGER_BINARY_HDR_SIZE + LOGGER_USB_LINE_LEN];
+#endif
+#endif
+
+_Static_assert(LOGCRASH_RECORD_COUNT < LOGQ_SIZE, "recovered records and marker must fit the log queue");
+
+static const char* const logger_levelName[] = {
+  LOGGER_TYPE_INFO,
+  LOGGER_TYPE_WARN,
+  LOGGER_TYPE_ERROR,
+};
+
+#define LOGGER_MSG_LEVEL(id, level, fmt)    [id] = level,
+static const uint8_t logger_msgLevel[LOGMSG_COUNT] = {
+  [LOGMSG_TEXT] = LOGGER_LEVEL_INFO,
+  LOGGER_MSG_TABLE(LOGGER_MSG_LEVEL)
+};
+#undef LOGGER_MSG_LEVEL
+
+#define LOGGER_MSG_FORMAT(id, level, fmt)   [id] = fmt,
+static const char* const logger_msgFormat[LOGMSG_COUNT] = {
+  [LOGMSG_TEXT] = "%s",
+  LOGGER_MSG_TABLE(LOGGER_MSG_FORMAT)
+};
+#undef LOGGER_MSG_FORMAT
+
 extern osEventFlagsId_t osFlag_Main;
+extern osThreadId_t loggerTaskHandle;
+#if LOGGER_USB_ENABLE
+extern USBD_HandleTypeDef hUsbDeviceFS;
+#endif
 /* Private function prototypes -----------------------------------------------*/
+static void logger_PushRecord(loggerLevel_t level, const char* sMsg, const char* sArg);
+static void logger_RestoreRecord(const loggerRecord_t* record);
+static void logger_AddSink(logSink_t* sink, const char* name, logSinkWrite_t pfnWrite,
+                           loggerRecord_t* queue, uint32_t queueSize);
+static logSinkResult_t logger_SysviewWrite(const loggerRecord_t* record);
+static logSinkResult_t logger_RamWrite(const loggerRecord_t* record);
+#if LOGGER_SDCARD_ENABLE
+static logSinkResult_t logger_SdWrite(const loggerRecord_t* record);
+#endif
+#if LOGGER_FLASH_ENABLE
+static logSinkResult_t logger_FlashWrite(const loggerRecord_t* record);
+#endif
+#if LOGGER_USB_ENABLE
+static logSinkResult_t logger_UsbWrite(const loggerRecord_t* record);
+static void logger_UsbCommand(const char* sCmd);
+#if LOGGER_SDCARD_ENABLE
+static bool logger_ParseUInt(const char** ppCmd, uint32_t* pValue);
+static uint32_t logger_UsbSend(const uint8_t* pData, uint32_t size);
+static void logger_UsbQueryDone(uint32_t count, uint32_t rc);
+static void logger_UsbStartQuery(void);
+#endif
+#endif
+#if LOGGER_BINARY_MODE || LOGGER_SDCARD_ENABLE
+static uint32_t logger_RecordTick(const loggerRecord_t* record);
+#endif
+#if LOGGER_BINARY_MODE
+static uint32_t logger_PackStored(const loggerRecord_t* record, uint32_t tick, uint8_t* pBuf);
+#endif
 /* function prototypes -------------------------------------------------------*/
 
 /**
@@ -49,154 +158,904 @@ extern osEventFlagsId_t osFlag_Main;
 */
 void logger_Init(void)
 {
-//  FRESULT res;
-//  if (BSP_SD_IsDetected() == SD_PRESENT)
-//  {
-//    osEventFlagsSet(osFlag_Main, MAIN_SD_PRESENT_FLAG);
-//    if ((res = f_mount(&SDFatFS, (TCHAR const*)SDPath, 1)) == FR_OK)
-//    {
-//      osEventFlagsSet(osFlag_Main, MAIN_MOUNT_SDCARD_FLAG);
-//      SEGGER_SYSVIEW_Print("[LOG] - Mount SDCARD Success");
-//
-//      res =  f_mkdir(LOGGER_LOG_DIR);
-//      if (res == FR_OK || FR_EXIST)
-//      {
-//        osEventFlagsSet(osFlag_Main, MAIN_CREATE_FOLDERS_FLAG);
-//        SEGGER_SYSVIEW_Print("[LOG] - Created Log folder");
-//
-//        // read the log file name
-//        flash_read_LogFileName(logger_filename);
-//        loggerFileName = logger_filename[0] + (logger_filename[1] << 8) +
-//            (logger_filename[2] << 16) + (logger_filename[3] << 24);
-//
-//        // set log file name as number
-//        if (loggerFileName == 0xFFFFFFFF)
-//          loggerFileName = 10000;
-//        else
-//          loggerFileName = loggerFileName + 1;
-//
-//        logger_filename[0] = loggerFileName & 0xFF;
-//        logger_filename[1] = (loggerFileName >> 8) & 0xFF;
-//        logger_filename[2] = (loggerFileName >> 16) & 0xFF;
-//        logger_filename[3] = (loggerFileName >> 24) & 0xFF;
-//        flash_write_LogFileName(logger_filename);
-//      }
-//      else
-//      {
-//        osEventFlagsClear(osFlag_Main, MAIN_CREATE_FOLDERS_FLAG);
-//        SEGGER_SYSVIEW_Error("[LOG] - Failed to create Log folder");
-//      }
-//    }
-//    else
-//    {
-//      osEventFlagsClear(osFlag_Main, MAIN_MOUNT_SDCARD_FLAG);
-//      SEGGER_SYSVIEW_Error("[LOG] - Failed to mount SDCARD");
-//    }
-//  }
-//  else
-//  {
-//    osEventFlagsClear(osFlag_Main, MAIN_SD_PRESENT_FLAG);
-//    SEGGER_SYSVIEW_Error("[LOG] - SDCARD is not present");
-//  }
-}
-
-/**
-* @brief  Log the Info Event into log file
+  logq_Init(&logger_queue);
+  atomic_init(&logger_truncated, 0);
+  logger_written = 0;
+  logger_reportedDrops = 0;
+  logger_ramCount = 0;
+
+  logger_AddSink(&logger_sysviewSink, LOGGER_SINK_SYSVIEW, logger_SysviewWrite,
+                 logger_sysviewQueue, sizeof(logger_sysviewQueue) / sizeof(loggerRecord_t));
+  logger_AddSink(&logger_ramSink, LOGGER_SINK_RAM, logger_RamWrite,
+                 logger_ramQueue, sizeof(logger_ramQueue) / sizeof(loggerRecord_t));
+#if LOGGER_SDCARD_ENABLE
+  logger_AddSink(&logger_sdSink, LOGGER_SINK_SDCARD, logger_SdWrite,
+                 logger_sdQueue, sizeof(logger_sdQueue) / sizeof(loggerRecord_t));
+#endif
+#if LOGGER_USB_ENABLE
+  logger_AddSink(&logger_usbSink, LOGGER_SINK_USB, logger_UsbWrite,
+                 logger_usbQueue, sizeof(logger_usbQueue) / sizeof(loggerRecord_t));
+#endif
+
+  // records kept in RAM across a fault or watchdog reset are queued for the
+  // logger task, so they reach storage without delaying the main task
+  uint32_t recovered = logcrash_Recover(&logger_crashRing, logger_RestoreRecord);
+  logcrash_Reset(&logger_crashRing);
+  if (recovered > 0)
+    LOGGER_LOG_MSG(LOGMSG_LOG_CRASH_RECOVERED, 1, recovered);
+
+#if LOGGER_SDCARD_ENABLE
+  FRESULT res;
+  if (BSP_SD_IsDetected() == SD_PRESENT)
+  {
+    osEventFlagsSet(osFlag_Main, MAIN_SD_PRESENT_FLAG);
+    if ((res = f_mount(&SDFatFS, (TCHAR const*)SDPath, 1)) == FR_OK)
+    {
+      osEventFlagsSet(osFlag_Main, MAIN_MOUNT_SDCARD_FLAG);
+      SEGGER_SYSVIEW_Print("[LOG] - Mount SDCARD Success");
+
+      res =  f_mkdir(LOGGER_LOG_DIR);
+      if (res == FR_OK || res == FR_EXIST)
+      {
+        osEventFlagsSet(osFlag_Main, MAIN_CREATE_FOLDERS_FLAG);
+        SEGGER_SYSVIEW_Print("[LOG] - Created Log folder");
+
+        // next log file number, one journal entry per boot instead of a sector erase
+        if (logjournal_Read(&loggerFileName) == PER_NO_ERROR)
+          loggerFileName = loggerFileName + 1;
+        else
+          loggerFileName = LOGSD_FIRST_FILE_NUMBER;
+
+        if (logjournal_Append(loggerFileName) != PER_NO_ERROR)
+          SEGGER_SYSVIEW_Error("[LOG] - Failed to update Log file number");
+
+        // the journal sector erase stalls the CPU, done here before the machine runs
+        if (logjournal_PrepareSpare() != PER_NO_ERROR)
+          SEGGER_SYSVIEW_Error("[LOG] - Failed to erase the spare journal sector");
+
+        // keep the log file open for the batched writer
+        if (logsd_Init(loggerFileName) != PER_NO_ERROR)
+          SEGGER_SYSVIEW_Error("[LOG] - Failed to open Log file");
+      }
+      else
+      {
+        osEventFlagsClear(osFlag_Main, MAIN_CREATE_FOLDERS_FLAG);
+        SEGGER_SYSVIEW_Error("[LOG] - Failed to create Log folder");
+      }
+    }
+    else
+    {
+      osEventFlagsClear(osFlag_Main, MAIN_MOUNT_SDCARD_FLAG);
+      SEGGER_SYSVIEW_Error("[LOG] - Failed to mount SDCARD");
+    }
+  }
+  else
+  {
+    osEventFlagsClear(osFlag_Main, MAIN_SD_PRESENT_FLAG);
+    SEGGER_SYSVIEW_Error("[LOG] - SDCARD is not present");
+  }
+#endif
+
+#if LOGGER_FLASH_ENABLE
+  // without a usable card the history is kept in the FLASH store
+  logger_bFlashStore = false;
+  if (!(osEventFlagsGet(osFlag_Main) & MAIN_CREATE_FOLDERS_FLAG))
+  {
+    if (logflash_Init(&logflash_internalDev) == PER_NO_ERROR)
+    {
+      logger_bFlashStore = true;
+      logger_AddSink(&logger_flashSink, LOGGER_SINK_FLASH, logger_FlashWrite,
+                     logger_flashQueue, sizeof(logger_flashQueue) / sizeof(loggerRecord_t));
+    }
+    else
+    {
+      SEGGER_SYSVIEW_Error("[LOG] - Failed to open FLASH log store");
+    }
+  }
+#endif
+}
+
+/**
+* @brief  Log a free text event, called by logger_LogInfo/Warn/Error once the
+*         level passed the build and runtime filters
+* @param  level      Event log level
 * @param  sMsg       Event log message
 * @param  sArg       Input argument
   @retval None
 */
-void logger_LogInfo(const char* sMsg, const char* sArg)
+void logger_LogText(loggerLevel_t level, const char* sMsg, const char* sArg)
 {
-  memset(logger_string_buf, '\0', sizeof(logger_string_buf));
-  if (strlen(sArg) > 0)
-    sprintf(logger_string_buf, "%s: %s", sMsg, sArg);
-  else
-    sprintf(logger_string_buf, "%s", sMsg);
+  logger_PushRecord(level, sMsg, sArg);
+}
 
-  logger_SaveLogEvents(LOGGER_TYPE_INFO, logger_string_buf);
-  SEGGER_SYSVIEW_Print(logger_string_buf);
+/**
+* @brief  Set the runtime log level, events below it are discarded before any
+*         copy or formatting
+* @param  level      Minimum level, LOGGER_LEVEL_NONE to suppress all events
+  @retval None
+*/
+void logger_SetLevel(loggerLevel_t level)
+{
+  logger_runtimeLevel = level;
 }
 
 /**
-* @brief  Log the Warn Event into log file
-* @param  sMsg       Event log message
-* @param  sArg       Input argument
+* @brief  Log an event from the message table with raw arguments, the text is
+*         only produced on the host (or by the logger task in text mode)
+* @param  msgId      Message ID from LOGGER_MSG_TABLE
+* @param  nArgs      Number of uint32_t arguments, at most LOGGER_MSG_MAX_ARGS
   @retval None
 */
-void logger_LogWarn(const char* sMsg, const char* sArg)
+void logger_LogMsg(loggerMsgId_t msgId, uint32_t nArgs, ...)
 {
-  memset(logger_string_buf, '\0', sizeof(logger_string_buf));
-  if (strlen(sArg) > 0)
-    sprintf(logger_string_buf, "%s: %s", sMsg, sArg);
-  else
-    sprintf(logger_string_buf, "%s", sMsg);
+  if ((msgId <= LOGMSG_TEXT) || (msgId >= LOGMSG_COUNT))
+    return;
 
-  logger_SaveLogEvents(LOGGER_TYPE_WARN, logger_string_buf);
-  SEGGER_SYSVIEW_Warn(logger_string_buf);
+  if (logger_msgLevel[msgId] < logger_runtimeLevel)
+    return;
+
+  logqSlot_t* slot = logq_Reserve(&logger_queue);
+  if (slot == NULL)
+    return;
+
+  if (nArgs > LOGGER_MSG_MAX_ARGS)
+    nArgs = LOGGER_MSG_MAX_ARGS;
+
+  loggerRecord_t* record = &slot->record;
+  record->timestamp = SEGGER_SYSVIEW_GET_TIMESTAMP();
+  record->msgId = (uint16_t)msgId;
+  record->level = logger_msgLevel[msgId];
+  record->bReplayed = 0;
+  record->len = (uint8_t)(nArgs * sizeof(uint32_t));
+
+  va_list ap;
+  va_start(ap, nArgs);
+  for (uint32_t idx = 0; idx < nArgs; idx++)
+    record->args[idx] = va_arg(ap, uint32_t);
+  va_end(ap);
+
+  logcrash_Append(&logger_crashRing, record);
+  logq_Commit(slot);
+
+  if ((record->level == LOGGER_LEVEL_ERROR) && (loggerTaskHandle != NULL))
+    osThreadFlagsSet(loggerTaskHandle, LOGGER_WAKEUP_FLAG);
 }
 
 /**
-* @brief  Log the Error Event into log file
-* @param  sMsg       Event log message
-* @param  sArg       Input argument
+* @brief  Read the logger counters
+* @param  stats      Destination of the counters
   @retval None
 */
-void logger_LogError(const char* sMsg, const char* sArg)
+void logger_GetStats(loggerStats_t* stats)
 {
-  memset(logger_string_buf, '\0', sizeof(logger_string_buf));
-  if (strlen(sArg) > 0)
-    sprintf(logger_string_buf, "%s: %s", sMsg, sArg);
-  else
-    sprintf(logger_string_buf, "%s", sMsg);
+  stats->written = logger_written;
+  stats->dropped = atomic_load_explicit(&logger_queue.dropped, memory_order_relaxed);
+  stats->truncated = atomic_load_explicit(&logger_truncated, memory_order_relaxed);
+  stats->highWater = logger_queue.highWater;
+}
+
+/**
+  * @brief  Function implementing the loggerTask thread.
+  *         Drain the log queue into the sink queues and feed the sinks, the
+  *         task wakes up periodically or immediately when an error is logged
+  * @param  argument: Not used
+  * @retval None
+  */
+void StartLoggerTask(void *argument)
+{
+  loggerRecord_t record;
+
+  for(;;)
+  {
+    osThreadFlagsWait(LOGGER_WAKEUP_FLAG, osFlagsWaitAny, LOGGER_TASK_DELAY_MS);
 
-  logger_SaveLogEvents(LOGGER_TYPE_ERROR, logger_string_buf);
-  SEGGER_SYSVIEW_Error(logger_string_buf);
+    // pump after each record, a burst longer than a sink queue (the boot
+    // replay) only piles up in the queue of a busy output
+    while (logq_Pop(&logger_queue, &record))
+    {
+      logsink_Dispatch(&record);
+      logger_written++;
+      logsink_PumpAll();
+    }
+
+    // a busy sink keeps its records for the next period
+    logsink_PumpAll();
+
+#if LOGGER_SDCARD_ENABLE
+    logsd_Poll();
+#endif
+#if LOGGER_USB_ENABLE && LOGGER_SDCARD_ENABLE
+    logger_UsbStartQuery();
+#endif
+#if LOGGER_FLASH_ENABLE
+    // erase ahead only between cycles, if LOGFLASH_RUNTIME_ERASE allows it
+    if (logger_bFlashStore)
+      logflash_Poll(!(osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG));
+#endif
+
+    // report lost records once the queue has room again
+    uint32_t dropped = atomic_load_explicit(&logger_queue.dropped, memory_order_relaxed);
+    if (dropped != logger_reportedDrops)
+    {
+      LOGGER_LOG_MSG(LOGMSG_LOG_DROPPED, 1, dropped - logger_reportedDrops);
+      logger_reportedDrops = dropped;
+    }
+
+    // records lost on a full sink queue, the output failures are in the sink stats
+    uint32_t overflow = logsink_GetOverflow();
+    if (overflow != logger_reportedOverflow)
+    {
+      LOGGER_LOG_MSG(LOGMSG_LOG_SINK_OVERFLOW, 1, overflow - logger_reportedOverflow);
+      logger_reportedOverflow = overflow;
+    }
+  }
+
+  // delete the logger thread, in case accidentally break the loop
+  osThreadTerminate(NULL);
 }
 
 /**
 * @brief  Save log events into log file
 * @param  sState     Event log state
-* @param  errorcode  Error Code
 * @param  sMsg       Event log message
   @retval rc:        If pass then return PER_NO_ERROR, otherwise error code
 */
 uint32_t logger_SaveLogEvents(const char* sState, const char* sMsg)
+{
+  logFmt_t fmt;
+
+  // "%6s - %s.\n"
+  logfmt_Init(&fmt, logger_line_buf, sizeof(logger_line_buf));
+  logfmt_StrPad(&fmt, sState, 6);
+  logfmt_Str(&fmt, " - ");
+  logfmt_Str(&fmt, sMsg);
+  logfmt_Str(&fmt, ".\n");
+  uint32_t size = logfmt_End(&fmt);
+
+  return logger_SaveLogData((const uint8_t*)logger_line_buf, size);
+}
+
+/**
+* @brief  Save one log record into log file, packed in binary mode or as a
+*         text line otherwise
+* @param  record     Log record
+  @retval rc:        If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logger_SaveLogRecord(const loggerRecord_t* record)
+{
+#if LOGGER_BINARY_MODE
+  uint32_t size = logger_PackStored(record, logger_RecordTick(record), logger_pack_buf);
+  return logger_SaveLogData(logger_pack_buf, size);
+#else
+  uint32_t size = logger_FormatLine(record, logger_line_buf, sizeof(logger_line_buf));
+  return logger_SaveLogData((const uint8_t*)logger_line_buf, size);
+#endif
+}
+
+/**
+* @brief  Copy the records kept by the RAM sink, oldest first
+* @param  records    Destination
+* @param  maxCount   Destination size in records
+  @retval Number of records copied
+*/
+uint32_t logger_ReadRamLog(loggerRecord_t* records, uint32_t maxCount)
+{
+  // the kernel lock keeps the logger task from replacing a record being copied
+  osKernelLock();
+  uint32_t count = (logger_ramCount < LOGGER_RAM_RECORD_COUNT) ? logger_ramCount : LOGGER_RAM_RECORD_COUNT;
+  if (count > maxCount)
+    count = maxCount;
+
+  for (uint32_t idx = 0; idx < count; idx++)
+    memcpy(&records[idx], &logger_ramLog[(logger_ramCount - count + idx) % LOGGER_RAM_RECORD_COUNT], sizeof(loggerRecord_t));
+  osKernelUnlock();
+
+  return count;
+}
+
+/**
+* @brief  Pack a record for binary storage, little endian:
+*         msgId(2) level(1) len(1) timestamp(4) payload(len)
+* @param  record     Log record
+* @param  pBuf       Destination, at least LOGGER_BINARY_MAX_SIZE bytes
+  @retval Packed size in bytes
+*/
+uint32_t logger_PackRecord(const loggerRecord_t* record, uint8_t* pBuf)
+{
+  uint32_t len = record->len;
+  if (len > LOGGER_RECORD_TEXT_LEN)
+    len = LOGGER_RECORD_TEXT_LEN;
+
+  pBuf[0] = record->msgId & 0xFF;
+  pBuf[1] = (record->msgId >> 8) & 0xFF;
+  pBuf[2] = record->level;
+  pBuf[3] = (uint8_t)len;
+  pBuf[4] = record->timestamp & 0xFF;
+  pBuf[5] = (record->timestamp >> 8) & 0xFF;
+  pBuf[6] = (record->timestamp >> 16) & 0xFF;
+  pBuf[7] = (record->timestamp >> 24) & 0xFF;
+  memcpy(&pBuf[LOGGER_BINARY_HDR_SIZE], record->text, len);
+
+  return LOGGER_BINARY_HDR_SIZE + len;
+}
+
+#if LOGGER_BINARY_MODE || LOGGER_SDCARD_ENABLE
+/**
+* @brief  Kernel tick of a record, the unit of the SD card index and of the
+*         queries. The cycle counter timestamp wraps after
+*         2^32 / SystemCoreClock s, far longer than a record waits in the
+*         queues. A record replayed from the crash ring was stamped by the
+*         cycle counter before the reset, so its age means nothing; it gets
+*         tick 0 and sorts before the records of this boot
+* @param  record     Log record
+  @retval Kernel tick
+*/
+static uint32_t logger_RecordTick(const loggerRecord_t* record)
+{
+  if (record->bReplayed)
+    return 0;
+
+  uint32_t ageMs = (SEGGER_SYSVIEW_GET_TIMESTAMP() - record->timestamp) / (SystemCoreClock / 1000U);
+  uint32_t tick = osKernelGetTickCount();
+
+  return (ageMs < tick) ? (tick - ageMs) : 0;
+}
+#endif
+
+#if LOGGER_BINARY_MODE
+/**
+* @brief  Pack a record for the SD card with its kernel tick as timestamp
+* @param  record     Log record
+* @param  tick       Kernel tick of the record
+* @param  pBuf       Destination, at least LOGGER_BINARY_MAX_SIZE bytes
+  @retval Packed size in bytes
+*/
+static uint32_t logger_PackStored(const loggerRecord_t* record, uint32_t tick, uint8_t* pBuf)
+{
+  uint32_t size = logger_PackRecord(record, pBuf);
+
+  pBuf[4] = tick & 0xFF;
+  pBuf[5] = (tick >> 8) & 0xFF;
+  pBuf[6] = (tick >> 16) & 0xFF;
+  pBuf[7] = (tick >> 24) & 0xFF;
+
+  return size;
+}
+#endif
+
+/**
+* @brief  Format a record as a text line, "%6s - %s.\n"
+* @param  record     Log record
+* @param  pBuf       Destination
+* @param  size       Destination size
+  @retval Line length in bytes
+*/
+uint32_t logger_FormatLine(const loggerRecord_t* record, char* pBuf, uint32_t size)
+{
+  logFmt_t fmt;
+
+  logfmt_Init(&fmt, pBuf, size);
+  logfmt_StrPad(&fmt, logger_levelName[record->level], 6);
+  logfmt_Str(&fmt, " - ");
+  if (record->msgId == LOGMSG_TEXT)
+    logfmt_Str(&fmt, record->text);
+  else
+    logfmt_Args(&fmt, logger_msgFormat[record->msgId], record->args, record->len / sizeof(uint32_t));
+  logfmt_Str(&fmt, ".\n");
+
+  return logfmt_End(&fmt);
+}
+
+/**
+* @brief  Find the extent, level and time of the stored record at the start of
+*         the data, a packed record in binary mode or a text line otherwise
+* @param  pData        Stored data
+* @param  size         Data size in bytes
+* @param  pRecordSize  Record size in bytes
+* @param  pLevel       Record level
+* @param  pTick        Kernel tick of the record, a text line has none and
+*                      gives LOGGER_NO_TICK
+  @retval true if a complete record starts the data
+*/
+bool logger_ParseRecord(const uint8_t* pData, uint32_t size, uint32_t* pRecordSize, uint8_t* pLevel, uint32_t* pTick)
+{
+#if LOGGER_BINARY_MODE
+  if ((size < LOGGER_BINARY_HDR_SIZE) || ((uint32_t)(LOGGER_BINARY_HDR_SIZE + pData[3]) > size))
+    return false;
+
+  *pRecordSize = LOGGER_BINARY_HDR_SIZE + pData[3];
+  *pLevel = (pData[2] <= LOGGER_LEVEL_ERROR) ? pData[2] : LOGGER_LEVEL_ERROR;
+  *pTick = (uint32_t)pData[4] | ((uint32_t)pData[5] << 8) | ((uint32_t)pData[6] << 16) | ((uint32_t)pData[7] << 24);
+  return true;
+#else
+  *pTick = LOGGER_NO_TICK;
+
+  const uint8_t* pEnd = memchr(pData, '\n', size);
+  if (pEnd == NULL)
+    return false;
+
+  *pRecordSize = (uint32_t)(pEnd - pData) + 1;
+
+  // "%6s - ", the level name is right aligned
+  uint32_t pos = 0;
+  while ((pos < *pRecordSize) && (pData[pos] == ' '))
+    pos++;
+
+  *pLevel = LOGGER_LEVEL_INFO;
+  for (uint8_t level = LOGGER_LEVEL_INFO; level <= LOGGER_LEVEL_ERROR; level++)
+  {
+    uint32_t len = strlen(logger_levelName[level]);
+    if (((pos + len) <= *pRecordSize) && (memcmp(&pData[pos], logger_levelName[level], len) == 0))
+      *pLevel = level;
+  }
+  return true;
+#endif
+}
+
+/**
+* @brief  Collect a USB CDC command line, called from CDC_Receive_FS
+* @param  pBuf       Received data
+* @param  len        Received size in bytes
+  @retval None
+*/
+void logger_UsbRxHandler(const uint8_t* pBuf, uint32_t len)
+{
+#if LOGGER_USB_ENABLE
+  for (uint32_t idx = 0; idx < len; idx++)
+  {
+    char c = (char)pBuf[idx];
+    if ((c == '\r') || (c == '\n'))
+    {
+      if (logger_usbCmdLen > 0)
+      {
+        logger_usbCmd[logger_usbCmdLen] = LOGGER_NULL_STRING;
+        logger_UsbCommand(logger_usbCmd);
+      }
+      logger_usbCmdLen = 0;
+    }
+    else if (logger_usbCmdLen < (LOGGER_USB_CMD_LEN - 1))
+    {
+      logger_usbCmd[logger_usbCmdLen++] = c;
+    }
+  }
+#else
+  (void)pBuf;
+  (void)len;
+#endif
+}
+
+/**
+* @brief  Append raw data into log file
+* @param  pData      Data to append
+* @param  size       Data size in bytes
+  @retval rc:        If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t logger_SaveLogData(const uint8_t* pData, uint32_t size)
 {
   uint32_t rc = PER_ERROR_SDCARD_FAILED_WRITE;
-  //uint32_t timestamp = SEGGER_SYSVIEW_GET_TIMESTAMP();
-
-//  memset(logger_line_buf, 0, sizeof(logger_line_buf));
-//  int size = sprintf(logger_line_buf, "%6s - %s.\n", sState, sMsg);
-//
-//  // make sure SD CARD is presented & mounted before
-//  if ((osEventFlagsGet(osFlag_Main) & MAIN_SD_PRESENT_FLAG) &&
-//      (osEventFlagsGet(osFlag_Main) & MAIN_MOUNT_SDCARD_FLAG) &&
-//      (osEventFlagsGet(osFlag_Main) & MAIN_CREATE_FOLDERS_FLAG))
-//  {
-//    //sprintf(logger_filepath, "%s/%lu.LOG", LOGGER_LOG_DIR, loggerFileName);
-//    sprintf(logger_filepath, "%s/log.LOG", LOGGER_LOG_DIR);
-//
-//    // create a file with read write access and open it
-//    if(f_open(&SDFile, logger_filepath, FA_OPEN_APPEND | FA_WRITE) == FR_OK)
-//    {
-//      osEventFlagsSet(osFlag_Main, MAIN_OPEN_FILE_FLAG);
-//
-//      // write distance data into files
-//      uint32_t bw;
-//      FRESULT res = f_write(&SDFile, logger_line_buf, size, (void *)&bw);
-//      if((bw > 0) && (res == FR_OK))
-//      {
-//        rc = PER_NO_ERROR;
-//      }
-//    }
-//
-//    f_close(&SDFile);
-//    osEventFlagsClear(osFlag_Main, MAIN_OPEN_FILE_FLAG);
-//  }
+
+#if LOGGER_SDCARD_ENABLE
+  // the writer only buffers here, sectors are written by the storage task
+  if (osEventFlagsGet(osFlag_Main) & MAIN_CREATE_FOLDERS_FLAG)
+    rc = logsd_Write(pData, size);
+#endif
 
   return rc;
 }
 
+/**
+* @brief  Copy the log event into a free queue slot, called from the logging task
+* @param  level      Event log level
+* @param  sMsg       Event log message
+* @param  sArg       Input argument, may be empty or NULL
+  @retval None
+*/
+static void logger_PushRecord(loggerLevel_t level, const char* sMsg, const char* sArg)
+{
+  logqSlot_t* slot = logq_Reserve(&logger_queue);
+  if (slot == NULL)
+    return;
+
+  loggerRecord_t* record = &slot->record;
+  record->timestamp = SEGGER_SYSVIEW_GET_TIMESTAMP();
+  record->msgId = LOGMSG_TEXT;
+  record->level = (uint8_t)level;
+  record->bReplayed = 0;
+
+  // "%s: %s", formatted straight into the queue slot
+  logFmt_t fmt;
+  logfmt_Init(&fmt, record->text, sizeof(record->text));
+  logfmt_Str(&fmt, sMsg);
+  if ((sArg != NULL) && (sArg[0] != LOGGER_NULL_STRING))
+  {
+    logfmt_Str(&fmt, ": ");
+    logfmt_Str(&fmt, sArg);
+  }
+  record->len = (uint8_t)logfmt_End(&fmt);
+
+  logcrash_Append(&logger_crashRing, record);
+  logq_Commit(slot);
+
+  if (fmt.bTruncated)
+    atomic_fetch_add_explicit(&logger_truncated, 1, memory_order_relaxed);
+
+  // errors are flushed right away, other levels wait for the logger period
+  if ((level == LOGGER_LEVEL_ERROR) && (loggerTaskHandle != NULL))
+    osThreadFlagsSet(loggerTaskHandle, LOGGER_WAKEUP_FLAG);
+}
+
+/**
+* @brief  Queue a record recovered from the crash ring as it was logged
+* @param  record     Log record
+  @retval None
+*/
+static void logger_RestoreRecord(const loggerRecord_t* record)
+{
+  logqSlot_t* slot = logq_Reserve(&logger_queue);
+  if (slot == NULL)
+    return;
+
+  memcpy(&slot->record, record, sizeof(loggerRecord_t));
+  slot->record.bReplayed = 1;
+  logq_Commit(slot);
+}
+
+/**
+* @brief  Set up a sink and add it to the registry
+* @param  sink       Sink
+* @param  name       Sink name, LOGGER_SINK_*
+* @param  pfnWrite   Non-blocking output
+* @param  queue      Queue storage
+* @param  queueSize  Queue size in records, power of two
+  @retval None
+*/
+static void logger_AddSink(logSink_t* sink, const char* name, logSinkWrite_t pfnWrite,
+                           loggerRecord_t* queue, uint32_t queueSize)
+{
+  sink->name = name;
+  sink->minLevel = LOGGER_LEVEL_INFO;
+  sink->pfnWrite = pfnWrite;
+  sink->queue = queue;
+  sink->queueSize = queueSize;
+
+  if (logsink_Register(sink) != PER_NO_ERROR)
+    SEGGER_SYSVIEW_Error("[LOG] - Failed to register log sink");
+}
+
+/**
+* @brief  SYSVIEW sink, the RTT buffer never blocks
+* @param  record     Log record
+  @retval Sink result
+*/
+static logSinkResult_t logger_SysviewWrite(const loggerRecord_t* record)
+{
+  const char* text = record->text;
+  char line[LOGGER_RECORD_TEXT_LEN];
+
+  // the host has no error names, a message with %E is formatted here
+  if ((record->msgId != LOGMSG_TEXT) && (strstr(logger_msgFormat[record->msgId], "%E") != NULL))
+  {
+    logFmt_t fmt;
+    logfmt_Init(&fmt, line, sizeof(line));
+    logfmt_Args(&fmt, logger_msgFormat[record->msgId], record->args, record->len / sizeof(uint32_t));
+    logfmt_End(&fmt);
+    text = line;
+  }
+  else if (record->msgId != LOGMSG_TEXT)
+  {
+    text = NULL;
+  }
+
+  if (text != NULL)
+  {
+    switch(record->level)
+    {
+      case LOGGER_LEVEL_WARN:
+        SEGGER_SYSVIEW_Warn(text);
+        break;
+      case LOGGER_LEVEL_ERROR:
+        SEGGER_SYSVIEW_Error(text);
+        break;
+      default:
+        SEGGER_SYSVIEW_Print(text);
+        break;
+    }
+  }
+  else
+  {
+    // SYSVIEW formats the arguments on the host side
+    const char* fmt = logger_msgFormat[record->msgId];
+    switch(record->level)
+    {
+      case LOGGER_LEVEL_WARN:
+        SEGGER_SYSVIEW_WarnfHost(fmt, record->args[0], record->args[1], record->args[2], record->args[3]);
+        break;
+      case LOGGER_LEVEL_ERROR:
+        SEGGER_SYSVIEW_ErrorfHost(fmt, record->args[0], record->args[1], record->args[2], record->args[3]);
+        break;
+      default:
+        SEGGER_SYSVIEW_PrintfHost(fmt, record->args[0], record->args[1], record->args[2], record->args[3]);
+        break;
+    }
+  }
+
+  return LOGSINK_WRITTEN;
+}
+
+/**
+* @brief  RAM sink, keeps the newest records for logger_ReadRamLog
+* @param  record     Log record
+  @retval Sink result
+*/
+static logSinkResult_t logger_RamWrite(const loggerRecord_t* record)
+{
+  osKernelLock();
+  memcpy(&logger_ramLog[logger_ramCount % LOGGER_RAM_RECORD_COUNT], record, sizeof(loggerRecord_t));
+  logger_ramCount++;
+  osKernelUnlock();
+
+  return LOGSINK_WRITTEN;
+}
+
+#if LOGGER_SDCARD_ENABLE
+/**
+* @brief  SD card sink, waits in its queue while both sector buffers are with
+*         the storage task
+* @param  record     Log record
+  @retval Sink result
+*/
+static logSinkResult_t logger_SdWrite(const loggerRecord_t* record)
+{
+  if (!(osEventFlagsGet(osFlag_Main) & MAIN_CREATE_FOLDERS_FLAG))
+    return LOGSINK_DISCARDED;
+
+  uint32_t tick = logger_RecordTick(record);
+#if LOGGER_BINARY_MODE
+  uint32_t size = logger_PackStored(record, tick, logger_pack_buf);
+  const uint8_t* pData = logger_pack_buf;
+#else
+  uint32_t size = logger_FormatLine(record, logger_line_buf, sizeof(logger_line_buf));
+  const uint8_t* pData = (const uint8_t*)logger_line_buf;
+#endif
+
+  if (!logsd_IsReady(size))
+    return LOGSINK_BUSY;
+
+  logsd_MarkRecord(record->level, tick);
+  logsd_Write(pData, size);
+
+  // errors must reach the card before a possible reset
+  if (record->level == LOGGER_LEVEL_ERROR)
+    logsd_Flush();
+
+  return LOGSINK_WRITTEN;
+}
+#endif
+
+#if LOGGER_FLASH_ENABLE
+/**
+* @brief  FLASH store sink, always packed records so each page decodes on its
+*         own. Waits in its queue for the erase ahead, or drops the record
+*         once the store is full and only the boot erases
+* @param  record     Log record
+  @retval Sink result
+*/
+static logSinkResult_t logger_FlashWrite(const loggerRecord_t* record)
+{
+  uint8_t buf[LOGGER_BINARY_MAX_SIZE];
+  uint32_t size = logger_PackRecord(record, buf);
+
+  // without the runtime erase a full store stays full until the next boot
+  if (!logflash_IsReady(size))
+    return LOGFLASH_RUNTIME_ERASE ? LOGSINK_BUSY : LOGSINK_DISCARDED;
+
+  logflash_Write(buf, size);
+
+  // errors must reach the FLASH before a possible reset
+  if (record->level == LOGGER_LEVEL_ERROR)
+    logflash_Flush();
+
+  return LOGSINK_WRITTEN;
+}
+#endif
+
+#if LOGGER_USB_ENABLE
+/**
+* @brief  USB CDC sink, text lines while a host is connected. The two line
+*         buffers alternate, the one being sent stays untouched until the
+*         CDC class accepts the next transfer
+* @param  record     Log record
+  @retval Sink result
+*/
+static logSinkResult_t logger_UsbWrite(const loggerRecord_t* record)
+{
+  if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED)
+    return LOGSINK_DISCARDED;
+
+  // the query answer owns the CDC stream until its end record
+  if (logger_bUsbQuery)
+    return LOGSINK_BUSY;
+
+  uint8_t* pBuf = logger_usbBuf[logger_usbActive];
+  uint32_t size = logger_FormatLine(record, (char*)pBuf, LOGGER_USB_LINE_LEN);
+
+  switch (CDC_Transmit_FS(pBuf, (uint16_t)size))
+  {
+    case USBD_OK:
+      logger_usbActive ^= 1;
+      return LOGSINK_WRITTEN;
+    case USBD_BUSY:
+      return LOGSINK_BUSY;
+    default:
+      return LOGSINK_DISCARDED;
+  }
+}
+
+/**
+* @brief  Parse a retrieval query, called from the USB receive interrupt. The
+*         logger task starts it, so no live line is sent once it runs
+* @param  sCmd       Command line without line end
+  @retval None
+*/
+static void logger_UsbCommand(const char* sCmd)
+{
+#if LOGGER_SDCARD_ENABLE
+  logsdQuery_t query = { .pfnSend = logger_UsbSend, .pfnDone = logger_UsbQueryDone };
+  uint32_t minLevel;
+  bool bValid;
+
+  if (logger_bUsbQuery || logger_bUsbQueryPending)
+    return;
+
+  if (strncmp(sCmd, "GET ", 4) == 0)
+  {
+    sCmd += 4;
+    bValid = logger_ParseUInt(&sCmd, &query.fromMs) && logger_ParseUInt(&sCmd, &query.toMs) &&
+        logger_ParseUInt(&sCmd, &minLevel);
+  }
+  else if (strncmp(sCmd, "LAST ", 5) == 0)
+  {
+    uint32_t span;
+    sCmd += 5;
+    bValid = logger_ParseUInt(&sCmd, &span) && logger_ParseUInt(&sCmd, &minLevel);
+    query.toMs = osKernelGetTickCount();
+    query.fromMs = (span < query.toMs) ? (query.toMs - span) : 0;
+  }
+  else
+  {
+    bValid = false;
+  }
+
+  if (!bValid || (minLevel > LOGGER_LEVEL_ERROR))
+    return;
+
+  query.levelMask = (uint8_t)(0xFFU << minLevel);
+
+  logger_usbQuery = query;
+  logger_bUsbQueryPending = true;
+  if (loggerTaskHandle != NULL)
+    osThreadFlagsSet(loggerTaskHandle, LOGGER_WAKEUP_FLAG);
+#else
+  // retrieval needs the SD card log and its index
+  (void)sCmd;
+#endif
+}
+
+#if LOGGER_SDCARD_ENABLE
+/**
+* @brief  Hand a pending query to the storage task, called by the logger task.
+*         The live lines stop first, a line already passed to the CDC class
+*         ends before the storage task can send
+* @param  None
+  @retval None
+*/
+static void logger_UsbStartQuery(void)
+{
+  if (!logger_bUsbQueryPending)
+    return;
+
+  logger_bUsbQuery = true;
+  if (logsd_Query(&logger_usbQuery) != PER_NO_ERROR)
+    logger_bUsbQuery = false;
+  logger_bUsbQueryPending = false;
+}
+
+/**
+* @brief  Read a decimal number followed by a space or the end of the line
+* @param  ppCmd      Command position, moved past the number
+* @param  pValue     Number
+  @retval true if a number was found
+*/
+static bool logger_ParseUInt(const char** ppCmd, uint32_t* pValue)
+{
+  const char* p = *ppCmd;
+  uint32_t value = 0;
+
+  while (*p == ' ')
+    p++;
+
+  if ((*p < '0') || (*p > '9'))
+    return false;
+
+  while ((*p >= '0') && (*p <= '9'))
+    value = (value * 10U) + (uint32_t)(*p++ - '0');
+
+  if ((*p != ' ') && (*p != LOGGER_NULL_STRING))
+    return false;
+
+  *ppCmd = p;
+  *pValue = value;
+  return true;
+}
+
+/**
+* @brief  Send query data over USB CDC, called by the storage task. Returns
+*         once the transfer is over, so the caller may reuse its buffer
+* @param  pData      Data
+* @param  size       Data size in bytes
+  @retval rc:        If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t logger_UsbSend(const uint8_t* pData, uint32_t size)
+{
+  uint32_t start = osKernelGetTickCount();
+  uint8_t res;
+
+  while ((res = CDC_Transmit_FS((uint8_t*)pData, (uint16_t)size)) == USBD_BUSY)
+  {
+    if ((osKernelGetTickCount() - start) >= LOGGER_USB_SEND_TIMEOUT_MS)
+      return PER_ERROR_USB_TRANSMIT;
+    osDelay(1);
+  }
+
+  if (res != USBD_OK)
+    return PER_ERROR_USB_TRANSMIT;
+
+  const USBD_CDC_HandleTypeDef* hcdc = (const USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  while ((hcdc != NULL) && (hcdc->TxState != 0))
+  {
+    if ((osKernelGetTickCount() - start) >= LOGGER_USB_SEND_TIMEOUT_MS)
+      return PER_ERROR_USB_TRANSMIT;
+    osDelay(1);
+  }
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Close a query with the end record and resume the live USB lines
+* @param  count      Records sent
+* @param  rc         Query result
+  @retval None
+*/
+static void logger_UsbQueryDone(uint32_t count, uint32_t rc)
+{
+  uint32_t size;
+
+#if LOGGER_BINARY_MODE
+  loggerRecord_t end = { .timestamp = count, .level = LOGGER_LEVEL_INFO, .len = 0, .msgId = LOGGER_QUERY_END_ID };
+  size = logger_PackRecord(&end, logger_usbEnd);
+#else
+  logFmt_t fmt;
+  logfmt_Init(&fmt, (char*)logger_usbEnd, sizeof(logger_usbEnd));
+  logfmt_StrPad(&fmt, "END", 6);
+  logfmt_Str(&fmt, " - ");
+  logfmt_UDec(&fmt, count);
+  if (rc != PER_NO_ERROR)
+  {
+    logfmt_Char(&fmt, ' ');
+    logfmt_ErrorCode(&fmt, rc);
+  }
+  logfmt_Str(&fmt, ".\n");
+  size = logfmt_End(&fmt);
+#endif
+
+  // a failed transfer is not answered again
+  if (rc != PER_ERROR_USB_TRANSMIT)
+    logger_UsbSend(logger_usbEnd, size);
+
+  logger_bUsbQuery = false;
+}
+#endif
+#endif
 
 /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
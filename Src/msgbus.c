@@ -0,0 +1,352 @@
+/**
+  ******************************************************************************
+  * @file    msgbus.c
+  * @author  IBronx MDE team
+  * @brief   Inter-task message bus
+  *          Fixed size messages come from a static pool and are handed to the
+  *          subscribers of their topic by pointer, never copied. Every
+  *          subscriber has its own lock-free queue, publishers in tasks and
+  *          interrupts reserve cells with the same sequence scheme as the log
+  *          queue. A publish sets the subscriber thread flag, flags of several
+  *          publishes merge, so a subscriber wakes once and drains the batch.
+  *          The message returns to the pool when the last subscriber releases
+  *          it.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "msgbus.h"
+#include "errorcode.h"
+#include "SEGGER_SYSVIEW.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#if (MSGBUS_POOL_SIZE > 32)
+#error "MSGBUS_POOL_SIZE must fit the 32 bit free map"
+#endif
+#if (MSGBUS_TOPIC_COUNT > 32)
+#error "MSGBUS_TOPIC_TABLE must fit the 32 bit topic mask"
+#endif
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static msgbusMsg_t msgbus_pool[MSGBUS_POOL_SIZE];
+static atomic_uint msgbus_freeMap;             // bit set, message free
+static msgbusSubscriber_t* msgbus_subscribers[MSGBUS_SUBSCRIBER_MAX];
+static volatile uint32_t msgbus_subscriberCount;
+
+// counters, updated by publishers in tasks and interrupts
+static atomic_uint msgbus_published;
+static atomic_uint msgbus_poolEmpty;
+static atomic_uint msgbus_poolLow;
+
+static const char* const msgbus_topicNames[MSGBUS_TOPIC_COUNT] = {
+#define MSGBUS_TOPIC_NAME(id, name)   name,
+  MSGBUS_TOPIC_TABLE(MSGBUS_TOPIC_NAME)
+#undef MSGBUS_TOPIC_NAME
+};
+/* Private function prototypes -----------------------------------------------*/
+static bool msgbus_Push(msgbusSubscriber_t* sub, msgbusMsg_t* msg);
+static bool msgbus_Pending(msgbusSubscriber_t* sub);
+static void msgbus_Free(msgbusMsg_t* msg);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Return every message to the pool, called before any task publishes
+* @param  None
+* @retval None
+*/
+void msgbus_Init(void)
+{
+  atomic_init(&msgbus_freeMap, (MSGBUS_POOL_SIZE == 32) ? 0xFFFFFFFFU : ((1U << MSGBUS_POOL_SIZE) - 1U));
+  msgbus_subscriberCount = 0;
+  atomic_init(&msgbus_published, 0);
+  atomic_init(&msgbus_poolEmpty, 0);
+  atomic_init(&msgbus_poolLow, MSGBUS_POOL_SIZE);
+}
+
+/**
+* @brief  Add a subscriber, called from task context before it waits on the bus
+* @param  sub:  Subscriber with topics and flag set, flag 0 for a subscriber that polls
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t msgbus_Subscribe(msgbusSubscriber_t* sub)
+{
+  if (msgbus_subscriberCount >= MSGBUS_SUBSCRIBER_MAX)
+    return PER_ERROR_INIT;
+
+  if (sub->thread == NULL)
+    sub->thread = osThreadGetId();
+
+  for (uint32_t idx = 0; idx < MSGBUS_QUEUE_SIZE; idx++)
+    atomic_init(&sub->cells[idx].seq, idx);
+  atomic_init(&sub->head, 0);
+  atomic_init(&sub->tail, 0);
+  atomic_init(&sub->dropped, 0);
+  sub->highWater = 0;
+  sub->received = 0;
+  sub->latencyMax = 0;
+  sub->latencyTotal = 0;
+
+  // publishers see the subscriber once the count covers it
+  msgbus_subscribers[msgbus_subscriberCount] = sub;
+  msgbus_subscriberCount++;
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Take a free message from the pool, from a task or an interrupt
+* @param  topic:  Topic of the message
+* @retval Message to fill in and publish, NULL when the pool is empty
+*/
+msgbusMsg_t* msgbus_Alloc(msgbusTopic_t topic)
+{
+  uint32_t map = atomic_load_explicit(&msgbus_freeMap, memory_order_relaxed);
+  uint32_t bit;
+
+  do
+  {
+    if (map == 0)
+    {
+      atomic_fetch_add_explicit(&msgbus_poolEmpty, 1, memory_order_relaxed);
+      return NULL;
+    }
+    bit = (uint32_t)__builtin_ctz(map);
+  } while (!atomic_compare_exchange_weak_explicit(&msgbus_freeMap, &map, map & ~(1U << bit),
+                                                  memory_order_acquire, memory_order_relaxed));
+
+  uint32_t remaining = (uint32_t)__builtin_popcount(map) - 1U;
+  uint32_t low = atomic_load_explicit(&msgbus_poolLow, memory_order_relaxed);
+  while ((remaining < low) &&
+         !atomic_compare_exchange_weak_explicit(&msgbus_poolLow, &low, remaining,
+                                                memory_order_relaxed, memory_order_relaxed))
+  {
+  }
+
+  msgbusMsg_t* msg = &msgbus_pool[bit];
+  msg->topic = (uint8_t)topic;
+  memset(msg->payload, 0, sizeof(msg->payload));
+  return msg;
+}
+
+/**
+* @brief  Hand a message to every subscriber of its topic, the publisher must not touch it afterwards
+* @param  msg:  Message from msgbus_Alloc
+* @retval rc:  PER_NO_ERROR, or PER_ERROR_QUEUE_FULL when a subscriber queue was full
+*/
+uint32_t msgbus_Publish(msgbusMsg_t* msg)
+{
+  uint32_t rc = PER_NO_ERROR;
+  uint32_t count = msgbus_subscriberCount;
+  uint32_t topic = MSGBUS_TOPIC(msg->topic);
+
+  msg->timestamp = SEGGER_SYSVIEW_GET_TIMESTAMP();
+
+  // the publisher holds one reference until every queue has the message
+  atomic_store_explicit(&msg->refs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&msgbus_published, 1, memory_order_relaxed);
+
+  for (uint32_t idx = 0; idx < count; idx++)
+  {
+    msgbusSubscriber_t* sub = msgbus_subscribers[idx];
+    if (!(sub->topics & topic))
+      continue;
+
+    atomic_fetch_add_explicit(&msg->refs, 1, memory_order_relaxed);
+    if (!msgbus_Push(sub, msg))
+    {
+      atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_relaxed);
+      rc = PER_ERROR_QUEUE_FULL;
+      continue;
+    }
+
+    if (sub->flag != 0)
+      osThreadFlagsSet(sub->thread, sub->flag);
+  }
+
+  msgbus_Release(msg);
+  return rc;
+}
+
+/**
+* @brief  Allocate and publish a message with one payload word
+* @param  topic:  Topic
+* @param  arg:  First payload word
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t msgbus_Post(msgbusTopic_t topic, uint32_t arg)
+{
+  msgbusMsg_t* msg = msgbus_Alloc(topic);
+
+  if (msg == NULL)
+    return PER_ERROR_QUEUE_FULL;
+
+  msg->payload[0] = arg;
+  return msgbus_Publish(msg);
+}
+
+/**
+* @brief  Take the oldest message of a subscriber, only called by its thread
+* @param  sub:  Subscriber
+* @retval Message to read and release, NULL when the queue is empty
+*/
+const msgbusMsg_t* msgbus_Receive(msgbusSubscriber_t* sub)
+{
+  uint32_t pos = atomic_load_explicit(&sub->tail, memory_order_relaxed);
+  msgbusCell_t* cell = &sub->cells[pos & MSGBUS_QUEUE_MASK];
+  uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+  // empty, or the publisher of this position has not committed yet
+  if ((int32_t)(seq - (pos + 1)) < 0)
+    return NULL;
+
+  uint32_t depth = atomic_load_explicit(&sub->head, memory_order_relaxed) - pos;
+  if (depth > sub->highWater)
+    sub->highWater = depth;
+
+  msgbusMsg_t* msg = cell->msg;
+
+  // release the cell for the publishers one lap later
+  atomic_store_explicit(&cell->seq, pos + MSGBUS_QUEUE_SIZE, memory_order_release);
+  atomic_store_explicit(&sub->tail, pos + 1, memory_order_relaxed);
+
+  uint32_t latency = SEGGER_SYSVIEW_GET_TIMESTAMP() - msg->timestamp;
+  sub->received++;
+  sub->latencyTotal += latency;
+  if (latency > sub->latencyMax)
+    sub->latencyMax = latency;
+
+  return msg;
+}
+
+/**
+* @brief  Drop a reference, the last one returns the message to the pool
+* @param  msg:  Message from msgbus_Receive
+* @retval None
+*/
+void msgbus_Release(const msgbusMsg_t* msg)
+{
+  msgbusMsg_t* owned = (msgbusMsg_t*)msg;
+
+  if (atomic_fetch_sub_explicit(&owned->refs, 1, memory_order_acq_rel) == 1)
+    msgbus_Free(owned);
+}
+
+/**
+* @brief  Block until the subscriber has messages
+* @param  sub:  Subscriber
+* @param  timeout:  Timeout in ms or osWaitForever
+* @retval true if messages are queued
+*/
+bool msgbus_Wait(msgbusSubscriber_t* sub, uint32_t timeout)
+{
+  // a flag may be left from messages already drained, check the queue itself
+  while (!msgbus_Pending(sub))
+  {
+    if (osThreadFlagsWait(sub->flag, osFlagsWaitAny, timeout) & osFlagsError)
+      return false;
+  }
+
+  return true;
+}
+
+/**
+* @brief  Read the bus counters
+* @param  stats:  Destination of the counters
+* @retval None
+*/
+void msgbus_GetStats(msgbusStats_t* stats)
+{
+  stats->published = atomic_load_explicit(&msgbus_published, memory_order_relaxed);
+  stats->poolEmpty = atomic_load_explicit(&msgbus_poolEmpty, memory_order_relaxed);
+  stats->poolLow = atomic_load_explicit(&msgbus_poolLow, memory_order_relaxed);
+}
+
+/**
+* @brief  Name of a topic
+* @param  topic:  Topic
+* @retval Name from MSGBUS_TOPIC_TABLE
+*/
+const char* msgbus_GetTopicName(msgbusTopic_t topic)
+{
+  return (topic < MSGBUS_TOPIC_COUNT) ? msgbus_topicNames[topic] : "UNKNOWN";
+}
+
+/**
+* @brief  Queue a message pointer for a subscriber
+* @param  sub:  Subscriber
+* @param  msg:  Message
+* @retval false when the queue is full
+*/
+static bool msgbus_Push(msgbusSubscriber_t* sub, msgbusMsg_t* msg)
+{
+  uint32_t pos = atomic_load_explicit(&sub->head, memory_order_relaxed);
+
+  for (;;)
+  {
+    msgbusCell_t* cell = &sub->cells[pos & MSGBUS_QUEUE_MASK];
+    uint32_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    int32_t diff = (int32_t)(seq - pos);
+
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(&sub->head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+      {
+        cell->msg = msg;
+        atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      atomic_fetch_add_explicit(&sub->dropped, 1, memory_order_relaxed);
+      return false;
+    }
+    else
+    {
+      pos = atomic_load_explicit(&sub->head, memory_order_relaxed);
+    }
+  }
+}
+
+/**
+* @brief  Check the oldest cell of a subscriber, a reserved cell counts only
+*         once its publisher committed it and will set the flag after
+* @param  sub:  Subscriber
+* @retval true if msgbus_Receive returns a message
+*/
+static bool msgbus_Pending(msgbusSubscriber_t* sub)
+{
+  uint32_t pos = atomic_load_explicit(&sub->tail, memory_order_relaxed);
+  uint32_t seq = atomic_load_explicit(&sub->cells[pos & MSGBUS_QUEUE_MASK].seq, memory_order_acquire);
+
+  return (seq == (pos + 1));
+}
+
+/**
+* @brief  Return a message to the pool
+* @param  msg:  Message
+* @retval None
+*/
+static void msgbus_Free(msgbusMsg_t* msg)
+{
+  uint32_t bit = (uint32_t)(msg - msgbus_pool);
+
+  atomic_fetch_or_explicit(&msgbus_freeMap, 1U << bit, memory_order_release);
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,137 @@
+/**
+  ******************************************************************************
+  * @file    rtos_objects.c
+  * @author  IBronx MDE team
+  * @brief   Static RTOS object registry
+  *          Every thread, semaphore, event flags group, message queue and timer
+  *          of the application is listed in the tables of rtos_objects.h. The
+  *          control blocks, stacks and queue buffers are reserved here, one
+  *          block per object kind, and the owner module creates its objects
+  *          with the matching attributes, so nothing is taken from the heap
+  *          at runtime. The total is checked against RTOS_STATIC_BUDGET when
+  *          compiling, the blocks show up by name in the map file.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rtos_objects.h"
+#include "app_main.h"
+#include "fsm.h"
+#include "log_sdwriter.h"
+
+/* Private define ------------------------------------------------------------*/
+#if (configSUPPORT_STATIC_ALLOCATION == 0)
+#error "the RTOS object registry needs configSUPPORT_STATIC_ALLOCATION"
+#endif
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+ // the CMSIS-RTOS2 wrapper keeps the timer callback and argument behind the
+ // timer when the control block has room, older wrappers allocate them once
+ typedef struct
+ {
+   StaticTimer_t timer;
+   osTimerFunc_t func;
+   void* argument;
+ }rtosTimerCb_t;
+
+static struct
+{
+#define RTOS_THREAD_MEM(id, sName, words, priority) \
+  StaticTask_t id##_cb; \
+  StackType_t id##_stack[words] __attribute__((aligned(8)));
+  RTOS_THREAD_TABLE(RTOS_THREAD_MEM)
+#undef RTOS_THREAD_MEM
+}rtos_threads;
+
+static struct
+{
+#define RTOS_SEMAPHORE_MEM(id, sName)   StaticSemaphore_t id##_cb;
+  RTOS_SEMAPHORE_TABLE(RTOS_SEMAPHORE_MEM)
+#undef RTOS_SEMAPHORE_MEM
+}rtos_semaphores;
+
+static struct
+{
+#define RTOS_FLAGS_MEM(id, sName)   StaticEventGroup_t id##_cb;
+  RTOS_FLAGS_TABLE(RTOS_FLAGS_MEM)
+#undef RTOS_FLAGS_MEM
+}rtos_flags;
+
+static struct
+{
+#define RTOS_QUEUE_MEM(id, sName, count, size) \
+  StaticQueue_t id##_cb; \
+  uint8_t id##_buf[(count) * (size)] __attribute__((aligned(4)));
+  RTOS_QUEUE_TABLE(RTOS_QUEUE_MEM)
+#undef RTOS_QUEUE_MEM
+}rtos_queues;
+
+static struct
+{
+#define RTOS_TIMER_MEM(id, sName)   rtosTimerCb_t id##_cb;
+  RTOS_TIMER_TABLE(RTOS_TIMER_MEM)
+#undef RTOS_TIMER_MEM
+}rtos_timers;
+
+#define RTOS_STATIC_BYTES   (sizeof(rtos_threads) + sizeof(rtos_semaphores) + sizeof(rtos_flags) + \
+                             sizeof(rtos_queues) + sizeof(rtos_timers))
+
+_Static_assert(RTOS_STATIC_BYTES <= RTOS_STATIC_BUDGET, "RTOS objects exceed RTOS_STATIC_BUDGET");
+
+/* Exported constants --------------------------------------------------------*/
+const uint32_t rtos_staticBytes = RTOS_STATIC_BYTES;
+
+const osThreadAttr_t rtos_threadAttr[RTOS_THREAD_COUNT] = {
+#define RTOS_THREAD_ATTR(id, sName, words, prio) \
+  [id] = { .name = sName, \
+           .cb_mem = &rtos_threads.id##_cb, .cb_size = sizeof(StaticTask_t), \
+           .stack_mem = rtos_threads.id##_stack, .stack_size = sizeof(rtos_threads.id##_stack), \
+           .priority = (osPriority_t)(prio) },
+  RTOS_THREAD_TABLE(RTOS_THREAD_ATTR)
+#undef RTOS_THREAD_ATTR
+};
+
+const osSemaphoreAttr_t rtos_semaphoreAttr[RTOS_SEMAPHORE_COUNT] = {
+#define RTOS_SEMAPHORE_ATTR(id, sName) \
+  [id] = { .name = sName, .cb_mem = &rtos_semaphores.id##_cb, .cb_size = sizeof(StaticSemaphore_t) },
+  RTOS_SEMAPHORE_TABLE(RTOS_SEMAPHORE_ATTR)
+#undef RTOS_SEMAPHORE_ATTR
+};
+
+const osEventFlagsAttr_t rtos_flagsAttr[RTOS_FLAGS_COUNT] = {
+#define RTOS_FLAGS_ATTR(id, sName) \
+  [id] = { .name = sName, .cb_mem = &rtos_flags.id##_cb, .cb_size = sizeof(StaticEventGroup_t) },
+  RTOS_FLAGS_TABLE(RTOS_FLAGS_ATTR)
+#undef RTOS_FLAGS_ATTR
+};
+
+const osMessageQueueAttr_t rtos_queueAttr[RTOS_QUEUE_COUNT] = {
+#define RTOS_QUEUE_ATTR(id, sName, count, size) \
+  [id] = { .name = sName, .cb_mem = &rtos_queues.id##_cb, .cb_size = sizeof(StaticQueue_t), \
+           .mq_mem = rtos_queues.id##_buf, .mq_size = sizeof(rtos_queues.id##_buf) },
+  RTOS_QUEUE_TABLE(RTOS_QUEUE_ATTR)
+#undef RTOS_QUEUE_ATTR
+};
+
+const osTimerAttr_t rtos_timerAttr[RTOS_TIMER_COUNT] = {
+#define RTOS_TIMER_ATTR(id, sName) \
+  [id] = { .name = sName, .cb_mem = &rtos_timers.id##_cb, .cb_size = sizeof(rtosTimerCb_t) },
+  RTOS_TIMER_TABLE(RTOS_TIMER_ATTR)
+#undef RTOS_TIMER_ATTR
+};
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
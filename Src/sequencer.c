@@ -0,0 +1,246 @@
+/**
+  ******************************************************************************
+  * @file    sequencer.c
+  * @author  IBronx MDE team
+  * @brief   Actuator timeline sequencer
+  *          A timeline is a constant table of output and wait steps with
+  *          offsets in ms. Steps with the same offset fire together, so the
+  *          solenoids overlap wherever the pneumatics allow it. The sequencer
+  *          task runs at high priority and sleeps to the absolute due tick of
+  *          each step, a slow IO expander write never shifts the steps after
+  *          it. The outputs of one offset go to the expander cache and leave
+  *          in a single burst. A wait step polls its condition until the
+  *          timeout and starts a new time origin for the steps that follow.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sequencer.h"
+#include "cmsis_os.h"
+#include "errorcode.h"
+#include "ioexp_cache.h"
+#include "rtos_objects.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static osEventFlagsId_t seq_flags;
+static const seqTimeline_t* seq_timeline;
+static volatile bool seq_bBusy;
+static uint32_t seq_result;
+static seqStats_t seq_stats;
+/* Private function prototypes -----------------------------------------------*/
+static bool seq_IsValid(const seqTimeline_t* timeline);
+static uint32_t seq_Execute(const seqTimeline_t* timeline);
+/* function prototypes -------------------------------------------------------*/
+
+/**
+* @brief  Create the sequencer flags, called before the sequencer task starts
+* @param  None
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t seq_Init(void)
+{
+  seq_flags = osEventFlagsNew(&rtos_flagsAttr[RTOS_FLAGS_SEQUENCER]);
+  if (seq_flags == NULL)
+    return PER_ERROR_INIT;
+
+  memset(&seq_stats, 0, sizeof(seqStats_t));
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Hand a timeline to the sequencer task and return
+* @param  timeline:  Timeline, must stay valid until it has finished
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t seq_Start(const seqTimeline_t* timeline)
+{
+  if ((seq_flags == NULL) || !seq_IsValid(timeline))
+    return PER_ERROR_INIT;
+
+  // test and set with the scheduler locked, two tasks may start at once
+  osKernelLock();
+  bool bBusy = seq_bBusy;
+  seq_bBusy = true;
+  osKernelUnlock();
+
+  if (bBusy)
+    return PER_ERROR_SEQUENCE_BUSY;
+
+  seq_timeline = timeline;
+  osEventFlagsClear(seq_flags, SEQ_DONE_FLAG);
+  osEventFlagsSet(seq_flags, SEQ_START_FLAG);
+
+  return PER_NO_ERROR;
+}
+
+/**
+* @brief  Wait until the running timeline has finished
+* @param  timeout:  Timeout in ms or osWaitForever
+* @retval rc:  Result of the timeline, PER_ERROR_SEQUENCE_BUSY when it is still running
+*/
+uint32_t seq_Wait(uint32_t timeout)
+{
+  uint32_t flags = osEventFlagsWait(seq_flags, SEQ_DONE_FLAG, osFlagsWaitAny | osFlagsNoClear, timeout);
+
+  if ((flags & osFlagsError) || !(flags & SEQ_DONE_FLAG))
+    return PER_ERROR_SEQUENCE_BUSY;
+
+  return seq_result;
+}
+
+/**
+* @brief  Run a timeline to the end
+* @param  timeline:  Timeline
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+uint32_t seq_Run(const seqTimeline_t* timeline)
+{
+  uint32_t rc = seq_Start(timeline);
+
+  if (rc != PER_NO_ERROR)
+    return rc;
+
+  return seq_Wait(osWaitForever);
+}
+
+/**
+* @brief  Read the sequencer counters
+* @param  stats:  Destination of the counters
+* @retval None
+*/
+void seq_GetStats(seqStats_t* stats)
+{
+  *stats = seq_stats;
+}
+
+/**
+  * @brief  Function implementing the sequencerTask thread.
+  * @param  argument: Not used
+  * @retval None
+  */
+void StartSequencerTask(void *argument)
+{
+  for(;;)
+  {
+    osEventFlagsWait(seq_flags, SEQ_START_FLAG, osFlagsWaitAny, osWaitForever);
+
+    seq_result = seq_Execute(seq_timeline);
+
+    seq_bBusy = false;
+    osEventFlagsSet(seq_flags, SEQ_DONE_FLAG);
+  }
+}
+
+/**
+* @brief  Check the offsets do not go back in time within each segment
+* @param  timeline:  Timeline
+* @retval True when the timeline can be run
+*/
+static bool seq_IsValid(const seqTimeline_t* timeline)
+{
+  uint16_t last = 0;
+
+  if ((timeline == NULL) || (timeline->steps == NULL))
+    return false;
+
+  for (uint32_t idx = 0; idx < timeline->stepCount; idx++)
+  {
+    const seqStep_t* step = &timeline->steps[idx];
+
+    if (step->offsetMs < last)
+      return false;
+    last = (step->type == SEQ_STEP_WAIT) ? 0 : step->offsetMs;
+  }
+
+  return true;
+}
+
+/**
+* @brief  Execute the steps of a timeline, stop at the first failure
+* @param  timeline:  Timeline
+* @retval rc:  If pass then return PER_NO_ERROR, otherwise error code
+*/
+static uint32_t seq_Execute(const seqTimeline_t* timeline)
+{
+  uint32_t rc = PER_NO_ERROR;
+  uint32_t start = osKernelGetTickCount();
+  uint32_t origin = start;
+  uint32_t idx;
+
+  for (idx = 0; idx < timeline->stepCount; idx++)
+  {
+    const seqStep_t* step = &timeline->steps[idx];
+    uint32_t due = origin + step->offsetMs;
+
+    if ((int32_t)(due - osKernelGetTickCount()) > 0)
+      osDelayUntil(due);
+
+    uint32_t late = osKernelGetTickCount() - due;
+    if (late > seq_stats.maxLateMs)
+      seq_stats.maxLateMs = late;
+
+    if (step->type == SEQ_STEP_OUTPUT)
+    {
+      rc = ioexp_SetOutputPin(step->port, step->pin, step->value);
+
+      // the last output of this offset sends the whole group
+      const seqStep_t* next = step + 1;
+      if ((idx + 1 >= timeline->stepCount) || (next->type != SEQ_STEP_OUTPUT) || (next->offsetMs != step->offsetMs))
+        ioexp_Flush();
+    }
+    else
+    {
+      if (step->pfnCondition != NULL)
+      {
+        while (!step->pfnCondition())
+        {
+          if ((osKernelGetTickCount() - due) >= step->timeoutMs)
+          {
+            rc = PER_ERROR_SEQUENCE_TIMEOUT;
+            break;
+          }
+          osDelay(SEQ_POLL_MS);
+        }
+      }
+      origin = osKernelGetTickCount();
+    }
+
+    if (rc != PER_NO_ERROR)
+      break;
+  }
+
+  // the bursts run on after the last step, collect their result
+  if (rc == PER_NO_ERROR)
+  {
+    rc = ioexp_Sync(SEQ_SYNC_TIMEOUT_MS);
+    idx = SEQ_STEP_SYNC;
+  }
+
+  seq_stats.runs++;
+  seq_stats.lastDurationMs = osKernelGetTickCount() - start;
+  if (rc != PER_NO_ERROR)
+  {
+    seq_stats.failures++;
+    seq_stats.failedStep = (uint8_t)idx;
+  }
+
+  return rc;
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    SEGGER_SYSVIEW.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for SEGGER SystemView, the output is discarded and
+  *          the timestamp is a counter the tests can move
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_SEGGER_SYSVIEW_H_
+#define TESTS_STUBS_SEGGER_SYSVIEW_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+extern uint32_t host_cycles;
+extern volatile bool host_bClockTimestamp;      // ns of the host clock instead of host_cycles, for benchmarks
+uint32_t host_Timestamp(void);
+
+#define SEGGER_SYSVIEW_GET_TIMESTAMP()  (host_Timestamp())
+
+static inline void SEGGER_SYSVIEW_Print(const char* s) { (void)s; }
+static inline void SEGGER_SYSVIEW_Warn(const char* s) { (void)s; }
+static inline void SEGGER_SYSVIEW_Error(const char* s) { (void)s; }
+static inline void SEGGER_SYSVIEW_PrintfHost(const char* s, ...) { (void)s; }
+static inline void SEGGER_SYSVIEW_PrintfTarget(const char* s, ...) { (void)s; }
+static inline void SEGGER_SYSVIEW_WarnfHost(const char* s, ...) { (void)s; }
+static inline void SEGGER_SYSVIEW_ErrorfHost(const char* s, ...) { (void)s; }
+
+#endif /* TESTS_STUBS_SEGGER_SYSVIEW_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,157 @@
+/**
+  ******************************************************************************
+  * @file    cmsis_os.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for CMSIS-RTOS2, see host_os.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_CMSIS_OS_H_
+#define TESTS_STUBS_CMSIS_OS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef void* osThreadId_t;
+typedef void* osSemaphoreId_t;
+typedef void* osEventFlagsId_t;
+typedef void* osMessageQueueId_t;
+typedef void* osTimerId_t;
+
+typedef enum
+{
+  osOK = 0,
+  osError = -1,
+  osErrorTimeout = -2,
+  osErrorResource = -3,
+  osErrorParameter = -4,
+}osStatus_t;
+
+typedef enum
+{
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityNormal2 = 26,
+  osPriorityNormal3 = 27,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40,
+  osPriorityRealtime = 48,
+}osPriority_t;
+
+typedef enum
+{
+  osTimerOnce = 0,
+  osTimerPeriodic = 1,
+}osTimerType_t;
+
+typedef void (*osThreadFunc_t)(void* argument);
+typedef void (*osTimerFunc_t)(void* argument);
+
+typedef struct
+{
+  const char* name;
+  uint32_t attr_bits;
+  void* cb_mem;
+  uint32_t cb_size;
+  void* stack_mem;
+  uint32_t stack_size;
+  osPriority_t priority;
+}osThreadAttr_t;
+
+typedef struct
+{
+  const char* name;
+  uint32_t attr_bits;
+  void* cb_mem;
+  uint32_t cb_size;
+}osSemaphoreAttr_t, osEventFlagsAttr_t, osTimerAttr_t;
+
+typedef struct
+{
+  const char* name;
+  uint32_t attr_bits;
+  void* cb_mem;
+  uint32_t cb_size;
+  void* mq_mem;
+  uint32_t mq_size;
+}osMessageQueueAttr_t;
+
+#define osWaitForever           0xFFFFFFFFU
+#define osFlagsWaitAny          0x00000000U
+#define osFlagsNoClear          0x00000002U
+#define osFlagsError            0x80000000U
+
+// static control blocks of rtos_objects.c, sized only
+typedef struct { uint8_t dummy[92]; } StaticTask_t;
+typedef struct { uint8_t dummy[80]; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct { uint8_t dummy[32]; } StaticEventGroup_t;
+typedef struct { uint8_t dummy[44]; } StaticTimer_t;
+typedef uint32_t StackType_t;
+#define configSUPPORT_STATIC_ALLOCATION 1
+
+// FreeRTOS critical sections, nothing to mask on the single host thread
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+uint32_t osKernelGetTickCount(void);
+int32_t osKernelLock(void);
+int32_t osKernelUnlock(void);
+int32_t osKernelRestoreLock(int32_t lock);
+osStatus_t osDelay(uint32_t ticks);
+osStatus_t osDelayUntil(uint32_t ticks);
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr);
+osThreadId_t osThreadGetId(void);
+osStatus_t osThreadTerminate(osThreadId_t thread_id);
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags);
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout);
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t* attr);
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout);
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id);
+uint32_t osSemaphoreGetCount(osSemaphoreId_t semaphore_id);
+
+osEventFlagsId_t osEventFlagsNew(const osEventFlagsAttr_t* attr);
+uint32_t osEventFlagsSet(osEventFlagsId_t ef_id, uint32_t flags);
+uint32_t osEventFlagsClear(osEventFlagsId_t ef_id, uint32_t flags);
+uint32_t osEventFlagsGet(osEventFlagsId_t ef_id);
+uint32_t osEventFlagsWait(osEventFlagsId_t ef_id, uint32_t flags, uint32_t options, uint32_t timeout);
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t* attr);
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void* msg_ptr, uint8_t msg_prio, uint32_t timeout);
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void* msg_ptr, uint8_t* msg_prio, uint32_t timeout);
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id);
+
+osTimerId_t osTimerNew(osTimerFunc_t func, osTimerType_t type, void* argument, const osTimerAttr_t* attr);
+osStatus_t osTimerStart(osTimerId_t timer_id, uint32_t ticks);
+osStatus_t osTimerStop(osTimerId_t timer_id);
+uint32_t osTimerIsRunning(osTimerId_t timer_id);
+
+// test control of the host kernel
+extern uint32_t host_tick;
+extern void (*host_pfnQueueEmpty)(osMessageQueueId_t mq_id);
+extern void (*host_pfnThreadWait)(void);
+extern void (*host_pfnFlagsWait)(osEventFlagsId_t ef_id);
+osTimerId_t host_LastTimer(void);               // timers are private to their module
+void host_TimerFire(osTimerId_t timer_id);
+uint32_t host_ThreadFlags(void);
+
+#endif /* TESTS_STUBS_CMSIS_OS_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
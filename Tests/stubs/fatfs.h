@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file    fatfs.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for FatFs and the SD card BSP, see host_fatfs.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_FATFS_H_
+#define TESTS_STUBS_FATFS_H_
+
+#include <stdint.h>
+
+typedef enum
+{
+  FR_OK = 0,
+  FR_DISK_ERR,
+  FR_INT_ERR,
+  FR_NOT_READY,
+  FR_NO_FILE,
+  FR_NO_PATH,
+  FR_INVALID_NAME,
+  FR_DENIED,
+  FR_EXIST,
+}FRESULT;
+
+typedef uint32_t FSIZE_t;
+typedef char TCHAR;
+typedef unsigned int UINT;
+
+typedef struct
+{
+  int file;                                 // index in the host file table
+  FSIZE_t fptr;
+  uint8_t flag;                             // FA_MODIFIED once written, until the next sync
+}FIL;
+
+typedef struct
+{
+  int dummy;
+}FATFS;
+
+#define FA_READ                 0x01
+#define FA_WRITE                0x02
+#define FA_OPEN_EXISTING        0x00
+#define FA_CREATE_NEW           0x04
+#define FA_CREATE_ALWAYS        0x08
+#define FA_OPEN_ALWAYS          0x10
+#define FA_OPEN_APPEND          0x30
+#define FA_MODIFIED             0x40
+
+#define SD_PRESENT              1
+#define SD_NOT_PRESENT          0
+
+extern FATFS SDFatFS;
+extern char SDPath[4];
+extern FIL SDFile;
+
+FRESULT f_mount(FATFS* fs, const TCHAR* path, uint8_t opt);
+FRESULT f_mkdir(const TCHAR* path);
+FRESULT f_open(FIL* fp, const TCHAR* path, uint8_t mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_sync(FIL* fp);
+FRESULT f_unlink(const TCHAR* path);
+FSIZE_t host_FileSize(const FIL* fp);
+uint8_t BSP_SD_IsDetected(void);
+
+#define f_size(fp)              host_FileSize(fp)
+#define f_tell(fp)              ((fp)->fptr)
+
+// test access to the card
+void host_FsReset(void);
+const uint8_t* host_FsData(const char* path, uint32_t* pSize);
+extern uint32_t host_fsWrites;              // f_write calls
+extern uint32_t host_fsUnaligned;           // f_write calls not starting on a 512 byte boundary
+extern uint32_t host_fsCalls;               // f_open, f_write, f_sync and f_close calls
+extern uint32_t host_fsBytes;               // bytes passed to f_write
+extern uint32_t host_fsSectors;             // data sectors programmed, a partial one is rewritten whole
+extern uint32_t host_fsDirUpdates;          // directory entries written by a sync or close after a write
+
+#endif /* TESTS_STUBS_FATFS_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file    host_device.c
+  * @author  IBronx MDE team
+  * @brief   Objects of the generated application files used by the logger
+  *          The USB CDC device is configured and collects every transmitted
+  *          byte in host_usbTx.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "cmsis_os.h"
+#include "usbd_cdc_if.h"
+
+#include <string.h>
+/* Private variables ---------------------------------------------------------*/
+USBD_HandleTypeDef hUsbDeviceFS = { .dev_state = USBD_STATE_CONFIGURED };
+uint8_t host_usbTx[16384];
+uint32_t host_usbTxLen;
+osThreadId_t loggerTaskHandle;
+osEventFlagsId_t osFlag_Main;
+/* function prototypes -------------------------------------------------------*/
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
+{
+  if ((host_usbTxLen + Len) > sizeof(host_usbTx))
+    return USBD_FAIL;
+
+  memcpy(&host_usbTx[host_usbTxLen], Buf, Len);
+  host_usbTxLen += Len;
+  return USBD_OK;
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,232 @@
+/**
+  ******************************************************************************
+  * @file    host_fatfs.c
+  * @author  IBronx MDE team
+  * @brief   In-memory FatFs behind the SD card writer
+  *          Files live in a fixed table of growable buffers, names are the
+  *          full paths. Directories are accepted and not tracked.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fatfs.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define HOST_MAX_FILES          256
+#define HOST_PATH_LEN           32
+/* Private variables ---------------------------------------------------------*/
+ typedef struct
+ {
+   char path[HOST_PATH_LEN];
+   uint8_t* data;
+   uint32_t size;
+   uint32_t capacity;
+   bool bUsed;
+ }hostFile_t;
+
+static hostFile_t host_files[HOST_MAX_FILES];
+
+FATFS SDFatFS;
+char SDPath[4] = "0:/";
+FIL SDFile;
+uint32_t host_fsWrites;
+uint32_t host_fsUnaligned;
+uint32_t host_fsCalls;
+uint32_t host_fsBytes;
+uint32_t host_fsSectors;
+uint32_t host_fsDirUpdates;
+/* function prototypes -------------------------------------------------------*/
+
+static int host_FsFind(const char* path)
+{
+  for (int idx = 0; idx < HOST_MAX_FILES; idx++)
+  {
+    if (host_files[idx].bUsed && (strcmp(host_files[idx].path, path) == 0))
+      return idx;
+  }
+  return -1;
+}
+
+static int host_FsCreate(const char* path)
+{
+  for (int idx = 0; idx < HOST_MAX_FILES; idx++)
+  {
+    if (!host_files[idx].bUsed)
+    {
+      memset(&host_files[idx], 0, sizeof(hostFile_t));
+      strncpy(host_files[idx].path, path, HOST_PATH_LEN - 1);
+      host_files[idx].bUsed = true;
+      return idx;
+    }
+  }
+  return -1;
+}
+
+void host_FsReset(void)
+{
+  for (int idx = 0; idx < HOST_MAX_FILES; idx++)
+  {
+    free(host_files[idx].data);
+    memset(&host_files[idx], 0, sizeof(hostFile_t));
+  }
+  host_fsWrites = 0;
+  host_fsUnaligned = 0;
+  host_fsCalls = 0;
+  host_fsBytes = 0;
+  host_fsSectors = 0;
+  host_fsDirUpdates = 0;
+}
+
+const uint8_t* host_FsData(const char* path, uint32_t* pSize)
+{
+  int file = host_FsFind(path);
+  if (file < 0)
+    return NULL;
+
+  *pSize = host_files[file].size;
+  return host_files[file].data;
+}
+
+uint8_t BSP_SD_IsDetected(void)
+{
+  return SD_PRESENT;
+}
+
+FRESULT f_mount(FATFS* fs, const TCHAR* path, uint8_t opt)
+{
+  (void)fs;
+  (void)path;
+  (void)opt;
+  return FR_OK;
+}
+
+FRESULT f_mkdir(const TCHAR* path)
+{
+  (void)path;
+  return FR_EXIST;
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, uint8_t mode)
+{
+  int file = host_FsFind(path);
+
+  host_fsCalls++;
+  if ((file < 0) && (mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS | FA_OPEN_ALWAYS)))
+    file = host_FsCreate(path);
+  else if ((file >= 0) && (mode & FA_CREATE_NEW))
+    return FR_EXIST;
+  if (file < 0)
+    return FR_NO_FILE;
+
+  if (mode & FA_CREATE_ALWAYS)
+    host_files[file].size = 0;
+
+  fp->file = file;
+  fp->flag = 0;
+  fp->fptr = ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) ? host_files[file].size : 0;
+  return FR_OK;
+}
+
+// the directory entry is updated when the file was written since the last sync
+static void host_FsSync(FIL* fp)
+{
+  host_fsCalls++;
+  if (fp->flag & FA_MODIFIED)
+    host_fsDirUpdates++;
+  fp->flag &= (uint8_t)~FA_MODIFIED;
+}
+
+FRESULT f_close(FIL* fp)
+{
+  host_FsSync(fp);
+  fp->file = -1;
+  return FR_OK;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br)
+{
+  hostFile_t* file = &host_files[fp->file];
+  uint32_t avail = (fp->fptr < file->size) ? (file->size - fp->fptr) : 0;
+
+  *br = (btr < avail) ? btr : avail;
+  memcpy(buff, &file->data[fp->fptr], *br);
+  fp->fptr += *br;
+  return FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+  hostFile_t* file = &host_files[fp->file];
+  uint32_t end = fp->fptr + btw;
+
+  host_fsCalls++;
+  host_fsWrites++;
+  if ((fp->fptr % 512U) != 0)
+    host_fsUnaligned++;
+  if (btw > 0)
+  {
+    host_fsBytes += btw;
+    host_fsSectors += ((end + 511U) / 512U) - (fp->fptr / 512U);
+    fp->flag |= FA_MODIFIED;
+  }
+
+  if (end > file->capacity)
+  {
+    file->capacity = (end + 4095U) & ~4095U;
+    file->data = realloc(file->data, file->capacity);
+  }
+  if (fp->fptr > file->size)
+    memset(&file->data[file->size], 0, fp->fptr - file->size);
+
+  memcpy(&file->data[fp->fptr], buff, btw);
+  fp->fptr = end;
+  if (end > file->size)
+    file->size = end;
+  *bw = btw;
+  return FR_OK;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs)
+{
+  fp->fptr = ofs;
+  return FR_OK;
+}
+
+FRESULT f_sync(FIL* fp)
+{
+  host_FsSync(fp);
+  return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR* path)
+{
+  int file = host_FsFind(path);
+  if (file < 0)
+    return FR_NO_FILE;
+
+  free(host_files[file].data);
+  memset(&host_files[file], 0, sizeof(hostFile_t));
+  return FR_OK;
+}
+
+FSIZE_t host_FileSize(const FIL* fp)
+{
+  return host_files[fp->file].size;
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
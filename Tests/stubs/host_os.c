@@ -0,0 +1,356 @@
+/**
+  ******************************************************************************
+  * @file    host_os.c
+  * @author  IBronx MDE team
+  * @brief   Single threaded host kernel behind the CMSIS-RTOS2 calls
+  *          Calls never block: an empty queue or semaphore fails at once and
+  *          time only moves when a test sets host_tick. Timers run when the
+  *          test fires them. host_pfnQueueEmpty, host_pfnThreadWait and
+  *          host_pfnFlagsWait let a test leave a task loop that waits on an
+  *          empty queue, a thread flag or an event flag.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "cmsis_os.h"
+#include "stm32f4xx_hal.h"
+#include "rtos_objects.h"
+#include "SEGGER_SYSVIEW.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+/* Private define ------------------------------------------------------------*/
+#define HOST_MAX_OBJECTS        32
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+ typedef struct
+ {
+   uint32_t msgCount;
+   uint32_t msgSize;
+   uint32_t head;
+   uint32_t count;
+   uint8_t* buf;
+ }hostQueue_t;
+
+ typedef struct
+ {
+   osTimerFunc_t func;
+   void* argument;
+   osTimerType_t type;
+   bool bRunning;
+ }hostTimer_t;
+
+static hostQueue_t host_queues[HOST_MAX_OBJECTS];
+static uint32_t host_queueCount;
+static uint32_t host_semaphores[HOST_MAX_OBJECTS];
+static uint32_t host_semaphoreCount;
+static uint32_t host_flags[HOST_MAX_OBJECTS];
+static uint32_t host_flagsCount;
+static hostTimer_t host_timers[HOST_MAX_OBJECTS];
+static uint32_t host_timerCount;
+static uint32_t host_threadFlags;
+static int host_thread;
+
+uint32_t host_tick;
+uint32_t host_cycles;
+volatile bool host_bClockTimestamp;
+uint32_t host_ipsr;
+uint32_t SystemCoreClock = 168000000U;
+GPIO_TypeDef host_gpioc;
+void (*host_pfnQueueEmpty)(osMessageQueueId_t mq_id);
+void (*host_pfnThreadWait)(void);
+void (*host_pfnFlagsWait)(osEventFlagsId_t ef_id);
+
+// the registry attributes only carry static memory, unused on the host
+const osThreadAttr_t rtos_threadAttr[RTOS_THREAD_COUNT];
+const osSemaphoreAttr_t rtos_semaphoreAttr[RTOS_SEMAPHORE_COUNT];
+const osEventFlagsAttr_t rtos_flagsAttr[RTOS_FLAGS_COUNT];
+const osMessageQueueAttr_t rtos_queueAttr[RTOS_QUEUE_COUNT];
+const osTimerAttr_t rtos_timerAttr[RTOS_TIMER_COUNT];
+const uint32_t rtos_staticBytes;
+/* function prototypes -------------------------------------------------------*/
+
+uint32_t host_Timestamp(void)
+{
+  if (!host_bClockTimestamp)
+    return host_cycles;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec);
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+  return host_tick;
+}
+
+int32_t osKernelLock(void)
+{
+  return 0;
+}
+
+int32_t osKernelUnlock(void)
+{
+  return 0;
+}
+
+int32_t osKernelRestoreLock(int32_t lock)
+{
+  return lock;
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+  host_tick += ticks;
+  return osOK;
+}
+
+osStatus_t osDelayUntil(uint32_t ticks)
+{
+  if ((int32_t)(ticks - host_tick) > 0)
+    host_tick = ticks;
+  return osOK;
+}
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr)
+{
+  (void)func;
+  (void)argument;
+  (void)attr;
+  return &host_thread;
+}
+
+osThreadId_t osThreadGetId(void)
+{
+  return &host_thread;
+}
+
+osStatus_t osThreadTerminate(osThreadId_t thread_id)
+{
+  (void)thread_id;
+  return osOK;
+}
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags)
+{
+  (void)thread_id;
+  host_threadFlags |= flags;
+  return host_threadFlags;
+}
+
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout)
+{
+  (void)options;
+  (void)timeout;
+  if (host_pfnThreadWait != NULL)
+    host_pfnThreadWait();
+  uint32_t set = host_threadFlags & flags;
+  host_threadFlags &= ~flags;
+  return (set != 0) ? set : (uint32_t)osErrorTimeout;
+}
+
+uint32_t host_ThreadFlags(void)
+{
+  return host_threadFlags;
+}
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t* attr)
+{
+  (void)max_count;
+  (void)attr;
+  if (host_semaphoreCount >= HOST_MAX_OBJECTS)
+    return NULL;
+  host_semaphores[host_semaphoreCount] = initial_count;
+  return &host_semaphores[host_semaphoreCount++];
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout)
+{
+  uint32_t* count = semaphore_id;
+  (void)timeout;
+  if (*count == 0)
+    return osErrorResource;
+  (*count)--;
+  return osOK;
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id)
+{
+  (*(uint32_t*)semaphore_id)++;
+  return osOK;
+}
+
+uint32_t osSemaphoreGetCount(osSemaphoreId_t semaphore_id)
+{
+  return *(uint32_t*)semaphore_id;
+}
+
+osEventFlagsId_t osEventFlagsNew(const osEventFlagsAttr_t* attr)
+{
+  (void)attr;
+  if (host_flagsCount >= HOST_MAX_OBJECTS)
+    return NULL;
+  return &host_flags[host_flagsCount++];
+}
+
+uint32_t osEventFlagsSet(osEventFlagsId_t ef_id, uint32_t flags)
+{
+  return (*(uint32_t*)ef_id |= flags);
+}
+
+uint32_t osEventFlagsClear(osEventFlagsId_t ef_id, uint32_t flags)
+{
+  uint32_t old = *(uint32_t*)ef_id;
+  *(uint32_t*)ef_id &= ~flags;
+  return old;
+}
+
+uint32_t osEventFlagsGet(osEventFlagsId_t ef_id)
+{
+  return (ef_id != NULL) ? *(uint32_t*)ef_id : 0;
+}
+
+uint32_t osEventFlagsWait(osEventFlagsId_t ef_id, uint32_t flags, uint32_t options, uint32_t timeout)
+{
+  (void)timeout;
+  if (((*(uint32_t*)ef_id & flags) == 0) && (host_pfnFlagsWait != NULL))
+    host_pfnFlagsWait(ef_id);
+  uint32_t set = *(uint32_t*)ef_id & flags;
+  if (set == 0)
+    return (uint32_t)osErrorTimeout;
+  if (!(options & osFlagsNoClear))
+    *(uint32_t*)ef_id &= ~set;
+  return set;
+}
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t* attr)
+{
+  (void)attr;
+  if (host_queueCount >= HOST_MAX_OBJECTS)
+    return NULL;
+  hostQueue_t* q = &host_queues[host_queueCount++];
+  q->msgCount = msg_count;
+  q->msgSize = msg_size;
+  q->head = 0;
+  q->count = 0;
+  q->buf = calloc(msg_count, msg_size);
+  return q;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void* msg_ptr, uint8_t msg_prio, uint32_t timeout)
+{
+  hostQueue_t* q = mq_id;
+  (void)msg_prio;
+  (void)timeout;
+  if (q->count >= q->msgCount)
+    return osErrorResource;
+  memcpy(&q->buf[((q->head + q->count) % q->msgCount) * q->msgSize], msg_ptr, q->msgSize);
+  q->count++;
+  return osOK;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void* msg_ptr, uint8_t* msg_prio, uint32_t timeout)
+{
+  hostQueue_t* q = mq_id;
+  (void)msg_prio;
+  (void)timeout;
+  if ((q->count == 0) && (host_pfnQueueEmpty != NULL))
+    host_pfnQueueEmpty(mq_id);
+  if (q->count == 0)
+    return osErrorResource;
+  memcpy(msg_ptr, &q->buf[q->head * q->msgSize], q->msgSize);
+  q->head = (q->head + 1) % q->msgCount;
+  q->count--;
+  return osOK;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id)
+{
+  return ((hostQueue_t*)mq_id)->count;
+}
+
+osTimerId_t osTimerNew(osTimerFunc_t func, osTimerType_t type, void* argument, const osTimerAttr_t* attr)
+{
+  (void)attr;
+  if (host_timerCount >= HOST_MAX_OBJECTS)
+    return NULL;
+  hostTimer_t* timer = &host_timers[host_timerCount++];
+  timer->func = func;
+  timer->argument = argument;
+  timer->type = type;
+  timer->bRunning = false;
+  return timer;
+}
+
+osStatus_t osTimerStart(osTimerId_t timer_id, uint32_t ticks)
+{
+  (void)ticks;
+  ((hostTimer_t*)timer_id)->bRunning = true;
+  return osOK;
+}
+
+osStatus_t osTimerStop(osTimerId_t timer_id)
+{
+  ((hostTimer_t*)timer_id)->bRunning = false;
+  return osOK;
+}
+
+uint32_t osTimerIsRunning(osTimerId_t timer_id)
+{
+  return ((hostTimer_t*)timer_id)->bRunning ? 1U : 0U;
+}
+
+osTimerId_t host_LastTimer(void)
+{
+  return (host_timerCount == 0) ? NULL : &host_timers[host_timerCount - 1];
+}
+
+void host_TimerFire(osTimerId_t timer_id)
+{
+  hostTimer_t* timer = timer_id;
+  // a one-shot timer has expired when its callback runs, the callback may start it again
+  if (timer->type == osTimerOnce)
+    timer->bRunning = false;
+  timer->func(timer->argument);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+  (void)TypeProgram;
+  (void)Address;
+  (void)Data;
+  return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError)
+{
+  (void)pEraseInit;
+  (void)SectorError;
+  return HAL_ERROR;
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
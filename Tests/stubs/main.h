@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    main.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for the CubeMX pin definitions
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_MAIN_H_
+#define TESTS_STUBS_MAIN_H_
+
+#include "stm32f4xx_hal.h"
+
+extern GPIO_TypeDef host_gpioc;
+
+#define RGBLED_Pin              GPIO_PIN_8
+#define RGBLED_GPIO_Port        (&host_gpioc)
+#define START_BTN_Pin           GPIO_PIN_13
+#define START_BTN_GPIO_Port     (&host_gpioc)
+#define IOEXP_INT_Pin           GPIO_PIN_0
+#define IOEXP_INT_GPIO_Port     (&host_gpioc)
+
+#endif /* TESTS_STUBS_MAIN_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
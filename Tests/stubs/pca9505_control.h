@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file    pca9505_control.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for the PCA9505 IO expander driver
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_PCA9505_CONTROL_H_
+#define TESTS_STUBS_PCA9505_CONTROL_H_
+
+#include <stdint.h>
+
+// solenoid outputs of the expander, port, pin and default state
+#define SOLENOID_ROTARY_PORT      0
+#define SOLENOID_ROTARY_PIN       0
+#define SOLENOID_ROTARY_BACKWARD  0
+#define SOLENOID_VACUUM_PORT      0
+#define SOLENOID_VACUUM_PIN       1
+#define SOLENOID_VACUUM_OFF       0
+#define SOLENOID_DISPATCH_PORT    0
+#define SOLENOID_DISPATCH_PIN     2
+#define SOLENOID_DISPATCH_OFF     0
+#define SOLENOID_FEEDER_PORT      0
+#define SOLENOID_FEEDER_PIN       3
+#define SOLENOID_FEEDER_UP        1
+
+// sets MAIN_IO_EXPANDER_FLAG when the expander answers, defined by the test
+void IO_Expander_Init(void);
+
+#endif /* TESTS_STUBS_PCA9505_CONTROL_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,32 @@
+/**
+  ******************************************************************************
+  * @file    screw_controller.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for the screw controller task
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_SCREW_CONTROLLER_H_
+#define TESTS_STUBS_SCREW_CONTROLLER_H_
+
+#define HAYASHI_OPERATION_START_FLAG  0x00000001U
+#define HAYASHI_OPERATION_STOP_FLAG   0x00000002U
+
+void StartScrewCtrlTask(void* argument);
+
+#endif /* TESTS_STUBS_SCREW_CONTROLLER_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,223 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for the STM32F4 HAL, only what the tested modules
+  *          use. The FLASH calls fail, the tests give the log store a RAM
+  *          device instead.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_STM32F4XX_HAL_H_
+#define TESTS_STUBS_STM32F4XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+  HAL_OK = 0,
+  HAL_ERROR,
+  HAL_BUSY,
+  HAL_TIMEOUT,
+}HAL_StatusTypeDef;
+
+typedef struct
+{
+  volatile uint32_t IDR;
+  volatile uint32_t ODR;
+  volatile uint32_t BSRR;
+}GPIO_TypeDef;
+
+typedef struct
+{
+  volatile uint32_t CR;
+  volatile uint32_t NDTR;
+}DMA_Stream_TypeDef;
+
+typedef struct
+{
+  uint32_t Mode;
+  uint32_t PeriphDataAlignment;
+  uint32_t MemDataAlignment;
+}DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+  DMA_Stream_TypeDef* Instance;
+  DMA_InitTypeDef Init;
+  void (*pfnCallback[2])(struct __DMA_HandleTypeDef* hdma);
+}DMA_HandleTypeDef;
+
+typedef enum
+{
+  HAL_DMA_XFER_CPLT_CB_ID = 0,
+  HAL_DMA_XFER_HALFCPLT_CB_ID,
+}HAL_DMA_CallbackIDTypeDef;
+
+typedef struct
+{
+  volatile uint32_t CR1;
+  volatile uint32_t DIER;
+  volatile uint32_t SR;
+  volatile uint32_t CNT;
+  volatile uint32_t ARR;
+  volatile uint32_t CCR1;
+}TIM_TypeDef;
+
+typedef struct
+{
+  TIM_TypeDef* Instance;
+}TIM_HandleTypeDef;
+
+#define DMA_SxCR_EN             0x00000001U
+#define DMA_CIRCULAR            0x00000100U
+#define TIM_CR1_CEN             0x00000001U
+#define TIM_FLAG_UPDATE         0x00000001U
+#define TIM_FLAG_CC1            0x00000002U
+#define TIM_FLAG_CC2            0x00000004U
+#define TIM_FLAG_CC3            0x00000008U
+#define TIM_FLAG_CC4            0x00000010U
+#define TIM_DMA_UPDATE          0x00000100U
+#define TIM_DMA_CC1             0x00000200U
+#define TIM_DMA_CC3             0x00000800U
+
+// the registers only hold what the driver wrote, the DMA runs when the test completes it
+#define __HAL_DMA_ENABLE(h)               ((h)->Instance->CR |= DMA_SxCR_EN)
+#define __HAL_DMA_DISABLE(h)              ((h)->Instance->CR &= ~DMA_SxCR_EN)
+#define __HAL_DMA_GET_TC_FLAG_INDEX(h)    0x20U
+#define __HAL_DMA_GET_HT_FLAG_INDEX(h)    0x10U
+#define __HAL_DMA_GET_TE_FLAG_INDEX(h)    0x08U
+#define __HAL_DMA_CLEAR_FLAG(h, flag)     ((void)(h), (void)(flag))
+#define __HAL_TIM_ENABLE(h)               ((h)->Instance->CR1 |= TIM_CR1_CEN)
+#define __HAL_TIM_ENABLE_DMA(h, dma)      ((h)->Instance->DIER |= (dma))
+#define __HAL_TIM_DISABLE_DMA(h, dma)     ((h)->Instance->DIER &= ~(dma))
+#define __HAL_TIM_CLEAR_FLAG(h, flag)     ((h)->Instance->SR &= ~(flag))
+
+typedef enum
+{
+  GPIO_PIN_RESET = 0,
+  GPIO_PIN_SET,
+}GPIO_PinState;
+
+typedef struct __I2C_HandleTypeDef
+{
+  void* Instance;
+  void (*pfnCallback[3])(struct __I2C_HandleTypeDef* hi2c);
+}I2C_HandleTypeDef;
+
+typedef enum
+{
+  HAL_I2C_MEM_TX_COMPLETE_CB_ID = 0,
+  HAL_I2C_MEM_RX_COMPLETE_CB_ID,
+  HAL_I2C_ERROR_CB_ID,
+}HAL_I2C_CallbackIDTypeDef;
+
+typedef void (*pI2C_CallbackTypeDef)(I2C_HandleTypeDef* hi2c);
+
+#define I2C_MEMADD_SIZE_8BIT    0x00000001U
+
+typedef enum
+{
+  EXTI9_5_IRQn = 23,
+  EXTI15_10_IRQn = 40,
+}IRQn_Type;
+
+#define GPIO_PIN_0              0x0001U
+#define GPIO_PIN_8              0x0100U
+#define GPIO_PIN_13             0x2000U
+
+typedef struct
+{
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t Sector;
+  uint32_t NbSectors;
+  uint32_t VoltageRange;
+}FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_SECTORS 0U
+#define FLASH_VOLTAGE_RANGE_3   2U
+#define FLASH_TYPEPROGRAM_WORD  2U
+#define FLASH_SECTOR_8          8U
+#define FLASH_SECTOR_9          9U
+#define FLASH_SECTOR_10         10U
+#define FLASH_SECTOR_11         11U
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError);
+
+// the I2C transfers are defined by the test that simulates the device
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                   uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                    uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                       uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                        uint8_t* pData, uint16_t Size);
+
+// the DMA starts are defined by the test that follows the transfers
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+
+static inline HAL_StatusTypeDef HAL_DMA_RegisterCallback(DMA_HandleTypeDef* hdma, HAL_DMA_CallbackIDTypeDef CallbackID,
+                                                         void (*pCallback)(DMA_HandleTypeDef* hdma))
+{
+  hdma->pfnCallback[CallbackID] = pCallback;
+  return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim)
+{
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_I2C_RegisterCallback(I2C_HandleTypeDef* hi2c, HAL_I2C_CallbackIDTypeDef CallbackID,
+                                                         pI2C_CallbackTypeDef pCallback)
+{
+  hi2c->pfnCallback[CallbackID] = pCallback;
+  return HAL_OK;
+}
+
+static inline GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+  return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+// no interrupt controller, the tests call the handlers
+static inline void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {}
+static inline void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {}
+
+// a single host thread stands in for the tasks, masking is a no-op
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void)priMask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline void __DMB(void) { __sync_synchronize(); }
+
+// task context unless a test sets host_ipsr around a handler call
+extern uint32_t host_ipsr;
+static inline uint32_t __get_IPSR(void) { return host_ipsr; }
+
+extern uint32_t SystemCoreClock;
+
+#endif /* TESTS_STUBS_STM32F4XX_HAL_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
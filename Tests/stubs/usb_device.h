@@ -0,0 +1,29 @@
+/**
+  ******************************************************************************
+  * @file    usb_device.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for the USB device init
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_USB_DEVICE_H_
+#define TESTS_STUBS_USB_DEVICE_H_
+
+void MX_USB_DEVICE_Init(void);
+
+#endif /* TESTS_STUBS_USB_DEVICE_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
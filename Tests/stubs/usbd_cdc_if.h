@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_if.h
+  * @author  IBronx MDE team
+  * @brief   Host stand-in for the USB CDC device, see host_device.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_STUBS_USBD_CDC_IF_H_
+#define TESTS_STUBS_USBD_CDC_IF_H_
+
+#include <stdint.h>
+
+#define USBD_OK                 0
+#define USBD_BUSY               1
+#define USBD_FAIL               3
+#define USBD_STATE_CONFIGURED   3
+
+typedef struct
+{
+  uint8_t dev_state;
+  void* pClassData;
+}USBD_HandleTypeDef;
+
+typedef struct
+{
+  volatile uint32_t TxState;
+}USBD_CDC_HandleTypeDef;
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
+
+// test access to the transmitted data
+extern uint8_t host_usbTx[16384];
+extern uint32_t host_usbTxLen;
+
+#endif /* TESTS_STUBS_USBD_CDC_IF_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
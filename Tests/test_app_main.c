@@ -0,0 +1,336 @@
+/**
+  ******************************************************************************
+  * @file    test_app_main.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the event driven main task
+  *          StartMainTask runs once, every time it waits on its empty event
+  *          queue the next step of the script drives the button and timers.
+  *          The drivers and sub tasks of the board are replaced by fakes.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "SEGGER_SYSVIEW.h"      // comes with FreeRTOSConfig.h on the target
+#include "../Src/app_main.c"
+#include "test_common.h"
+
+#include <setjmp.h>
+#include <string.h>
+/* Private variables ---------------------------------------------------------*/
+volatile loggerLevel_t logger_runtimeLevel = LOGGER_LEVEL_INFO;
+
+static jmp_buf test_mainExit;
+static osTimerId_t test_debounceTimer;
+static msgbusSubscriber_t test_subscriber = {
+  .name = "TEST",
+  .topics = MSGBUS_TOPIC(MSGBUS_FAULT),
+};
+static uint32_t test_step;
+static uint32_t test_seqRuns;
+static uint32_t test_seqRc = PER_NO_ERROR;
+static uint32_t test_seqTick;
+
+// latency of the scripted presses, new event queue against the old 200 ms poll
+#define TEST_PRESSES            20
+#define TEST_POLL_MS            200
+#define TEST_BOUNCE_MS          5
+
+static uint32_t test_press;
+static uint32_t test_pressTick;
+static bool test_bPressPosted;
+static bool test_bReleased;
+static bool test_bOperation;
+static uint32_t test_eventTotal;
+static uint32_t test_eventMax;
+static uint32_t test_pollTotal;
+static uint32_t test_pollMax;
+/* function prototypes -------------------------------------------------------*/
+
+void IO_Expander_Init(void)
+{
+  osEventFlagsSet(osFlag_Main, MAIN_IO_EXPANDER_FLAG);
+}
+
+uint32_t ioexp_Init(void)
+{
+  return PER_NO_ERROR;
+}
+
+uint32_t ioexp_SetOutputPin(uint8_t port, uint8_t pin, uint8_t state)
+{
+  return PER_NO_ERROR;
+}
+
+void ioexp_Flush(void)
+{
+}
+
+void ioexp_Capture(void)
+{
+}
+
+void ioexp_InterruptHandler(void)
+{
+}
+
+uint32_t seq_Init(void)
+{
+  return PER_NO_ERROR;
+}
+
+uint32_t seq_Run(const seqTimeline_t* timeline)
+{
+  test_seqRuns++;
+  test_seqTick = host_tick;
+  return test_seqRc;
+}
+
+void seq_GetStats(seqStats_t* stats)
+{
+  memset(stats, 0, sizeof(seqStats_t));
+}
+
+void logger_Init(void)
+{
+}
+
+void logger_LogMsg(loggerMsgId_t msgId, uint32_t nArgs, ...)
+{
+}
+
+void MX_USB_DEVICE_Init(void)
+{
+}
+
+void StartFeederTask(void* argument)
+{
+}
+
+void StartScrewCtrlTask(void* argument)
+{
+}
+
+void StartSequencerTask(void* argument)
+{
+}
+
+void StartLoggerTask(void* argument)
+{
+}
+
+// debounce samples of the start button, 2 ms apart
+static void test_Button(bool bPressed, uint32_t samples)
+{
+  host_gpioc.IDR = bPressed ? 0 : START_BTN_Pin;
+  for (uint32_t idx = 0; idx < samples; idx++)
+  {
+    host_tick += DEBOUNCE_SAMPLE_MS;
+    host_TimerFire(test_debounceTimer);
+  }
+}
+
+// contact closed at dt ms after the press, it bounces open twice in the first 5 ms
+static bool test_Contact(int32_t dt)
+{
+  return (dt >= 0) && !((dt == 1) || (dt == 4));
+}
+
+// the old main task polled the pin every 200 ms and acted on the first closed sample
+static uint32_t test_PollLatency(uint32_t pressTick)
+{
+  uint32_t poll = (pressTick + TEST_POLL_MS - 1) / TEST_POLL_MS * TEST_POLL_MS;
+  while (!test_Contact((int32_t)(poll - pressTick)))
+    poll += TEST_POLL_MS;
+  return poll - pressTick;
+}
+
+// one press of the latency script, every call is one step of the main task
+static bool test_Press(void)
+{
+  if (test_bPressPosted)
+  {
+    // handled when the main task reached its empty queue, at the tick of the post
+    uint32_t latency = host_tick - test_pressTick;
+    TEST_EQUAL(!!(osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG), !test_bOperation);
+    if (!test_bOperation)
+      TEST_EQUAL(test_seqTick, host_tick);
+    test_eventTotal += latency;
+    if (latency > test_eventMax)
+      test_eventMax = latency;
+
+    latency = test_PollLatency(test_pressTick);
+    test_pollTotal += latency;
+    if (latency > test_pollMax)
+      test_pollMax = latency;
+
+    test_bPressPosted = false;
+    test_press++;
+  }
+  if (!test_bReleased)
+  {
+    if (test_press == TEST_PRESSES)
+      return false;
+
+    // release and unlock, the next step presses again
+    test_Button(false, 10);
+    host_TimerFire(main_buttonTimer);
+    test_bReleased = true;
+    return true;
+  }
+
+  // the press lands at a new phase of the old 200 ms poll, 10 ms apart
+  test_seqRc = PER_NO_ERROR;
+  test_seqTick = 0;
+  test_bOperation = !!(osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG);
+  test_pressTick = (host_tick / TEST_POLL_MS + 1) * TEST_POLL_MS + test_press * 10;
+  while (host_tick < test_pressTick)
+    test_Button(false, 1);
+
+  for (uint32_t idx = 0; (idx < 100) && (osMessageQueueGetCount(main_eventQueue) == 0); idx++)
+  {
+    host_gpioc.IDR = test_Contact((int32_t)(host_tick - test_pressTick)) ? 0 : START_BTN_Pin;
+    host_tick += DEBOUNCE_SAMPLE_MS;
+    host_TimerFire(test_debounceTimer);
+  }
+  TEST_EQUAL(osMessageQueueGetCount(main_eventQueue), 1);
+  test_bPressPosted = true;
+  test_bReleased = false;
+  return true;
+}
+
+static void test_Step(void)
+{
+  switch (test_step++)
+  {
+    case 0:
+      // init posted its DONE, the main task waits in idle
+      TEST_EQUAL(main_GetState(), STATE_MAIN_START_IDLE);
+      TEST_CHECK(osEventFlagsGet(osFlag_Main) & MAIN_IO_EXPANDER_FLAG);
+      TEST_CHECK(osTimerIsRunning(main_heartbeatTimer));
+      TEST_CHECK(feederTaskHandle != NULL);
+      test_debounceTimer = host_LastTimer();
+      msgbus_Subscribe(&test_subscriber);
+
+      // the press is posted once the button has been stable for 20 ms
+      test_Button(true, MAIN_BUTTON_DEBOUNCE_MS / DEBOUNCE_SAMPLE_MS - 1);
+      TEST_EQUAL(osMessageQueueGetCount(main_eventQueue), 0);
+      test_Button(true, 1);
+      TEST_EQUAL(osMessageQueueGetCount(main_eventQueue), 1);
+      break;
+
+    case 1:
+      // handled at the tick of the edge, the operation runs and the main task is idle again
+      TEST_EQUAL(main_GetState(), STATE_MAIN_START_IDLE);
+      TEST_EQUAL(test_seqRuns, 1);
+      TEST_EQUAL(main_transitionStats[1].count, 1);
+      TEST_EQUAL(main_transitionStats[1].latencyMax, 0);
+      TEST_EQUAL(osSemaphoreGetCount(osSmp_StartBtn), 1);
+      TEST_CHECK(osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG);
+      TEST_CHECK(osEventFlagsGet(osFlag_ScrewCtrl) & HAYASHI_OPERATION_START_FLAG);
+      TEST_CHECK(osTimerIsRunning(main_buttonTimer));
+
+      // a second press within the lockout is ignored
+      test_Button(false, 10);
+      test_Button(true, 10);
+      TEST_EQUAL(osMessageQueueGetCount(main_eventQueue), 1);
+      break;
+
+    case 2:
+      TEST_EQUAL(main_fsm.unhandled, 1);
+      TEST_EQUAL(osSemaphoreGetCount(osSmp_StartBtn), 1);
+      TEST_EQUAL(test_seqRuns, 1);
+
+      // a button held through the lockout acts again, it stops the operation
+      host_TimerFire(main_buttonTimer);
+      break;
+
+    case 3:
+      TEST_EQUAL(osSemaphoreGetCount(osSmp_StartBtn), 0);
+      TEST_CHECK(!(osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG));
+      TEST_CHECK(osEventFlagsGet(osFlag_ScrewCtrl) & HAYASHI_OPERATION_STOP_FLAG);
+      TEST_CHECK(osEventFlagsGet(osFlag_ScrewFeeder) & FEEDER_OPERATION_STOP_FLAG);
+
+      // released before the lockout ends, the unlock does nothing
+      test_Button(false, 10);
+      host_TimerFire(main_buttonTimer);
+      break;
+
+    case 4:
+      TEST_EQUAL(osSemaphoreGetCount(osSmp_StartBtn), 0);
+      TEST_CHECK(!main_bButtonLocked);
+
+      // a failed preparation aborts back to idle and reports the fault
+      test_seqRc = PER_ERROR_SEQUENCE_TIMEOUT;
+      test_Button(true, 10);
+      break;
+
+    case 5:
+    {
+      TEST_EQUAL(main_GetState(), STATE_MAIN_START_IDLE);
+      TEST_EQUAL(test_seqRuns, 2);
+      TEST_EQUAL(main_stateStats[STATE_MAIN_RUNNING].entries, 1);
+      TEST_CHECK(!(osEventFlagsGet(osFlag_Main) & MAIN_OPERATION_FLAG));
+      const msgbusMsg_t* msg = msgbus_Receive(&test_subscriber);
+      TEST_CHECK((msg != NULL) && (msg->payload[0] == PER_ERROR_SEQUENCE_TIMEOUT));
+      if (msg != NULL)
+        msgbus_Release(msg);
+
+      // a full event queue is reported, not blocked on
+      for (uint32_t idx = 0; idx < MAIN_EVENT_QUEUE_SIZE; idx++)
+        TEST_EQUAL(main_PostEvent(MAIN_EVENT_HEARTBEAT), PER_NO_ERROR);
+      TEST_EQUAL(main_PostEvent(MAIN_EVENT_HEARTBEAT), PER_ERROR_QUEUE_FULL);
+      break;
+    }
+
+    default:
+      if (test_Press())
+        break;
+
+      // the FSM acts on the tick of the debounced edge, the press waits out the bounce and debounce only
+      TEST_EQUAL(osMessageQueueGetCount(main_eventQueue), 0);
+      TEST_EQUAL(main_fsm.unhandled, 1);
+      TEST_EQUAL(main_transitionStats[5].latencyMax, 0);
+      TEST_CHECK(test_eventMax <= TEST_BOUNCE_MS + MAIN_BUTTON_DEBOUNCE_MS + 2 * DEBOUNCE_SAMPLE_MS);
+      TEST_CHECK(test_eventMax < test_pollMax);
+      printf("app_main: press to action over %u presses, 200 ms polling %u ms mean %u max, "
+             "event queue %u ms mean %u max\n", TEST_PRESSES, test_pollTotal / TEST_PRESSES,
+             test_pollMax, test_eventTotal / TEST_PRESSES, test_eventMax);
+      longjmp(test_mainExit, 1);
+  }
+}
+
+static void test_MainIdle(osMessageQueueId_t mq_id)
+{
+  (void)mq_id;
+  test_Step();
+}
+
+int main(void)
+{
+  TEST_EQUAL(main_PostEvent(MAIN_EVENT_BUTTON), PER_ERROR_INIT);
+
+  host_tick = 1000;
+  host_gpioc.IDR = START_BTN_Pin;
+  host_pfnQueueEmpty = test_MainIdle;
+  if (setjmp(test_mainExit) == 0)
+    StartMainTask(NULL);
+  host_pfnQueueEmpty = NULL;
+
+  TEST_EQUAL(test_step, 7 + 2 * TEST_PRESSES);
+  TEST_EQUAL(test_press, TEST_PRESSES);
+  return test_Report("app_main");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file    test_common.h
+  * @author  IBronx MDE team
+  * @brief   Check macros shared by the host tests
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef TESTS_TEST_COMMON_H_
+#define TESTS_TEST_COMMON_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static uint32_t test_checks;
+static uint32_t test_failures;
+
+#define TEST_CHECK(cond) \
+  do { \
+    test_checks++; \
+    if (!(cond)) { \
+      test_failures++; \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+#define TEST_EQUAL(actual, expected) \
+  do { \
+    unsigned long long test_a = (unsigned long long)(actual); \
+    unsigned long long test_e = (unsigned long long)(expected); \
+    test_checks++; \
+    if (test_a != test_e) { \
+      test_failures++; \
+      printf("%s:%d: %s is %llu, expected %llu\n", __FILE__, __LINE__, #actual, test_a, test_e); \
+    } \
+  } while (0)
+
+// monotonic time of the benchmarks, their figures are printed and never checked
+static inline double test_Seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+// print the result line, the return value is the process exit code
+static inline int test_Report(const char* sName)
+{
+  printf("%s: %u checks, %u failed\n", sName, (unsigned)test_checks, (unsigned)test_failures);
+  return (test_failures == 0) ? 0 : 1;
+}
+
+#endif /* TESTS_TEST_COMMON_H_ */
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,248 @@
+/**
+  ******************************************************************************
+  * @file    test_debounce.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the bit-sliced input debounce
+  *          The filter is compared with one counter per input, the sample
+  *          timer with the edges and the time it reports them.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "debounce.h"
+#include "cmsis_os.h"
+#include "errorcode.h"
+#include "test_common.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+/* Private variables ---------------------------------------------------------*/
+typedef struct
+{
+  uint32_t threshold[32];
+  uint32_t count[32];
+  uint32_t state;
+}testRef_t;
+
+static uint32_t test_input;
+static uint32_t test_rose;
+static uint32_t test_fell;
+static uint32_t test_roseTick;
+static uint32_t test_fellTick;
+static uint32_t test_edges;
+/* function prototypes -------------------------------------------------------*/
+
+// one sample count per input, the loop the bit planes replace
+static uint32_t test_RefFilter(testRef_t* ref, uint32_t mask, uint32_t sample)
+{
+  uint32_t toggle = 0;
+
+  for (uint32_t bit = 0; bit < 32; bit++)
+  {
+    uint32_t in = 1U << bit;
+    if (!(mask & in) || ((sample & in) == (ref->state & in)))
+    {
+      ref->count[bit] = 0;
+      continue;
+    }
+    if (++ref->count[bit] == ref->threshold[bit])
+    {
+      ref->state ^= in;
+      ref->count[bit] = 0;
+      toggle |= in;
+    }
+  }
+  return toggle;
+}
+
+static uint32_t test_Rand(void)
+{
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void test_Filter(void)
+{
+  uint32_t wrong = 0;
+
+  srand(1);
+  for (uint32_t round = 0; round < 200; round++)
+  {
+    debouncePort_t port = { .mask = (round & 1) ? 0xFFFFFFFFU : test_Rand() };
+    testRef_t ref = { .state = 0 };
+
+    for (uint32_t bit = 0; bit < 32; bit++)
+    {
+      uint32_t samples = 1 + (uint32_t)rand() % 31;
+      debounce_SetTime(&port, 1U << bit, samples * DEBOUNCE_SAMPLE_MS);
+      ref.threshold[bit] = samples;
+    }
+
+    // noisy inputs, each held for a while now and then so counts run out
+    uint32_t held = test_Rand();
+    for (uint32_t step = 0; step < 5000; step++)
+    {
+      if ((step % 40) == 0)
+        held = test_Rand();
+      uint32_t noise = test_Rand() & test_Rand() & test_Rand();
+      uint32_t sample = held ^ noise;
+
+      uint32_t toggle = debounce_Filter(&port, sample);
+      if ((toggle != test_RefFilter(&ref, port.mask, sample)) || (port.state != ref.state))
+        wrong++;
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+
+  // every 16 sample bounce pattern of one input, 4 samples to switch
+  for (uint32_t pattern = 0; pattern < (1U << 16); pattern++)
+  {
+    debouncePort_t port = { .mask = 1 };
+    testRef_t ref = { .threshold = { 4 } };
+
+    debounce_SetTime(&port, 1, 4 * DEBOUNCE_SAMPLE_MS);
+    for (uint32_t step = 0; step < 16; step++)
+    {
+      uint32_t sample = (pattern >> step) & 1;
+      if (debounce_Filter(&port, sample) != test_RefFilter(&ref, 1, sample))
+        wrong++;
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+}
+
+// times round up to whole samples and stay within the counter
+static void test_SetTime(void)
+{
+  static const uint32_t timesMs[] = { 0, 1, 2, 3, 10, 20, 61, 62, 63, 1000 };
+  static const uint32_t samples[] = { 1, 1, 1, 2, 5, 10, 31, 31, 31, 31 };
+
+  for (uint32_t idx = 0; idx < (sizeof(timesMs) / sizeof(timesMs[0])); idx++)
+  {
+    debouncePort_t port = { .mask = 0x80 };
+    debounce_SetTime(&port, 0x80, timesMs[idx]);
+
+    uint32_t count = 0;
+    while (debounce_Filter(&port, 0x80) == 0)
+      count++;
+    TEST_EQUAL(count + 1, samples[idx]);
+  }
+}
+
+static uint32_t test_Read(void)
+{
+  return test_input;
+}
+
+static void test_Edge(uint32_t rose, uint32_t fell, uint32_t timestamp)
+{
+  test_rose |= rose;
+  test_fell |= fell;
+  if (rose)
+    test_roseTick = timestamp;
+  if (fell)
+    test_fellTick = timestamp;
+  test_edges++;
+}
+
+// the sample timer reports an edge once the input has been stable for its time
+static void test_Timer(void)
+{
+  static debouncePort_t port = {
+    .name = "TEST",
+    .pfnRead = test_Read,
+    .pfnEdge = test_Edge,
+    .mask = 0x0F,
+  };
+
+  host_tick = 500;
+  test_input = 0x05;
+  debounce_SetTime(&port, 0x01, 20);
+  TEST_EQUAL(debounce_Register(&port), PER_NO_ERROR);
+  TEST_EQUAL(debounce_Init(), PER_NO_ERROR);
+  osTimerId_t timer = host_LastTimer();
+  TEST_CHECK(osTimerIsRunning(timer));
+
+  // the inputs at registration are the state, other inputs get the default
+  TEST_EQUAL(debounce_GetState(&port), 0x05);
+
+  // input 0 falls and bounces once, input 1 rises, input 4 is not filtered
+  uint32_t changed = host_tick;
+  for (uint32_t sample = 0; sample < 20; sample++)
+  {
+    host_tick += DEBOUNCE_SAMPLE_MS;
+    test_input = (sample == 3) ? 0x17 : 0x16;
+    host_TimerFire(timer);
+  }
+
+  // input 1 after the default time, input 0 after its 20 ms from the bounce
+  TEST_EQUAL(test_edges, 2);
+  TEST_EQUAL(test_rose, 0x02);
+  TEST_EQUAL(test_fell, 0x01);
+  TEST_EQUAL(test_roseTick - changed, DEBOUNCE_DEFAULT_MS);
+  TEST_EQUAL(test_fellTick - (changed + 4 * DEBOUNCE_SAMPLE_MS), 20);
+  TEST_EQUAL(debounce_GetState(&port), 0x06);
+  TEST_EQUAL(port.timestamp, test_fellTick);
+
+  // a port without read function and ports past DEBOUNCE_PORT_MAX are refused
+  static debouncePort_t more[DEBOUNCE_PORT_MAX];
+  more[0].mask = 1;
+  TEST_EQUAL(debounce_Register(&more[0]), PER_ERROR_INIT);
+  for (uint32_t idx = 0; idx < DEBOUNCE_PORT_MAX; idx++)
+  {
+    more[idx].pfnRead = test_Read;
+    TEST_EQUAL(debounce_Register(&more[idx]), (idx < (DEBOUNCE_PORT_MAX - 1)) ? PER_NO_ERROR : PER_ERROR_INIT);
+  }
+}
+
+// filter time of a 32 input port per sample, for comparison only
+static void test_FilterTime(void)
+{
+  static uint32_t samples[4096];
+  debouncePort_t port = { .mask = 0xFFFFFFFFU };
+  testRef_t ref = { .state = 0 };
+  uint32_t sum = 0;
+
+  debounce_SetTime(&port, 0xFFFFFFFFU, 10);
+  for (uint32_t bit = 0; bit < 32; bit++)
+    ref.threshold[bit] = 5;
+  for (uint32_t idx = 0; idx < 4096; idx++)
+    samples[idx] = test_Rand() & test_Rand();
+
+  clock_t start = clock();
+  for (uint32_t round = 0; round < 200; round++)
+    for (uint32_t idx = 0; idx < 4096; idx++)
+      sum += test_RefFilter(&ref, 0xFFFFFFFFU, samples[idx]);
+  double refNs = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (200 * 4096.0);
+
+  start = clock();
+  for (uint32_t round = 0; round < 200; round++)
+    for (uint32_t idx = 0; idx < 4096; idx++)
+      sum += debounce_Filter(&port, samples[idx]);
+  double planeNs = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / (200 * 4096.0);
+
+  printf("debounce: %.1f ns per 32 input sample, per-input loop %.1f ns (%08x)\n", planeNs, refNs, (unsigned)sum);
+}
+
+int main(void)
+{
+  test_Filter();
+  test_SetTime();
+  test_Timer();
+  test_FilterTime();
+  return test_Report("debounce");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,237 @@
+/**
+  ******************************************************************************
+  * @file    test_fsm.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the table driven state machine
+  *          Scripted events run through a small machine whose hooks write a
+  *          trace, the trace and the statistics are compared afterwards.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm.h"
+#include "errorcode.h"
+#include "test_common.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+enum { TEST_IDLE = 0, TEST_RUN, TEST_STOP, TEST_STATE_COUNT };
+enum { TEST_EV_GO = 0, TEST_EV_DONE, TEST_EV_PING, TEST_EV_ABORT, TEST_EV_UNKNOWN };
+/* Private variables ---------------------------------------------------------*/
+static char test_trace[256];
+static uint32_t test_clock;
+static bool test_bAllowed;
+static bool test_bChain;                        // RUN entry posts DONE
+static uint32_t test_nestedRc;
+
+static uint32_t test_Clock(void);
+static void test_EnterIdle(void* context);
+static void test_EnterRun(void* context);
+static void test_ExitRun(void* context);
+static void test_EnterStop(void* context);
+static bool test_Allowed(void* context, const fsmEvent_t* event);
+static void test_Action(void* context, const fsmEvent_t* event);
+
+static const fsmState_t test_states[] = {
+  [TEST_IDLE] = { "IDLE", test_EnterIdle, NULL },
+  [TEST_RUN]  = { "RUN",  test_EnterRun,  test_ExitRun },
+  [TEST_STOP] = { "STOP", test_EnterStop, NULL },
+};
+
+static const fsmTransition_t test_transitions[] = {
+  { TEST_IDLE,     TEST_EV_GO,    TEST_RUN,       test_Allowed, test_Action },
+  { TEST_RUN,      TEST_EV_DONE,  TEST_IDLE,      NULL,         test_Action },
+  { TEST_RUN,      TEST_EV_ABORT, TEST_STOP,      NULL,         NULL },
+  { FSM_STATE_ANY, TEST_EV_PING,  FSM_STATE_NONE, NULL,         test_Action },
+  { FSM_STATE_ANY, TEST_EV_ABORT, TEST_IDLE,      NULL,         NULL },
+};
+
+#define TEST_TRANSITION_COUNT   (sizeof(test_transitions) / sizeof(test_transitions[0]))
+
+static fsmStateStats_t test_stateStats[TEST_STATE_COUNT];
+static fsmTransitionStats_t test_transitionStats[TEST_TRANSITION_COUNT];
+
+static fsm_t test_fsm = {
+  .states = test_states,
+  .stateCount = TEST_STATE_COUNT,
+  .transitions = test_transitions,
+  .transitionCount = TEST_TRANSITION_COUNT,
+  .stateStats = test_stateStats,
+  .transitionStats = test_transitionStats,
+  .pfnClock = test_Clock,
+  .context = test_trace,
+};
+/* function prototypes -------------------------------------------------------*/
+
+static uint32_t test_Clock(void)
+{
+  return test_clock;
+}
+
+static void test_Trace(void* context, const char* sText)
+{
+  strncat((char*)context, sText, sizeof(test_trace) - strlen((char*)context) - 1);
+}
+
+static void test_EnterIdle(void* context)
+{
+  test_Trace(context, "+I");
+}
+
+static void test_EnterRun(void* context)
+{
+  test_Trace(context, "+R");
+  // hooks post, a nested dispatch is refused
+  test_nestedRc = fsm_Dispatch(&test_fsm);
+  if (test_bChain)
+    fsm_Post(&test_fsm, TEST_EV_DONE);
+}
+
+static void test_ExitRun(void* context)
+{
+  test_Trace(context, "-R");
+}
+
+static void test_EnterStop(void* context)
+{
+  test_Trace(context, "+S");
+}
+
+static bool test_Allowed(void* context, const fsmEvent_t* event)
+{
+  return test_bAllowed;
+}
+
+static void test_Action(void* context, const fsmEvent_t* event)
+{
+  static const char* const sNames[] = { "(go)", "(done)", "(ping)" };
+  test_Trace(context, sNames[event->id]);
+}
+
+// post a script of events, dispatch them and check the trace
+static void test_Script(const uint8_t* p_events, uint32_t count, const char* sTrace)
+{
+  test_trace[0] = '\0';
+  for (uint32_t idx = 0; idx < count; idx++)
+    TEST_EQUAL(fsm_Post(&test_fsm, p_events[idx]), PER_NO_ERROR);
+  TEST_EQUAL(fsm_Dispatch(&test_fsm), count);
+  TEST_CHECK(strcmp(test_trace, sTrace) == 0);
+}
+
+static void test_Transitions(void)
+{
+  test_clock = 100;
+  fsm_Init(&test_fsm, TEST_IDLE);
+  TEST_CHECK(strcmp(test_trace, "+I") == 0);
+  TEST_EQUAL(fsm_GetState(&test_fsm), TEST_IDLE);
+
+  // the guard holds GO back, PING acts in every state without leaving it
+  static const uint8_t blocked[] = { TEST_EV_GO, TEST_EV_PING, TEST_EV_DONE };
+  test_Script(blocked, sizeof(blocked), "(ping)");
+  TEST_EQUAL(test_fsm.unhandled, 2);
+  TEST_EQUAL(fsm_GetState(&test_fsm), TEST_IDLE);
+
+  // exit, action, entry in that order
+  test_bAllowed = true;
+  static const uint8_t run[] = { TEST_EV_GO, TEST_EV_PING, TEST_EV_DONE };
+  test_Script(run, sizeof(run), "(go)+R(ping)-R(done)+I");
+  TEST_EQUAL(test_nestedRc, 0);
+
+  // the first matching row wins, ABORT from RUN goes to STOP, from STOP the ANY row
+  static const uint8_t abort[] = { TEST_EV_GO, TEST_EV_ABORT, TEST_EV_ABORT, TEST_EV_UNKNOWN };
+  test_Script(abort, sizeof(abort), "(go)+R-R+S+I");
+  TEST_EQUAL(test_fsm.unhandled, 3);
+
+  // an event posted by an entry hook runs in the same dispatch
+  test_bChain = true;
+  test_trace[0] = '\0';
+  fsm_Post(&test_fsm, TEST_EV_GO);
+  TEST_EQUAL(fsm_Dispatch(&test_fsm), 2);
+  TEST_CHECK(strcmp(test_trace, "(go)+R-R(done)+I") == 0);
+  test_bChain = false;
+}
+
+static void test_Stats(void)
+{
+  test_clock = 1000;
+  test_bAllowed = true;
+  fsm_Init(&test_fsm, TEST_IDLE);
+  TEST_EQUAL(test_stateStats[TEST_IDLE].entries, 1);
+
+  // GO posted at 1000, handled at 1030 after 30 in IDLE
+  fsm_Post(&test_fsm, TEST_EV_GO);
+  test_clock = 1030;
+  fsm_Dispatch(&test_fsm);
+  TEST_EQUAL(test_stateStats[TEST_IDLE].dwellTotal, 30);
+  TEST_EQUAL(test_transitionStats[0].latencyMax, 30);
+  TEST_EQUAL(fsm_GetDwell(&test_fsm), 0);
+
+  // two visits of RUN, 50 and 20
+  test_clock = 1080;
+  TEST_EQUAL(fsm_GetDwell(&test_fsm), 50);
+  fsm_Post(&test_fsm, TEST_EV_DONE);
+  fsm_Dispatch(&test_fsm);
+  fsm_Post(&test_fsm, TEST_EV_GO);
+  fsm_Dispatch(&test_fsm);
+  test_clock = 1100;
+  fsm_Post(&test_fsm, TEST_EV_DONE);
+  fsm_Dispatch(&test_fsm);
+  TEST_EQUAL(test_stateStats[TEST_RUN].entries, 2);
+  TEST_EQUAL(test_stateStats[TEST_RUN].dwellTotal, 70);
+  TEST_EQUAL(test_stateStats[TEST_RUN].dwellMax, 50);
+  TEST_EQUAL(test_transitionStats[0].count, 2);
+  TEST_EQUAL(test_transitionStats[1].count, 2);
+  TEST_EQUAL(test_transitionStats[1].latencyTotal, 0);
+
+  // a forwarded event keeps its post time
+  fsmEvent_t event = { .id = TEST_EV_PING, .postTime = 1060 };
+  fsm_PostEvent(&test_fsm, &event);
+  fsm_Dispatch(&test_fsm);
+  TEST_EQUAL(test_transitionStats[3].latencyMax, 40);
+}
+
+static void test_Queue(void)
+{
+  fsm_Init(&test_fsm, TEST_IDLE);
+
+  // the queue holds FSM_QUEUE_SIZE events, the rest is counted
+  for (uint32_t idx = 0; idx < FSM_QUEUE_SIZE; idx++)
+    TEST_EQUAL(fsm_Post(&test_fsm, TEST_EV_PING), PER_NO_ERROR);
+  TEST_EQUAL(fsm_Post(&test_fsm, TEST_EV_PING), PER_ERROR_QUEUE_FULL);
+  TEST_EQUAL(test_fsm.dropped, 1);
+  TEST_EQUAL(fsm_Dispatch(&test_fsm), FSM_QUEUE_SIZE);
+  TEST_EQUAL(fsm_Dispatch(&test_fsm), 0);
+
+  // the indexes wrap over many laps
+  for (uint32_t idx = 0; idx < (FSM_QUEUE_SIZE * 40 + 3); idx++)
+  {
+    fsm_Post(&test_fsm, TEST_EV_PING);
+    if ((idx % 3) == 2)
+      fsm_Dispatch(&test_fsm);
+  }
+  fsm_Dispatch(&test_fsm);
+  TEST_EQUAL(test_fsm.dropped, 1);
+  TEST_EQUAL(test_transitionStats[3].count, FSM_QUEUE_SIZE * 41 + 3);
+}
+
+int main(void)
+{
+  test_Transitions();
+  test_Stats();
+  test_Queue();
+  return test_Report("fsm");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
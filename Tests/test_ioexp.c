@@ -0,0 +1,407 @@
+/**
+  ******************************************************************************
+  * @file    test_ioexp.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the PCA9505 register cache
+  *          The I2C calls go to a simulated PCA9505 register file that counts
+  *          the transactions and bytes, the DMA transfers complete when the
+  *          test says so and can be made to fail.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "ioexp_cache.h"
+#include "errorcode.h"
+#include "test_common.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_REG_IP0            0x00
+#define TEST_REG_OP0            0x08
+#define TEST_REG_IOC0           0x18
+#define TEST_REG_MSK0           0x20
+#define TEST_REG_COUNT          0x28
+#define TEST_I2C_HZ             400000U
+/* Private variables ---------------------------------------------------------*/
+ typedef struct
+ {
+   bool bPending;
+   bool bWrite;
+   uint8_t reg;
+   uint8_t* pData;
+   uint16_t size;
+ }testDma_t;
+
+I2C_HandleTypeDef hi2c1;
+
+static uint8_t test_regs[TEST_REG_COUNT];   // PCA9505 register file
+static uint32_t test_transactions;          // bus transactions, blocking and DMA
+static uint32_t test_bytes;                 // bytes on the bus, address and register byte included
+static uint32_t test_failCount;             // DMA transfers still to fail
+static testDma_t test_dma;
+static osTimerId_t test_flushTimer;
+/* function prototypes -------------------------------------------------------*/
+
+static uint8_t test_Reg(uint16_t memAddress, uint32_t idx)
+{
+  // auto increment walks the registers in address order
+  return (uint8_t)(((memAddress & 0x7F) + ((memAddress & 0x80) ? idx : 0)) % TEST_REG_COUNT);
+}
+
+static void test_Count(uint16_t size, bool bRead)
+{
+  test_transactions++;
+  // a read sends the register with a write header, then a repeated start
+  test_bytes += 2U + (bRead ? 1U : 0U) + size;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                   uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+  if (test_dma.bPending)
+    return HAL_BUSY;
+  test_Count(Size, true);
+  for (uint32_t idx = 0; idx < Size; idx++)
+    pData[idx] = test_regs[test_Reg(MemAddress, idx)];
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                    uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+  if (test_dma.bPending)
+    return HAL_BUSY;
+  test_Count(Size, false);
+  for (uint32_t idx = 0; idx < Size; idx++)
+    test_regs[test_Reg(MemAddress, idx)] = pData[idx];
+  return HAL_OK;
+}
+
+static HAL_StatusTypeDef test_StartDma(bool bWrite, uint16_t MemAddress, uint8_t* pData, uint16_t Size)
+{
+  if (test_dma.bPending)
+    return HAL_BUSY;
+  test_Count(Size, !bWrite);
+  test_dma.bPending = true;
+  test_dma.bWrite = bWrite;
+  test_dma.reg = (uint8_t)MemAddress;
+  test_dma.pData = pData;
+  test_dma.size = Size;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                       uint8_t* pData, uint16_t Size)
+{
+  return test_StartDma(false, MemAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+                                        uint8_t* pData, uint16_t Size)
+{
+  return test_StartDma(true, MemAddress, pData, Size);
+}
+
+// end the DMA transfer in flight and run its callback in interrupt context
+static bool test_Complete(void)
+{
+  if (!test_dma.bPending)
+    return false;
+  test_dma.bPending = false;
+
+  host_ipsr = 31;
+  if (test_failCount > 0)
+  {
+    test_failCount--;
+    hi2c1.pfnCallback[HAL_I2C_ERROR_CB_ID](&hi2c1);
+  }
+  else
+  {
+    for (uint32_t idx = 0; idx < test_dma.size; idx++)
+    {
+      if (test_dma.bWrite)
+        test_regs[test_Reg(test_dma.reg, idx)] = test_dma.pData[idx];
+      else
+        test_dma.pData[idx] = test_regs[test_Reg(test_dma.reg, idx)];
+    }
+    hi2c1.pfnCallback[test_dma.bWrite ? HAL_I2C_MEM_TX_COMPLETE_CB_ID : HAL_I2C_MEM_RX_COMPLETE_CB_ID](&hi2c1);
+  }
+  host_ipsr = 0;
+  return true;
+}
+
+// one kernel tick, the flush timer runs when it expires
+static void test_Tick(void)
+{
+  host_tick++;
+  if (osTimerIsRunning(test_flushTimer))
+    host_TimerFire(test_flushTimer);
+}
+
+// run the bus and the ticks until the cache has nothing left to send
+static void test_Settle(void)
+{
+  for (uint32_t idx = 0; idx < 1000; idx++)
+  {
+    while (test_Complete())
+      ;
+    if (!osTimerIsRunning(test_flushTimer))
+      return;
+    test_Tick();
+  }
+}
+
+// bus time of a transfer at TEST_I2C_HZ, 9 clocks per byte plus start and stop
+static uint32_t test_BusUs(uint32_t bytes)
+{
+  return (bytes * 9U + 2U) * 1000000U / TEST_I2C_HZ;
+}
+
+static void test_Init(void)
+{
+  // INT released, the expander has nothing new to report
+  host_gpioc.IDR |= IOEXP_INT_PIN;
+  for (uint32_t port = 0; port < IOEXP_PORT_COUNT; port++)
+  {
+    test_regs[TEST_REG_IP0 + port] = (uint8_t)(0x11 * port);
+    test_regs[TEST_REG_OP0 + port] = 0x00;
+    test_regs[TEST_REG_IOC0 + port] = (port == 4) ? 0xFF : 0x00;
+    test_regs[TEST_REG_MSK0 + port] = 0xFF;
+  }
+
+  TEST_EQUAL(ioexp_Init(), PER_NO_ERROR);
+  test_flushTimer = host_LastTimer();
+
+  // one blocking read per bank and one of the inputs, not counted by the cache
+  ioexpStats_t stats;
+  ioexp_GetStats(&stats);
+  TEST_EQUAL(test_transactions, 4);
+  TEST_EQUAL(stats.transactions, 0);
+  TEST_EQUAL(ioexp_GetDirection(4), 0xFF);
+  TEST_EQUAL(ioexp_GetInputPort(3), 0x33);
+  TEST_EQUAL(ioexp_Sync(0), PER_NO_ERROR);
+}
+
+static void test_Burst(void)
+{
+  static const uint8_t pins[][3] = { { 0, 0x01, 1 }, { 0, 0x02, 1 }, { 1, 0x10, 1 }, { 3, 0x80, 1 } };
+  uint32_t count = sizeof(pins) / sizeof(pins[0]);
+
+  // before: one blocking register write per pin change, the last solenoid waits for all of them
+  uint8_t output[IOEXP_PORT_COUNT] = { 0 };
+  uint32_t transactions = test_transactions;
+  uint32_t bytes = test_bytes;
+  for (uint32_t idx = 0; idx < count; idx++)
+  {
+    output[pins[idx][0]] |= pins[idx][1];
+    HAL_I2C_Mem_Write(&hi2c1, IOEXP_I2C_ADDRESS, TEST_REG_OP0 + pins[idx][0], I2C_MEMADD_SIZE_8BIT, &output[pins[idx][0]], 1, 10);
+  }
+  uint32_t beforeTransactions = test_transactions - transactions;
+  uint32_t beforeBytes = test_bytes - bytes;
+  memset(output, 0, sizeof(output));
+  for (uint32_t port = 0; port < IOEXP_PORT_COUNT; port++)
+    test_regs[TEST_REG_OP0 + port] = 0;
+
+  // after: the same changes in one tick, nothing goes out before the flush timer
+  transactions = test_transactions;
+  bytes = test_bytes;
+  for (uint32_t idx = 0; idx < count; idx++)
+    TEST_EQUAL(ioexp_SetOutputPin(pins[idx][0], pins[idx][1], pins[idx][2]), PER_NO_ERROR);
+  TEST_EQUAL(test_transactions, transactions);
+  TEST_CHECK(osTimerIsRunning(test_flushTimer));
+  TEST_EQUAL(ioexp_Sync(0), PER_ERROR_I2C_TRANSMIT_COMMAND);
+
+  // one auto increment burst from port 0 to port 3, the clean port 2 with its cached value
+  test_Tick();
+  TEST_EQUAL(test_transactions - transactions, 1);
+  TEST_CHECK(test_dma.bPending && test_dma.bWrite);
+  TEST_EQUAL(test_dma.reg, TEST_REG_OP0 | 0x80);
+  TEST_EQUAL(test_dma.size, 4);
+  test_Settle();
+  TEST_EQUAL(test_transactions - transactions, 1);
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 0], 0x03);
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 1], 0x10);
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 2], 0x00);
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 3], 0x80);
+  TEST_EQUAL(ioexp_Sync(0), PER_NO_ERROR);
+  TEST_CHECK(!osTimerIsRunning(test_flushTimer));
+
+  uint32_t afterBytes = test_bytes - bytes;
+  TEST_EQUAL(beforeTransactions, count);
+  TEST_CHECK(afterBytes < beforeBytes);
+  printf("ioexp: %u pin changes, per-pin writes %u transactions %u bytes %u us, burst 1 transaction %u bytes %u us\n",
+         (unsigned)count, (unsigned)beforeTransactions, (unsigned)beforeBytes,
+         (unsigned)(count * test_BusUs(beforeBytes / count)), (unsigned)afterBytes, (unsigned)test_BusUs(afterBytes));
+}
+
+static void test_ShadowReads(void)
+{
+  uint32_t transactions = test_transactions;
+  uint32_t sum = 0;
+
+  // every read comes from the copies
+  for (uint32_t loop = 0; loop < 1000; loop++)
+  {
+    for (uint8_t port = 0; port < IOEXP_PORT_COUNT; port++)
+    {
+      sum += ioexp_GetOutputPort(port) + ioexp_GetDirection(port) + ioexp_GetInputPort(port);
+      sum += ioexp_GetOutputPin(port, 0x10) ? 1 : 0;
+    }
+  }
+  TEST_EQUAL(test_transactions, transactions);
+  TEST_EQUAL(sum, 1000 * (0x03 + 0x10 + 0x80 + 0xFF + 0x00 + 0x11 + 0x22 + 0x33 + 0x44 + 1));
+
+  // writing the cached state is skipped and arms nothing
+  ioexpStats_t before;
+  ioexpStats_t after;
+  ioexp_GetStats(&before);
+  TEST_EQUAL(ioexp_SetOutputPin(0, 0x03, 1), PER_NO_ERROR);
+  TEST_EQUAL(ioexp_SetOutputPin(2, 0x01, 0), PER_NO_ERROR);
+  ioexp_GetStats(&after);
+  TEST_EQUAL(after.skipped - before.skipped, 2);
+  TEST_CHECK(!osTimerIsRunning(test_flushTimer));
+  test_Settle();
+  TEST_EQUAL(test_transactions, transactions);
+}
+
+static void test_Transactions(void)
+{
+  ioexpStats_t before;
+  ioexpStats_t after;
+  ioexp_GetStats(&before);
+  uint32_t transactions = test_transactions;
+
+  // the bursts and the input reads started by the cache, the outputs go out before the directions
+  ioexp_SetOutputPin(4, 0x01, 1);
+  ioexp_SetDirection(1, 0x0F);
+  test_Tick();
+  TEST_CHECK(test_dma.bWrite && (test_dma.reg == ((TEST_REG_OP0 + 4) | 0x80)));
+
+  // a change and an INT edge during the burst go out from its completion, the read first
+  ioexp_SetOutputPin(0, 0x04, 1);
+  test_regs[TEST_REG_IP0 + 2] = 0x5A;
+  ioexp_InterruptHandler();
+  TEST_EQUAL(test_transactions - transactions, 1);
+  test_Complete();
+  TEST_CHECK(!test_dma.bWrite && (test_dma.reg == (TEST_REG_IP0 | 0x80)));
+  test_Settle();
+  TEST_EQUAL(test_regs[TEST_REG_IOC0 + 1], 0x0F);
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 0], 0x07);
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 4], 0x01);
+  TEST_EQUAL(ioexp_GetInputPort(2), 0x5A);
+
+  // output burst, read, then the new output and the directions each in a burst of their own bank
+  ioexp_GetStats(&after);
+  TEST_EQUAL(test_transactions - transactions, 4);
+  TEST_EQUAL(after.transactions - before.transactions, 4);
+  TEST_EQUAL(after.captures - before.captures, 1);
+
+  // a bus held by a blocking transfer defers the burst to the next tick
+  ioexp_SetOutputPin(0, 0x08, 1);
+  test_dma.bPending = true;
+  test_Tick();
+  test_dma.bPending = false;
+  ioexp_GetStats(&after);
+  TEST_EQUAL(after.busyRetries - before.busyRetries, 1);
+  TEST_CHECK(osTimerIsRunning(test_flushTimer));
+  test_Settle();
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 0], 0x0F);
+  TEST_EQUAL(test_transactions - transactions, 5);
+}
+
+static void test_Retry(void)
+{
+  ioexpStats_t before;
+  ioexpStats_t after;
+  ioexp_GetStats(&before);
+  uint32_t transactions = test_transactions;
+
+  // a failed burst keeps the timer armed and is resent after one tick
+  ioexp_SetOutputPin(1, 0x01, 1);
+  test_failCount = 1;
+  test_Tick();
+  test_Complete();
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 1], 0x10);
+  TEST_CHECK(osTimerIsRunning(test_flushTimer));
+  TEST_EQUAL(ioexp_Sync(0), PER_ERROR_I2C_TRANSMIT_COMMAND);
+  test_Tick();
+  TEST_EQUAL(test_transactions - transactions, 2);
+  test_Settle();
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 1], 0x11);
+  TEST_CHECK(!osTimerIsRunning(test_flushTimer));
+
+  // a dead bus is retried after 1, 2, 4 ... ticks up to IOEXP_RETRY_DELAY_MAX
+  ioexp_SetOutputPin(3, 0x01, 1);
+  test_failCount = 100;
+  uint32_t lastTry = host_tick;
+  uint32_t gaps[12];
+  for (uint32_t idx = 0; idx < 12; idx++)
+  {
+    transactions = test_transactions;
+    while ((test_transactions == transactions) && (host_tick - lastTry < 1000))
+      test_Tick();
+    gaps[idx] = host_tick - lastTry;
+    lastTry = host_tick;
+    test_Complete();
+  }
+  for (uint32_t idx = 1; idx < 12; idx++)
+  {
+    uint32_t expected = 1U << (idx - 1);
+    TEST_EQUAL(gaps[idx], (expected > IOEXP_RETRY_DELAY_MAX) ? IOEXP_RETRY_DELAY_MAX : expected);
+  }
+
+  // the bus comes back, the port is written and the backoff starts over
+  test_failCount = 0;
+  test_Settle();
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 3], 0x81);
+  TEST_CHECK(!osTimerIsRunning(test_flushTimer));
+  ioexp_GetStats(&after);
+  TEST_EQUAL(after.errors - before.errors, 13);
+
+  ioexp_SetOutputPin(3, 0x02, 1);
+  test_failCount = 1;
+  test_Tick();
+  test_Complete();
+  transactions = test_transactions;
+  test_Tick();
+  TEST_EQUAL(test_transactions - transactions, 1);
+  test_Settle();
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 3], 0x83);
+
+  // a flush during the backoff sends at once
+  ioexp_SetOutputPin(4, 0x02, 1);
+  test_failCount = 2;
+  test_Tick();
+  test_Complete();
+  test_Tick();
+  test_Complete();
+  transactions = test_transactions;
+  ioexp_Flush();
+  TEST_EQUAL(test_transactions - transactions, 1);
+  test_Settle();
+  TEST_EQUAL(test_regs[TEST_REG_OP0 + 4], 0x03);
+}
+
+int main(void)
+{
+  test_Init();
+  test_Burst();
+  test_ShadowReads();
+  test_Transactions();
+  test_Retry();
+  return test_Report("ioexp");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,279 @@
+/**
+  ******************************************************************************
+  * @file    test_led_animation.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the LED animations
+  *          The module source is included to reach the packed color helpers,
+  *          the LED driver is replaced by a frame capture.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "../Src/led_animation.c"
+#include "test_common.h"
+
+#include <stdlib.h>
+/* Private variables ---------------------------------------------------------*/
+osEventFlagsId_t osFlag_Main;
+
+static uint8_t test_pixels[RGBLED_STRIP_COUNT][MAX_WS28XX_LED][3];
+static uint32_t test_commits;
+/* function prototypes -------------------------------------------------------*/
+
+void rgbled_Init(void)
+{
+}
+
+void rgbled_SetStripPixel(uint32_t strip, uint32_t led, uint8_t red, uint8_t green, uint8_t blue)
+{
+  test_pixels[strip][led][0] = red;
+  test_pixels[strip][led][1] = green;
+  test_pixels[strip][led][2] = blue;
+}
+
+uint32_t rgbled_Commit(void)
+{
+  test_commits++;
+  return PER_NO_ERROR;
+}
+
+static uint32_t test_Byte(uint32_t rgb, uint32_t idx)
+{
+  return (rgb >> (idx * 8)) & 0xFF;
+}
+
+static void test_Scale(void)
+{
+  uint32_t wrong = 0;
+
+  // every channel value at every level, each byte position on its own
+  for (uint32_t value = 0; value < 256; value++)
+  {
+    uint32_t rgb = LEDANIM_PACK(value, 255 - value, value ^ 0x5A);
+    for (uint32_t level = 0; level <= 256; level++)
+    {
+      uint32_t out = ledanim_Scale(rgb, level);
+      for (uint32_t idx = 0; idx < 3; idx++)
+      {
+        if (test_Byte(out, idx) != ((test_Byte(rgb, idx) * level) >> 8))
+          wrong++;
+      }
+      if (test_Byte(out, 3) != 0)
+        wrong++;
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+}
+
+static void test_AddSat(void)
+{
+  uint32_t wrong = 0;
+
+  // every pair of bytes, carries must not reach the next byte
+  for (uint32_t x = 0; x < 256; x++)
+  {
+    for (uint32_t y = 0; y < 256; y++)
+    {
+      uint32_t a = x | (y << 8) | (x << 16) | (y << 24);
+      uint32_t b = y | (y << 8) | (255 - x) << 16 | (x << 24);
+      uint32_t out = ledanim_AddSat(a, b);
+      for (uint32_t idx = 0; idx < 4; idx++)
+      {
+        uint32_t sum = test_Byte(a, idx) + test_Byte(b, idx);
+        if (test_Byte(out, idx) != ((sum > 255) ? 255 : sum))
+          wrong++;
+      }
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+}
+
+// channel value after the level and brightness, before the gamma
+static uint32_t test_Channel(uint32_t value, uint32_t level, uint32_t brightness)
+{
+  value = (value * level) >> 8;
+  if (brightness > LEDANIM_BRIGHTNESS_ONE)
+  {
+    value += (value * (brightness - LEDANIM_BRIGHTNESS_ONE)) >> 8;
+    return (value > 255) ? 255 : value;
+  }
+  return (value * brightness) >> 8;
+}
+
+static void test_CheckLeds(uint8_t red, uint8_t green, uint8_t blue, const uint32_t* p_levels, uint32_t brightness)
+{
+  for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+  {
+    TEST_EQUAL(test_pixels[0][led][0], ledanim_gamma[test_Channel(red, p_levels[led], brightness)]);
+    TEST_EQUAL(test_pixels[0][led][1], ledanim_gamma[test_Channel(green, p_levels[led], brightness)]);
+    TEST_EQUAL(test_pixels[0][led][2], ledanim_gamma[test_Channel(blue, p_levels[led], brightness)]);
+  }
+}
+
+static void test_Frames(void)
+{
+  uint32_t full[MAX_WS28XX_LED];
+  uint32_t off[MAX_WS28XX_LED] = { 0 };
+
+  for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+    full[led] = 256;
+
+  host_tick = 1000;
+  msgbus_Init();
+  TEST_EQUAL(ledanim_Init(), PER_NO_ERROR);
+  TEST_CHECK(osTimerIsRunning(ledanim_timer));
+
+  // start blink, on for the first half of the 400 ms period
+  msgbus_Post(MSGBUS_MAIN_STATE, STATE_MAIN_START);
+  host_TimerFire(ledanim_timer);
+  TEST_EQUAL(test_commits, 1);
+  test_CheckLeds(255, 160, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  host_tick += 250;
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(255, 160, 0, off, LEDANIM_BRIGHTNESS_ONE);
+
+  // brightness above 1.0 saturates per channel, the maximum is clipped
+  host_tick += 150;
+  for (uint32_t brightness = 0; brightness <= LEDANIM_BRIGHTNESS_MAX; brightness += 7)
+  {
+    host_tick += 400;
+    ledanim_SetBrightness((uint16_t)brightness);
+    host_TimerFire(ledanim_timer);
+    test_CheckLeds(255, 160, 0, full, brightness);
+  }
+  ledanim_SetBrightness(0xFFFF);
+  TEST_EQUAL(ledanim_brightness, LEDANIM_BRIGHTNESS_MAX);
+  ledanim_SetBrightness(LEDANIM_BRIGHTNESS_ONE);
+
+  // running chase follows the operation flag, head at 1/5 of the period
+  msgbus_Post(MSGBUS_MAIN_STATE, STATE_MAIN_RUNNING);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(0, 64, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  osEventFlagsSet(osFlag_Main, MAIN_OPERATION_FLAG);
+  host_TimerFire(ledanim_timer);
+  host_tick += 200;
+  host_TimerFire(ledanim_timer);
+  uint32_t chase[MAX_WS28XX_LED];
+  for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+    chase[led] = (led == 1) ? 256 : ((led == 0) ? LEDANIM_CHASE_TAIL : LEDANIM_CHASE_BASE);
+  test_CheckLeds(0, 255, 0, chase, LEDANIM_BRIGHTNESS_ONE);
+
+  // a fault blinks over the state in the color of its group until cleared,
+  // the codes appended after the groups map like the rest
+  msgbus_Post(MSGBUS_FAULT, PER_ERROR_FLASH_ERASE);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(255, 255, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  msgbus_Post(MSGBUS_FAULT, PER_ERROR_FLASH_FOREIGN);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(255, 255, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  msgbus_Post(MSGBUS_FAULT, PER_ERROR_QUEUE_FULL);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(0, 255, 255, full, LEDANIM_BRIGHTNESS_ONE);
+  msgbus_Post(MSGBUS_FAULT, PER_ERROR_SEQUENCE_TIMEOUT);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(255, 0, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  msgbus_Post(MSGBUS_FAULT, PER_ERROR_INIT);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(255, 0, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  ledanim_ClearError();
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(0, 255, 0, chase, LEDANIM_BRIGHTNESS_ONE);
+
+  // a played pattern stays over the state on every frame, a fault shows over it
+  ledanim_Play(&(ledAnimation_t){ LEDANIM_SOLID, 0, 0, 255, 1000 });
+  for (uint32_t frame = 0; frame < 3; frame++)
+  {
+    host_tick += LEDANIM_FRAME_MS;
+    host_TimerFire(ledanim_timer);
+    test_CheckLeds(0, 0, 255, full, LEDANIM_BRIGHTNESS_ONE);
+  }
+  msgbus_Post(MSGBUS_MAIN_STATE, STATE_MAIN_START);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(0, 0, 255, full, LEDANIM_BRIGHTNESS_ONE);
+  msgbus_Post(MSGBUS_FAULT, PER_ERROR_INIT);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(255, 0, 0, full, LEDANIM_BRIGHTNESS_ONE);
+  ledanim_ClearError();
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(0, 0, 255, full, LEDANIM_BRIGHTNESS_ONE);
+
+  // cleared, the state shows again; played again, it starts from its first frame
+  ledanim_Play(NULL);
+  host_TimerFire(ledanim_timer);
+  TEST_EQUAL(ledanim_state.pattern, LEDANIM_BLINK);
+  test_CheckLeds(255, 160, 0, (((host_tick - ledanim_stateTick) % 400) < 200) ? full : off, LEDANIM_BRIGHTNESS_ONE);
+  ledanim_Play(&(ledAnimation_t){ LEDANIM_BLINK, 0, 0, 255, 400 });
+  TEST_EQUAL(ledanim_playedTick, host_tick);
+  host_TimerFire(ledanim_timer);
+  test_CheckLeds(0, 0, 255, full, LEDANIM_BRIGHTNESS_ONE);
+  ledanim_Play(NULL);
+}
+
+// frame render time per LED on the host, for comparison only: the timer
+// callback with packed colors against a per-channel loop of test_Channel
+static void test_RenderTime(void)
+{
+  const uint32_t rounds = 200000;
+  const uint8_t color[3] = { 255, 160, 40 };
+  uint32_t sum = 0;
+
+  ledanim_SetBrightness(LEDANIM_BRIGHTNESS_ONE + 0x80);
+  ledanim_Play(&(ledAnimation_t){ LEDANIM_BREATHE, 255, 160, 40, 1000 });
+
+  double start = test_Seconds();
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    host_tick++;
+    host_TimerFire(ledanim_timer);
+    sum += test_pixels[0][round % MAX_WS28XX_LED][round % 3];
+  }
+  double callbackNs = (test_Seconds() - start) * 1e9 / (rounds * (double)MAX_WS28XX_LED);
+
+  start = test_Seconds();
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    host_tick++;
+    for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+    {
+      uint32_t level = ledanim_Level(&ledanim_played, host_tick - ledanim_playedTick, led);
+      uint8_t out[3];
+      for (uint32_t channel = 0; channel < 3; channel++)
+        out[channel] = ledanim_gamma[test_Channel(color[channel], level, ledanim_brightness)];
+      for (uint32_t strip = 0; strip < RGBLED_STRIP_COUNT; strip++)
+        rgbled_SetStripPixel(strip, led, out[0], out[1], out[2]);
+    }
+    rgbled_Commit();
+    sum += test_pixels[0][round % MAX_WS28XX_LED][round % 3];
+  }
+  double channelNs = (test_Seconds() - start) * 1e9 / (rounds * (double)MAX_WS28XX_LED);
+
+  ledanim_Play(NULL);
+  ledanim_SetBrightness(LEDANIM_BRIGHTNESS_ONE);
+  printf("led_animation: frame of %u LEDs x %u strips %.1f ns per LED, per-channel loop %.1f ns (%08x)\n",
+         (unsigned)MAX_WS28XX_LED, (unsigned)RGBLED_STRIP_COUNT, callbackNs, channelNs, (unsigned)sum);
+}
+
+int main(void)
+{
+  osFlag_Main = osEventFlagsNew(NULL);
+
+  test_Scale();
+  test_AddSat();
+  test_Frames();
+  test_RenderTime();
+  return test_Report("led_animation");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
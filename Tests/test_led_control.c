@@ -0,0 +1,224 @@
+/**
+  ******************************************************************************
+  * @file    test_led_control.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the WS28xx framebuffer commit and frame queue
+  *          The DMA starts of the GPIO backend are counted and the transfers
+  *          complete when the test says so. The DMA buffer is poisoned before
+  *          a frame starts, so the LEDs encoded again can be told apart.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "led_control.h"
+#include "led_encoder.h"
+#include "cmsis_os.h"
+#include "test_common.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_POISON             0xA5A5A5A5U
+#define TEST_ALL_LEDS           ((1U << MAX_WS28XX_LED) - 1U)
+/* Private variables ---------------------------------------------------------*/
+static DMA_Stream_TypeDef test_streams[3];
+static TIM_TypeDef test_tim8;
+
+DMA_HandleTypeDef hdma_tim8_up = { .Instance = &test_streams[0] };
+DMA_HandleTypeDef hdma_tim8_ch1 = { .Instance = &test_streams[1] };
+DMA_HandleTypeDef hdma_tim8_ch3 = { .Instance = &test_streams[2] };
+TIM_HandleTypeDef htim8 = { .Instance = &test_tim8 };
+
+extern uint32_t WS2812_DMA_BUFFER[TOTAL_RGB_LED_PIXEL_SIZE];
+
+static uint32_t test_frames;                // data transfers started
+static uint32_t test_latches;               // reset latches started
+static uint8_t test_colors[MAX_WS28XX_LED][3];
+static bool test_bCompleteOnWait;
+/* function prototypes -------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+  if (hdma == &hdma_tim8_ch1)
+    test_frames++;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef* hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+  if ((hdma == &hdma_tim8_ch3) && (DataLength == RGBLED_LATCH_SLOTS))
+    test_latches++;
+  return HAL_OK;
+}
+
+// end of the data, then end of the latch, both on the CC3 stream
+static void test_Complete(void)
+{
+  hdma_tim8_ch3.pfnCallback[HAL_DMA_XFER_CPLT_CB_ID](&hdma_tim8_ch3);
+  hdma_tim8_ch3.pfnCallback[HAL_DMA_XFER_CPLT_CB_ID](&hdma_tim8_ch3);
+}
+
+static void test_Set(uint32_t led, uint8_t red, uint8_t green, uint8_t blue)
+{
+  test_colors[led][0] = red;
+  test_colors[led][1] = green;
+  test_colors[led][2] = blue;
+  rgbled_SetStripPixel(0, led, red, green, blue);
+}
+
+// the DMA buffer of each LED holds its last color, or the poison when not encoded again
+static void test_CheckBuffer(uint32_t encodedMask)
+{
+  for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+  {
+    uint32_t expected[RGB_LED_PIXEL_SIZE];
+    const uint32_t* p_words = &WS2812_DMA_BUFFER[led * RGB_LED_PIXEL_SIZE];
+
+    if (encodedMask & (1U << led))
+    {
+      ledenc_EncodePixel(expected, test_colors[led][0], test_colors[led][1], test_colors[led][2]);
+      TEST_CHECK(memcmp(p_words, expected, sizeof(expected)) == 0);
+    }
+    else
+    {
+      uint32_t poisoned = 0;
+      for (uint32_t word = 0; word < RGB_LED_PIXEL_SIZE; word++)
+        poisoned += (p_words[word] == TEST_POISON) ? 1U : 0U;
+      TEST_EQUAL(poisoned, RGB_LED_PIXEL_SIZE);
+    }
+  }
+}
+
+static void test_Poison(void)
+{
+  for (uint32_t word = 0; word < (RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED); word++)
+    WS2812_DMA_BUFFER[word] = TEST_POISON;
+}
+
+// rgbled_WaitFrame waits one tick at a time
+static void test_FlagsWait(osEventFlagsId_t ef_id)
+{
+  (void)ef_id;
+  host_tick++;
+  if (test_bCompleteOnWait)
+  {
+    test_bCompleteOnWait = false;
+    test_Complete();
+  }
+}
+
+static void test_Commit(void)
+{
+  rgbled_Init();
+  TEST_CHECK(hdma_tim8_ch3.pfnCallback[HAL_DMA_XFER_CPLT_CB_ID] != NULL);
+  test_frames = 0;
+
+  // the first commit sends every LED
+  test_Poison();
+  uint32_t seq = rgbled_Commit();
+  TEST_EQUAL(test_frames, 1);
+  test_CheckBuffer(TEST_ALL_LEDS);
+  TEST_CHECK(!rgbled_WaitFrame(seq, 0));
+  test_Complete();
+  TEST_EQUAL(test_latches, 1);
+  TEST_CHECK(rgbled_WaitFrame(seq, 0));
+
+  // no change, or the same color again, starts no transfer
+  TEST_EQUAL(rgbled_Commit(), seq);
+  test_Set(2, 0, 0, 0);
+  TEST_EQUAL(rgbled_Commit(), seq);
+  TEST_EQUAL(test_frames, 1);
+
+  // only the runs of changed LEDs are encoded again
+  test_Set(1, 10, 20, 30);
+  test_Set(3, 40, 50, 60);
+  test_Set(4, 70, 80, 90);
+  test_Poison();
+  seq = rgbled_Commit();
+  TEST_EQUAL(test_frames, 2);
+  test_CheckBuffer((1U << 1) | (1U << 3) | (1U << 4));
+  test_Complete();
+  TEST_CHECK(rgbled_WaitFrame(seq, 0));
+}
+
+static void test_Replace(void)
+{
+  // a frame is being sent, the next commit waits in the other slot
+  test_Set(0, 1, 2, 3);
+  uint32_t sending = rgbled_Commit();
+  test_Set(2, 4, 5, 6);
+  uint32_t replaced = rgbled_Commit();
+  TEST_EQUAL(test_frames, 3);
+
+  // a third commit replaces the waiting one and keeps its changed LEDs
+  test_Set(4, 7, 8, 9);
+  uint32_t latest = rgbled_Commit();
+  TEST_EQUAL(test_frames, 3);
+  TEST_CHECK(!rgbled_WaitFrame(replaced, 0));
+
+  // the first frame done, the replacing one starts from the completion
+  test_Poison();
+  test_Complete();
+  TEST_CHECK(rgbled_WaitFrame(sending, 0));
+  TEST_CHECK(!rgbled_WaitFrame(replaced, 0));
+  TEST_EQUAL(test_frames, 4);
+  test_CheckBuffer((1U << 2) | (1U << 4));
+
+  // a replaced frame is done once the one replacing it is
+  test_Complete();
+  TEST_CHECK(rgbled_WaitFrame(replaced, 0));
+  TEST_CHECK(rgbled_WaitFrame(latest, 0));
+  TEST_EQUAL(rgbled_Commit(), latest);
+  TEST_EQUAL(test_frames, 4);
+}
+
+static void test_Wait(void)
+{
+  uint8_t frames[RGBLED_STRIP_COUNT * RGB_LED_FRAME_SIZE];
+
+  host_pfnFlagsWait = test_FlagsWait;
+
+  // a frame from outside the framebuffer, then the next commit sends every LED
+  memset(frames, 0x11, sizeof(frames));
+  uint32_t seq = rgbled_SubmitFrame(frames);
+  TEST_EQUAL(test_frames, 5);
+
+  // times out while the strip is busy, completes while waiting
+  host_tick = 100;
+  TEST_CHECK(!rgbled_WaitFrame(seq, 5));
+  TEST_EQUAL(host_tick, 105);
+  test_bCompleteOnWait = true;
+  TEST_CHECK(rgbled_WaitFrame(seq, osWaitForever));
+  TEST_EQUAL(host_tick, 106);
+
+  test_Set(0, 9, 9, 9);
+  test_Poison();
+  seq = rgbled_Commit();
+  TEST_EQUAL(test_frames, 6);
+  test_CheckBuffer(TEST_ALL_LEDS);
+  test_Complete();
+  TEST_CHECK(rgbled_WaitFrame(seq, 0));
+
+  host_pfnFlagsWait = NULL;
+}
+
+int main(void)
+{
+  test_Commit();
+  test_Replace();
+  test_Wait();
+  return test_Report("led_control");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
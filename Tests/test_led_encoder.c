@@ -0,0 +1,372 @@
+/**
+  ******************************************************************************
+  * @file    test_led_encoder.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the WS2812 encoders
+  *          Each encoder is compared bit for bit with a per-bit reference
+  *          loop like the one it replaced.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "led_encoder.h"
+#include "test_common.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_ONE                ((uint32_t)RGB_LED_PIN)
+#define TEST_ZERO               ((uint32_t)RGB_LED_PIN << 16)
+#define TEST_STREAM_LEDS        64
+#define TEST_TIM8_CLOCK         168000000U  // APB2 timer clock of TIM8
+
+// WS2812 high and low times of a 0 and a 1 bit, +-150 ns
+#define TEST_T0H_NS             400
+#define TEST_T0L_NS             850
+#define TEST_T1H_NS             800
+#define TEST_T1L_NS             450
+#define TEST_TOLERANCE_NS       150
+/* function prototypes -------------------------------------------------------*/
+
+// the branch per bit loop of the original led_control.c
+static void test_RefPixel(uint32_t* p_buf, uint8_t red, uint8_t green, uint8_t blue)
+{
+  const uint8_t grb[3] = { green, red, blue };
+
+  for (uint32_t color = 0; color < 3; color++)
+  {
+    for (int32_t bit = 7; bit >= 0; bit--)
+    {
+      if ((grb[color] >> bit) & 0x01)
+        *p_buf++ = TEST_ONE;
+      else
+        *p_buf++ = TEST_ZERO;
+    }
+  }
+}
+
+static void test_Pixel(void)
+{
+  uint32_t ref[RGB_LED_PIXEL_SIZE];
+  uint32_t buf[RGB_LED_PIXEL_SIZE];
+  uint32_t wrong = 0;
+
+  // every color
+  for (uint32_t color = 0; color < (1U << 24); color++)
+  {
+    test_RefPixel(ref, (uint8_t)(color >> 16), (uint8_t)(color >> 8), (uint8_t)color);
+    ledenc_EncodePixel(buf, (uint8_t)(color >> 16), (uint8_t)(color >> 8), (uint8_t)color);
+    if (memcmp(ref, buf, sizeof(ref)) != 0)
+      wrong++;
+  }
+  TEST_EQUAL(wrong, 0);
+
+  // one color over the strip
+  uint32_t strip[RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED];
+  ledenc_EncodePixel(strip, 0x12, 0x34, 0x56);
+  ledenc_FillPixels(strip, MAX_WS28XX_LED);
+  test_RefPixel(ref, 0x12, 0x34, 0x56);
+  for (uint32_t led = 0; led < MAX_WS28XX_LED; led++)
+    TEST_CHECK(memcmp(&strip[led * RGB_LED_PIXEL_SIZE], ref, sizeof(ref)) == 0);
+}
+
+// the frame sent through the two halves of the stream buffer, each half
+// refilled once the DMA has sent it, must be the whole frame encoded at once
+static void test_Stream(uint32_t ledCount)
+{
+  static uint8_t frame[TEST_STREAM_LEDS * 3];
+  static uint32_t whole[TEST_STREAM_LEDS * RGB_LED_PIXEL_SIZE];
+  static uint32_t sent[TEST_STREAM_LEDS * RGB_LED_PIXEL_SIZE + 2 * RGBLED_STREAM_BUFFER_SIZE];
+  uint32_t ring[RGBLED_STREAM_BUFFER_SIZE];
+  const uint32_t half = RGBLED_STREAM_BUFFER_SIZE / 2;
+  uint32_t next = 0;
+  uint32_t sentLen = 0;
+
+  if ((ledCount == 0) || (ledCount > TEST_STREAM_LEDS))
+    return;
+
+  for (uint32_t idx = 0; idx < (ledCount * 3); idx++)
+    frame[idx] = (uint8_t)(idx * 37 + ledCount);
+
+  for (uint32_t led = 0; led < ledCount; led++)
+    test_RefPixel(&whole[led * RGB_LED_PIXEL_SIZE], frame[led * 3 + 1], frame[led * 3], frame[led * 3 + 2]);
+
+  // both halves before the start, then a refill per half sent
+  ledenc_EncodeFrame(&ring[0], frame, next, RGBLED_STREAM_HALF_LEDS, ledCount);
+  next += RGBLED_STREAM_HALF_LEDS;
+  ledenc_EncodeFrame(&ring[half], frame, next, RGBLED_STREAM_HALF_LEDS, ledCount);
+  next += RGBLED_STREAM_HALF_LEDS;
+
+  for (uint32_t part = 0; sentLen < (ledCount * RGB_LED_PIXEL_SIZE + RGBLED_STREAM_BUFFER_SIZE); part++)
+  {
+    uint32_t* p_half = &ring[(part & 1) * half];
+    memcpy(&sent[sentLen], p_half, half * sizeof(uint32_t));
+    sentLen += half;
+    ledenc_EncodeFrame(p_half, frame, next, RGBLED_STREAM_HALF_LEDS, ledCount);
+    next += RGBLED_STREAM_HALF_LEDS;
+  }
+
+  TEST_CHECK(memcmp(sent, whole, ledCount * RGB_LED_PIXEL_SIZE * sizeof(uint32_t)) == 0);
+
+  // past the last LED the line is left alone until the DMA is stopped
+  uint32_t set = 0;
+  for (uint32_t word = ledCount * RGB_LED_PIXEL_SIZE; word < sentLen; word++)
+    set |= sent[word];
+  TEST_EQUAL(set, 0);
+}
+
+// BSRR word of one data bit of parallel strips, set or reset per strip
+static uint32_t test_RefStripWord(const uint8_t* p_frames, uint32_t stripCount, uint32_t idx, uint32_t bit)
+{
+  uint32_t word = 0;
+
+  for (uint32_t strip = 0; strip < stripCount; strip++)
+  {
+    uint32_t pin = (uint32_t)RGB_LED_PIN << strip;
+    if (p_frames[strip * RGB_LED_FRAME_SIZE + idx] & (0x80 >> bit))
+      word |= pin;
+    else
+      word |= pin << 16;
+  }
+  return word;
+}
+
+static void test_Strips(void)
+{
+  static uint8_t frames[8 * RGB_LED_FRAME_SIZE];
+  uint32_t buf[RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED];
+  uint32_t wrong = 0;
+
+  srand(1);
+  for (uint32_t idx = 0; idx < sizeof(frames); idx++)
+    frames[idx] = (uint8_t)rand();
+
+  // every strip count and every part of the frame
+  for (uint32_t stripCount = 1; stripCount <= 8; stripCount++)
+  {
+    for (uint32_t first = 0; first < MAX_WS28XX_LED; first++)
+    {
+      for (uint32_t count = 1; (first + count) <= MAX_WS28XX_LED; count++)
+      {
+        memset(buf, 0xA5, sizeof(buf));
+        ledenc_EncodeStrips(buf, frames, stripCount, first, count);
+        for (uint32_t idx = first * 3; idx < ((first + count) * 3); idx++)
+        {
+          for (uint32_t bit = 0; bit < 8; bit++)
+          {
+            if (buf[(idx - first * 3) * 8 + bit] != test_RefStripWord(frames, stripCount, idx, bit))
+              wrong++;
+          }
+        }
+        // nothing written past the part
+        if ((count < MAX_WS28XX_LED) && (buf[count * RGB_LED_PIXEL_SIZE] != 0xA5A5A5A5U))
+          wrong++;
+      }
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+
+  // every byte value on every strip of the transpose
+  for (uint32_t strip = 0; strip < 8; strip++)
+  {
+    for (uint32_t value = 0; value < 256; value++)
+    {
+      frames[strip * RGB_LED_FRAME_SIZE] = (uint8_t)value;
+      ledenc_EncodeStrips(buf, frames, 8, 0, 1);
+      for (uint32_t bit = 0; bit < 8; bit++)
+      {
+        if (buf[bit] != test_RefStripWord(frames, 8, 0, bit))
+          wrong++;
+      }
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+
+  // a single strip is the plain frame encoding
+  uint32_t single[RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED];
+  ledenc_EncodeStrips(buf, frames, 1, 0, MAX_WS28XX_LED);
+  ledenc_EncodeFrame(single, frames, 0, MAX_WS28XX_LED, MAX_WS28XX_LED);
+  TEST_CHECK(memcmp(buf, single, sizeof(buf)) == 0);
+}
+
+// high and low time of one data bit within the WS2812 tolerance
+static void test_CheckBit(bool bOne, double highNs, double lowNs)
+{
+  double wantHigh = bOne ? TEST_T1H_NS : TEST_T0H_NS;
+  double wantLow = bOne ? TEST_T1L_NS : TEST_T0L_NS;
+
+  TEST_CHECK((highNs >= (wantHigh - TEST_TOLERANCE_NS)) && (highNs <= (wantHigh + TEST_TOLERANCE_NS)));
+  TEST_CHECK((lowNs >= (wantLow - TEST_TOLERANCE_NS)) && (lowNs <= (wantLow + TEST_TOLERANCE_NS)));
+}
+
+static void test_Spi(void)
+{
+  static uint8_t frame[256 * 3];
+  static uint8_t buf[256 * RGBLED_SPI_BYTES_PER_LED];
+  uint32_t wrong = 0;
+
+  // every byte value in every color position
+  for (uint32_t idx = 0; idx < sizeof(frame); idx++)
+    frame[idx] = (uint8_t)(idx / 3);
+  ledenc_EncodeSpi(buf, frame, 0, 256);
+
+  for (uint32_t idx = 0; idx < sizeof(frame); idx++)
+  {
+    uint32_t bits = ((uint32_t)buf[idx * 3] << 16) | ((uint32_t)buf[idx * 3 + 1] << 8) | buf[idx * 3 + 2];
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+      uint32_t code = (bits >> (21 - bit * 3)) & 0x07;
+      if (code != (((frame[idx] >> (7 - bit)) & 0x01) ? 0x06U : 0x04U))
+        wrong++;
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+
+  // a part lands at its own offset
+  uint8_t part[2 * RGBLED_SPI_BYTES_PER_LED];
+  ledenc_EncodeSpi(part, frame, 100, 2);
+  TEST_CHECK(memcmp(part, &buf[100 * RGBLED_SPI_BYTES_PER_LED], sizeof(part)) == 0);
+
+  // pulse times over the SCK range, 1 or 2 high bits of 3
+  static const double sckHz[] = { 2250000.0, 2400000.0, 2500000.0 };
+  for (uint32_t idx = 0; idx < (sizeof(sckHz) / sizeof(sckHz[0])); idx++)
+  {
+    double bitNs = 1e9 / sckHz[idx];
+    test_CheckBit(false, bitNs, 2 * bitNs);
+    test_CheckBit(true, 2 * bitNs, bitNs);
+  }
+
+  // the latch bytes still in the buffer when the DMA completes hold MOSI low long enough
+  TEST_CHECK(((RGBLED_SPI_LATCH_BYTES - 2) * 8 * 10) >= (RGBLED_LATCH_US * 24));
+  double latchUs = (RGBLED_SPI_LATCH_BYTES - 2) * 8 / 2.4;
+  printf("led_encoder: SPI at 2.4 MHz T0H %.0f ns, T1H %.0f ns, latch %.1f us\n", 1e9 / 2.4e6, 2e9 / 2.4e6, latchUs);
+}
+
+static void test_Pwm(void)
+{
+  static uint8_t frame[256 * 3];
+  static uint16_t buf[256 * RGB_LED_PIXEL_SIZE];
+  uint32_t period = TEST_TIM8_CLOCK / WS2812_FREQ;
+  uint16_t ccr0 = (uint16_t)((period * RGBLED_PWM_T0H_PERCENT + 50) / 100);
+  uint16_t ccr1 = (uint16_t)((period * RGBLED_PWM_T1H_PERCENT + 50) / 100);
+  uint32_t wrong = 0;
+
+  for (uint32_t idx = 0; idx < sizeof(frame); idx++)
+    frame[idx] = (uint8_t)(idx / 3 + idx);
+  ledenc_EncodePwm(buf, frame, 0, 256, ccr0, ccr1);
+
+  for (uint32_t idx = 0; idx < sizeof(frame); idx++)
+  {
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+      if (buf[idx * 8 + bit] != (((frame[idx] >> (7 - bit)) & 0x01) ? ccr1 : ccr0))
+        wrong++;
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+
+  uint16_t part[RGB_LED_PIXEL_SIZE];
+  ledenc_EncodePwm(part, frame, 77, 1, ccr0, ccr1);
+  TEST_CHECK(memcmp(part, &buf[77 * RGB_LED_PIXEL_SIZE], sizeof(part)) == 0);
+
+  // compare values of the 1.25 us period against the pulse times
+  double tickNs = 1e9 / TEST_TIM8_CLOCK;
+  test_CheckBit(false, ccr0 * tickNs, (period - ccr0) * tickNs);
+  test_CheckBit(true, ccr1 * tickNs, (period - ccr1) * tickNs);
+  TEST_CHECK((RGBLED_LATCH_SLOTS * 1000000ULL) >= ((uint64_t)RGBLED_LATCH_US * WS2812_FREQ));
+  printf("led_encoder: PWM T0H %.0f ns, T1H %.0f ns, latch %u slots\n", ccr0 * tickNs, ccr1 * tickNs, (unsigned)RGBLED_LATCH_SLOTS);
+}
+
+// encode time per pixel on the host, for comparison only
+static void test_PixelTime(void)
+{
+  static uint32_t buf[RGB_LED_PIXEL_SIZE * 1024];
+  const uint32_t rounds = 2000;
+  uint32_t sum = 0;
+
+  double start = test_Seconds();
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    for (uint32_t led = 0; led < 1024; led++)
+      test_RefPixel(&buf[led * RGB_LED_PIXEL_SIZE], (uint8_t)(led * 7 + round), (uint8_t)led, (uint8_t)(led ^ round));
+    sum += buf[round % (sizeof(buf) / sizeof(buf[0]))];
+  }
+  double refNs = (test_Seconds() - start) * 1e9 / (rounds * 1024.0);
+
+  start = test_Seconds();
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    for (uint32_t led = 0; led < 1024; led++)
+      ledenc_EncodePixel(&buf[led * RGB_LED_PIXEL_SIZE], (uint8_t)(led * 7 + round), (uint8_t)led, (uint8_t)(led ^ round));
+    sum += buf[round % (sizeof(buf) / sizeof(buf[0]))];
+  }
+  double tableNs = (test_Seconds() - start) * 1e9 / (rounds * 1024.0);
+
+  printf("led_encoder: %.1f ns per pixel, per-bit loop %.1f ns (%08x)\n", tableNs, refNs, (unsigned)sum);
+}
+
+// encode time of a full frame of 8 parallel strips on the host, for comparison only
+static void test_StripsTime(void)
+{
+  static uint8_t frames[8 * RGB_LED_FRAME_SIZE];
+  static uint32_t buf[RGB_LED_PIXEL_SIZE * MAX_WS28XX_LED];
+  const uint32_t rounds = 20000;
+  uint32_t sum = 0;
+
+  for (uint32_t idx = 0; idx < sizeof(frames); idx++)
+    frames[idx] = (uint8_t)(idx * 31);
+
+  double start = test_Seconds();
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    frames[round % sizeof(frames)]++;
+    for (uint32_t idx = 0; idx < RGB_LED_FRAME_SIZE; idx++)
+    {
+      for (uint32_t bit = 0; bit < 8; bit++)
+        buf[idx * 8 + bit] = test_RefStripWord(frames, 8, idx, bit);
+    }
+    sum += buf[round % (sizeof(buf) / sizeof(buf[0]))];
+  }
+  double refNs = (test_Seconds() - start) * 1e9 / rounds;
+
+  start = test_Seconds();
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    frames[round % sizeof(frames)]++;
+    ledenc_EncodeStrips(buf, frames, 8, 0, MAX_WS28XX_LED);
+    sum += buf[round % (sizeof(buf) / sizeof(buf[0]))];
+  }
+  double stripNs = (test_Seconds() - start) * 1e9 / rounds;
+
+  printf("led_encoder: 8 strips of %u LEDs %.2f us per frame, per-strip per-bit loop %.2f us (%08x)\n",
+         (unsigned)MAX_WS28XX_LED, stripNs / 1000, refNs / 1000, (unsigned)sum);
+}
+
+int main(void)
+{
+  test_Pixel();
+  test_Stream(MAX_WS28XX_LED);
+  for (uint32_t ledCount = 1; ledCount <= TEST_STREAM_LEDS; ledCount++)
+    test_Stream(ledCount);
+  test_Strips();
+  test_Spi();
+  test_Pwm();
+  test_PixelTime();
+  test_StripsTime();
+  return test_Report("led_encoder");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
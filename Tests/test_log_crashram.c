@@ -0,0 +1,164 @@
+/**
+  ******************************************************************************
+  * @file    test_log_crashram.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the crash surviving RAM log
+  *          Checks the ring recovery order, torn and foreign content, and the
+  *          replay of the records by the next logger_Init.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_crashram.h"
+#include "logger.h"
+#include "cmsis_os.h"
+#include "test_common.h"
+
+#include <setjmp.h>
+#include <string.h>
+/* Private variables ---------------------------------------------------------*/
+static logCrashRing_t test_ring;
+static loggerRecord_t test_restored[LOGCRASH_RECORD_COUNT + 1];
+static uint32_t test_restoredCount;
+static jmp_buf test_loggerExit;
+static uint32_t test_waits;
+/* function prototypes -------------------------------------------------------*/
+
+static void test_Restore(const loggerRecord_t* record)
+{
+  if (test_restoredCount < (sizeof(test_restored) / sizeof(test_restored[0])))
+    test_restored[test_restoredCount] = *record;
+  test_restoredCount++;
+}
+
+static uint32_t test_Recover(void)
+{
+  test_restoredCount = 0;
+  return logcrash_Recover(&test_ring, test_Restore);
+}
+
+static void test_Append(uint32_t n)
+{
+  loggerRecord_t record = { .timestamp = 1000 + n, .level = LOGGER_LEVEL_WARN, .msgId = LOGMSG_LOG_DROPPED, .len = 4 };
+  record.args[0] = n;
+  logcrash_Append(&test_ring, &record);
+}
+
+static void test_LoggerWait(void)
+{
+  if (++test_waits > 1)
+    longjmp(test_loggerExit, 1);
+}
+
+static void test_RunLogger(void)
+{
+  test_waits = 0;
+  host_pfnThreadWait = test_LoggerWait;
+  if (setjmp(test_loggerExit) == 0)
+    StartLoggerTask(NULL);
+  host_pfnThreadWait = NULL;
+}
+
+static void test_Ring(void)
+{
+  // CRC-16/CCITT-FALSE check value
+  TEST_EQUAL(logcrash_Crc16(LOGCRASH_CRC_INIT, (const uint8_t*)"123456789", 9), 0x29B1);
+
+  // power-on content is not a ring
+  memset(&test_ring, 0xA5, sizeof(test_ring));
+  TEST_EQUAL(test_Recover(), 0);
+
+  logcrash_Reset(&test_ring);
+  TEST_EQUAL(test_Recover(), 0);
+
+  for (uint32_t n = 0; n < 5; n++)
+    test_Append(n);
+  TEST_EQUAL(test_Recover(), 5);
+  for (uint32_t n = 0; n < 5; n++)
+  {
+    TEST_EQUAL(test_restored[n].args[0], n);
+    TEST_EQUAL(test_restored[n].timestamp, 1000 + n);
+    TEST_EQUAL(test_restored[n].msgId, LOGMSG_LOG_DROPPED);
+  }
+
+  // after wrapping only the newest records remain, oldest first
+  for (uint32_t n = 5; n < (LOGCRASH_RECORD_COUNT + 10); n++)
+    test_Append(n);
+  TEST_EQUAL(test_Recover(), LOGCRASH_RECORD_COUNT);
+  TEST_EQUAL(test_restored[0].args[0], 10);
+  TEST_EQUAL(test_restored[LOGCRASH_RECORD_COUNT - 1].args[0], LOGCRASH_RECORD_COUNT + 9);
+
+  // a slot torn by the reset is skipped
+  test_ring.slots[(LOGCRASH_RECORD_COUNT + 9) % LOGCRASH_RECORD_COUNT].payload[0] ^= 0x01;
+  TEST_EQUAL(test_Recover(), LOGCRASH_RECORD_COUNT - 1);
+  TEST_EQUAL(test_restored[LOGCRASH_RECORD_COUNT - 2].args[0], LOGCRASH_RECORD_COUNT + 8);
+
+  // text is cut to the slot payload
+  loggerRecord_t record = { .level = LOGGER_LEVEL_ERROR, .msgId = LOGMSG_TEXT };
+  record.len = (uint8_t)strlen(strcpy(record.text, "[TEST] - a longer text than the payload"));
+  logcrash_Reset(&test_ring);
+  logcrash_Append(&test_ring, &record);
+  TEST_EQUAL(test_Recover(), 1);
+  TEST_EQUAL(test_restored[0].len, LOGCRASH_PAYLOAD_LEN);
+  TEST_CHECK(memcmp(test_restored[0].text, record.text, LOGCRASH_PAYLOAD_LEN) == 0);
+}
+
+static void test_Replay(void)
+{
+  loggerRecord_t records[LOGGER_RAM_RECORD_COUNT];
+
+  logger_Init();
+  test_RunLogger();
+  uint32_t base = logger_ReadRamLog(records, LOGGER_RAM_RECORD_COUNT);
+
+  // logged and lost in the queue by a reset before the logger task ran
+  LOGGER_LOG_MSG(LOGMSG_LOG_DROPPED, 1, 0x1234);
+  logger_LogError("[TEST] - before reset", "");
+
+  logger_Init();
+  test_RunLogger();
+  TEST_EQUAL(logger_ReadRamLog(records, LOGGER_RAM_RECORD_COUNT), base + 3);
+
+  loggerRecord_t* logged = &records[base];
+  TEST_EQUAL(logged[0].msgId, LOGMSG_LOG_DROPPED);
+  TEST_EQUAL(logged[0].args[0], 0x1234);
+  TEST_EQUAL(logged[1].msgId, LOGMSG_TEXT);
+  TEST_CHECK(memcmp(logged[1].text, "[TEST] - before reset", LOGCRASH_PAYLOAD_LEN) == 0);
+  TEST_EQUAL(logged[2].msgId, LOGMSG_LOG_CRASH_RECOVERED);
+  TEST_EQUAL(logged[2].args[0], 2);
+
+  // only the replayed records are flagged, they get tick 0 on the SD card
+  TEST_EQUAL(logged[0].bReplayed, 1);
+  TEST_EQUAL(logged[1].bReplayed, 1);
+  TEST_EQUAL(logged[2].bReplayed, 0);
+  TEST_EQUAL(logged[1].level, LOGGER_LEVEL_ERROR);
+
+  // the replay is not replayed again
+  logger_Init();
+  test_RunLogger();
+  TEST_EQUAL(logger_ReadRamLog(records, LOGGER_RAM_RECORD_COUNT), base + 2);
+  TEST_EQUAL(records[base + 1].msgId, LOGMSG_LOG_CRASH_RECOVERED);
+  TEST_EQUAL(records[base + 1].args[0], 1);
+  TEST_EQUAL(records[base].bReplayed, 1);
+}
+
+int main(void)
+{
+  test_Ring();
+  test_Replay();
+  return test_Report("log_crashram");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
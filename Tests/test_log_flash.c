@@ -0,0 +1,233 @@
+/**
+  ******************************************************************************
+  * @file    test_log_flash.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the FLASH log store on a RAM device
+  *          The device behaves like NOR FLASH: programming only clears bits
+  *          and an erase sets a whole sector. Checks the head found again
+  *          after a reset, the wrap with erase at boot, a torn page and the
+  *          refusal of an area holding foreign data.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_flash.h"
+#include "errorcode.h"
+#include "test_common.h"
+
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_SECTOR_SIZE        (16U * LOGFLASH_PAGE_SIZE)
+#define TEST_SECTOR_COUNT       4
+#define TEST_RECORD_SIZE        40
+#define TEST_SECTOR_PAGES       (TEST_SECTOR_SIZE / LOGFLASH_PAGE_SIZE)
+#define TEST_PAGES              (TEST_SECTOR_PAGES * TEST_SECTOR_COUNT)
+#define TEST_PAGE_RECORDS       (LOGFLASH_PAGE_PAYLOAD / TEST_RECORD_SIZE)
+/* Private variables ---------------------------------------------------------*/
+static uint8_t test_mem[TEST_SECTOR_SIZE * TEST_SECTOR_COUNT];
+static uint32_t test_erases;
+static uint32_t test_next;                      // record number of the next record
+static uint32_t test_expect;                    // next record number while reading back
+static uint32_t test_wrong;
+static uint32_t test_records;
+
+// the program image symbols checked for the internal device
+uint32_t _sidata, _sdata, _edata;
+/* function prototypes -------------------------------------------------------*/
+
+static uint32_t test_Read(uint32_t offset, void* pData, uint32_t size)
+{
+  memcpy(pData, &test_mem[offset], size);
+  return PER_NO_ERROR;
+}
+
+static uint32_t test_Program(uint32_t offset, const void* pData, uint32_t size)
+{
+  const uint8_t* pSrc = pData;
+
+  for (uint32_t idx = 0; idx < size; idx++)
+    test_mem[offset + idx] &= pSrc[idx];
+  return PER_NO_ERROR;
+}
+
+static uint32_t test_Erase(uint32_t sectorIdx)
+{
+  memset(&test_mem[sectorIdx * TEST_SECTOR_SIZE], 0xFF, TEST_SECTOR_SIZE);
+  test_erases++;
+  return PER_NO_ERROR;
+}
+
+static const logFlashDev_t test_dev = {
+  .pfnRead = test_Read,
+  .pfnProgram = test_Program,
+  .pfnErase = test_Erase,
+  .sectorSize = TEST_SECTOR_SIZE,
+  .sectorCount = TEST_SECTOR_COUNT,
+};
+
+// records are numbered, the first one read back sets the expected start
+static void test_Page(uint32_t seq, const uint8_t* pPayload, uint32_t len, void* ctx)
+{
+  uint32_t* pLastSeq = ctx;
+
+  if ((test_records > 0) && (seq != (*pLastSeq + 1)))
+    test_wrong++;
+  *pLastSeq = seq;
+
+  if ((len % TEST_RECORD_SIZE) != 0)
+    test_wrong++;
+  for (uint32_t pos = 0; (pos + TEST_RECORD_SIZE) <= len; pos += TEST_RECORD_SIZE)
+  {
+    uint32_t n;
+    memcpy(&n, &pPayload[pos], sizeof(n));
+    if ((test_records > 0) && (n != test_expect))
+      test_wrong++;
+    test_expect = n + 1;
+    test_records++;
+  }
+}
+
+static uint32_t test_ReadBack(void)
+{
+  uint32_t lastSeq = 0;
+
+  test_records = 0;
+  test_wrong = 0;
+  return logflash_ForEachPage(test_Page, &lastSeq);
+}
+
+static bool test_Write(void)
+{
+  uint8_t record[TEST_RECORD_SIZE];
+
+  if (!logflash_IsReady(sizeof(record)))
+    return false;
+
+  memset(record, (int)test_next, sizeof(record));
+  memcpy(record, &test_next, sizeof(test_next));
+  TEST_EQUAL(logflash_Write(record, sizeof(record)), PER_NO_ERROR);
+  test_next++;
+  return true;
+}
+
+static void test_Reboot(void)
+{
+  logFlashStats_t before;
+  logFlashStats_t after;
+
+  logflash_GetStats(&before);
+  TEST_EQUAL(logflash_Init(&test_dev), PER_NO_ERROR);
+  logflash_GetStats(&after);
+  TEST_EQUAL(after.headSeq, before.headSeq);
+}
+
+static void test_Store(void)
+{
+  logFlashStats_t stats;
+
+  memset(test_mem, 0xFF, sizeof(test_mem));
+  TEST_EQUAL(logflash_Init(&test_dev), PER_NO_ERROR);
+  TEST_EQUAL(test_erases, 0);
+  TEST_EQUAL(test_ReadBack(), 0);
+
+  // a flush programs the partial page, the head survives a reset
+  for (uint32_t n = 0; n < 20; n++)
+    TEST_CHECK(test_Write());
+  logflash_Flush();
+  test_Reboot();
+  TEST_EQUAL(test_ReadBack(), 4);
+  TEST_EQUAL(test_records, 20);
+  TEST_EQUAL(test_wrong, 0);
+
+  // without runtime erase the store fills the erased sectors and stops
+  while (test_Write())
+    logflash_Poll(true);
+  logflash_GetStats(&stats);
+  TEST_EQUAL(stats.erases, 0);
+  TEST_EQUAL(stats.errors, 0);
+  TEST_EQUAL(test_ReadBack(), TEST_PAGES);
+  TEST_EQUAL(test_wrong, 0);
+
+  // the page buffer of the full store is lost with the reset, the next boot
+  // erases the oldest sector and the store continues
+  test_next = test_expect;
+  test_Reboot();
+  TEST_EQUAL(test_erases, 1);
+  TEST_EQUAL(test_ReadBack(), TEST_PAGES - TEST_SECTOR_PAGES);
+  for (uint32_t n = 0; n < (10 * TEST_PAGE_RECORDS); n++)
+    TEST_CHECK(test_Write());
+  logflash_Flush();
+
+  uint32_t pages = test_ReadBack();
+  TEST_EQUAL(pages, TEST_PAGES - TEST_SECTOR_PAGES + 10);
+  TEST_EQUAL(test_wrong, 0);
+  TEST_EQUAL(test_expect, test_next);
+
+  // a payload torn by a reset fails its CRC, its page stays used
+  logflash_GetStats(&stats);
+  uint32_t tornSeq = stats.headSeq - 1;
+  uint32_t lastPage = 0;
+  for (uint32_t page = 0; page < (sizeof(test_mem) / LOGFLASH_PAGE_SIZE); page++)
+  {
+    logFlashPageHdr_t hdr;
+    memcpy(&hdr, &test_mem[page * LOGFLASH_PAGE_SIZE], sizeof(hdr));
+    if ((hdr.magic == LOGFLASH_MAGIC) && (hdr.seq == tornSeq))
+      lastPage = page;
+  }
+  test_mem[(lastPage * LOGFLASH_PAGE_SIZE) + sizeof(logFlashPageHdr_t) + 5] &= 0x0F;
+
+  // the boot also erases the sector after the head, the oldest one
+  test_Reboot();
+  TEST_EQUAL(test_erases, 2);
+  TEST_EQUAL(test_ReadBack(), pages - TEST_SECTOR_PAGES - 1);
+  TEST_EQUAL(test_wrong, 0);
+  TEST_CHECK(test_Write());
+  logflash_Flush();
+  TEST_EQUAL(test_ReadBack(), pages - TEST_SECTOR_PAGES);
+  TEST_EQUAL(test_wrong, 2);      // the sequence and the records skip the torn page
+}
+
+static void test_Foreign(void)
+{
+  logFlashStats_t stats;
+
+  // another owner's data is never erased
+  memset(test_mem, 0xFF, sizeof(test_mem));
+  memcpy(&test_mem[2 * TEST_SECTOR_SIZE + 100], "calibration", 11);
+  test_erases = 0;
+  TEST_EQUAL(logflash_Init(&test_dev), PER_ERROR_FLASH_FOREIGN);
+  TEST_CHECK(!logflash_IsReady(TEST_RECORD_SIZE));
+  TEST_EQUAL(logflash_ForEachPage(test_Page, NULL), 0);
+  TEST_EQUAL(test_erases, 0);
+  TEST_CHECK(memcmp(&test_mem[2 * TEST_SECTOR_SIZE + 100], "calibration", 11) == 0);
+
+  // a sector whose first header was torn before its sequence is skipped
+  memset(test_mem, 0xFF, sizeof(test_mem));
+  uint32_t magic = LOGFLASH_MAGIC;
+  memcpy(&test_mem[TEST_SECTOR_SIZE], &magic, sizeof(magic));
+  TEST_EQUAL(logflash_Init(&test_dev), PER_NO_ERROR);
+  logflash_GetStats(&stats);
+  TEST_EQUAL(stats.headSeq, 0);
+  TEST_CHECK(test_Write());
+}
+
+int main(void)
+{
+  test_Store();
+  test_Foreign();
+  return test_Report("log_flash");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,223 @@
+/**
+  ******************************************************************************
+  * @file    test_log_format.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the allocation-free log formatter
+  *          The number conversions are compared with the C library printf,
+  *          which only the host test uses.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_format.h"
+#include "errorcode.h"
+#include "test_common.h"
+
+#include <stdlib.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_ERRORCODE_H        "../Inc/errorcode.h"
+#define TEST_ROUNDS             200000
+/* Private variables ---------------------------------------------------------*/
+static const char* const test_formats[] = {
+  "%u", "%d", "%x", "%X", "%lu", "%ld", "%5u", "%05u", "%5d", "%05d",
+  "%8x", "%08X", "%2u", "%1d", "%010d", "%12u",
+};
+/* function prototypes -------------------------------------------------------*/
+
+static const char* test_Args(char* buf, uint32_t size, const char* format, const uint32_t* args, uint32_t nArgs)
+{
+  logFmt_t fmt;
+
+  logfmt_Init(&fmt, buf, size);
+  logfmt_Args(&fmt, format, args, nArgs);
+  logfmt_End(&fmt);
+  return buf;
+}
+
+static void test_Numbers(void)
+{
+  static const uint32_t values[] = { 0, 1, 9, 10, 99, 12345, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, (uint32_t)-5, (uint32_t)-12345 };
+  uint32_t wrong = 0;
+  char buf[64];
+  char ref[64];
+
+  srand(1);
+  for (uint32_t idx = 0; idx < 20000; idx++)
+  {
+    const char* format = test_formats[idx % (sizeof(test_formats) / sizeof(test_formats[0]))];
+    uint32_t value = (idx < 200) ? values[idx % (sizeof(values) / sizeof(values[0]))] :
+        ((((uint32_t)rand() << 16) ^ (uint32_t)rand()) >> (idx % 31));
+
+    test_Args(buf, sizeof(buf), format, &value, 1);
+    if (strchr(format, 'd') != NULL)
+      snprintf(ref, sizeof(ref), strchr(format, 'l') ? "%d" : format, (int32_t)value);
+    else
+      snprintf(ref, sizeof(ref), strchr(format, 'l') ? "%u" : format, value);
+
+    if (strcmp(buf, ref) != 0)
+    {
+      if (wrong++ < 5)
+        printf("\"%s\" of %u: \"%s\", printf \"%s\"\n", format, (unsigned)value, buf, ref);
+    }
+  }
+  TEST_EQUAL(wrong, 0);
+}
+
+static void test_Text(void)
+{
+  static const uint32_t args[] = { 3, PER_ERROR_INIT, 0x9999 };
+  logFmt_t fmt;
+  char buf[64];
+
+  TEST_CHECK(strcmp(test_Args(buf, sizeof(buf), "step %u, error %E, %E", args, 3),
+                    "step 3, error INIT(0x0001), 0x9999") == 0);
+  TEST_CHECK(strcmp(test_Args(buf, sizeof(buf), "%E", (const uint32_t[]){ PER_NO_ERROR }, 1),
+                    "NO_ERROR(0x0000)") == 0);
+  TEST_CHECK(strcmp(test_Args(buf, sizeof(buf), "100%% %u %u", args, 1), "100% 3 0") == 0);
+  TEST_CHECK(strcmp(test_Args(buf, sizeof(buf), "end %", args, 1), "end ") == 0);
+
+  logfmt_Init(&fmt, buf, sizeof(buf));
+  logfmt_StrPad(&fmt, "Warn", 6);
+  logfmt_Str(&fmt, " - ");
+  logfmt_Hex(&fmt, 0xAB, 4);
+  logfmt_Char(&fmt, ' ');
+  logfmt_Dec(&fmt, -42);
+  TEST_EQUAL(logfmt_End(&fmt), strlen("  Warn - 0x00AB -42"));
+  TEST_CHECK(strcmp(buf, "  Warn - 0x00AB -42") == 0);
+  TEST_CHECK(!fmt.bTruncated);
+}
+
+static void test_ErrorNames(void)
+{
+  FILE* f = fopen(TEST_ERRORCODE_H, "r");
+  char line[160];
+  char name[64];
+  char base[32];
+  char buf[80];
+  char ref[80];
+  uint32_t offset;
+  uint32_t count = 0;
+
+  // every code defined in errorcode.h prints by its name
+  TEST_CHECK(f != NULL);
+  while ((f != NULL) && (fgets(line, sizeof(line), f) != NULL))
+  {
+    if (sscanf(line, " #define %63s (%31[A-Z_] + %u)", name, base, &offset) != 3)
+      continue;
+    if (strncmp(name, "PER_", 4) != 0)
+      continue;
+
+    uint32_t code = offset + ((strcmp(base, "PER_ERROR_APP_NUM") == 0) ? PER_ERROR_APP_NUM : PER_ERROR_BASE_NUM);
+    snprintf(ref, sizeof(ref), "%s(0x%04X)", name + ((strncmp(name, "PER_ERROR_", 10) == 0) ? 10 : 4), (unsigned)code);
+    if (strcmp(test_Args(buf, sizeof(buf), "%E", &code, 1), ref) != 0)
+      printf("%s prints \"%s\"\n", name, buf);
+    TEST_CHECK(strcmp(buf, ref) == 0);
+    count++;
+  }
+  if (f != NULL)
+    fclose(f);
+  TEST_CHECK(count > 50);
+}
+
+static void test_Truncation(void)
+{
+  logFmt_t fmt;
+  char buf[12];
+
+  memset(buf, 'x', sizeof(buf));
+  logfmt_Init(&fmt, buf, 8);
+  logfmt_Str(&fmt, "0123456789");
+  logfmt_UDec(&fmt, 42);
+  TEST_EQUAL(logfmt_End(&fmt), 7);
+  TEST_CHECK(fmt.bTruncated);
+  TEST_CHECK(strcmp(buf, "0123456") == 0);
+  TEST_EQUAL(buf[8], 'x');
+}
+
+static void test_Speed(void)
+{
+  static const char sLevel[] = "Info";
+  static const char sMsg[] = "[EXTI] - Receive Start button signal";
+  static const char sArg[] = "SOLENOID_FEEDER_UP";
+  char buf[96];
+  logFmt_t fmt;
+  uint32_t sum = 0;
+
+  // the text line of logger_SaveLogEvents, "%6s - %s.\n"
+  double start = test_Seconds();
+  for (uint32_t idx = 0; idx < TEST_ROUNDS; idx++)
+    sum += (uint32_t)snprintf(buf, sizeof(buf), "%6s - %s.\n", sLevel, sMsg);
+  double lineRef = (test_Seconds() - start) * 1e9 / TEST_ROUNDS;
+
+  start = test_Seconds();
+  for (uint32_t idx = 0; idx < TEST_ROUNDS; idx++)
+  {
+    logfmt_Init(&fmt, buf, sizeof(buf));
+    logfmt_StrPad(&fmt, sLevel, 6);
+    logfmt_Str(&fmt, " - ");
+    logfmt_Str(&fmt, sMsg);
+    logfmt_Str(&fmt, ".\n");
+    sum += logfmt_End(&fmt);
+  }
+  double lineFmt = (test_Seconds() - start) * 1e9 / TEST_ROUNDS;
+
+  // a message with a string argument, "%s: %s"
+  start = test_Seconds();
+  for (uint32_t idx = 0; idx < TEST_ROUNDS; idx++)
+    sum += (uint32_t)snprintf(buf, sizeof(buf), "%s: %s", sMsg, sArg);
+  double argRef = (test_Seconds() - start) * 1e9 / TEST_ROUNDS;
+
+  start = test_Seconds();
+  for (uint32_t idx = 0; idx < TEST_ROUNDS; idx++)
+  {
+    logfmt_Init(&fmt, buf, sizeof(buf));
+    logfmt_Str(&fmt, sMsg);
+    logfmt_Str(&fmt, ": ");
+    logfmt_Str(&fmt, sArg);
+    sum += logfmt_End(&fmt);
+  }
+  double argFmt = (test_Seconds() - start) * 1e9 / TEST_ROUNDS;
+
+  // numbers and an error code from a binary record
+  uint32_t args[3] = { 0, 0xBEEF, PER_ERROR_FLASH_EMPTY };
+  start = test_Seconds();
+  for (uint32_t idx = 0; idx < TEST_ROUNDS; idx++)
+    sum += (uint32_t)snprintf(buf, sizeof(buf), "step %u at %08X, %s(0x%04X)", (unsigned)idx, (unsigned)args[1], "FLASH_EMPTY", (unsigned)args[2]);
+  double numRef = (test_Seconds() - start) * 1e9 / TEST_ROUNDS;
+
+  start = test_Seconds();
+  for (uint32_t idx = 0; idx < TEST_ROUNDS; idx++)
+  {
+    args[0] = idx;
+    sum += (uint32_t)strlen(test_Args(buf, sizeof(buf), "step %u at %08X, %E", args, 3));
+  }
+  double numFmt = (test_Seconds() - start) * 1e9 / TEST_ROUNDS;
+
+  printf("log_format: line %.0f ns, snprintf %.0f ns; \"%%s: %%s\" %.0f ns, snprintf %.0f ns; numbers %.0f ns, snprintf %.0f ns (%u)\n",
+         lineFmt, lineRef, argFmt, argRef, numFmt, numRef, (unsigned)sum);
+}
+
+int main(void)
+{
+  test_Numbers();
+  test_Text();
+  test_ErrorNames();
+  test_Truncation();
+  test_Speed();
+  return test_Report("log_format");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
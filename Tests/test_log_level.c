@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file    test_log_level.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the build and runtime log level filters
+  *          Built with LOGGER_BUILD_LEVEL at WARN: a site below the build
+  *          level must not even evaluate its arguments, a site below the
+  *          runtime level must not reach the queue.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "logger.h"
+#include "cmsis_os.h"
+#include "test_common.h"
+
+#include <setjmp.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#if LOGGER_BUILD_LEVEL != LOGGER_LEVEL_WARN
+#error "test_log_level is built with LOGGER_BUILD_LEVEL=LOGGER_LEVEL_WARN"
+#endif
+#define TEST_ROUNDS             10000000U
+/* Private variables ---------------------------------------------------------*/
+static jmp_buf test_loggerExit;
+static uint32_t test_waits;
+static uint32_t test_evaluated;
+/* function prototypes -------------------------------------------------------*/
+
+static void test_LoggerWait(void)
+{
+  if (++test_waits > 1)
+    longjmp(test_loggerExit, 1);
+}
+
+// one period of the logger task, the queue is drained into the sinks
+static void test_RunLogger(void)
+{
+  test_waits = 0;
+  host_pfnThreadWait = test_LoggerWait;
+  if (setjmp(test_loggerExit) == 0)
+    StartLoggerTask(NULL);
+  host_pfnThreadWait = NULL;
+}
+
+static uint32_t test_Arg(uint32_t value)
+{
+  test_evaluated++;
+  return value;
+}
+
+// ns per call, the volatile loop counter keeps the compiled out calls from
+// removing the loop, every loop pays for it alike
+static void test_Speed(void)
+{
+  volatile uint32_t n;
+  double start;
+  double build;
+  double runtime;
+  double info;
+  double warn;
+  double call;
+
+  logger_SetLevel(LOGGER_LEVEL_ERROR);
+  test_evaluated = 0;
+
+  start = test_Seconds();
+  for (n = 0; n < TEST_ROUNDS; n++)
+    LOGGER_LOG_MSG(LOGMSG_EXTI_START_BUTTON, 1, test_Arg(n));
+  build = test_Seconds() - start;
+
+  start = test_Seconds();
+  for (n = 0; n < TEST_ROUNDS; n++)
+    LOGGER_LOG_MSG(LOGMSG_LOG_DROPPED, 1, test_Arg(n));
+  runtime = test_Seconds() - start;
+
+  start = test_Seconds();
+  for (n = 0; n < TEST_ROUNDS; n++)
+    logger_LogInfo("[TEST] - info", "");
+  info = test_Seconds() - start;
+
+  start = test_Seconds();
+  for (n = 0; n < TEST_ROUNDS; n++)
+    logger_LogWarn("[TEST] - warn", "");
+  warn = test_Seconds() - start;
+
+  // the unfiltered call, the level is only checked inside logger_LogMsg
+  start = test_Seconds();
+  for (n = 0; n < TEST_ROUNDS; n++)
+    logger_LogMsg(LOGMSG_LOG_DROPPED, 1, test_Arg(n));
+  call = test_Seconds() - start;
+
+  TEST_EQUAL(test_evaluated, TEST_ROUNDS);
+  logger_SetLevel(LOGGER_LEVEL_WARN);
+
+  printf("log_level: suppressed LOGGER_LOG_MSG %.2f ns build level, %.2f ns runtime level; "
+         "logger_LogInfo %.2f ns, logger_LogWarn %.2f ns; call into logger_LogMsg %.2f ns\n",
+         build * 1e9 / TEST_ROUNDS, runtime * 1e9 / TEST_ROUNDS, info * 1e9 / TEST_ROUNDS,
+         warn * 1e9 / TEST_ROUNDS, call * 1e9 / TEST_ROUNDS);
+}
+
+int main(void)
+{
+  loggerRecord_t records[LOGGER_RAM_RECORD_COUNT];
+
+  logger_Init();
+  test_RunLogger();
+  memset(records, 0, sizeof(records));
+  uint32_t base = logger_ReadRamLog(records, LOGGER_RAM_RECORD_COUNT);
+
+  // below the build level, removed with its arguments
+  LOGGER_LOG_MSG(LOGMSG_EXTI_START_BUTTON, 1, test_Arg(1));
+  TEST_EQUAL(test_evaluated, 0);
+
+  // runtime level at the build level
+  LOGGER_LOG_MSG(LOGMSG_LOG_DROPPED, 1, test_Arg(7));
+  TEST_EQUAL(test_evaluated, 1);
+  LOGGER_LOG_MSG(LOGMSG_MAIN_IOEXP_INIT_FAIL, 0);
+  logger_LogInfo("[TEST] - info", "");
+  logger_LogWarn("[TEST] - warn", "1");
+
+  // runtime level raised to errors
+  logger_SetLevel(LOGGER_LEVEL_ERROR);
+  LOGGER_LOG_MSG(LOGMSG_LOG_DROPPED, 1, test_Arg(8));
+  TEST_EQUAL(test_evaluated, 1);
+  logger_LogWarn("[TEST] - warn", "2");
+  logger_LogError("[TEST] - error", "3");
+
+  // nothing passes LOGGER_LEVEL_NONE
+  logger_SetLevel(LOGGER_LEVEL_NONE);
+  LOGGER_LOG_MSG(LOGMSG_MAIN_IOEXP_INIT_FAIL, 0);
+  LOGGER_LOG_MSG(LOGMSG_LOG_DROPPED, 1, test_Arg(9));
+  logger_LogError("[TEST] - error", "4");
+  TEST_EQUAL(test_evaluated, 1);
+  logger_SetLevel(LOGGER_LEVEL_WARN);
+
+  test_RunLogger();
+  TEST_EQUAL(logger_ReadRamLog(records, LOGGER_RAM_RECORD_COUNT), base + 4);
+
+  loggerRecord_t* logged = &records[base];
+  TEST_EQUAL(logged[0].msgId, LOGMSG_LOG_DROPPED);
+  TEST_EQUAL(logged[0].args[0], 7);
+  TEST_EQUAL(logged[1].msgId, LOGMSG_MAIN_IOEXP_INIT_FAIL);
+  TEST_EQUAL(logged[1].level, LOGGER_LEVEL_ERROR);
+  TEST_EQUAL(logged[2].msgId, LOGMSG_TEXT);
+  TEST_CHECK(strcmp(logged[2].text, "[TEST] - warn: 1") == 0);
+  TEST_EQUAL(logged[3].level, LOGGER_LEVEL_ERROR);
+  TEST_CHECK(strcmp(logged[3].text, "[TEST] - error: 3") == 0);
+
+  test_Speed();
+
+  return test_Report("log_level");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,174 @@
+/**
+  ******************************************************************************
+  * @file    test_log_queue.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the lock-free log record queue
+  *          Checks order, the full and uncommitted cases and that concurrent
+  *          producers lose no record the queue accepted.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_queue.h"
+#include "test_common.h"
+
+#include <pthread.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_PRODUCERS          4
+#define TEST_RECORDS            20000
+// producer in the top byte of the timestamp, sequence number below
+#define TEST_STAMP(producer, seq) (((producer) << 24) | (seq))
+#define TEST_PRODUCER(record)   ((record).timestamp >> 24)
+#define TEST_SEQ(record)        ((record).timestamp & 0x00FFFFFFU)
+/* Private variables ---------------------------------------------------------*/
+static logQueue_t test_queue;
+static atomic_uint test_accepted;
+static atomic_uint test_finished;
+/* function prototypes -------------------------------------------------------*/
+
+static bool test_Push(uint32_t producer, uint32_t seq)
+{
+  logqSlot_t* slot = logq_Reserve(&test_queue);
+  if (slot == NULL)
+    return false;
+
+  slot->record.timestamp = TEST_STAMP(producer, seq);
+  logq_Commit(slot);
+  return true;
+}
+
+static void test_Order(void)
+{
+  loggerRecord_t record;
+
+  logq_Init(&test_queue);
+  TEST_CHECK(!logq_Pop(&test_queue, &record));
+
+  // several laps around the ring, order kept and nothing dropped
+  for (uint32_t seq = 0; seq < 5 * LOGQ_SIZE; seq++)
+  {
+    TEST_CHECK(test_Push(0, seq));
+    TEST_CHECK(logq_Pop(&test_queue, &record));
+    TEST_EQUAL(TEST_SEQ(record), seq);
+  }
+  TEST_EQUAL(atomic_load(&test_queue.dropped), 0);
+  TEST_EQUAL(test_queue.highWater, 1);
+}
+
+static void test_Full(void)
+{
+  loggerRecord_t record;
+
+  logq_Init(&test_queue);
+  for (uint32_t seq = 0; seq < LOGQ_SIZE; seq++)
+    TEST_CHECK(test_Push(0, seq));
+
+  TEST_CHECK(!test_Push(0, LOGQ_SIZE));
+  TEST_EQUAL(atomic_load(&test_queue.dropped), 1);
+  TEST_EQUAL(logq_GetDepth(&test_queue), LOGQ_SIZE);
+
+  // one pop frees exactly one slot
+  TEST_CHECK(logq_Pop(&test_queue, &record));
+  TEST_EQUAL(TEST_SEQ(record), 0);
+  TEST_CHECK(test_Push(0, LOGQ_SIZE));
+  TEST_CHECK(!test_Push(0, LOGQ_SIZE + 1));
+  TEST_EQUAL(test_queue.highWater, LOGQ_SIZE);
+}
+
+static void test_Uncommitted(void)
+{
+  loggerRecord_t record;
+
+  logq_Init(&test_queue);
+
+  // a reserved slot holds back the later committed ones
+  logqSlot_t* first = logq_Reserve(&test_queue);
+  TEST_CHECK(first != NULL);
+  TEST_CHECK(test_Push(0, 1));
+  TEST_CHECK(!logq_Pop(&test_queue, &record));
+
+  first->record.timestamp = TEST_STAMP(0, 0);
+  logq_Commit(first);
+  TEST_CHECK(logq_Pop(&test_queue, &record));
+  TEST_EQUAL(TEST_SEQ(record), 0);
+  TEST_CHECK(logq_Pop(&test_queue, &record));
+  TEST_EQUAL(TEST_SEQ(record), 1);
+}
+
+static void* test_Producer(void* arg)
+{
+  uint32_t producer = (uint32_t)(uintptr_t)arg;
+
+  for (uint32_t seq = 0; seq < TEST_RECORDS; seq++)
+  {
+    if (test_Push(producer, seq))
+      atomic_fetch_add(&test_accepted, 1);
+  }
+  atomic_fetch_add(&test_finished, 1);
+  return NULL;
+}
+
+static void test_Producers(void)
+{
+  pthread_t threads[TEST_PRODUCERS];
+  uint32_t next[TEST_PRODUCERS] = {0};
+  uint32_t received = 0;
+  uint32_t outOfOrder = 0;
+  loggerRecord_t record;
+
+  logq_Init(&test_queue);
+  atomic_init(&test_accepted, 0);
+  atomic_init(&test_finished, 0);
+
+  for (uint32_t idx = 0; idx < TEST_PRODUCERS; idx++)
+    pthread_create(&threads[idx], NULL, test_Producer, (void*)(uintptr_t)idx);
+
+  for (;;)
+  {
+    // drain once more after the last producer finished
+    bool bDone = (atomic_load(&test_finished) == TEST_PRODUCERS);
+    while (logq_Pop(&test_queue, &record))
+    {
+      uint32_t producer = TEST_PRODUCER(record);
+      if ((producer >= TEST_PRODUCERS) || (TEST_SEQ(record) < next[producer]))
+        outOfOrder++;
+      else
+        next[producer] = TEST_SEQ(record) + 1;
+      received++;
+    }
+    if (bDone)
+      break;
+  }
+
+  for (uint32_t idx = 0; idx < TEST_PRODUCERS; idx++)
+    pthread_join(threads[idx], NULL);
+
+  TEST_EQUAL(outOfOrder, 0);
+  TEST_EQUAL(received, atomic_load(&test_accepted));
+  TEST_EQUAL(received + atomic_load(&test_queue.dropped), TEST_PRODUCERS * TEST_RECORDS);
+  TEST_EQUAL(logq_GetDepth(&test_queue), 0);
+}
+
+int main(void)
+{
+  test_Order();
+  test_Full();
+  test_Uncommitted();
+  test_Producers();
+  return test_Report("log_queue");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,438 @@
+/**
+  ******************************************************************************
+  * @file    test_log_sdwriter.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the batched SD card log writer
+  *          Records are packed like the SD sink does and written through the
+  *          in-memory FatFs, the storage task runs until its queue is empty.
+  *          The rotated files are also left in build/rotate with the expected
+  *          text, for the Tools/logdecode.py check of the Makefile. A query
+  *          over both files of a rotation must send exactly the matching
+  *          records.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_sdwriter.h"
+#include "log_journal.h"
+#include "logger.h"
+#include "app_main.h"
+#include "errorcode.h"
+#include "cmsis_os.h"
+#include "fatfs.h"
+#include "test_common.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_STREAM_SIZE        (64U * 1024U)
+#define TEST_ROTATE_DIR         "build/rotate"
+#define TEST_BENCH_LINES        20000
+/* Private variables ---------------------------------------------------------*/
+static jmp_buf test_storageExit;
+static uint8_t test_stream[TEST_STREAM_SIZE];   // every byte handed to the writer
+static uint32_t test_streamLen;
+static uint32_t test_journal;
+static FILE* test_expected;                     // decoded text of the records
+static uint8_t test_answer[TEST_STREAM_SIZE];   // query output
+static uint32_t test_answerLen;
+static uint32_t test_doneCount;
+static uint32_t test_doneRc;
+static bool test_bDone;
+
+extern osEventFlagsId_t osFlag_Main;
+/* function prototypes -------------------------------------------------------*/
+
+// the FLASH journal is not part of this test
+uint32_t logjournal_Read(uint32_t* pValue)
+{
+  *pValue = test_journal;
+  return PER_NO_ERROR;
+}
+
+uint32_t logjournal_Append(uint32_t value)
+{
+  test_journal = value;
+  return PER_NO_ERROR;
+}
+
+uint32_t logjournal_PrepareSpare(void)
+{
+  return PER_NO_ERROR;
+}
+
+static void test_StorageIdle(osMessageQueueId_t mq_id)
+{
+  (void)mq_id;
+  longjmp(test_storageExit, 1);
+}
+
+// run the storage task until it waits for the next request
+static void test_RunStorage(void)
+{
+  host_pfnQueueEmpty = test_StorageIdle;
+  if (setjmp(test_storageExit) == 0)
+    StartLogStorageTask(NULL);
+  host_pfnQueueEmpty = NULL;
+}
+
+// one text record as the SD sink packs it, n selects the length
+static void test_Log(uint8_t level, uint32_t n)
+{
+  loggerRecord_t record = { .timestamp = host_tick, .level = level, .msgId = LOGMSG_TEXT };
+  uint8_t buf[LOGGER_BINARY_MAX_SIZE];
+
+  record.len = (uint8_t)snprintf(record.text, sizeof(record.text), "record %u %.*s", n, (int)(n % 40U),
+                                 "........................................");
+  uint32_t size = logger_PackRecord(&record, buf);
+
+  if (!logsd_IsReady(size))
+    test_RunStorage();
+  TEST_CHECK(logsd_IsReady(size));
+
+  logsd_MarkRecord(level, host_tick);
+  TEST_EQUAL(logsd_Write(buf, size), PER_NO_ERROR);
+
+  if ((test_streamLen + size) <= sizeof(test_stream))
+  {
+    memcpy(&test_stream[test_streamLen], buf, size);
+    test_streamLen += size;
+  }
+
+  if (test_expected != NULL)
+  {
+    char line[LOGGER_STR_LEN];
+    fwrite(line, 1, logger_FormatLine(&record, line, sizeof(line)), test_expected);
+  }
+}
+
+// write the tail like the logger task, which retries a sync without a free buffer
+static void test_Sync(void)
+{
+  test_RunStorage();
+  logsd_Flush();
+  test_RunStorage();
+}
+
+static void test_Start(uint32_t fileNumber)
+{
+  host_FsReset();
+  host_tick = 0;
+  test_streamLen = 0;
+  osFlag_Main = osEventFlagsNew(NULL);
+  osEventFlagsSet(osFlag_Main, MAIN_SD_PRESENT_FLAG | MAIN_MOUNT_SDCARD_FLAG | MAIN_CREATE_FOLDERS_FLAG);
+  test_journal = fileNumber;
+}
+
+static void test_Aligned(void)
+{
+  logsdStats_t stats;
+  uint32_t size;
+
+  test_Start(LOGSD_FIRST_FILE_NUMBER);
+  TEST_EQUAL(logsd_Init(LOGSD_FIRST_FILE_NUMBER), PER_NO_ERROR);
+
+  // records cross sector boundaries, syncs leave partial sectors behind
+  for (uint32_t n = 0; n < 1000; n++)
+  {
+    test_Log(n % 3, n);
+    if ((n % 97) == 0)
+      test_Sync();
+    host_tick += 7;
+    logsd_Poll();
+  }
+  test_Sync();
+
+  const uint8_t* pData = host_FsData(LOGGER_LOG_DIR "/10000.LOG", &size);
+  TEST_CHECK(pData != NULL);
+  TEST_EQUAL(size, test_streamLen);
+  TEST_CHECK((pData != NULL) && (memcmp(pData, test_stream, test_streamLen) == 0));
+
+  // every write starts on a sector, the tail is rewritten by the next one
+  TEST_EQUAL(host_fsUnaligned, 0);
+  logsd_GetStats(&stats);
+  TEST_EQUAL(stats.bytesLogged, test_streamLen);
+  TEST_EQUAL(stats.sectorWrites, test_streamLen / LOGSD_SECTOR_SIZE);
+  TEST_CHECK(stats.syncs > 0);
+  TEST_EQUAL(stats.dropped, 0);
+  TEST_EQUAL(stats.errors, 0);
+}
+
+static void test_UnalignedTail(void)
+{
+  FIL file;
+  UINT bw;
+  uint32_t size;
+  uint8_t old[700];
+
+  // a file left by the last boot ends inside a sector
+  test_Start(LOGSD_FIRST_FILE_NUMBER + 1);
+  memset(old, 0x5A, sizeof(old));
+  f_open(&file, LOGGER_LOG_DIR "/10001.LOG", FA_OPEN_ALWAYS | FA_WRITE);
+  f_write(&file, old, sizeof(old), &bw);
+  f_close(&file);
+  host_fsUnaligned = 0;
+
+  TEST_EQUAL(logsd_Init(LOGSD_FIRST_FILE_NUMBER + 1), PER_NO_ERROR);
+  for (uint32_t n = 0; n < 100; n++)
+    test_Log(LOGGER_LEVEL_INFO, n);
+  test_Sync();
+
+  const uint8_t* pData = host_FsData(LOGGER_LOG_DIR "/10001.LOG", &size);
+  TEST_EQUAL(size, sizeof(old) + test_streamLen);
+  TEST_CHECK((pData != NULL) && (memcmp(pData, old, sizeof(old)) == 0));
+  TEST_CHECK((pData != NULL) && (memcmp(&pData[sizeof(old)], test_stream, test_streamLen) == 0));
+  TEST_EQUAL(host_fsUnaligned, 0);
+}
+
+// each file must decode from its first byte to its end, the record numbers
+// continue across the files
+static void test_CheckFile(uint32_t fileNumber, uint32_t* pNext)
+{
+  char path[LOGGER_PATH_LEN];
+  uint32_t size;
+  uint32_t pos = 0;
+  uint32_t wrong = 0;
+  uint32_t recordSize;
+  uint8_t level;
+  uint32_t tick;
+
+  snprintf(path, sizeof(path), LOGGER_LOG_DIR "/%u.LOG", (unsigned)fileNumber);
+  const uint8_t* pData = host_FsData(path, &size);
+  TEST_CHECK(pData != NULL);
+  if (pData == NULL)
+    return;
+
+  while ((pos < size) && logger_ParseRecord(&pData[pos], size - pos, &recordSize, &level, &tick))
+  {
+    char text[LOGGER_RECORD_TEXT_LEN + 1] = {0};
+    unsigned n = 0;
+
+    memcpy(text, &pData[pos + LOGGER_BINARY_HDR_SIZE], recordSize - LOGGER_BINARY_HDR_SIZE);
+    if ((sscanf(text, "record %u", &n) != 1) || (n != *pNext))
+      wrong++;
+    *pNext = n + 1;
+    pos += recordSize;
+  }
+  TEST_EQUAL(pos, size);
+  TEST_EQUAL(wrong, 0);
+
+  snprintf(path, sizeof(path), TEST_ROTATE_DIR "/%u.LOG", (unsigned)fileNumber);
+  FILE* file = fopen(path, "wb");
+  if (file != NULL)
+  {
+    fwrite(pData, 1, size, file);
+    fclose(file);
+  }
+}
+
+static void test_Rotation(void)
+{
+  logsdStats_t stats;
+  uint32_t size;
+  uint32_t n = 0;
+  uint32_t next = 0;
+
+  test_Start(LOGSD_FIRST_FILE_NUMBER);
+  mkdir(TEST_ROTATE_DIR, 0777);
+  test_expected = fopen(TEST_ROTATE_DIR "/expected.txt", "w");
+  TEST_EQUAL(logsd_Init(LOGSD_FIRST_FILE_NUMBER), PER_NO_ERROR);
+
+  // by age with a partial sector pending, then by size
+  for (; n < 100; n++)
+    test_Log(n % 3, n);
+  host_tick += LOGSD_ROTATE_AGE_MS;
+  for (; n < 200; n++)
+    test_Log(n % 3, n);
+  test_Sync();
+  TEST_EQUAL(logsd_GetFileNumber(), LOGSD_FIRST_FILE_NUMBER + 1);
+
+  for (; logsd_GetFileNumber() == (LOGSD_FIRST_FILE_NUMBER + 1); n++)
+  {
+    test_Log(LOGGER_LEVEL_INFO, n);
+    if ((n % 100) == 0)
+      test_RunStorage();
+  }
+  for (uint32_t last = n + 50; n < last; n++)
+    test_Log(LOGGER_LEVEL_WARN, n);
+  test_Sync();
+
+  fclose(test_expected);
+  test_expected = NULL;
+
+  logsd_GetStats(&stats);
+  TEST_EQUAL(stats.rotations, 2);
+  TEST_EQUAL(stats.dropped, 0);
+  TEST_EQUAL(stats.errors, 0);
+  TEST_EQUAL(test_journal, LOGSD_FIRST_FILE_NUMBER + 2);
+  TEST_EQUAL(host_fsUnaligned, 0);
+  TEST_CHECK(host_FsData(LOGGER_LOG_DIR "/10001.LOG", &size) != NULL);
+  TEST_CHECK(size >= LOGSD_ROTATE_SIZE);
+
+  for (uint32_t file = LOGSD_FIRST_FILE_NUMBER; file <= (LOGSD_FIRST_FILE_NUMBER + 2); file++)
+    test_CheckFile(file, &next);
+  TEST_EQUAL(next, n);
+}
+
+static uint32_t test_Send(const uint8_t* pData, uint32_t size)
+{
+  if ((test_answerLen + size) > sizeof(test_answer))
+    return PER_ERROR_USB_TRANSMIT;
+
+  memcpy(&test_answer[test_answerLen], pData, size);
+  test_answerLen += size;
+  return PER_NO_ERROR;
+}
+
+static void test_Done(uint32_t count, uint32_t rc)
+{
+  test_doneCount = count;
+  test_doneRc = rc;
+  test_bDone = true;
+}
+
+static void test_Query(void)
+{
+  const uint32_t levelMask = (1U << LOGGER_LEVEL_WARN) | (1U << LOGGER_LEVEL_ERROR);
+  const uint32_t fromMs = 50000;
+  const uint32_t toMs = LOGSD_ROTATE_AGE_MS + 100000;
+  uint32_t expected = 0;
+
+  test_Start(LOGSD_FIRST_FILE_NUMBER);
+  TEST_EQUAL(logsd_Init(LOGSD_FIRST_FILE_NUMBER), PER_NO_ERROR);
+
+  // one record each 50 ms over several index buckets, the second half after
+  // a rotation by age
+  for (uint32_t n = 0; n < 3000; n++)
+  {
+    host_tick = (n * 50U) + ((n >= 1500) ? LOGSD_ROTATE_AGE_MS : 0U);
+    test_Log(n % 3, n);
+    if ((host_tick >= fromMs) && (host_tick <= toMs) && ((levelMask >> (n % 3)) & 1U))
+      expected++;
+    if ((n % 50) == 0)
+      test_RunStorage();
+  }
+  test_Sync();
+  TEST_EQUAL(logsd_GetFileNumber(), LOGSD_FIRST_FILE_NUMBER + 1);
+
+  logsdQuery_t query = { .fromMs = fromMs, .toMs = toMs, .levelMask = (uint8_t)levelMask,
+                         .pfnSend = test_Send, .pfnDone = test_Done };
+  test_answerLen = 0;
+  test_bDone = false;
+  TEST_EQUAL(logsd_Query(&query), PER_NO_ERROR);
+  TEST_EQUAL(logsd_Query(&query), PER_ERROR_LOG_QUERY_BUSY);
+  test_RunStorage();
+  TEST_CHECK(test_bDone);
+  TEST_EQUAL(test_doneRc, PER_NO_ERROR);
+  TEST_EQUAL(test_doneCount, expected);
+
+  // the buckets only narrow the search, every record sent must match
+  uint32_t pos = 0;
+  uint32_t count = 0;
+  uint32_t wrong = 0;
+  uint32_t recordSize;
+  uint8_t level;
+  uint32_t tick;
+  while ((pos < test_answerLen) && logger_ParseRecord(&test_answer[pos], test_answerLen - pos, &recordSize, &level, &tick))
+  {
+    if ((tick < fromMs) || (tick > toMs) || !((levelMask >> level) & 1U))
+      wrong++;
+    pos += recordSize;
+    count++;
+  }
+  TEST_EQUAL(pos, test_answerLen);
+  TEST_EQUAL(count, expected);
+  TEST_EQUAL(wrong, 0);
+
+  // a new query is accepted once the last one is done
+  TEST_EQUAL(logsd_Query(&query), PER_NO_ERROR);
+  test_RunStorage();
+}
+
+// card traffic of one run, data and directory sectors programmed per payload byte
+static void test_PrintTraffic(const char* name, uint32_t lines, double seconds)
+{
+  uint32_t cardBytes = (host_fsSectors + host_fsDirUpdates) * LOGSD_SECTOR_SIZE;
+
+  printf("log_sdwriter: %s %.0f lines/s, %u FatFs calls, %u sectors + %u directory updates "
+         "for %u bytes, write amplification %.1f\n", name, lines / seconds, host_fsCalls,
+         host_fsSectors, host_fsDirUpdates, host_fsBytes, (double)cardBytes / host_fsBytes);
+}
+
+static void test_Throughput(void)
+{
+  loggerRecord_t record = { .level = LOGGER_LEVEL_INFO, .msgId = LOGMSG_TEXT };
+  uint8_t buf[LOGGER_BINARY_MAX_SIZE];
+  uint32_t payload = 0;
+  uint32_t batchedCalls;
+  uint32_t batchedSectors;
+  FIL file;
+  UINT bw;
+
+  // batched, the records go through the storage task like the SD sink sends
+  // them, the task keeps up with the logger and syncs by time and size
+  test_Start(LOGSD_FIRST_FILE_NUMBER);
+  TEST_EQUAL(logsd_Init(LOGSD_FIRST_FILE_NUMBER), PER_NO_ERROR);
+  double start = test_Seconds();
+  for (uint32_t n = 0; n < TEST_BENCH_LINES; n++)
+  {
+    test_Log(LOGGER_LEVEL_INFO, n);
+    host_tick += 7;
+    logsd_Poll();
+    test_RunStorage();
+  }
+  test_Sync();
+  double batched = test_Seconds() - start;
+  payload = host_fsBytes;
+  batchedCalls = host_fsCalls;
+  batchedSectors = host_fsSectors + host_fsDirUpdates;
+  test_PrintTraffic("batched", TEST_BENCH_LINES, batched);
+
+  // the old logger opened, wrote and closed the file for every line
+  test_Start(LOGSD_FIRST_FILE_NUMBER);
+  start = test_Seconds();
+  for (uint32_t n = 0; n < TEST_BENCH_LINES; n++)
+  {
+    record.timestamp = host_tick;
+    record.len = (uint8_t)snprintf(record.text, sizeof(record.text), "record %u %.*s", n, (int)(n % 40U),
+                                   "........................................");
+    uint32_t size = logger_PackRecord(&record, buf);
+    TEST_EQUAL(f_open(&file, LOGGER_LOG_DIR "/10000.LOG", FA_OPEN_APPEND | FA_WRITE), FR_OK);
+    TEST_EQUAL(f_write(&file, buf, size, &bw), FR_OK);
+    f_close(&file);
+    host_tick += 7;
+  }
+  double perLine = test_Seconds() - start;
+  test_PrintTraffic("per line", TEST_BENCH_LINES, perLine);
+
+  // the index file adds a little, the log itself is the same
+  TEST_CHECK(host_fsBytes <= payload);
+  TEST_CHECK(batchedCalls < host_fsCalls);
+  TEST_CHECK(batchedSectors < (host_fsSectors + host_fsDirUpdates));
+}
+
+int main(void)
+{
+  test_Aligned();
+  test_UnalignedTail();
+  test_Rotation();
+  test_Query();
+  test_Throughput();
+  return test_Report("log_sdwriter");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,143 @@
+/**
+  ******************************************************************************
+  * @file    test_log_sink.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the log sink routing
+  *          A busy output keeps its records queued without holding back the
+  *          other sinks, a full queue counts overflow, an unavailable output
+  *          counts discarded records.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "log_sink.h"
+#include "errorcode.h"
+#include "test_common.h"
+
+#include <string.h>
+/* Private variables ---------------------------------------------------------*/
+static loggerRecord_t test_fastQueue[8];
+static loggerRecord_t test_slowQueue[4];
+static loggerRecord_t test_offQueue[4];
+static logSink_t test_fast;
+static logSink_t test_slow;
+static logSink_t test_off;
+static uint32_t test_fastSeen[64];
+static uint32_t test_fastCount;
+static uint32_t test_slowSeen[64];
+static uint32_t test_slowCount;
+static bool test_bSlowBusy;
+/* function prototypes -------------------------------------------------------*/
+
+static logSinkResult_t test_FastWrite(const loggerRecord_t* record)
+{
+  test_fastSeen[test_fastCount++ % 64] = record->args[0];
+  return LOGSINK_WRITTEN;
+}
+
+static logSinkResult_t test_SlowWrite(const loggerRecord_t* record)
+{
+  if (test_bSlowBusy)
+    return LOGSINK_BUSY;
+
+  test_slowSeen[test_slowCount++ % 64] = record->args[0];
+  return LOGSINK_WRITTEN;
+}
+
+static logSinkResult_t test_OffWrite(const loggerRecord_t* record)
+{
+  (void)record;
+  return LOGSINK_DISCARDED;
+}
+
+static void test_Setup(logSink_t* sink, const char* name, logSinkWrite_t pfnWrite,
+                       loggerRecord_t* queue, uint32_t queueSize, loggerLevel_t minLevel)
+{
+  sink->name = name;
+  sink->minLevel = minLevel;
+  sink->pfnWrite = pfnWrite;
+  sink->queue = queue;
+  sink->queueSize = queueSize;
+}
+
+static void test_Dispatch(uint32_t n, loggerLevel_t level)
+{
+  loggerRecord_t record = { .level = level, .msgId = LOGMSG_LOG_DROPPED, .len = 4 };
+  record.args[0] = n;
+  logsink_Dispatch(&record);
+}
+
+int main(void)
+{
+  logSinkStats_t stats;
+
+  // the queue index is masked
+  test_Setup(&test_fast, "FAST", test_FastWrite, test_fastQueue, 6, LOGGER_LEVEL_INFO);
+  TEST_EQUAL(logsink_Register(&test_fast), PER_ERROR_INIT);
+
+  test_Setup(&test_fast, "FAST", test_FastWrite, test_fastQueue, 8, LOGGER_LEVEL_INFO);
+  test_Setup(&test_slow, "SLOW", test_SlowWrite, test_slowQueue, 4, LOGGER_LEVEL_INFO);
+  test_Setup(&test_off, "OFF", test_OffWrite, test_offQueue, 4, LOGGER_LEVEL_WARN);
+  TEST_EQUAL(logsink_Register(&test_fast), PER_NO_ERROR);
+  TEST_EQUAL(logsink_Register(&test_slow), PER_NO_ERROR);
+  TEST_EQUAL(logsink_Register(&test_off), PER_NO_ERROR);
+  TEST_EQUAL(logsink_Register(&test_fast), PER_NO_ERROR);
+  TEST_CHECK(!logsink_GetStats("NONE", &stats));
+
+  // the busy output holds its queue, the others keep writing
+  test_bSlowBusy = true;
+  for (uint32_t n = 0; n < 10; n++)
+  {
+    test_Dispatch(n, (n % 2) ? LOGGER_LEVEL_WARN : LOGGER_LEVEL_INFO);
+    TEST_CHECK(!logsink_PumpAll());
+  }
+  TEST_EQUAL(test_fastCount, 10);
+  for (uint32_t n = 0; n < 10; n++)
+    TEST_EQUAL(test_fastSeen[n], n);
+  TEST_EQUAL(test_slowCount, 0);
+
+  TEST_CHECK(logsink_GetStats("SLOW", &stats));
+  TEST_EQUAL(stats.queued, 4);
+  TEST_EQUAL(stats.overflow, 6);
+  TEST_EQUAL(stats.highWater, 4);
+  TEST_EQUAL(stats.busy, 10);
+  TEST_EQUAL(logsink_GetOverflow(), 6);
+
+  TEST_CHECK(logsink_GetStats("OFF", &stats));
+  TEST_EQUAL(stats.queued, 5);
+  TEST_EQUAL(stats.discarded, 5);
+  TEST_EQUAL(stats.overflow, 0);
+
+  // once free the oldest queued records come out in order
+  test_bSlowBusy = false;
+  TEST_CHECK(logsink_PumpAll());
+  TEST_EQUAL(test_slowCount, 4);
+  for (uint32_t n = 0; n < 4; n++)
+    TEST_EQUAL(test_slowSeen[n], n);
+
+  // a muted sink takes nothing
+  logsink_SetLevel("FAST", LOGGER_LEVEL_NONE);
+  test_Dispatch(10, LOGGER_LEVEL_ERROR);
+  TEST_CHECK(logsink_PumpAll());
+  TEST_EQUAL(test_fastCount, 10);
+  TEST_EQUAL(test_slowCount, 5);
+  TEST_CHECK(logsink_GetStats("FAST", &stats));
+  TEST_EQUAL(stats.written, 10);
+  TEST_EQUAL(stats.overflow, 0);
+
+  return test_Report("log_sink");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,341 @@
+/**
+  ******************************************************************************
+  * @file    test_msgbus.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the message bus
+  *          Checks the subscriber queues, the message references and the
+  *          pool, then concurrent publishers against two subscribers.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "msgbus.h"
+#include "errorcode.h"
+#include "SEGGER_SYSVIEW.h"
+#include "test_common.h"
+
+#include <pthread.h>
+#include <sched.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_PUBLISHERS         4
+#define TEST_MESSAGES           20000
+#define TEST_BENCH_MESSAGES     200000      // per benchmark run, split over the publishers
+/* Private variables ---------------------------------------------------------*/
+static msgbusSubscriber_t test_faults = { .name = "FAULTS", .topics = MSGBUS_TOPIC(MSGBUS_FAULT) };
+static msgbusSubscriber_t test_all = {
+  .name = "ALL",
+  .topics = MSGBUS_TOPIC(MSGBUS_FAULT) | MSGBUS_TOPIC(MSGBUS_MAIN_STATE),
+};
+static msgbusSubscriber_t test_other = { .name = "OTHER", .topics = MSGBUS_TOPIC(MSGBUS_OPERATION_STOP) };
+static msgbusSubscriber_t test_bench = { .name = "BENCH", .topics = MSGBUS_TOPIC(MSGBUS_MAIN_STATE) };
+static atomic_uint test_finished;
+static atomic_uint test_benchDropped;
+/* function prototypes -------------------------------------------------------*/
+
+static void test_Start(void)
+{
+  msgbus_Init();
+  TEST_EQUAL(msgbus_Subscribe(&test_faults), PER_NO_ERROR);
+  TEST_EQUAL(msgbus_Subscribe(&test_all), PER_NO_ERROR);
+  TEST_EQUAL(msgbus_Subscribe(&test_other), PER_NO_ERROR);
+}
+
+// every message back in the pool
+static uint32_t test_PoolFree(void)
+{
+  msgbusMsg_t* taken[MSGBUS_POOL_SIZE + 1];
+  uint32_t count = 0;
+
+  while ((count <= MSGBUS_POOL_SIZE) && ((taken[count] = msgbus_Alloc(MSGBUS_FAULT)) != NULL))
+    count++;
+  for (uint32_t idx = 0; idx < count; idx++)
+  {
+    atomic_store(&taken[idx]->refs, 1);
+    msgbus_Release(taken[idx]);
+  }
+  return count;
+}
+
+static void test_Order(void)
+{
+  test_Start();
+  TEST_CHECK(msgbus_Receive(&test_faults) == NULL);
+
+  // several laps of the queues, each subscriber sees only its topics
+  for (uint32_t seq = 0; seq < 5 * MSGBUS_QUEUE_SIZE; seq++)
+  {
+    TEST_EQUAL(msgbus_Post((seq & 1) ? MSGBUS_MAIN_STATE : MSGBUS_FAULT, seq), PER_NO_ERROR);
+
+    const msgbusMsg_t* msg = msgbus_Receive(&test_all);
+    TEST_CHECK((msg != NULL) && (msg->payload[0] == seq));
+    if (msg != NULL)
+      msgbus_Release(msg);
+
+    msg = msgbus_Receive(&test_faults);
+    TEST_CHECK((seq & 1) ? (msg == NULL) : ((msg != NULL) && (msg->payload[0] == seq)));
+    if (msg != NULL)
+      msgbus_Release(msg);
+  }
+  TEST_CHECK(msgbus_Receive(&test_other) == NULL);
+  TEST_EQUAL(test_all.received, 5 * MSGBUS_QUEUE_SIZE);
+  TEST_EQUAL(test_all.highWater, 1);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE);
+
+  msgbusStats_t stats;
+  msgbus_GetStats(&stats);
+  TEST_EQUAL(stats.published, 5 * MSGBUS_QUEUE_SIZE);
+  TEST_EQUAL(stats.poolEmpty, 1);
+  TEST_EQUAL(stats.poolLow, 0);
+}
+
+static void test_References(void)
+{
+  test_Start();
+
+  // a message returns to the pool with the last release
+  TEST_EQUAL(msgbus_Post(MSGBUS_FAULT, 7), PER_NO_ERROR);
+  const msgbusMsg_t* first = msgbus_Receive(&test_faults);
+  const msgbusMsg_t* second = msgbus_Receive(&test_all);
+  TEST_CHECK((first != NULL) && (first == second));
+  TEST_EQUAL(atomic_load(&first->refs), 2);
+  msgbus_Release(first);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE - 1);
+  msgbus_Release(second);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE);
+
+  // a message nobody subscribed to is freed by the publish
+  TEST_EQUAL(msgbus_Post(MSGBUS_SCREW_COUNT_RESET, 0), PER_NO_ERROR);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE);
+}
+
+static void test_Full(void)
+{
+  test_Start();
+
+  // a full queue drops for that subscriber only
+  for (uint32_t seq = 0; seq < MSGBUS_QUEUE_SIZE; seq++)
+  {
+    TEST_EQUAL(msgbus_Post(MSGBUS_FAULT, seq), PER_NO_ERROR);
+    const msgbusMsg_t* msg = msgbus_Receive(&test_all);
+    if (msg != NULL)
+      msgbus_Release(msg);
+  }
+  TEST_EQUAL(msgbus_Post(MSGBUS_FAULT, MSGBUS_QUEUE_SIZE), PER_ERROR_QUEUE_FULL);
+  TEST_EQUAL(atomic_load(&test_faults.dropped), 1);
+  TEST_EQUAL(atomic_load(&test_all.dropped), 0);
+  const msgbusMsg_t* msg = msgbus_Receive(&test_all);
+  TEST_CHECK((msg != NULL) && (msg->payload[0] == MSGBUS_QUEUE_SIZE));
+  if (msg != NULL)
+    msgbus_Release(msg);
+
+  // the empty pool is reported the same way
+  for (uint32_t seq = 0; seq < MSGBUS_QUEUE_SIZE; seq++)
+  {
+    msg = msgbus_Receive(&test_faults);
+    TEST_CHECK((msg != NULL) && (msg->payload[0] == seq));
+    if (msg != NULL)
+      msgbus_Release(msg);
+  }
+  msgbusMsg_t* taken[MSGBUS_POOL_SIZE];
+  for (uint32_t idx = 0; idx < MSGBUS_POOL_SIZE; idx++)
+    taken[idx] = msgbus_Alloc(MSGBUS_FAULT);
+  TEST_EQUAL(msgbus_Post(MSGBUS_FAULT, 0), PER_ERROR_QUEUE_FULL);
+  for (uint32_t idx = 0; idx < MSGBUS_POOL_SIZE; idx++)
+    TEST_EQUAL(msgbus_Publish(taken[idx]), (idx < MSGBUS_QUEUE_SIZE) ? PER_NO_ERROR : PER_ERROR_QUEUE_FULL);
+  TEST_EQUAL(test_faults.highWater, MSGBUS_QUEUE_SIZE);
+}
+
+static void test_Uncommitted(void)
+{
+  test_Start();
+
+  // a cell reserved by a publisher that was interrupted holds back the later ones
+  uint32_t pos = atomic_fetch_add(&test_faults.head, 1);
+  TEST_EQUAL(msgbus_Post(MSGBUS_FAULT, 1), PER_NO_ERROR);
+  TEST_CHECK(msgbus_Receive(&test_faults) == NULL);
+  TEST_CHECK(!msgbus_Wait(&test_faults, 0));
+
+  msgbusMsg_t* msg = msgbus_Alloc(MSGBUS_FAULT);
+  msg->payload[0] = 0;
+  atomic_store(&msg->refs, 1);
+  test_faults.cells[pos & MSGBUS_QUEUE_MASK].msg = msg;
+  atomic_store(&test_faults.cells[pos & MSGBUS_QUEUE_MASK].seq, pos + 1);
+  TEST_CHECK(msgbus_Wait(&test_faults, 0));
+
+  for (uint32_t seq = 0; seq < 2; seq++)
+  {
+    const msgbusMsg_t* got = msgbus_Receive(&test_faults);
+    TEST_CHECK((got != NULL) && (got->payload[0] == seq));
+    if (got != NULL)
+      msgbus_Release(got);
+  }
+  const msgbusMsg_t* got = msgbus_Receive(&test_all);
+  if (got != NULL)
+    msgbus_Release(got);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE);
+}
+
+static void* test_Publisher(void* arg)
+{
+  uint32_t publisher = (uint32_t)(uintptr_t)arg;
+
+  for (uint32_t seq = 0; seq < TEST_MESSAGES; seq++)
+  {
+    msgbusMsg_t* msg;
+    while ((msg = msgbus_Alloc(MSGBUS_FAULT)) == NULL)
+      sched_yield();
+    msg->payload[0] = publisher;
+    msg->payload[1] = seq;
+    msgbus_Publish(msg);
+  }
+  atomic_fetch_add(&test_finished, 1);
+  return NULL;
+}
+
+static uint32_t test_Drain(msgbusSubscriber_t* sub, uint32_t* p_next)
+{
+  const msgbusMsg_t* msg;
+  uint32_t outOfOrder = 0;
+
+  while ((msg = msgbus_Receive(sub)) != NULL)
+  {
+    uint32_t publisher = msg->payload[0];
+    if ((publisher >= TEST_PUBLISHERS) || (msg->payload[1] < p_next[publisher]))
+      outOfOrder++;
+    else
+      p_next[publisher] = msg->payload[1] + 1;
+    msgbus_Release(msg);
+  }
+  return outOfOrder;
+}
+
+static void test_Publishers(void)
+{
+  pthread_t threads[TEST_PUBLISHERS];
+  uint32_t nextFaults[TEST_PUBLISHERS] = {0};
+  uint32_t nextAll[TEST_PUBLISHERS] = {0};
+  uint32_t outOfOrder = 0;
+
+  test_Start();
+  atomic_init(&test_finished, 0);
+
+  for (uint32_t idx = 0; idx < TEST_PUBLISHERS; idx++)
+    pthread_create(&threads[idx], NULL, test_Publisher, (void*)(uintptr_t)idx);
+
+  for (;;)
+  {
+    // drain once more after the last publisher finished
+    bool bDone = (atomic_load(&test_finished) == TEST_PUBLISHERS);
+    outOfOrder += test_Drain(&test_faults, nextFaults);
+    outOfOrder += test_Drain(&test_all, nextAll);
+    if (bDone)
+      break;
+  }
+
+  for (uint32_t idx = 0; idx < TEST_PUBLISHERS; idx++)
+    pthread_join(threads[idx], NULL);
+
+  // every message either arrived or was counted as dropped, none is left allocated
+  TEST_EQUAL(outOfOrder, 0);
+  TEST_EQUAL(test_faults.received + atomic_load(&test_faults.dropped), TEST_PUBLISHERS * TEST_MESSAGES);
+  TEST_EQUAL(test_all.received + atomic_load(&test_all.dropped), TEST_PUBLISHERS * TEST_MESSAGES);
+  TEST_EQUAL(test_other.received, 0);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE);
+}
+
+static void* test_BenchPublisher(void* arg)
+{
+  uint32_t count = (uint32_t)(uintptr_t)arg;
+
+  // a full queue or an empty pool waits for the subscriber, a message still dropped is counted
+  for (uint32_t seq = 0; seq < count; seq++)
+  {
+    msgbusMsg_t* msg;
+    while ((atomic_load(&test_bench.head) - atomic_load(&test_bench.tail)) >= MSGBUS_QUEUE_SIZE)
+      sched_yield();
+    while ((msg = msgbus_Alloc(MSGBUS_MAIN_STATE)) == NULL)
+      sched_yield();
+    msg->payload[0] = seq;
+    if (msgbus_Publish(msg) != PER_NO_ERROR)
+      atomic_fetch_add(&test_benchDropped, 1);
+  }
+  atomic_fetch_add(&test_finished, 1);
+  return NULL;
+}
+
+static void test_Benchmark(uint32_t publishers)
+{
+  pthread_t threads[TEST_PUBLISHERS];
+  uint64_t depthTotal = 0;
+
+  msgbus_Init();
+  TEST_EQUAL(msgbus_Subscribe(&test_bench), PER_NO_ERROR);
+  atomic_init(&test_finished, 0);
+  atomic_init(&test_benchDropped, 0);
+
+  // timestamps and latencies in ns of the host clock
+  host_bClockTimestamp = true;
+  double start = test_Seconds();
+  for (uint32_t idx = 0; idx < publishers; idx++)
+    pthread_create(&threads[idx], NULL, test_BenchPublisher, (void*)(uintptr_t)(TEST_BENCH_MESSAGES / publishers));
+
+  // one subscriber, the depth is sampled at every receive
+  for (;;)
+  {
+    bool bDone = (atomic_load(&test_finished) == publishers);
+    const msgbusMsg_t* msg;
+    uint32_t batch = 0;
+    while ((msg = msgbus_Receive(&test_bench)) != NULL)
+    {
+      depthTotal += atomic_load(&test_bench.head) - atomic_load(&test_bench.tail);
+      msgbus_Release(msg);
+      batch++;
+    }
+    if (bDone)
+      break;
+    if (batch == 0)
+      sched_yield();
+  }
+  double seconds = test_Seconds() - start;
+  host_bClockTimestamp = false;
+
+  for (uint32_t idx = 0; idx < publishers; idx++)
+    pthread_join(threads[idx], NULL);
+
+  uint32_t dropped = atomic_load(&test_benchDropped);
+  uint32_t received = test_bench.received;
+  TEST_EQUAL(received + dropped, (TEST_BENCH_MESSAGES / publishers) * publishers);
+  TEST_EQUAL(atomic_load(&test_bench.dropped), dropped);
+  TEST_EQUAL(test_PoolFree(), MSGBUS_POOL_SIZE);
+
+  printf("msgbus: %u publishers, %.2f M msgs/s received, %u dropped, depth %.1f mean %u max, latency %.0f ns mean %u ns max\n",
+         (unsigned)publishers, received / seconds / 1e6, (unsigned)dropped,
+         (received > 0) ? (double)depthTotal / received : 0.0, (unsigned)test_bench.highWater,
+         (received > 0) ? (double)test_bench.latencyTotal / received : 0.0, (unsigned)test_bench.latencyMax);
+}
+
+int main(void)
+{
+  test_Order();
+  test_References();
+  test_Full();
+  test_Uncommitted();
+  test_Publishers();
+  for (uint32_t publishers = 1; publishers <= TEST_PUBLISHERS; publishers *= 2)
+    test_Benchmark(publishers);
+  return test_Report("msgbus");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
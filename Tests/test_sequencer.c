@@ -0,0 +1,229 @@
+/**
+  ******************************************************************************
+  * @file    test_sequencer.c
+  * @author  IBronx MDE team
+  * @brief   Host test of the actuator timeline sequencer
+  *          The IO expander cache is replaced by fakes that record the tick
+  *          of every output and burst. The sequencer task runs one timeline
+  *          and is left when it waits for the next start.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 IBronx.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by IBronx under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sequencer.h"
+#include "ioexp_cache.h"
+#include "errorcode.h"
+#include "cmsis_os.h"
+#include "test_common.h"
+
+#include <setjmp.h>
+#include <string.h>
+/* Private define ------------------------------------------------------------*/
+#define TEST_MAX_OUTPUTS        16
+/* Private variables ---------------------------------------------------------*/
+ typedef struct
+ {
+   uint32_t tick;
+   uint8_t pin;
+   uint8_t value;
+   uint32_t burst;                          // bursts sent before this output
+ }testOutput_t;
+
+static jmp_buf test_taskExit;
+static testOutput_t test_outputs[TEST_MAX_OUTPUTS];
+static uint32_t test_outputCount;
+static uint32_t test_bursts;
+static uint32_t test_burstMs;               // time a burst takes to queue
+static uint32_t test_syncRc = PER_NO_ERROR;
+static uint32_t test_readyTick;             // the wait condition holds from here
+/* function prototypes -------------------------------------------------------*/
+
+uint32_t ioexp_SetOutputPin(uint8_t port, uint8_t pin, uint8_t state)
+{
+  if (test_outputCount < TEST_MAX_OUTPUTS)
+  {
+    test_outputs[test_outputCount] = (testOutput_t){ host_tick, pin, state, test_bursts };
+    test_outputCount++;
+  }
+  return PER_NO_ERROR;
+}
+
+void ioexp_Flush(void)
+{
+  test_bursts++;
+  host_tick += test_burstMs;
+}
+
+uint32_t ioexp_Sync(uint32_t timeout)
+{
+  return test_syncRc;
+}
+
+static bool test_Ready(void)
+{
+  return host_tick >= test_readyTick;
+}
+
+static void test_TaskWait(osEventFlagsId_t ef_id)
+{
+  (void)ef_id;
+  longjmp(test_taskExit, 1);
+}
+
+// start the timeline and run the sequencer task until it waits again
+static uint32_t test_Run(const seqTimeline_t* timeline)
+{
+  test_outputCount = 0;
+  test_bursts = 0;
+  TEST_EQUAL(seq_Start(timeline), PER_NO_ERROR);
+  TEST_EQUAL(seq_Start(timeline), PER_ERROR_SEQUENCE_BUSY);
+
+  host_pfnFlagsWait = test_TaskWait;
+  if (setjmp(test_taskExit) == 0)
+    StartSequencerTask(NULL);
+  host_pfnFlagsWait = NULL;
+
+  return seq_Wait(0);
+}
+
+static void test_Output(uint32_t idx, uint32_t tick, uint8_t pin, uint32_t burst)
+{
+  TEST_EQUAL(test_outputs[idx].tick, tick);
+  TEST_EQUAL(test_outputs[idx].pin, pin);
+  TEST_EQUAL(test_outputs[idx].burst, burst);
+}
+
+static void test_Offsets(void)
+{
+  static const seqStep_t steps[] = {
+    SEQ_OUTPUT(0, 0, 1, 1),
+    SEQ_OUTPUT(0, 0, 2, 1),
+    SEQ_OUTPUT(10, 0, 3, 1),
+    SEQ_SETTLE(30),
+    SEQ_OUTPUT(5, 0, 4, 0),
+    SEQ_OUTPUT(5, 0, 5, 0),
+  };
+  static const seqTimeline_t timeline = { "offsets", steps, 6 };
+  static const seqStep_t backwards[] = { SEQ_OUTPUT(10, 0, 1, 1), SEQ_OUTPUT(5, 0, 2, 1) };
+  static const seqTimeline_t invalid = { "backwards", backwards, 2 };
+  seqStats_t stats;
+
+  TEST_EQUAL(seq_Start(&timeline), PER_ERROR_INIT);
+  TEST_EQUAL(seq_Init(), PER_NO_ERROR);
+  TEST_EQUAL(seq_Start(&invalid), PER_ERROR_INIT);
+  TEST_EQUAL(seq_Wait(0), PER_ERROR_SEQUENCE_BUSY);
+
+  // the outputs of one offset share a burst, the settle starts a new origin
+  host_tick = 1000;
+  TEST_EQUAL(test_Run(&timeline), PER_NO_ERROR);
+  TEST_EQUAL(test_outputCount, 5);
+  TEST_EQUAL(test_bursts, 3);
+  test_Output(0, 1000, 1, 0);
+  test_Output(1, 1000, 2, 0);
+  test_Output(2, 1010, 3, 1);
+  test_Output(3, 1035, 4, 2);
+  test_Output(4, 1035, 5, 2);
+
+  seq_GetStats(&stats);
+  TEST_EQUAL(stats.runs, 1);
+  TEST_EQUAL(stats.failures, 0);
+  TEST_EQUAL(stats.lastDurationMs, 35);
+  TEST_EQUAL(stats.maxLateMs, 0);
+
+  // done, the next timeline is accepted
+  TEST_EQUAL(test_Run(&timeline), PER_NO_ERROR);
+}
+
+static void test_Conditions(void)
+{
+  static const seqStep_t steps[] = {
+    SEQ_OUTPUT(0, 0, 1, 1),
+    SEQ_WAIT(5, test_Ready, 20),
+    SEQ_OUTPUT(3, 0, 2, 0),
+  };
+  static const seqTimeline_t timeline = { "conditions", steps, 3 };
+  seqStats_t stats;
+
+  // met within the timeout, the next step counts from the moment it held
+  host_tick = 2000;
+  test_readyTick = 2012;
+  TEST_EQUAL(test_Run(&timeline), PER_NO_ERROR);
+  TEST_EQUAL(test_outputCount, 2);
+  test_Output(1, 2015, 2, 1);
+
+  // never met, the timeline stops at the wait step after its timeout
+  host_tick = 3000;
+  test_readyTick = UINT32_MAX;
+  TEST_EQUAL(test_Run(&timeline), PER_ERROR_SEQUENCE_TIMEOUT);
+  TEST_EQUAL(test_outputCount, 1);
+  TEST_EQUAL(host_tick, 3025);
+
+  seq_GetStats(&stats);
+  TEST_EQUAL(stats.failures, 1);
+  TEST_EQUAL(stats.failedStep, 1);
+  TEST_EQUAL(stats.lastDurationMs, 25);
+}
+
+static void test_SyncFailure(void)
+{
+  static const seqStep_t steps[] = { SEQ_OUTPUT(0, 0, 1, 1), SEQ_OUTPUT(4, 0, 1, 0) };
+  static const seqTimeline_t timeline = { "sync", steps, 2 };
+  seqStats_t stats;
+
+  // every step ran, the bursts failed on the bus afterwards
+  host_tick = 4000;
+  test_syncRc = PER_ERROR_I2C_TRANSMIT_COMMAND;
+  TEST_EQUAL(test_Run(&timeline), PER_ERROR_I2C_TRANSMIT_COMMAND);
+  test_syncRc = PER_NO_ERROR;
+  TEST_EQUAL(test_outputCount, 2);
+
+  seq_GetStats(&stats);
+  TEST_EQUAL(stats.failures, 2);
+  TEST_EQUAL(stats.failedStep, SEQ_STEP_SYNC);
+}
+
+static void test_Late(void)
+{
+  static const seqStep_t steps[] = {
+    SEQ_OUTPUT(0, 0, 1, 1),
+    SEQ_OUTPUT(5, 0, 2, 1),
+    SEQ_OUTPUT(30, 0, 3, 1),
+  };
+  static const seqTimeline_t timeline = { "late", steps, 3 };
+  seqStats_t stats;
+
+  // a 7 ms burst delays the step 5 ms after it, the later step stays on time
+  host_tick = 5000;
+  test_burstMs = 7;
+  TEST_EQUAL(test_Run(&timeline), PER_NO_ERROR);
+  test_burstMs = 0;
+  test_Output(1, 5007, 2, 1);
+  test_Output(2, 5030, 3, 2);
+
+  seq_GetStats(&stats);
+  TEST_EQUAL(stats.maxLateMs, 2);
+  TEST_EQUAL(stats.lastDurationMs, 37);
+}
+
+int main(void)
+{
+  test_Offsets();
+  test_Conditions();
+  test_SyncFailure();
+  test_Late();
+  return test_Report("sequencer");
+}
+
+
+ /************************ (C) COPYRIGHT IBronx *****************END OF FILE****/
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Decode binary log files written with LOGGER_BINARY_MODE.
+
+The message table is read from Inc/logger_msg.h and the error names for
+%E from Inc/errorcode.h, so the decoder always matches the firmware built
+from the same source tree. The output uses
+the same "%6s - %s.\\n" line format as the text logger.
+
+With --flash the input is a dump of the FLASH log area (log_flash.c):
+pages are checked against their CRC and decoded in sequence order.
+A capture of a USB "GET"/"LAST" query answer decodes like a log file.
+Records on the SD card and in query answers carry the kernel tick, use
+--freq 1000 to print seconds; the FLASH store keeps the cycle counter.
+
+Usage: logdecode.py [--table Inc/logger_msg.h] [--errors Inc/errorcode.h] [--timestamps] [--freq HZ] [--flash] LOGFILE...
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+HDR = struct.Struct("<HBBI")        # msgId, level, len, timestamp
+PAGE_HDR = struct.Struct("<IIHH")   # magic, seq, len, crc
+PAGE_SIZE = 256
+PAGE_MAGIC = 0x474F4C50             # LOGFLASH_MAGIC
+ERASED_SEQ = 0xFFFFFFFF
+QUERY_END_ID = 0xFFFF               # ends a USB query answer, timestamp = record count
+LEVELS = ["Info", "Warn", "Error"]
+LEVEL_IDS = {"LOGGER_LEVEL_INFO": 0, "LOGGER_LEVEL_WARN": 1, "LOGGER_LEVEL_ERROR": 2}
+ENTRY = re.compile(r'X\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+SPEC = re.compile(r"%(-?\d*)l*([udxXE])")
+ERROR_BASE = re.compile(r"#define\s+(PER_ERROR_\w+_NUM)\s+\((0x[0-9a-fA-F]+|\d+)\)")
+ERROR_ENTRY = re.compile(r"^\s*#define\s+(PER_\w+)\s+\((PER_ERROR_\w+_NUM)\s*\+\s*(\d+)\)", re.M)
+
+
+def load_table(path):
+    """Return {msgId: (name, level, fmt)} in table order, IDs start at 1."""
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    table = {}
+    for msg_id, (name, level, fmt) in enumerate(ENTRY.findall(text), start=1):
+        table[msg_id] = (name, LEVEL_IDS.get(level, 0), fmt)
+    return table
+
+
+def load_errors(path):
+    """Return {code: name} from the PER_* defines, names as logfmt_ErrorCode prints them."""
+    if not os.path.exists(path):
+        return {}
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    bases = {name: int(value, 0) for name, value in ERROR_BASE.findall(text)}
+    errors = {}
+    for name, base, offset in ERROR_ENTRY.findall(text):
+        short = name[len("PER_ERROR_"):] if name.startswith("PER_ERROR_") else name[len("PER_"):]
+        errors[bases.get(base, 0) + int(offset)] = short
+    return errors
+
+
+def format_args(fmt, args, errors=None):
+    it = iter(args)
+
+    def sub(m):
+        value = next(it, 0)
+        width, conv = m.group(1), m.group(2)
+        if conv == "E":
+            name = (errors or {}).get(value)
+            return ("%s(0x%04X)" % (name, value)) if name else ("0x%04X" % value)
+        if conv == "d" and value & 0x80000000:
+            value -= 1 << 32
+        return ("%" + width + conv) % value
+
+    return SPEC.sub(sub, fmt)
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT as logcrash_Crc16."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def flash_pages(data):
+    """Return the payload of the valid pages of a FLASH dump, oldest first."""
+    pages = []
+    for pos in range(0, len(data) - PAGE_SIZE + 1, PAGE_SIZE):
+        magic, seq, length, crc = PAGE_HDR.unpack_from(data, pos)
+        if magic != PAGE_MAGIC or seq == ERASED_SEQ or length > PAGE_SIZE - PAGE_HDR.size:
+            continue
+        payload = data[pos + PAGE_HDR.size:pos + PAGE_HDR.size + length]
+        if crc16(payload, crc16(data[pos:pos + PAGE_HDR.size - 2])) == crc:
+            pages.append((seq, payload))
+    return [payload for _, payload in sorted(pages)]
+
+
+def decode(data, table, errors=None):
+    pos = 0
+    while pos + HDR.size <= len(data):
+        msg_id, level, length, timestamp = HDR.unpack_from(data, pos)
+        pos += HDR.size
+        payload = data[pos:pos + length]
+        pos += length
+        if len(payload) < length or msg_id == QUERY_END_ID:
+            break
+
+        if msg_id == 0:
+            text = payload.decode("ascii", errors="replace")
+        elif msg_id in table:
+            args = struct.unpack("<%dI" % (length // 4), payload[:length // 4 * 4])
+            text = format_args(table[msg_id][2], args, errors)
+        else:
+            text = "<unknown message %d>" % msg_id
+
+        name = LEVELS[level] if level < len(LEVELS) else str(level)
+        yield timestamp, name, text
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--table", default=os.path.join(root, "Inc", "logger_msg.h"))
+    parser.add_argument("--errors", default=os.path.join(root, "Inc", "errorcode.h"))
+    parser.add_argument("--timestamps", action="store_true", help="prefix lines with the record timestamp")
+    parser.add_argument("--freq", type=float, default=0, help="timestamp frequency, print seconds instead of ticks")
+    parser.add_argument("--flash", action="store_true", help="input is a dump of the FLASH log area")
+    parser.add_argument("files", nargs="+")
+    opts = parser.parse_args()
+
+    table = load_table(opts.table)
+    errors = load_errors(opts.errors)
+    for path in opts.files:
+        with open(path, "rb") as f:
+            data = f.read()
+        if opts.flash:
+            data = b"".join(flash_pages(data))
+        for timestamp, level, text in decode(data, table, errors):
+            prefix = ""
+            if opts.timestamps:
+                prefix = ("%12.6f " % (timestamp / opts.freq)) if opts.freq else ("%10u " % timestamp)
+            sys.stdout.write("%s%6s - %s.\n" % (prefix, level, text))
+
+
+if __name__ == "__main__":
+    main()